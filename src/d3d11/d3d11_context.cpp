@@ -3369,19 +3369,21 @@ namespace dxvk {
     uint32_t slotId = computeConstantBufferBinding(ShaderStage,
       D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
     
+    // Shaders may still be translated in the background,
+    // so only wait for the result on the CS thread
     EmitCs([
       cSlotId = slotId,
       cStage  = GetShaderStage(ShaderStage),
-      cSlice  = pShaderModule           != nullptr
-             && pShaderModule->GetIcb() != nullptr
-        ? DxvkBufferSlice(pShaderModule->GetIcb())
-        : DxvkBufferSlice(),
       cShader = pShaderModule != nullptr
-        ? pShaderModule->GetShader()
-        : nullptr
+        ? *pShaderModule
+        : D3D11CommonShader()
     ] (DxvkContext* ctx) {
-      ctx->bindShader        (cStage, cShader);
-      ctx->bindResourceBuffer(cSlotId, cSlice);
+      Rc<DxvkBuffer> icb = cShader.GetIcb();
+
+      ctx->bindShader        (cStage, cShader.GetShader());
+      ctx->bindResourceBuffer(cSlotId, icb != nullptr
+        ? DxvkBufferSlice(icb)
+        : DxvkBufferSlice());
     });
   }
 
@@ -1987,15 +1987,26 @@ namespace dxvk {
     if (FAILED(hr))
       return hr;
 
-    auto shader = commonShader.GetShader();
+    // Checking shader flags requires waiting for the shader
+    // to be translated, so only do that if the device does
+    // not support all the relevant extensions anyway.
+    const auto& extensions = m_dxvkDevice->extensions();
 
-    if (shader->flags().test(DxvkShaderFlag::ExportsStencilRef)
-     && !m_dxvkDevice->extensions().extShaderStencilExport)
-      return E_INVALIDARG;
+    if (!extensions.extShaderStencilExport
+     || !extensions.extShaderViewportIndexLayer) {
+      auto shader = commonShader.GetShader();
 
-    if (shader->flags().test(DxvkShaderFlag::ExportsViewportIndexLayerFromVertexStage)
-     && !m_dxvkDevice->extensions().extShaderViewportIndexLayer)
-      return E_INVALIDARG;
+      if (shader == nullptr)
+        return E_INVALIDARG;
+
+      if (shader->flags().test(DxvkShaderFlag::ExportsStencilRef)
+       && !extensions.extShaderStencilExport)
+        return E_INVALIDARG;
+
+      if (shader->flags().test(DxvkShaderFlag::ExportsViewportIndexLayerFromVertexStage)
+       && !extensions.extShaderViewportIndexLayer)
+        return E_INVALIDARG;
+    }
 
     *pShaderModule = std::move(commonShader);
     return S_OK;
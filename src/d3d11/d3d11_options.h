@@ -74,6 +74,10 @@ namespace dxvk {
     /// Apitrace mode: Maps all buffers in cached memory.
     /// Enabled automatically if dxgitrace.dll is attached.
     bool apitraceMode;
+
+    /// Translate shaders on worker threads instead of
+    /// blocking the thread that creates the shader
+    bool asyncShaderTranslation;
   };
   
 }
\ No newline at end of file
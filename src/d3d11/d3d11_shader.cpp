@@ -2,81 +2,92 @@
 #include "d3d11_shader.h"
 
 namespace dxvk {
-  
+
   D3D11CommonShader:: D3D11CommonShader() { }
   D3D11CommonShader::~D3D11CommonShader() { }
-  
-  
+
+
   D3D11CommonShader::D3D11CommonShader(
-          D3D11Device*    pDevice,
-    const DxvkShaderKey*  pShaderKey,
-    const DxbcModuleInfo* pDxbcModuleInfo,
-    const void*           pShaderBytecode,
-          size_t          BytecodeLength) {
+          std::shared_future<D3D11CommonShaderData> Data)
+  : m_data(std::move(Data)) { }
+
+
+  D3D11CommonShaderData D3D11CommonShader::Translate(
+    const Rc<DxvkDevice>&   Device,
+    const DxvkShaderKey*    pShaderKey,
+    const DxbcModuleInfo*   pDxbcModuleInfo,
+    const DxbcModule&       Module) {
     const std::string name = pShaderKey->toString();
     Logger::debug(str::format("Compiling shader ", name));
-    
-    DxbcReader reader(
-      reinterpret_cast<const char*>(pShaderBytecode),
-      BytecodeLength);
-    
-    DxbcModule module(reader);
-    
-    // If requested by the user, dump both the raw DXBC
-    // shader and the compiled SPIR-V module to a file.
-    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
-    
-    if (dumpPath.size() != 0) {
-      reader.store(std::ofstream(str::format(dumpPath, "/", name, ".dxbc"),
-        std::ios_base::binary | std::ios_base::trunc));
-    }
-    
+
+    TraceScope trace("shader", "Translate DXBC", name.c_str());
+
+    D3D11CommonShaderData result;
+
     // Decide whether we need to create a pass-through
     // geometry shader for vertex shader stream output
     bool passthroughShader = pDxbcModuleInfo->xfb != nullptr
-      && module.programInfo().type() != DxbcProgramType::GeometryShader;
+      && Module.programInfo().type() != DxbcProgramType::GeometryShader;
+
+    result.shader = passthroughShader
+      ? Module.compilePassthroughShader(*pDxbcModuleInfo, name)
+      : Module.compile                 (*pDxbcModuleInfo, name);
+    result.shader->setShaderKey(*pShaderKey);
+
+    // If requested by the user, dump the
+    // compiled SPIR-V module to a file.
+    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
 
-    m_shader = passthroughShader
-      ? module.compilePassthroughShader(*pDxbcModuleInfo, name)
-      : module.compile                 (*pDxbcModuleInfo, name);
-    m_shader->setShaderKey(*pShaderKey);
-    
     if (dumpPath.size() != 0) {
       std::ofstream dumpStream(
         str::format(dumpPath, "/", name, ".spv"),
         std::ios_base::binary | std::ios_base::trunc);
-      
-      m_shader->dump(dumpStream);
+
+      result.shader->dump(dumpStream);
     }
-    
+
     // Create shader constant buffer if necessary
-    if (m_shader->shaderConstants().data() != nullptr) {
+    if (result.shader->shaderConstants().data() != nullptr) {
       DxvkBufferCreateInfo info;
-      info.size   = m_shader->shaderConstants().sizeInBytes();
+      info.size   = result.shader->shaderConstants().sizeInBytes();
       info.usage  = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-      info.stages = util::pipelineStages(m_shader->stage());
+      info.stages = util::pipelineStages(result.shader->stage());
       info.access = VK_ACCESS_UNIFORM_READ_BIT;
-      
+
       VkMemoryPropertyFlags memFlags
         = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
         | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-      
-      m_buffer = pDevice->GetDXVKDevice()->createBuffer(info, memFlags);
 
-      std::memcpy(m_buffer->mapPtr(0),
-        m_shader->shaderConstants().data(),
-        m_shader->shaderConstants().sizeInBytes());
+      result.icb = Device->createBuffer(info, memFlags);
+
+      std::memcpy(result.icb->mapPtr(0),
+        result.shader->shaderConstants().data(),
+        result.shader->shaderConstants().sizeInBytes());
     }
 
-    pDevice->GetDXVKDevice()->registerShader(m_shader);
+    Device->registerShader(result.shader);
+    return result;
   }
 
-  
+
   D3D11ShaderModuleSet:: D3D11ShaderModuleSet() { }
-  D3D11ShaderModuleSet::~D3D11ShaderModuleSet() { }
-  
-  
+
+
+  D3D11ShaderModuleSet::~D3D11ShaderModuleSet() {
+    // Workers drain the queue before exiting, so that
+    // every pending future will eventually be ready
+    { std::lock_guard<std::mutex> lock(m_workerLock);
+      m_stopThreads = true;
+    }
+
+    m_workerCond.notify_all();
+
+    for (auto& worker : m_workerThreads)
+      worker.join();
+  }
+
+
   HRESULT D3D11ShaderModuleSet::GetShaderModule(
           D3D11Device*        pDevice,
     const DxvkShaderKey*      pShaderKey,
@@ -86,40 +97,148 @@ namespace dxvk {
           D3D11CommonShader*  pShader) {
     // Use the shader's unique key for the lookup
     { std::unique_lock<std::mutex> lock(m_mutex);
-      
+
       auto entry = m_modules.find(*pShaderKey);
       if (entry != m_modules.end()) {
         *pShader = entry->second;
         return S_OK;
       }
     }
-    
-    // This shader has not been compiled yet, so we have to create a
-    // new module. This takes a while, so we won't lock the structure.
-    D3D11CommonShader module;
-    
+
+    // Parse the shader on the calling thread so that
+    // we can reject invalid bytecode right away. The
+    // module keeps its own copy of the shader code.
+    std::unique_ptr<DxbcModule> module;
+
     try {
-      module = D3D11CommonShader(pDevice, pShaderKey,
-        pDxbcModuleInfo, pShaderBytecode, BytecodeLength);
+      DxbcReader reader(
+        reinterpret_cast<const char*>(pShaderBytecode),
+        BytecodeLength);
+
+      module = std::make_unique<DxbcModule>(reader);
+
+      // If requested by the user, dump the raw DXBC shader
+      const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
+
+      if (dumpPath.size() != 0) {
+        reader.store(std::ofstream(str::format(dumpPath, "/", pShaderKey->toString(), ".dxbc"),
+          std::ios_base::binary | std::ios_base::trunc));
+      }
     } catch (const DxvkError& e) {
       Logger::err(e.message());
       return E_INVALIDARG;
     }
-    
+
+    // Stream output declarations reference application
+    // memory, so those shaders are translated right away.
+    bool async = pDevice->GetOptions()->asyncShaderTranslation
+              && pDxbcModuleInfo->xfb == nullptr;
+
+    D3D11CommonShader commonShader;
+    TranslationJob    job;
+
+    if (async) {
+      job.device     = pDevice->GetDXVKDevice();
+      job.key        = *pShaderKey;
+      job.moduleInfo = *pDxbcModuleInfo;
+      job.module     = std::move(module);
+
+      if (pDxbcModuleInfo->tess != nullptr)
+        job.tess = *pDxbcModuleInfo->tess;
+
+      commonShader = D3D11CommonShader(job.promise.get_future().share());
+    } else {
+      // This takes a while, so we won't lock the structure.
+      std::promise<D3D11CommonShaderData> promise;
+
+      try {
+        promise.set_value(D3D11CommonShader::Translate(
+          pDevice->GetDXVKDevice(), pShaderKey,
+          pDxbcModuleInfo, *module));
+      } catch (const DxvkError& e) {
+        Logger::err(e.message());
+        return E_INVALIDARG;
+      }
+
+      commonShader = D3D11CommonShader(promise.get_future().share());
+    }
+
     // Insert the new module into the lookup table. If another thread
     // has compiled the same shader in the meantime, we should return
     // that object instead and discard the newly created module.
     { std::unique_lock<std::mutex> lock(m_mutex);
-      
-      auto status = m_modules.insert({ *pShaderKey, module });
+
+      auto status = m_modules.insert({ *pShaderKey, commonShader });
       if (!status.second) {
         *pShader = status.first->second;
         return S_OK;
       }
     }
-    
-    *pShader = std::move(module);
+
+    if (async)
+      this->EnqueueJob(std::move(job));
+
+    *pShader = std::move(commonShader);
     return S_OK;
   }
-  
+
+
+  void D3D11ShaderModuleSet::EnqueueJob(
+          TranslationJob&&    Job) {
+    std::lock_guard<std::mutex> lock(m_workerLock);
+
+    // Start the worker threads on first use
+    if (m_workerThreads.empty()) {
+      uint32_t numWorkers = DxvkShader::getTranslationThreadCount();
+
+      Logger::info(str::format("D3D11: Using ", numWorkers, " shader translation threads"));
+
+      for (uint32_t i = 0; i < numWorkers; i++)
+        m_workerThreads.emplace_back([this] () { WorkerFunc(); });
+    }
+
+    m_workerQueue.push(std::move(Job));
+    m_workerCond.notify_one();
+  }
+
+
+  void D3D11ShaderModuleSet::WorkerFunc() {
+    env::setThreadName("dxvk-dxbc");
+
+    while (true) {
+      TranslationJob job;
+
+      { std::unique_lock<std::mutex> lock(m_workerLock);
+
+        m_workerCond.wait(lock, [this] () {
+          return !m_workerQueue.empty()
+              || m_stopThreads;
+        });
+
+        if (m_workerQueue.empty())
+          break;
+
+        job = std::move(m_workerQueue.front());
+        m_workerQueue.pop();
+      }
+
+      // The tessellation info pointer would otherwise still
+      // point to the stack of the thread creating the shader
+      if (job.moduleInfo.tess != nullptr)
+        job.moduleInfo.tess = &job.tess;
+
+      try {
+        job.promise.set_value(D3D11CommonShader::Translate(
+          job.device, &job.key, &job.moduleInfo, *job.module));
+      } catch (const DxvkError& e) {
+        // Shader creation has already succeeded, so
+        // the shader will simply remain unbound.
+        Logger::err(str::format("Failed to translate shader ", job.key.toString()));
+        Logger::err(e.message());
+
+        job.promise.set_value(D3D11CommonShaderData());
+      }
+    }
+  }
+
 }
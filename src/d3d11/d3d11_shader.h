@@ -1,6 +1,10 @@
 #pragma once
 
+#include <condition_variable>
+#include <future>
+#include <memory>
 #include <mutex>
+#include <queue>
 #include <unordered_map>
 
 #include "../dxbc/dxbc_module.h"
@@ -10,6 +14,7 @@
 
 #include "../util/sha1/sha1_util.h"
 
+#include "../util/thread.h"
 #include "../util/util_env.h"
 
 #include "d3d11_device_child.h"
@@ -19,12 +24,29 @@ namespace dxvk {
   
   class D3D11Device;
   
+  /**
+   * \brief Translated shader data
+   *
+   * Stores the compiled shader along with
+   * the immediate constant buffer, if any.
+   */
+  struct D3D11CommonShaderData {
+    Rc<DxvkShader> shader;
+    Rc<DxvkBuffer> icb;
+  };
+
+
   /**
    * \brief Common shader object
    * 
    * Stores the compiled SPIR-V shader and the SHA-1
    * hash of the original DXBC shader, which can be
    * used to identify the shader.
+   *
+   * Shaders may be translated on a worker thread,
+   * in which case accessing the compiled shader
+   * blocks until translation has finished. This
+   * should ideally only happen on the CS thread.
    */
   class D3D11CommonShader {
     
@@ -32,29 +54,40 @@ namespace dxvk {
     
     D3D11CommonShader();
     D3D11CommonShader(
-            D3D11Device*    pDevice,
-      const DxvkShaderKey*  pShaderKey,
-      const DxbcModuleInfo* pDxbcModuleInfo,
-      const void*           pShaderBytecode,
-            size_t          BytecodeLength);
+            std::shared_future<D3D11CommonShaderData> Data);
     ~D3D11CommonShader();
 
+    /**
+     * \brief Translates a shader
+     *
+     * \param [in] Device DXVK device
+     * \param [in] pShaderKey Shader key
+     * \param [in] pDxbcModuleInfo DXBC module info
+     * \param [in] Module The DXBC module
+     * \returns Compiled shader and ICB
+     */
+    static D3D11CommonShaderData Translate(
+      const Rc<DxvkDevice>&   Device,
+      const DxvkShaderKey*    pShaderKey,
+      const DxbcModuleInfo*   pDxbcModuleInfo,
+      const DxbcModule&       Module);
+
     Rc<DxvkShader> GetShader() const {
-      return m_shader;
+      return m_data.valid() ? m_data.get().shader : nullptr;
     }
 
     Rc<DxvkBuffer> GetIcb() const {
-      return m_buffer;
+      return m_data.valid() ? m_data.get().icb : nullptr;
     }
     
     std::string GetName() const {
-      return m_shader->debugName();
+      Rc<DxvkShader> shader = GetShader();
+      return shader != nullptr ? shader->debugName() : std::string();
     }
     
   private:
     
-    Rc<DxvkShader> m_shader;
-    Rc<DxvkBuffer> m_buffer;
+    std::shared_future<D3D11CommonShaderData> m_data;
     
   };
   
@@ -132,6 +165,10 @@ namespace dxvk {
    * times, so we should cache the resulting shader modules
    * and reuse them rather than creating new ones. This
    * class is thread-safe.
+   *
+   * Shaders are translated on a pool of worker threads,
+   * so that applications creating many shaders from one
+   * thread are not limited to a single core.
    */
   class D3D11ShaderModuleSet {
     
@@ -149,6 +186,15 @@ namespace dxvk {
             D3D11CommonShader*  pShader);
     
   private:
+
+    struct TranslationJob {
+      std::promise<D3D11CommonShaderData> promise;
+      Rc<DxvkDevice>              device;
+      DxvkShaderKey               key;
+      DxbcModuleInfo              moduleInfo;
+      DxbcTessInfo                tess;
+      std::unique_ptr<DxbcModule> module;
+    };
     
     std::mutex m_mutex;
     
@@ -156,6 +202,17 @@ namespace dxvk {
       DxvkShaderKey,
       D3D11CommonShader,
       DxvkHash, DxvkEq> m_modules;
+
+    std::mutex                  m_workerLock;
+    std::condition_variable     m_workerCond;
+    std::queue<TranslationJob>  m_workerQueue;
+    std::vector<dxvk::thread>   m_workerThreads;
+    bool                        m_stopThreads = false;
+
+    void EnqueueJob(
+            TranslationJob&&    Job);
+
+    void WorkerFunc();
     
   };
   
@@ -195,6 +195,8 @@ namespace dxvk {
           UINT                      SyncInterval,
           UINT                      PresentFlags,
     const DXGI_PRESENT_PARAMETERS*  pPresentParameters) {
+    TraceScope trace("app", "Present");
+
     auto options = m_parent->GetOptions();
 
     if (options->syncInterval >= 0)
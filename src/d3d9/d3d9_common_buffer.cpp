@@ -12,6 +12,17 @@ namespace dxvk {
     if (GetMapMode() == D3D9_COMMON_BUFFER_MAP_MODE_BUFFER)
       m_stagingBuffer = CreateStagingBuffer();
 
+    // Small dynamic buffers share memory for discards rather
+    // than each growing and keeping their own set of slices
+    const auto& arena = m_parent->GetDynamicBufferArena();
+
+    if (arena != nullptr
+     && (m_desc.Usage & D3DUSAGE_DYNAMIC)
+     && GetMapMode() == D3D9_COMMON_BUFFER_MAP_MODE_DIRECT
+     && m_desc.Size <= m_parent->GetOptions()->dynamicBufferArenaLimit
+     && arena->isCompatible(m_buffer->info(), m_buffer->memFlags()))
+      m_buffer->setArena(arena);
+
     m_sliceHandle = GetMapBuffer()->getSliceHandle();
   }
 
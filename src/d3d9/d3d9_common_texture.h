@@ -343,6 +343,18 @@ namespace dxvk {
     bool SetDirty(UINT Subresource, bool value) { return std::exchange(m_dirty[Subresource], value); }
     void MarkAllDirty() { for (uint32_t i = 0; i < m_dirty.size(); i++) m_dirty[i] = true; }
 
+    /**
+     * \brief Pending readback
+     *
+     * Stores the fence value of the last GPU copy into the
+     * mapping buffer of the given subresource that has not
+     * been waited for yet, or zero if there is none.
+     * \param [in] Subresource Subresource index
+     * \param [in] value New fence value
+     * \returns Previous fence value
+     */
+    uint64_t SetReadbackSeq(UINT Subresource, uint64_t value) { return std::exchange(m_readbackSeq[Subresource], value); }
+
   private:
 
     D3D9DeviceEx*                 m_device;
@@ -376,6 +388,9 @@ namespace dxvk {
     D3D9SubresourceArray<
       bool>                       m_dirty = { };
 
+    D3D9SubresourceArray<
+      uint64_t>                   m_readbackSeq = { };
+
     /**
      * \brief Mip level
      * \returns Size of packed mip level in bytes
@@ -0,0 +1,1315 @@
+#include "d3d9_cpu_shader.h"
+
+#include "../dxso/dxso_module.h"
+
+#include <algorithm>
+#include <array>
+
+namespace dxvk {
+
+  // Output registers used for shader models before 3.0.
+  // Colors and texture coordinates use registers 0 to 9.
+  constexpr uint32_t CpuOutputRegColor    = 0;
+  constexpr uint32_t CpuOutputRegTexcoord = 2;
+  constexpr uint32_t CpuOutputRegRaster   = 10;
+
+  // Same limits as the compiler. Anything above
+  // these would not run on real hardware either.
+  constexpr uint32_t CpuMaxFrameDepth = 64;
+  constexpr int32_t  CpuMaxLoopCount  = 255;
+
+
+  struct D3D9CpuVertexShader::ExecState {
+    const D3D9CpuVec4*  v;
+          D3D9CpuVec4*  o;
+    __m128              mask;
+    __m128              p[4];
+    __m128i             a[4];
+    int32_t             aL;
+    D3D9CpuVec4         r[DxsoMaxTempRegs];
+  };
+
+
+  static __m128 CpuAllLanes() {
+    return _mm_castsi128_ps(_mm_set1_epi32(-1));
+  }
+
+
+  static __m128 CpuNegate(__m128 x) {
+    return _mm_xor_ps(x, _mm_set1_ps(-0.0f));
+  }
+
+
+  static __m128 CpuAbs(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+  }
+
+
+  static __m128 CpuCompare(DxsoComparison Comparison, __m128 a, __m128 b) {
+    switch (Comparison) {
+      default:
+      case DxsoComparison::Never:        return _mm_setzero_ps();
+      case DxsoComparison::GreaterThan:  return _mm_cmpgt_ps(a, b);
+      case DxsoComparison::Equal:        return _mm_cmpeq_ps(a, b);
+      case DxsoComparison::GreaterEqual: return _mm_cmpge_ps(a, b);
+      case DxsoComparison::LessThan:     return _mm_cmplt_ps(a, b);
+      case DxsoComparison::NotEqual:     return _mm_and_ps(_mm_cmpneq_ps(a, b), _mm_cmpord_ps(a, b));
+      case DxsoComparison::LessEqual:    return _mm_cmple_ps(a, b);
+      case DxsoComparison::Always:       return CpuAllLanes();
+    }
+  }
+
+
+  static bool IsSupportedOpcode(DxsoOpcode Opcode) {
+    switch (Opcode) {
+      case DxsoOpcode::Mov:
+      case DxsoOpcode::Mova:
+      case DxsoOpcode::Add:
+      case DxsoOpcode::Sub:
+      case DxsoOpcode::Mad:
+      case DxsoOpcode::Mul:
+      case DxsoOpcode::Rcp:
+      case DxsoOpcode::Rsq:
+      case DxsoOpcode::Dp3:
+      case DxsoOpcode::Dp4:
+      case DxsoOpcode::Min:
+      case DxsoOpcode::Max:
+      case DxsoOpcode::Slt:
+      case DxsoOpcode::Sge:
+      case DxsoOpcode::Exp:
+      case DxsoOpcode::ExpP:
+      case DxsoOpcode::Log:
+      case DxsoOpcode::LogP:
+      case DxsoOpcode::Lit:
+      case DxsoOpcode::Dst:
+      case DxsoOpcode::Lrp:
+      case DxsoOpcode::Frc:
+      case DxsoOpcode::M4x4:
+      case DxsoOpcode::M4x3:
+      case DxsoOpcode::M3x4:
+      case DxsoOpcode::M3x3:
+      case DxsoOpcode::M3x2:
+      case DxsoOpcode::Pow:
+      case DxsoOpcode::Crs:
+      case DxsoOpcode::Sgn:
+      case DxsoOpcode::Abs:
+      case DxsoOpcode::Nrm:
+      case DxsoOpcode::SinCos:
+      case DxsoOpcode::SetP:
+      case DxsoOpcode::Call:
+      case DxsoOpcode::CallNz:
+      case DxsoOpcode::Ret:
+      case DxsoOpcode::Label:
+      case DxsoOpcode::Loop:
+      case DxsoOpcode::EndLoop:
+      case DxsoOpcode::Rep:
+      case DxsoOpcode::EndRep:
+      case DxsoOpcode::If:
+      case DxsoOpcode::Ifc:
+      case DxsoOpcode::Else:
+      case DxsoOpcode::EndIf:
+      case DxsoOpcode::Break:
+      case DxsoOpcode::BreakC:
+      case DxsoOpcode::BreakP:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
+  static uint32_t GetSourceCount(DxsoOpcode Opcode) {
+    switch (Opcode) {
+      case DxsoOpcode::Mad:
+      case DxsoOpcode::Lrp:
+        return 3;
+
+      case DxsoOpcode::Add:
+      case DxsoOpcode::Sub:
+      case DxsoOpcode::Mul:
+      case DxsoOpcode::Dp3:
+      case DxsoOpcode::Dp4:
+      case DxsoOpcode::Min:
+      case DxsoOpcode::Max:
+      case DxsoOpcode::Slt:
+      case DxsoOpcode::Sge:
+      case DxsoOpcode::Dst:
+      case DxsoOpcode::M4x4:
+      case DxsoOpcode::M4x3:
+      case DxsoOpcode::M3x4:
+      case DxsoOpcode::M3x3:
+      case DxsoOpcode::M3x2:
+      case DxsoOpcode::Pow:
+      case DxsoOpcode::Crs:
+      case DxsoOpcode::SetP:
+      case DxsoOpcode::Ifc:
+      case DxsoOpcode::BreakC:
+      case DxsoOpcode::Loop:
+        return 2;
+
+      case DxsoOpcode::Call:
+      case DxsoOpcode::Ret:
+      case DxsoOpcode::Label:
+      case DxsoOpcode::EndLoop:
+      case DxsoOpcode::EndRep:
+      case DxsoOpcode::Else:
+      case DxsoOpcode::EndIf:
+      case DxsoOpcode::Break:
+        return 0;
+
+      default:
+        return 1;
+    }
+  }
+
+
+  D3D9CpuVertexShader::D3D9CpuVertexShader(
+    const void*                   pBytecode,
+    const D3D9ConstantLayout&     Layout,
+    const DxsoOptions&            Options,
+    const D3D9CpuShaderConstants& Constants)
+  : m_floatEmulation(Options.d3d9FloatEmulation),
+    m_strictPow     (Options.strictPow) {
+    DecodeShader(pBytecode, Layout, Constants);
+
+    if (m_supported)
+      m_supported = LinkControlFlow();
+  }
+
+
+  void D3D9CpuVertexShader::Execute(
+    const D3D9CpuVec4*            pInputs,
+          D3D9CpuVec4*            pOutputs) const {
+    ExecState state;
+    state.v    = pInputs;
+    state.o    = pOutputs;
+    state.mask = CpuAllLanes();
+    state.aL   = 0;
+
+    for (uint32_t i = 0; i < 4; i++) {
+      state.p[i] = _mm_setzero_ps();
+      state.a[i] = _mm_setzero_si128();
+    }
+
+    for (uint32_t i = 0; i < m_tempCount; i++)
+      state.r[i] = CpuSplat(Vector4(0.0f));
+
+    for (const auto& output : m_outputs) {
+      // Fog defaults to 1 if the shader does not write it
+      float value = output.semantic.usage == DxsoUsage::Fog ? 1.0f : 0.0f;
+      pOutputs[output.regNumber] = CpuSplat(Vector4(value));
+    }
+
+    std::array<Frame, CpuMaxFrameDepth> frames;
+    uint32_t depth = 0;
+
+    uint32_t pc = 0;
+
+    while (pc < m_instructions.size()) {
+      const DxsoInstructionContext& ctx = m_instructions[pc];
+
+      switch (ctx.instruction.opcode) {
+        case DxsoOpcode::If:
+        case DxsoOpcode::Ifc: {
+          if (depth == CpuMaxFrameDepth)
+            return;
+
+          __m128 cond = _mm_and_ps(state.mask, LoadCondition(state, ctx));
+
+          Frame& frame = frames[depth++];
+          frame.type      = FrameType::If;
+          frame.savedMask = state.mask;
+          frame.condMask  = cond;
+
+          state.mask = cond;
+
+          if (!CpuAny(cond)) {
+            pc = m_links[pc];
+            continue;
+          }
+        } break;
+
+        case DxsoOpcode::Else: {
+          const Frame& frame = frames[depth - 1];
+          state.mask = _mm_andnot_ps(frame.condMask, frame.savedMask);
+
+          if (!CpuAny(state.mask)) {
+            pc = m_links[pc];
+            continue;
+          }
+        } break;
+
+        case DxsoOpcode::EndIf: {
+          state.mask = frames[--depth].savedMask;
+        } break;
+
+        case DxsoOpcode::Loop:
+        case DxsoOpcode::Rep: {
+          bool isLoop = ctx.instruction.opcode == DxsoOpcode::Loop;
+          Vector4i count = LoadInt(ctx.src[isLoop ? 1 : 0]);
+
+          if (count.x <= 0) {
+            pc = m_links[pc] + 1;
+            continue;
+          }
+
+          if (depth == CpuMaxFrameDepth)
+            return;
+
+          Frame& frame = frames[depth++];
+          frame.type       = FrameType::Loop;
+          frame.savedMask  = state.mask;
+          frame.pc         = pc;
+          frame.remaining  = std::min(count.x, CpuMaxLoopCount);
+          frame.loopBackup = state.aL;
+          frame.stride     = isLoop ? count.z : 0;
+
+          if (isLoop)
+            state.aL = count.y;
+        } break;
+
+        case DxsoOpcode::EndLoop:
+        case DxsoOpcode::EndRep: {
+          Frame& frame = frames[depth - 1];
+          state.aL += frame.stride;
+
+          if (--frame.remaining > 0 && CpuAny(state.mask)) {
+            pc = frame.pc + 1;
+            continue;
+          }
+
+          state.mask = frame.savedMask;
+          state.aL   = frame.loopBackup;
+          depth -= 1;
+        } break;
+
+        case DxsoOpcode::Break:
+        case DxsoOpcode::BreakC:
+        case DxsoOpcode::BreakP: {
+          __m128 cond = state.mask;
+
+          if (ctx.instruction.opcode != DxsoOpcode::Break)
+            cond = _mm_and_ps(cond, LoadCondition(state, ctx));
+
+          if (!CpuAny(cond))
+            break;
+
+          uint32_t loop = depth - 1;
+
+          while (frames[loop].type != FrameType::Loop)
+            loop -= 1;
+
+          // Lanes that break must stay disabled when
+          // leaving any branches inside the loop body
+          for (uint32_t i = loop + 1; i < depth; i++) {
+            frames[i].savedMask = _mm_andnot_ps(cond, frames[i].savedMask);
+            frames[i].condMask  = _mm_andnot_ps(cond, frames[i].condMask);
+          }
+
+          state.mask = _mm_andnot_ps(cond, state.mask);
+
+          if (!CpuAny(state.mask)) {
+            const Frame& frame = frames[loop];
+            state.mask = frame.savedMask;
+            state.aL   = frame.loopBackup;
+            depth = loop;
+
+            pc = m_links[frame.pc] + 1;
+            continue;
+          }
+        } break;
+
+        case DxsoOpcode::Call:
+        case DxsoOpcode::CallNz: {
+          __m128 cond = state.mask;
+
+          if (ctx.instruction.opcode == DxsoOpcode::CallNz)
+            cond = _mm_and_ps(cond, LoadCondition(state, ctx));
+
+          if (!CpuAny(cond))
+            break;
+
+          if (depth == CpuMaxFrameDepth)
+            return;
+
+          Frame& frame = frames[depth++];
+          frame.type      = FrameType::Call;
+          frame.savedMask = state.mask;
+          frame.pc        = pc + 1;
+
+          state.mask = cond;
+
+          pc = m_links[pc] + 1;
+          continue;
+        }
+
+        case DxsoOpcode::Ret: {
+          while (depth && frames[depth - 1].type != FrameType::Call)
+            depth -= 1;
+
+          // Returning from the main function
+          if (!depth)
+            return;
+
+          const Frame& frame = frames[--depth];
+          state.mask = frame.savedMask;
+
+          pc = frame.pc;
+          continue;
+        }
+
+        case DxsoOpcode::Label:
+          // Subroutines follow the main function
+          return;
+
+        default:
+          ExecuteAlu(state, ctx);
+      }
+
+      pc += 1;
+    }
+  }
+
+
+  void D3D9CpuVertexShader::DecodeShader(
+    const void*                   pBytecode,
+    const D3D9ConstantLayout&     Layout,
+    const D3D9CpuShaderConstants& Constants) {
+    DxsoReader reader(reinterpret_cast<const char*>(pBytecode));
+    DxsoModule module(reader);
+
+    m_info = module.info();
+
+    if (m_info.type() != DxsoProgramTypes::VertexShader) {
+      m_supported = false;
+      return;
+    }
+
+    m_fConsts.assign(Constants.fConsts, Constants.fConsts + Layout.floatCount);
+    m_iConsts.assign(Constants.iConsts, Constants.iConsts + Layout.intCount);
+    m_bConsts.assign(Constants.bConsts, Constants.bConsts + Layout.bitmaskCount);
+
+    const bool sm3 = m_info.majorVersion() >= 3;
+
+    auto isValidRegister = [&] (const DxsoRegister& reg) {
+      const uint32_t num = reg.id.num;
+
+      if (reg.hasRelative) {
+        if (reg.relative.id.type != DxsoRegisterType::Addr
+         && reg.relative.id.type != DxsoRegisterType::Loop)
+          return false;
+
+        // Only aL can index outputs
+        if (reg.id.type == DxsoRegisterType::Output
+         && reg.relative.id.type != DxsoRegisterType::Loop)
+          return false;
+      }
+
+      switch (reg.id.type) {
+        case DxsoRegisterType::Temp:          return num < DxsoMaxTempRegs;
+        case DxsoRegisterType::Input:         return num < DxsoMaxInterfaceRegs;
+        case DxsoRegisterType::Addr:          return num == 0;
+        case DxsoRegisterType::Loop:          return num == 0;
+        case DxsoRegisterType::Predicate:     return num == 0;
+        case DxsoRegisterType::RasterizerOut: return num <= RasterOutPointSize;
+        case DxsoRegisterType::AttributeOut:  return num < 2;
+        case DxsoRegisterType::Output:        return num < (sm3 ? 12u : 8u);
+        case DxsoRegisterType::Const:
+        case DxsoRegisterType::Const2:
+        case DxsoRegisterType::Const3:
+        case DxsoRegisterType::Const4:
+        case DxsoRegisterType::ConstInt:
+        case DxsoRegisterType::ConstBool:
+        case DxsoRegisterType::Label:
+          return true;
+
+        default:
+          return false;
+      }
+    };
+
+    auto useRegister = [&] (const DxsoRegister& reg) {
+      if (!isValidRegister(reg)) {
+        m_supported = false;
+        return;
+      }
+
+      switch (reg.id.type) {
+        case DxsoRegisterType::Temp:
+          m_tempCount = std::max(m_tempCount, reg.id.num + 1);
+          break;
+
+        case DxsoRegisterType::Input: {
+          // Like the compiler, treat undeclared inputs as colors
+          auto entry = std::find_if(m_inputs.begin(), m_inputs.end(),
+            [&] (const D3D9CpuShaderIo& io) { return io.regNumber == reg.id.num; });
+
+          if (entry == m_inputs.end())
+            m_inputs.push_back({ { DxsoUsage::Color, reg.id.num }, reg.id.num, IdentityWriteMask });
+        } break;
+
+        case DxsoRegisterType::RasterizerOut: {
+          static const std::array<DxsoUsage, 3> usages = {
+            DxsoUsage::Position, DxsoUsage::Fog, DxsoUsage::PointSize };
+
+          DeclareOutput({ usages[reg.id.num], 0 }, CpuOutputRegRaster + reg.id.num,
+            reg.id.num == RasterOutPosition ? IdentityWriteMask : DxsoRegMask(1));
+        } break;
+
+        case DxsoRegisterType::AttributeOut:
+          DeclareOutput({ DxsoUsage::Color, reg.id.num },
+            CpuOutputRegColor + reg.id.num, IdentityWriteMask);
+          break;
+
+        case DxsoRegisterType::Output:
+          if (!sm3) {
+            DeclareOutput({ DxsoUsage::Texcoord, reg.id.num },
+              CpuOutputRegTexcoord + reg.id.num, IdentityWriteMask);
+          }
+          break;
+
+        default:
+          break;
+      }
+    };
+
+    for (const auto& ctx : module.instructions()) {
+      const DxsoOpcode opcode = ctx.instruction.opcode;
+
+      switch (opcode) {
+        case DxsoOpcode::Nop:
+        case DxsoOpcode::Comment:
+        case DxsoOpcode::Phase:
+        case DxsoOpcode::End:
+          continue;
+
+        case DxsoOpcode::Dcl:
+          if (ctx.dst.id.type == DxsoRegisterType::Input) {
+            if (ctx.dst.id.num >= DxsoMaxInterfaceRegs)
+              m_supported = false;
+            else
+              m_inputs.push_back({ ctx.dcl.semantic, ctx.dst.id.num, ctx.dst.mask });
+          } else if (ctx.dst.id.type == DxsoRegisterType::Output) {
+            if (ctx.dst.id.num >= 12)
+              m_supported = false;
+            else
+              DeclareOutput(ctx.dcl.semantic, ctx.dst.id.num, ctx.dst.mask);
+          }
+          continue;
+
+        case DxsoOpcode::Def:
+          if (ctx.dst.id.num < m_fConsts.size()) {
+            m_fConsts[ctx.dst.id.num] = Vector4(
+              ctx.def.float32[0], ctx.def.float32[1],
+              ctx.def.float32[2], ctx.def.float32[3]);
+          }
+          continue;
+
+        case DxsoOpcode::DefI:
+          if (ctx.dst.id.num < m_iConsts.size()) {
+            m_iConsts[ctx.dst.id.num] = Vector4i(
+              ctx.def.int32[0], ctx.def.int32[1],
+              ctx.def.int32[2], ctx.def.int32[3]);
+          }
+          continue;
+
+        case DxsoOpcode::DefB:
+          if (ctx.dst.id.num / 32 < m_bConsts.size()) {
+            uint32_t bit = 1u << (ctx.dst.id.num % 32);
+            m_bConsts[ctx.dst.id.num / 32] &= ~bit;
+
+            if (ctx.def.uint32[0])
+              m_bConsts[ctx.dst.id.num / 32] |= bit;
+          }
+          continue;
+
+        default:
+          break;
+      }
+
+      if (!IsSupportedOpcode(opcode)) {
+        Logger::warn(str::format("D3D9CpuVertexShader: Unsupported opcode: ", opcode));
+        m_supported = false;
+        return;
+      }
+
+      bool hasDst = opcode != DxsoOpcode::If
+                 && opcode != DxsoOpcode::Ifc
+                 && opcode != DxsoOpcode::Else
+                 && opcode != DxsoOpcode::EndIf
+                 && opcode != DxsoOpcode::Loop
+                 && opcode != DxsoOpcode::EndLoop
+                 && opcode != DxsoOpcode::Rep
+                 && opcode != DxsoOpcode::EndRep
+                 && opcode != DxsoOpcode::Break
+                 && opcode != DxsoOpcode::BreakC
+                 && opcode != DxsoOpcode::BreakP
+                 && opcode != DxsoOpcode::Ret;
+
+      if (hasDst)
+        useRegister(ctx.dst);
+
+      // The decoder does not reset unused operands,
+      // so only look at the ones the opcode reads
+      for (uint32_t i = 0; i < GetSourceCount(opcode); i++)
+        useRegister(ctx.src[i]);
+
+      if (opcode >= DxsoOpcode::M4x4 && opcode <= DxsoOpcode::M3x2) {
+        for (uint32_t i = 1; i < 4; i++) {
+          DxsoRegister row = ctx.src[1];
+          row.id.num += i;
+          useRegister(row);
+        }
+      }
+
+      if (ctx.instruction.predicated)
+        useRegister(ctx.pred);
+
+      m_instructions.push_back(ctx);
+    }
+  }
+
+
+  bool D3D9CpuVertexShader::LinkControlFlow() {
+    const uint32_t count = uint32_t(m_instructions.size());
+
+    m_links.resize(count, ~0u);
+
+    std::vector<uint32_t> stack;
+
+    auto topIs = [&] (std::initializer_list<DxsoOpcode> opcodes) {
+      if (stack.empty())
+        return false;
+
+      DxsoOpcode top = m_instructions[stack.back()].instruction.opcode;
+      return std::find(opcodes.begin(), opcodes.end(), top) != opcodes.end();
+    };
+
+    for (uint32_t i = 0; i < count; i++) {
+      const DxsoInstructionContext& ctx = m_instructions[i];
+
+      switch (ctx.instruction.opcode) {
+        case DxsoOpcode::If:
+        case DxsoOpcode::Ifc:
+        case DxsoOpcode::Loop:
+        case DxsoOpcode::Rep:
+          stack.push_back(i);
+          break;
+
+        case DxsoOpcode::Else:
+          if (!topIs({ DxsoOpcode::If, DxsoOpcode::Ifc }))
+            return false;
+
+          m_links[stack.back()] = i;
+          stack.back() = i;
+          break;
+
+        case DxsoOpcode::EndIf:
+          if (!topIs({ DxsoOpcode::If, DxsoOpcode::Ifc, DxsoOpcode::Else }))
+            return false;
+
+          m_links[stack.back()] = i;
+          stack.pop_back();
+          break;
+
+        case DxsoOpcode::EndLoop:
+        case DxsoOpcode::EndRep:
+          if (!topIs({ ctx.instruction.opcode == DxsoOpcode::EndLoop
+              ? DxsoOpcode::Loop : DxsoOpcode::Rep }))
+            return false;
+
+          m_links[stack.back()] = i;
+          m_links[i] = stack.back();
+          stack.pop_back();
+          break;
+
+        case DxsoOpcode::Break:
+        case DxsoOpcode::BreakC:
+        case DxsoOpcode::BreakP: {
+          bool inLoop = std::any_of(stack.begin(), stack.end(), [&] (uint32_t index) {
+            DxsoOpcode opcode = m_instructions[index].instruction.opcode;
+            return opcode == DxsoOpcode::Loop || opcode == DxsoOpcode::Rep;
+          });
+
+          if (!inLoop)
+            return false;
+        } break;
+
+        case DxsoOpcode::Label: {
+          if (!stack.empty())
+            return false;
+
+          uint32_t label = ctx.dst.id.num;
+
+          if (label >= m_labels.size())
+            m_labels.resize(label + 1, ~0u);
+
+          m_labels[label] = i;
+        } break;
+
+        default:
+          break;
+      }
+    }
+
+    if (!stack.empty())
+      return false;
+
+    // Resolve call targets now that all labels are known
+    for (uint32_t i = 0; i < count; i++) {
+      const DxsoInstructionContext& ctx = m_instructions[i];
+
+      if (ctx.instruction.opcode != DxsoOpcode::Call
+       && ctx.instruction.opcode != DxsoOpcode::CallNz)
+        continue;
+
+      uint32_t label = ctx.dst.id.num;
+
+      if (label >= m_labels.size() || m_labels[label] == ~0u)
+        return false;
+
+      m_links[i] = m_labels[label];
+    }
+
+    return true;
+  }
+
+
+  void D3D9CpuVertexShader::DeclareOutput(
+          DxsoSemantic            Semantic,
+          uint32_t                RegNumber,
+          DxsoRegMask             Mask) {
+    for (const auto& output : m_outputs) {
+      if (output.semantic == Semantic && output.regNumber == RegNumber)
+        return;
+    }
+
+    m_outputs.push_back({ Semantic, RegNumber, Mask });
+  }
+
+
+  uint32_t D3D9CpuVertexShader::GetOutputIndex(
+    const ExecState&              State,
+    const DxsoRegister&           Reg) const {
+    switch (Reg.id.type) {
+      case DxsoRegisterType::RasterizerOut:
+        return CpuOutputRegRaster + Reg.id.num;
+
+      case DxsoRegisterType::AttributeOut:
+        return CpuOutputRegColor + Reg.id.num;
+
+      case DxsoRegisterType::Output: {
+        if (m_info.majorVersion() < 3)
+          return CpuOutputRegTexcoord + Reg.id.num;
+
+        uint32_t index = Reg.id.num + (Reg.hasRelative ? State.aL : 0);
+        return index < 12 ? index : ~0u;
+      }
+
+      default:
+        return ~0u;
+    }
+  }
+
+
+  __m128i D3D9CpuVertexShader::LoadRelative(
+    const ExecState&              State,
+    const DxsoBaseRegister&       Reg) const {
+    if (Reg.id.type == DxsoRegisterType::Loop)
+      return _mm_set1_epi32(State.aL);
+
+    return State.a[Reg.swizzle[0]];
+  }
+
+
+  D3D9CpuVec4 D3D9CpuVertexShader::LoadConstant(
+    const ExecState&              State,
+    const DxsoRegister&           Reg) const {
+    uint32_t base = Reg.id.num;
+
+    switch (Reg.id.type) {
+      case DxsoRegisterType::Const2: base += 2048; break;
+      case DxsoRegisterType::Const3: base += 4096; break;
+      case DxsoRegisterType::Const4: base += 6144; break;
+      default: break;
+    }
+
+    auto fetch = [this] (uint32_t index) {
+      return index < m_fConsts.size() ? m_fConsts[index] : Vector4(0.0f);
+    };
+
+    if (!Reg.hasRelative)
+      return CpuSplat(fetch(base));
+
+    alignas(16) int32_t offsets[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(offsets), LoadRelative(State, Reg.relative));
+
+    // Relative addressing is usually uniform across the batch
+    if (offsets[0] == offsets[1] && offsets[0] == offsets[2] && offsets[0] == offsets[3])
+      return CpuSplat(fetch(base + offsets[0]));
+
+    std::array<Vector4, 4> values;
+
+    for (uint32_t i = 0; i < 4; i++)
+      values[i] = fetch(base + offsets[i]);
+
+    return CpuLoad(values.data());
+  }
+
+
+  D3D9CpuVec4 D3D9CpuVertexShader::LoadRaw(
+    const ExecState&              State,
+    const DxsoRegister&           Reg) const {
+    switch (Reg.id.type) {
+      case DxsoRegisterType::Temp:
+        return State.r[Reg.id.num];
+
+      case DxsoRegisterType::Input: {
+        if (!Reg.hasRelative)
+          return State.v[Reg.id.num];
+
+        alignas(16) int32_t offsets[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(offsets), LoadRelative(State, Reg.relative));
+
+        D3D9CpuVec4 result;
+
+        for (uint32_t c = 0; c < 4; c++) {
+          alignas(16) float lanes[4];
+
+          for (uint32_t i = 0; i < 4; i++) {
+            uint32_t index = Reg.id.num + offsets[i];
+
+            alignas(16) float values[4];
+            _mm_store_ps(values, index < DxsoMaxInterfaceRegs
+              ? State.v[index][c] : _mm_setzero_ps());
+            lanes[i] = values[i];
+          }
+
+          result[c] = _mm_load_ps(lanes);
+        }
+
+        return result;
+      }
+
+      case DxsoRegisterType::Const:
+      case DxsoRegisterType::Const2:
+      case DxsoRegisterType::Const3:
+      case DxsoRegisterType::Const4:
+        return LoadConstant(State, Reg);
+
+      case DxsoRegisterType::ConstInt: {
+        Vector4i value = Reg.id.num < m_iConsts.size()
+          ? m_iConsts[Reg.id.num] : Vector4i();
+
+        return CpuSplat(Vector4(
+          float(value.x), float(value.y),
+          float(value.z), float(value.w)));
+      }
+
+      case DxsoRegisterType::ConstBool:
+        return CpuSplat(Vector4(LoadBool(Reg) ? 1.0f : 0.0f));
+
+      case DxsoRegisterType::Addr: {
+        D3D9CpuVec4 result;
+
+        for (uint32_t c = 0; c < 4; c++)
+          result[c] = _mm_cvtepi32_ps(State.a[c]);
+
+        return result;
+      }
+
+      case DxsoRegisterType::Loop:
+        return CpuSplat(Vector4(float(State.aL)));
+
+      case DxsoRegisterType::Predicate: {
+        D3D9CpuVec4 result;
+
+        for (uint32_t c = 0; c < 4; c++)
+          result[c] = _mm_and_ps(State.p[c], _mm_set1_ps(1.0f));
+
+        return result;
+      }
+
+      case DxsoRegisterType::RasterizerOut:
+      case DxsoRegisterType::AttributeOut:
+      case DxsoRegisterType::Output: {
+        uint32_t index = GetOutputIndex(State, Reg);
+
+        if (index < D3D9CpuOutputRegCount)
+          return State.o[index];
+      } [[fallthrough]];
+
+      default:
+        return CpuSplat(Vector4(0.0f));
+    }
+  }
+
+
+  D3D9CpuVec4 D3D9CpuVertexShader::LoadSrc(
+    const ExecState&              State,
+    const DxsoRegister&           Reg) const {
+    D3D9CpuVec4 raw = LoadRaw(State, Reg);
+
+    if (Reg.modifier == DxsoRegModifier::Dz
+     || Reg.modifier == DxsoRegModifier::Dw) {
+      __m128 divisor = raw[Reg.modifier == DxsoRegModifier::Dz ? 2 : 3];
+
+      for (uint32_t c = 0; c < 4; c++)
+        raw[c] = _mm_div_ps(raw[c], divisor);
+    }
+
+    D3D9CpuVec4 result;
+
+    for (uint32_t c = 0; c < 4; c++) {
+      __m128 x = raw[Reg.swizzle[c]];
+
+      switch (Reg.modifier) {
+        case DxsoRegModifier::Neg:
+          x = CpuNegate(x);
+          break;
+
+        case DxsoRegModifier::Bias:
+        case DxsoRegModifier::BiasNeg:
+          x = _mm_sub_ps(x, _mm_set1_ps(0.5f));
+          break;
+
+        case DxsoRegModifier::Sign:
+        case DxsoRegModifier::SignNeg:
+          x = _mm_sub_ps(_mm_add_ps(x, x), _mm_set1_ps(1.0f));
+          break;
+
+        case DxsoRegModifier::Comp:
+          x = _mm_sub_ps(_mm_set1_ps(1.0f), x);
+          break;
+
+        case DxsoRegModifier::X2:
+        case DxsoRegModifier::X2Neg:
+          x = _mm_add_ps(x, x);
+          break;
+
+        case DxsoRegModifier::Abs:
+        case DxsoRegModifier::AbsNeg:
+          x = CpuAbs(x);
+          break;
+
+        default:
+          break;
+      }
+
+      if (Reg.modifier == DxsoRegModifier::BiasNeg
+       || Reg.modifier == DxsoRegModifier::SignNeg
+       || Reg.modifier == DxsoRegModifier::X2Neg
+       || Reg.modifier == DxsoRegModifier::AbsNeg)
+        x = CpuNegate(x);
+
+      result[c] = x;
+    }
+
+    return result;
+  }
+
+
+  __m128 D3D9CpuVertexShader::LoadCondition(
+    const ExecState&              State,
+    const DxsoInstructionContext& Ctx) const {
+    if (Ctx.instruction.opcode == DxsoOpcode::Ifc
+     || Ctx.instruction.opcode == DxsoOpcode::BreakC) {
+      __m128 a = LoadSrc(State, Ctx.src[0])[0];
+      __m128 b = LoadSrc(State, Ctx.src[1])[0];
+      return CpuCompare(Ctx.instruction.specificData.comparison, a, b);
+    }
+
+    const DxsoRegister& reg = Ctx.src[0];
+    __m128 cond;
+
+    if (reg.id.type == DxsoRegisterType::ConstBool)
+      cond = LoadBool(reg) ? CpuAllLanes() : _mm_setzero_ps();
+    else
+      cond = State.p[reg.swizzle[0]];
+
+    if (reg.modifier == DxsoRegModifier::Not)
+      cond = _mm_xor_ps(cond, CpuAllLanes());
+
+    return cond;
+  }
+
+
+  bool D3D9CpuVertexShader::LoadBool(
+    const DxsoRegister&           Reg) const {
+    uint32_t index = Reg.id.num / 32;
+
+    if (index >= m_bConsts.size())
+      return false;
+
+    return (m_bConsts[index] >> (Reg.id.num % 32)) & 1;
+  }
+
+
+  Vector4i D3D9CpuVertexShader::LoadInt(
+    const DxsoRegister&           Reg) const {
+    Vector4i value = Reg.id.num < m_iConsts.size()
+      ? m_iConsts[Reg.id.num] : Vector4i();
+
+    return Vector4i(
+      value.data[Reg.swizzle[0]], value.data[Reg.swizzle[1]],
+      value.data[Reg.swizzle[2]], value.data[Reg.swizzle[3]]);
+  }
+
+
+  void D3D9CpuVertexShader::StoreDst(
+          ExecState&              State,
+    const DxsoInstructionContext& Ctx,
+          D3D9CpuVec4             Value) const {
+    const DxsoRegister& dst = Ctx.dst;
+
+    __m128 writeMask[4];
+
+    for (uint32_t c = 0; c < 4; c++) {
+      writeMask[c] = State.mask;
+
+      if (Ctx.instruction.predicated) {
+        __m128 pred = State.p[Ctx.pred.swizzle[c]];
+
+        if (Ctx.pred.modifier == DxsoRegModifier::Not)
+          pred = _mm_xor_ps(pred, CpuAllLanes());
+
+        writeMask[c] = _mm_and_ps(writeMask[c], pred);
+      }
+    }
+
+    if (dst.id.type == DxsoRegisterType::Addr) {
+      bool floor = m_info.majorVersion() < 2 && m_info.minorVersion() < 2;
+
+      for (uint32_t c = 0; c < 4; c++) {
+        if (!dst.mask[c])
+          continue;
+
+        __m128i value = floor
+          ? _mm_cvttps_epi32(CpuFloor(Value[c]))
+          : _mm_cvtps_epi32(Value[c]);
+
+        __m128i mask = _mm_castps_si128(writeMask[c]);
+        State.a[c] = _mm_or_si128(_mm_and_si128(mask, value), _mm_andnot_si128(mask, State.a[c]));
+      }
+
+      return;
+    }
+
+    D3D9CpuVec4* reg = nullptr;
+    DxsoRegMask  mask = dst.mask;
+    bool         saturate = dst.saturate;
+
+    if (dst.id.type == DxsoRegisterType::Temp) {
+      reg = &State.r[dst.id.num];
+    } else {
+      uint32_t index = GetOutputIndex(State, dst);
+
+      if (index >= D3D9CpuOutputRegCount)
+        return;
+
+      reg = &State.o[index];
+
+      // Fog and point size are scalar, and fog is always saturated
+      if (dst.id.type == DxsoRegisterType::RasterizerOut
+       && dst.id.num != RasterOutPosition) {
+        mask = DxsoRegMask(1);
+        saturate |= dst.id.num == RasterOutFog;
+      }
+    }
+
+    for (uint32_t c = 0; c < 4; c++) {
+      if (!mask[c])
+        continue;
+
+      __m128 value = saturate ? CpuSaturate(Value[c]) : Value[c];
+      (*reg)[c] = CpuSelect(writeMask[c], value, (*reg)[c]);
+    }
+  }
+
+
+  void D3D9CpuVertexShader::ExecuteAlu(
+          ExecState&              State,
+    const DxsoInstructionContext& Ctx) const {
+    const DxsoOpcode opcode = Ctx.instruction.opcode;
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+
+    auto src = [&] (uint32_t i) {
+      return LoadSrc(State, Ctx.src[i]);
+    };
+
+    auto map1 = [&] (auto fn) {
+      D3D9CpuVec4 a = src(0);
+
+      for (uint32_t c = 0; c < 4; c++)
+        a[c] = fn(a[c]);
+
+      return a;
+    };
+
+    auto map2 = [&] (auto fn) {
+      D3D9CpuVec4 a = src(0);
+      D3D9CpuVec4 b = src(1);
+
+      for (uint32_t c = 0; c < 4; c++)
+        a[c] = fn(a[c], b[c]);
+
+      return a;
+    };
+
+    auto map3 = [&] (auto fn) {
+      D3D9CpuVec4 a = src(0);
+      D3D9CpuVec4 b = src(1);
+      D3D9CpuVec4 d = src(2);
+
+      for (uint32_t c = 0; c < 4; c++)
+        a[c] = fn(a[c], b[c], d[c]);
+
+      return a;
+    };
+
+    auto clampMax = [&] (__m128 x) {
+      // Returns the second operand for NaN
+      return m_floatEmulation ? _mm_min_ps(x, _mm_set1_ps(FLT_MAX)) : x;
+    };
+
+    auto exp2 = [] (__m128 x) {
+      return CpuPerLane(x, [] (float f) { return std::exp2(f); });
+    };
+
+    D3D9CpuVec4 result;
+
+    switch (opcode) {
+      case DxsoOpcode::Mov:
+      case DxsoOpcode::Mova:
+        result = src(0);
+        break;
+
+      case DxsoOpcode::Add:
+        result = map2([] (__m128 a, __m128 b) { return _mm_add_ps(a, b); });
+        break;
+
+      case DxsoOpcode::Sub:
+        result = map2([] (__m128 a, __m128 b) { return _mm_sub_ps(a, b); });
+        break;
+
+      case DxsoOpcode::Mul:
+        result = map2([] (__m128 a, __m128 b) { return _mm_mul_ps(a, b); });
+        break;
+
+      case DxsoOpcode::Mad:
+        result = map3([] (__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); });
+        break;
+
+      case DxsoOpcode::Min:
+        result = map2([] (__m128 a, __m128 b) { return _mm_min_ps(a, b); });
+        break;
+
+      case DxsoOpcode::Max:
+        result = map2([] (__m128 a, __m128 b) { return _mm_max_ps(a, b); });
+        break;
+
+      case DxsoOpcode::Slt:
+        result = map2([&] (__m128 a, __m128 b) { return _mm_and_ps(_mm_cmplt_ps(a, b), one); });
+        break;
+
+      case DxsoOpcode::Sge:
+        result = map2([&] (__m128 a, __m128 b) { return _mm_and_ps(_mm_cmpge_ps(a, b), one); });
+        break;
+
+      case DxsoOpcode::Rcp:
+        result = map1([&] (__m128 a) { return clampMax(_mm_div_ps(one, a)); });
+        break;
+
+      case DxsoOpcode::Rsq:
+        result = map1([&] (__m128 a) { return clampMax(CpuRsq(CpuAbs(a))); });
+        break;
+
+      case DxsoOpcode::Abs:
+        result = map1([] (__m128 a) { return CpuAbs(a); });
+        break;
+
+      case DxsoOpcode::Frc:
+        result = map1([] (__m128 a) { return _mm_sub_ps(a, CpuFloor(a)); });
+        break;
+
+      case DxsoOpcode::Sgn:
+        result = map1([&] (__m128 a) {
+          return _mm_sub_ps(
+            _mm_and_ps(_mm_cmpgt_ps(a, zero), one),
+            _mm_and_ps(_mm_cmplt_ps(a, zero), one));
+        });
+        break;
+
+      case DxsoOpcode::ExpP:
+        if (m_info.majorVersion() < 2) {
+          __m128 x = src(0)[0];
+          __m128 f = CpuFloor(x);
+
+          result[0] = exp2(f);
+          result[1] = _mm_sub_ps(x, f);
+          result[2] = exp2(x);
+          result[3] = one;
+          break;
+        } [[fallthrough]];
+
+      case DxsoOpcode::Exp:
+        result = map1(exp2);
+        break;
+
+      case DxsoOpcode::Log:
+      case DxsoOpcode::LogP:
+        result = map1([&] (__m128 a) {
+          __m128 r = CpuPerLane(CpuAbs(a), [] (float f) { return std::log2(f); });
+          return m_floatEmulation ? _mm_max_ps(r, _mm_set1_ps(-FLT_MAX)) : r;
+        });
+        break;
+
+      case DxsoOpcode::Pow:
+        result = map2([&] (__m128 a, __m128 b) {
+          __m128 r = CpuPow(CpuAbs(a), b);
+
+          if (m_strictPow && m_floatEmulation)
+            r = CpuSelect(_mm_cmpeq_ps(b, zero), one, r);
+
+          return r;
+        });
+        break;
+
+      case DxsoOpcode::Lrp:
+        result = map3([] (__m128 a, __m128 b, __m128 c) {
+          return _mm_add_ps(c, _mm_mul_ps(a, _mm_sub_ps(b, c)));
+        });
+        break;
+
+      case DxsoOpcode::Dp3:
+      case DxsoOpcode::Dp4: {
+        D3D9CpuVec4 a = src(0);
+        D3D9CpuVec4 b = src(1);
+
+        __m128 dot = opcode == DxsoOpcode::Dp3
+          ? CpuDot3(a, b) : CpuDot4(a, b);
+
+        for (uint32_t c = 0; c < 4; c++)
+          result[c] = dot;
+      } break;
+
+      case DxsoOpcode::M4x4:
+      case DxsoOpcode::M4x3:
+      case DxsoOpcode::M3x4:
+      case DxsoOpcode::M3x3:
+      case DxsoOpcode::M3x2: {
+        uint32_t dotCount  = 4;
+        uint32_t iterCount = 4;
+
+        switch (opcode) {
+          case DxsoOpcode::M4x3: iterCount = 3; break;
+          case DxsoOpcode::M3x4: dotCount  = 3; break;
+          case DxsoOpcode::M3x3: dotCount  = 3; iterCount = 3; break;
+          case DxsoOpcode::M3x2: dotCount  = 3; iterCount = 2; break;
+          default: break;
+        }
+
+        D3D9CpuVec4 a = src(0);
+
+        for (uint32_t i = 0; i < 4; i++) {
+          if (i >= iterCount) {
+            result[i] = zero;
+            continue;
+          }
+
+          DxsoRegister row = Ctx.src[1];
+          row.id.num += i;
+
+          D3D9CpuVec4 b = LoadSrc(State, row);
+          result[i] = dotCount == 3 ? CpuDot3(a, b) : CpuDot4(a, b);
+        }
+      } break;
+
+      case DxsoOpcode::Nrm: {
+        D3D9CpuVec4 a = src(0);
+        __m128 rsq = clampMax(CpuRsq(CpuDot3(a, a)));
+
+        for (uint32_t c = 0; c < 4; c++)
+          result[c] = _mm_mul_ps(a[c], rsq);
+      } break;
+
+      case DxsoOpcode::Crs: {
+        D3D9CpuVec4 a = src(0);
+        D3D9CpuVec4 b = src(1);
+
+        result[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+        result[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+        result[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+        result[3] = zero;
+      } break;
+
+      case DxsoOpcode::SinCos: {
+        __m128 x = src(0)[0];
+
+        result[0] = CpuPerLane(x, [] (float f) { return std::cos(f); });
+        result[1] = CpuPerLane(x, [] (float f) { return std::sin(f); });
+        result[2] = zero;
+        result[3] = zero;
+      } break;
+
+      case DxsoOpcode::Lit: {
+        D3D9CpuVec4 a = src(0);
+
+        __m128 power = _mm_min_ps(_mm_max_ps(a[3],
+          _mm_set1_ps(-127.9961f)), _mm_set1_ps(127.9961f));
+
+        __m128 lit = _mm_and_ps(
+          _mm_cmpge_ps(a[0], zero),
+          _mm_cmpge_ps(a[1], zero));
+
+        result[0] = one;
+        result[1] = _mm_max_ps(a[0], zero);
+        result[2] = _mm_and_ps(lit, CpuPow(a[1], power));
+        result[3] = one;
+      } break;
+
+      case DxsoOpcode::Dst: {
+        D3D9CpuVec4 a = src(0);
+        D3D9CpuVec4 b = src(1);
+
+        result[0] = one;
+        result[1] = _mm_mul_ps(a[1], b[1]);
+        result[2] = a[2];
+        result[3] = b[3];
+      } break;
+
+      case DxsoOpcode::SetP: {
+        D3D9CpuVec4 a = src(0);
+        D3D9CpuVec4 b = src(1);
+
+        for (uint32_t c = 0; c < 4; c++) {
+          if (!Ctx.dst.mask[c])
+            continue;
+
+          __m128 mask = State.mask;
+
+          if (Ctx.instruction.predicated) {
+            __m128 pred = State.p[Ctx.pred.swizzle[c]];
+
+            if (Ctx.pred.modifier == DxsoRegModifier::Not)
+              pred = _mm_xor_ps(pred, CpuAllLanes());
+
+            mask = _mm_and_ps(mask, pred);
+          }
+
+          __m128 value = CpuCompare(Ctx.instruction.specificData.comparison, a[c], b[c]);
+          State.p[c] = CpuSelect(mask, value, State.p[c]);
+        }
+      } return;
+
+      default:
+        return;
+    }
+
+    StoreDst(State, Ctx, result);
+  }
+
+}
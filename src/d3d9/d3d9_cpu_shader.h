@@ -0,0 +1,202 @@
+#pragma once
+
+#include "d3d9_constant_layout.h"
+#include "d3d9_cpu_simd.h"
+
+#include "../dxso/dxso_decoder.h"
+#include "../dxso/dxso_options.h"
+
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Number of output registers
+   *
+   * Shader model 3 uses \c o0 to \c o11. Older shader
+   * models have dedicated output registers, which are
+   * mapped to the same register file, see \ref
+   * D3D9CpuVertexShader::GetOutputs.
+   */
+  constexpr uint32_t D3D9CpuOutputRegCount = 16;
+
+  /**
+   * \brief Shader constants for CPU vertex shaders
+   *
+   * Points to the application-provided constants. Values
+   * defined within the shader take precedence.
+   */
+  struct D3D9CpuShaderConstants {
+    const Vector4*  fConsts = nullptr;
+    const Vector4i* iConsts = nullptr;
+    const uint32_t* bConsts = nullptr;
+  };
+
+  /**
+   * \brief Shader input or output
+   */
+  struct D3D9CpuShaderIo {
+    DxsoSemantic semantic;
+    uint32_t     regNumber;
+    DxsoRegMask  mask;
+  };
+
+  /**
+   * \brief DXSO vertex shader interpreter
+   *
+   * Executes \c vs_1_1 to \c vs_3_0 shaders on the CPU,
+   * four vertices at a time. Each register holds one
+   * component per SSE register, so that all arithmetic
+   * runs on the whole batch at once.
+   *
+   * Conditional branches and breaks may diverge within
+   * a batch. Like on a GPU, both sides of a branch are
+   * executed in that case, and lanes that do not take
+   * a branch are masked out when writing registers.
+   *
+   * Vertex texture fetches are not supported.
+   */
+  class D3D9CpuVertexShader {
+
+  public:
+
+    D3D9CpuVertexShader(
+      const void*                   pBytecode,
+      const D3D9ConstantLayout&     Layout,
+      const DxsoOptions&            Options,
+      const D3D9CpuShaderConstants& Constants);
+
+    /**
+     * \brief Checks whether the shader can be executed
+     * \returns \c false if the shader uses unsupported features
+     */
+    bool IsSupported() const {
+      return m_supported;
+    }
+
+    /**
+     * \brief Shader inputs
+     *
+     * The register number is the index into
+     * the input array passed to \ref Execute.
+     * \returns Input declarations
+     */
+    const std::vector<D3D9CpuShaderIo>& GetInputs() const {
+      return m_inputs;
+    }
+
+    /**
+     * \brief Shader outputs
+     *
+     * The register number is the index into the output
+     * array written by \ref Execute. Only the components
+     * in the mask belong to the given semantic. Colors of
+     * shader models before 3.0 are saturated.
+     * \returns Output declarations
+     */
+    const std::vector<D3D9CpuShaderIo>& GetOutputs() const {
+      return m_outputs;
+    }
+
+    /**
+     * \brief Runs the shader for a batch of vertices
+     *
+     * \param [in] pInputs Input registers
+     * \param [out] pOutputs Output registers, must have
+     *    room for \ref D3D9CpuOutputRegCount registers
+     */
+    void Execute(
+      const D3D9CpuVec4*            pInputs,
+            D3D9CpuVec4*            pOutputs) const;
+
+  private:
+
+    enum class FrameType : uint32_t {
+      If, Loop, Call,
+    };
+
+    struct Frame {
+      FrameType type;
+      __m128    savedMask;
+      __m128    condMask;
+      uint32_t  pc;
+      int32_t   remaining;
+      int32_t   loopBackup;
+      int32_t   stride;
+    };
+
+    struct ExecState;
+
+    DxsoProgramInfo                     m_info;
+    bool                                m_supported = true;
+
+    bool                                m_floatEmulation = false;
+    bool                                m_strictPow      = false;
+
+    uint32_t                            m_tempCount = 0;
+
+    std::vector<DxsoInstructionContext> m_instructions;
+    std::vector<uint32_t>               m_links;
+    std::vector<uint32_t>               m_labels;
+
+    std::vector<D3D9CpuShaderIo>        m_inputs;
+    std::vector<D3D9CpuShaderIo>        m_outputs;
+
+    std::vector<Vector4>                m_fConsts;
+    std::vector<Vector4i>               m_iConsts;
+    std::vector<uint32_t>               m_bConsts;
+
+    void DecodeShader(
+      const void*                   pBytecode,
+      const D3D9ConstantLayout&     Layout,
+      const D3D9CpuShaderConstants& Constants);
+
+    bool LinkControlFlow();
+
+    void DeclareOutput(
+            DxsoSemantic            Semantic,
+            uint32_t                RegNumber,
+            DxsoRegMask             Mask);
+
+    uint32_t GetOutputIndex(
+      const ExecState&              State,
+      const DxsoRegister&           Reg) const;
+
+    __m128i LoadRelative(
+      const ExecState&              State,
+      const DxsoBaseRegister&       Reg) const;
+
+    D3D9CpuVec4 LoadConstant(
+      const ExecState&              State,
+      const DxsoRegister&           Reg) const;
+
+    D3D9CpuVec4 LoadRaw(
+      const ExecState&              State,
+      const DxsoRegister&           Reg) const;
+
+    D3D9CpuVec4 LoadSrc(
+      const ExecState&              State,
+      const DxsoRegister&           Reg) const;
+
+    __m128 LoadCondition(
+      const ExecState&              State,
+      const DxsoInstructionContext& Ctx) const;
+
+    bool LoadBool(
+      const DxsoRegister&           Reg) const;
+
+    Vector4i LoadInt(
+      const DxsoRegister&           Reg) const;
+
+    void StoreDst(
+            ExecState&              State,
+      const DxsoInstructionContext& Ctx,
+            D3D9CpuVec4             Value) const;
+
+    void ExecuteAlu(
+            ExecState&              State,
+      const DxsoInstructionContext& Ctx) const;
+
+  };
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <cfloat>
+#include <cmath>
+
+#include "../util/util_matrix.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Number of vertices processed at once
+   */
+  constexpr uint32_t D3D9CpuLaneCount = 4;
+
+  /**
+   * \brief Four-component vector for a vertex batch
+   *
+   * Stores each component in its own SSE register, so that
+   * lane \c i of every register belongs to vertex \c i of
+   * the batch. Arithmetic on this layout never needs any
+   * horizontal operations or shuffles.
+   */
+  struct D3D9CpuVec4 {
+    __m128 c[4];
+
+    __m128& operator [] (uint32_t i) { return c[i]; }
+    const __m128& operator [] (uint32_t i) const { return c[i]; }
+  };
+
+
+  /**
+   * \brief Broadcast matrix
+   *
+   * Stores each matrix element in all lanes of an SSE
+   * register, so that it can be applied to a batch.
+   */
+  struct D3D9CpuMat4 {
+    __m128 m[4][4];
+  };
+
+
+  inline D3D9CpuVec4 CpuSplat(const Vector4& v) {
+    return D3D9CpuVec4 {{
+      _mm_set1_ps(v.x), _mm_set1_ps(v.y),
+      _mm_set1_ps(v.z), _mm_set1_ps(v.w) }};
+  }
+
+
+  inline D3D9CpuMat4 CpuSplat(const Matrix4& m) {
+    D3D9CpuMat4 result;
+
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t j = 0; j < 4; j++)
+        result.m[i][j] = _mm_set1_ps(m[i][j]);
+    }
+
+    return result;
+  }
+
+
+  /**
+   * \brief Converts four vectors to a batch
+   *
+   * \param [in] pVectors One vector per lane
+   * \returns Vectors in batch layout
+   */
+  inline D3D9CpuVec4 CpuLoad(const Vector4* pVectors) {
+    D3D9CpuVec4 result;
+
+    for (uint32_t i = 0; i < 4; i++)
+      result[i] = _mm_loadu_ps(&pVectors[i][0]);
+
+    _MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+    return result;
+  }
+
+
+  /**
+   * \brief Converts a batch to four vectors
+   *
+   * \param [in] v Vectors in batch layout
+   * \param [out] pVectors One vector per lane
+   */
+  inline void CpuStore(D3D9CpuVec4 v, Vector4* pVectors) {
+    _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+
+    for (uint32_t i = 0; i < 4; i++)
+      _mm_storeu_ps(&pVectors[i][0], v[i]);
+  }
+
+
+  inline __m128 CpuSelect(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+
+  inline bool CpuAny(__m128 mask) {
+    return _mm_movemask_ps(mask) != 0;
+  }
+
+
+  inline __m128 CpuSaturate(__m128 x) {
+    // Returns 0 for NaN, since max returns its second operand
+    return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  }
+
+
+  inline __m128 CpuFloor(__m128 x) {
+    // Only valid within the int32 range, which covers
+    // anything that can be meaningfully floored anyway
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+  }
+
+
+  inline __m128 CpuDot3(const D3D9CpuVec4& a, const D3D9CpuVec4& b) {
+    return _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+      _mm_mul_ps(a[2], b[2]));
+  }
+
+
+  inline __m128 CpuDot4(const D3D9CpuVec4& a, const D3D9CpuVec4& b) {
+    return _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+      _mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+  }
+
+
+  inline __m128 CpuRsq(__m128 x) {
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+  }
+
+
+  /**
+   * \brief Normalizes the first three components
+   *
+   * Zero vectors are left unchanged rather than
+   * producing NaN, like the fixed-function shader.
+   */
+  inline D3D9CpuVec4 CpuNormalize3(const D3D9CpuVec4& v) {
+    __m128 len2 = CpuDot3(v, v);
+    __m128 zero = _mm_cmpeq_ps(len2, _mm_setzero_ps());
+    __m128 rsq  = _mm_andnot_ps(zero, CpuRsq(len2));
+
+    return D3D9CpuVec4 {{
+      _mm_mul_ps(v[0], rsq), _mm_mul_ps(v[1], rsq),
+      _mm_mul_ps(v[2], rsq), v[3] }};
+  }
+
+
+  /**
+   * \brief Transforms a batch of vectors
+   *
+   * Computes \c m*v for each lane, where each row of
+   * the D3D matrix is a column of the \c Matrix4.
+   * \param [in] m Broadcast matrix
+   * \param [in] v Vectors
+   * \param [in] n Number of input components
+   */
+  inline D3D9CpuVec4 CpuTransform(const D3D9CpuMat4& m, const D3D9CpuVec4& v, uint32_t n = 4) {
+    D3D9CpuVec4 result;
+
+    for (uint32_t j = 0; j < 4; j++) {
+      result[j] = _mm_mul_ps(m.m[0][j], v[0]);
+
+      for (uint32_t i = 1; i < n; i++)
+        result[j] = _mm_add_ps(result[j], _mm_mul_ps(m.m[i][j], v[i]));
+    }
+
+    return result;
+  }
+
+
+  /**
+   * \brief Applies a scalar function to each lane
+   *
+   * Used for transcendental functions that SSE has no
+   * instructions for. These are rare enough in vertex
+   * processing that this does not matter much.
+   */
+  template<typename Fn>
+  __m128 CpuPerLane(__m128 x, Fn fn) {
+    alignas(16) float v[4];
+    _mm_store_ps(v, x);
+
+    for (uint32_t i = 0; i < 4; i++)
+      v[i] = fn(v[i]);
+
+    return _mm_load_ps(v);
+  }
+
+
+  template<typename Fn>
+  __m128 CpuPerLane(__m128 x, __m128 y, Fn fn) {
+    alignas(16) float a[4];
+    alignas(16) float b[4];
+    _mm_store_ps(a, x);
+    _mm_store_ps(b, y);
+
+    for (uint32_t i = 0; i < 4; i++)
+      a[i] = fn(a[i], b[i]);
+
+    return _mm_load_ps(a);
+  }
+
+
+  inline __m128 CpuPow(__m128 x, __m128 y) {
+    return CpuPerLane(x, y, [] (float a, float b) { return std::pow(a, b); });
+  }
+
+}
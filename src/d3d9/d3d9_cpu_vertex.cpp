@@ -0,0 +1,1108 @@
+#include "d3d9_cpu_vertex.h"
+#include "d3d9_fixed_function.h"
+#include "d3d9_shader.h"
+#include "d3d9_util.h"
+#include "d3d9_vertex_declaration.h"
+
+#include "../util/util_bit.h"
+#include "../util/util_env.h"
+
+#include <algorithm>
+
+namespace dxvk {
+
+  // Number of vertices per worker task. Small enough to
+  // balance shader workloads, large enough to keep the
+  // synchronization overhead negligible.
+  constexpr uint32_t CpuVertexChunkSize  = 4096;
+  constexpr uint32_t CpuVertexMaxThreads = 8;
+
+
+  static float HalfToFloat(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exp  = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+
+    if (exp == 0x1f)
+      return bit::cast<float>(sign | 0x7f800000u | (mant << 13));
+
+    if (exp == 0) {
+      // Zero or denormal, scale by 2^-24
+      float value = float(mant) * (1.0f / 16777216.0f);
+      return sign ? -value : value;
+    }
+
+    return bit::cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+  }
+
+
+  static uint16_t FloatToHalf(float f) {
+    uint32_t bits = bit::cast<uint32_t>(f);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t  exp  = int32_t((bits >> 23) & 0xff) - 112;
+    uint32_t mant = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+      return uint16_t(sign | 0x7c00 | (mant ? 0x200 : 0));
+
+    if (exp >= 0x1f)
+      return uint16_t(sign | 0x7c00);
+
+    if (exp <= 0) {
+      if (exp < -10)
+        return uint16_t(sign);
+
+      mant |= 0x800000;
+      return uint16_t(sign | (mant >> (14 - exp)));
+    }
+
+    return uint16_t(sign | (exp << 10) | (mant >> 13));
+  }
+
+
+  template<typename T>
+  static T ReadUnaligned(const uint8_t* pData) {
+    T value;
+    std::memcpy(&value, pData, sizeof(value));
+    return value;
+  }
+
+
+  static Vector4 DecodeElement(const uint8_t* pData, D3DDECLTYPE Type) {
+    Vector4 v(0.0f, 0.0f, 0.0f, 1.0f);
+
+    switch (Type) {
+      case D3DDECLTYPE_FLOAT4: v.w = ReadUnaligned<float>(pData + 12); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT3: v.z = ReadUnaligned<float>(pData +  8); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT2: v.y = ReadUnaligned<float>(pData +  4); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT1: v.x = ReadUnaligned<float>(pData +  0); break;
+
+      case D3DDECLTYPE_D3DCOLOR:
+        v = Vector4(pData[2], pData[1], pData[0], pData[3]) * (1.0f / 255.0f);
+        break;
+
+      case D3DDECLTYPE_UBYTE4:
+        v = Vector4(pData[0], pData[1], pData[2], pData[3]);
+        break;
+
+      case D3DDECLTYPE_UBYTE4N:
+        v = Vector4(pData[0], pData[1], pData[2], pData[3]) * (1.0f / 255.0f);
+        break;
+
+      case D3DDECLTYPE_SHORT4:
+      case D3DDECLTYPE_SHORT4N:
+        v.z = ReadUnaligned<int16_t>(pData + 4);
+        v.w = ReadUnaligned<int16_t>(pData + 6);
+        [[fallthrough]];
+      case D3DDECLTYPE_SHORT2:
+      case D3DDECLTYPE_SHORT2N:
+        v.x = ReadUnaligned<int16_t>(pData + 0);
+        v.y = ReadUnaligned<int16_t>(pData + 2);
+
+        if (Type == D3DDECLTYPE_SHORT2N || Type == D3DDECLTYPE_SHORT4N) {
+          for (uint32_t i = 0; i < (Type == D3DDECLTYPE_SHORT2N ? 2 : 4); i++)
+            v[i] = std::max(v[i] * (1.0f / 32767.0f), -1.0f);
+        }
+        break;
+
+      case D3DDECLTYPE_USHORT4N:
+        v.z = ReadUnaligned<uint16_t>(pData + 4) * (1.0f / 65535.0f);
+        v.w = ReadUnaligned<uint16_t>(pData + 6) * (1.0f / 65535.0f);
+        [[fallthrough]];
+      case D3DDECLTYPE_USHORT2N:
+        v.x = ReadUnaligned<uint16_t>(pData + 0) * (1.0f / 65535.0f);
+        v.y = ReadUnaligned<uint16_t>(pData + 2) * (1.0f / 65535.0f);
+        break;
+
+      case D3DDECLTYPE_UDEC3: {
+        uint32_t dw = ReadUnaligned<uint32_t>(pData);
+        v = Vector4(float(dw & 0x3ff), float((dw >> 10) & 0x3ff), float((dw >> 20) & 0x3ff), 1.0f);
+      } break;
+
+      case D3DDECLTYPE_DEC3N: {
+        int32_t dw = ReadUnaligned<int32_t>(pData);
+        v = Vector4(
+          float((dw << 22) >> 22),
+          float((dw << 12) >> 22),
+          float((dw <<  2) >> 22), 511.0f) * (1.0f / 511.0f);
+      } break;
+
+      case D3DDECLTYPE_FLOAT16_4:
+        v.z = HalfToFloat(ReadUnaligned<uint16_t>(pData + 4));
+        v.w = HalfToFloat(ReadUnaligned<uint16_t>(pData + 6));
+        [[fallthrough]];
+      case D3DDECLTYPE_FLOAT16_2:
+        v.x = HalfToFloat(ReadUnaligned<uint16_t>(pData + 0));
+        v.y = HalfToFloat(ReadUnaligned<uint16_t>(pData + 2));
+        break;
+
+      default:
+        break;
+    }
+
+    return v;
+  }
+
+
+  template<typename T>
+  static void WriteUnaligned(uint8_t* pData, T value) {
+    std::memcpy(pData, &value, sizeof(value));
+  }
+
+
+  static uint8_t PackUnorm8(float f) {
+    return uint8_t(std::clamp(f, 0.0f, 1.0f) * 255.0f + 0.5f);
+  }
+
+
+  static void EncodeElement(uint8_t* pData, D3DDECLTYPE Type, const Vector4& v) {
+    switch (Type) {
+      case D3DDECLTYPE_FLOAT4: WriteUnaligned<float>(pData + 12, v.w); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT3: WriteUnaligned<float>(pData +  8, v.z); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT2: WriteUnaligned<float>(pData +  4, v.y); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT1: WriteUnaligned<float>(pData +  0, v.x); break;
+
+      case D3DDECLTYPE_D3DCOLOR:
+        pData[0] = PackUnorm8(v.z);
+        pData[1] = PackUnorm8(v.y);
+        pData[2] = PackUnorm8(v.x);
+        pData[3] = PackUnorm8(v.w);
+        break;
+
+      case D3DDECLTYPE_UBYTE4:
+        for (uint32_t i = 0; i < 4; i++)
+          pData[i] = uint8_t(std::clamp(v[i], 0.0f, 255.0f));
+        break;
+
+      case D3DDECLTYPE_UBYTE4N:
+        for (uint32_t i = 0; i < 4; i++)
+          pData[i] = PackUnorm8(v[i]);
+        break;
+
+      case D3DDECLTYPE_SHORT2:
+      case D3DDECLTYPE_SHORT4:
+        for (uint32_t i = 0; i < (Type == D3DDECLTYPE_SHORT2 ? 2 : 4); i++)
+          WriteUnaligned<int16_t>(pData + 2 * i, int16_t(std::clamp(v[i], -32768.0f, 32767.0f)));
+        break;
+
+      case D3DDECLTYPE_SHORT2N:
+      case D3DDECLTYPE_SHORT4N:
+        for (uint32_t i = 0; i < (Type == D3DDECLTYPE_SHORT2N ? 2 : 4); i++)
+          WriteUnaligned<int16_t>(pData + 2 * i, int16_t(std::clamp(v[i], -1.0f, 1.0f) * 32767.0f));
+        break;
+
+      case D3DDECLTYPE_USHORT2N:
+      case D3DDECLTYPE_USHORT4N:
+        for (uint32_t i = 0; i < (Type == D3DDECLTYPE_USHORT2N ? 2 : 4); i++)
+          WriteUnaligned<uint16_t>(pData + 2 * i, uint16_t(std::clamp(v[i], 0.0f, 1.0f) * 65535.0f + 0.5f));
+        break;
+
+      case D3DDECLTYPE_FLOAT16_2:
+      case D3DDECLTYPE_FLOAT16_4:
+        for (uint32_t i = 0; i < (Type == D3DDECLTYPE_FLOAT16_2 ? 2 : 4); i++)
+          WriteUnaligned<uint16_t>(pData + 2 * i, FloatToHalf(v[i]));
+        break;
+
+      default:
+        break;
+    }
+  }
+
+
+  D3D9CpuVertexWorkers::D3D9CpuVertexWorkers() {
+
+  }
+
+
+  D3D9CpuVertexWorkers::~D3D9CpuVertexWorkers() {
+    { std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopThreads = true;
+    }
+
+    m_workCond.notify_all();
+
+    for (auto& thread : m_threads)
+      thread.join();
+  }
+
+
+  void D3D9CpuVertexWorkers::Run(
+          uint32_t                        TaskCount,
+    const std::function<void (uint32_t)>& Task) {
+    if (TaskCount <= 1) {
+      if (TaskCount)
+        Task(0);
+      return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_runLock);
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Start the worker threads on first use, the
+    // calling thread counts as one of the workers
+    if (m_threads.empty()) {
+      uint32_t numWorkers = std::min(dxvk::thread::hardware_concurrency(), CpuVertexMaxThreads);
+
+      if (numWorkers > 1) {
+        Logger::info(str::format("D3D9: Using ", numWorkers - 1, " CPU vertex processing threads"));
+
+        for (uint32_t i = 1; i < numWorkers; i++)
+          m_threads.emplace_back([this] () { WorkerFunc(); });
+      }
+    }
+
+    m_task         = &Task;
+    m_taskCount    = TaskCount;
+    m_nextTask     = 0;
+    m_pendingTasks = TaskCount;
+
+    m_workCond.notify_all();
+
+    while (m_nextTask < m_taskCount) {
+      uint32_t index = m_nextTask++;
+
+      lock.unlock();
+      Task(index);
+      lock.lock();
+
+      m_pendingTasks -= 1;
+    }
+
+    m_doneCond.wait(lock, [this] () {
+      return !m_pendingTasks;
+    });
+
+    m_task      = nullptr;
+    m_taskCount = 0;
+    m_nextTask  = 0;
+  }
+
+
+  void D3D9CpuVertexWorkers::WorkerFunc() {
+    env::setThreadName("dxvk-cpu-vertex");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+      m_workCond.wait(lock, [this] () {
+        return m_nextTask < m_taskCount
+            || m_stopThreads;
+      });
+
+      if (m_stopThreads)
+        break;
+
+      const auto* task = m_task;
+      uint32_t index = m_nextTask++;
+
+      lock.unlock();
+      (*task)(index);
+      lock.lock();
+
+      if (!(--m_pendingTasks))
+        m_doneCond.notify_one();
+    }
+  }
+
+
+  struct D3D9CpuVertexProcessor::BatchState {
+    D3D9CpuMat4 worldView;
+    D3D9CpuMat4 normalMatrix;
+    D3D9CpuMat4 projection;
+
+    std::array<D3D9CpuMat4, 4> blend;
+    std::array<D3D9CpuMat4, caps::TextureStageCount> texMatrices;
+
+    D3D9CpuVec4 viewportScale;
+    D3D9CpuVec4 viewportOffset;
+  };
+
+
+  D3D9CpuVertexProcessor::D3D9CpuVertexProcessor(
+    const D3D9CapturableState*  pState,
+    const D3D9ConstantLayout&   ConstantLayout,
+    const DxsoOptions&          ShaderOptions,
+    const D3D9VertexDecl*       pSrcDecl,
+    const D3D9VertexDecl*       pDstDecl,
+          DWORD                 Flags) {
+    if (pSrcDecl == nullptr) {
+      m_supported = false;
+      return;
+    }
+
+    const auto& vp = pState->viewport;
+
+    m_viewportScale  = Vector4( 0.5f * float(vp.Width), -0.5f * float(vp.Height), vp.MaxZ - vp.MinZ, 1.0f);
+    m_viewportOffset = Vector4(float(vp.X) + 0.5f * float(vp.Width), float(vp.Y) + 0.5f * float(vp.Height), vp.MinZ, 0.0f);
+
+    m_dstStride = pDstDecl->GetSize();
+
+    if (pState->vertexShader != nullptr)
+      InitShader(pState, ConstantLayout, ShaderOptions, pSrcDecl, pDstDecl, Flags);
+    else
+      InitFixedFunction(pState, pSrcDecl, pDstDecl, Flags);
+  }
+
+
+  D3D9CpuVertexProcessor::~D3D9CpuVertexProcessor() {
+
+  }
+
+
+  void D3D9CpuVertexProcessor::Process(
+          D3D9CpuVertexWorkers& Workers,
+    const D3D9CpuVertexStream*  pStreams,
+          uint32_t              FirstVertex,
+          uint32_t              VertexCount,
+          uint8_t*              pDst) const {
+    uint32_t taskCount = (VertexCount + CpuVertexChunkSize - 1) / CpuVertexChunkSize;
+
+    Workers.Run(taskCount, [&] (uint32_t task) {
+      uint32_t first = task * CpuVertexChunkSize;
+      uint32_t count = std::min(CpuVertexChunkSize, VertexCount - first);
+
+      ProcessRange(pStreams, FirstVertex + first, count, pDst + size_t(first) * m_dstStride);
+    });
+  }
+
+
+  void D3D9CpuVertexProcessor::InitFixedFunction(
+    const D3D9CapturableState*  pState,
+    const D3D9VertexDecl*       pSrcDecl,
+    const D3D9VertexDecl*       pDstDecl,
+          DWORD                 Flags) {
+    const auto& rs = pState->renderStates;
+
+    // Pre-transformed vertices are rejected here,
+    // since they have no POSITION element
+    m_ff.position = FindInput(pSrcDecl, D3DDECLUSAGE_POSITION, 0);
+    m_ff.normal   = FindInput(pSrcDecl, D3DDECLUSAGE_NORMAL,   0);
+
+    if (m_ff.position < 0) {
+      m_supported = false;
+      return;
+    }
+
+    const auto& world = pState->transforms[GetTransformIndex(D3DTS_WORLD)];
+    const auto& view  = pState->transforms[GetTransformIndex(D3DTS_VIEW)];
+
+    m_worldView    = view * world;
+    m_normalMatrix = transpose(inverse(m_worldView));
+    m_projection   = pState->transforms[GetTransformIndex(D3DTS_PROJECTION)];
+
+    // Vertex blending, same rules as the fixed-function shader
+    bool hasBlendWeight  = pSrcDecl->TestFlag(D3D9VertexDeclFlag::HasBlendWeight);
+    bool hasBlendIndices = pSrcDecl->TestFlag(D3D9VertexDeclFlag::HasBlendIndices);
+    bool blendIndexed    = hasBlendIndices && rs[D3DRS_INDEXEDVERTEXBLENDENABLE];
+
+    DWORD blendMode = rs[D3DRS_VERTEXBLEND];
+
+    bool blendEnabled = blendMode != D3DVBF_DISABLE
+      && (blendMode != D3DVBF_0WEIGHTS ? hasBlendWeight : blendIndexed);
+
+    if (blendEnabled && blendMode == D3DVBF_TWEENING) {
+      m_tween       = true;
+      m_tweenFactor = bit::cast<float>(rs[D3DRS_TWEENFACTOR]);
+
+      m_ff.position1 = FindInput(pSrcDecl, D3DDECLUSAGE_POSITION, 1);
+      m_ff.normal1   = FindInput(pSrcDecl, D3DDECLUSAGE_NORMAL,   1);
+    } else if (blendEnabled) {
+      m_blendCount   = std::min(uint32_t(blendMode & 0xff), 3u);
+      m_blendIndexed = blendIndexed;
+
+      m_ff.blendWeight  = FindInput(pSrcDecl, D3DDECLUSAGE_BLENDWEIGHT,  0);
+      m_ff.blendIndices = FindInput(pSrcDecl, D3DDECLUSAGE_BLENDINDICES, 0);
+
+      uint32_t matrixCount = m_blendIndexed ? 256 : m_blendCount + 1;
+
+      for (uint32_t i = 0; i < matrixCount; i++)
+        m_blendMatrices.push_back(view * pState->transforms[GetTransformIndex(D3DTS_WORLDMATRIX(i))]);
+    }
+
+    // Lighting, same rules as the fixed-function shader
+    bool hasColor0 = pSrcDecl->TestFlag(D3D9VertexDeclFlag::HasColor0);
+    bool hasColor1 = pSrcDecl->TestFlag(D3D9VertexDeclFlag::HasColor1);
+
+    m_ff.color[0] = FindInput(pSrcDecl, D3DDECLUSAGE_COLOR, 0);
+    m_ff.color[1] = FindInput(pSrcDecl, D3DDECLUSAGE_COLOR, 1);
+
+    m_normalize   = rs[D3DRS_NORMALIZENORMALS] != 0;
+    m_lighting    = rs[D3DRS_LIGHTING] != 0;
+    m_localViewer = rs[D3DRS_LOCALVIEWER] && m_lighting;
+
+    if (m_lighting) {
+      uint32_t mask = rs[D3DRS_COLORVERTEX]
+        ? (hasColor0 ? D3DMCS_COLOR1 : D3DMCS_MATERIAL)
+        | (hasColor1 ? D3DMCS_COLOR2 : D3DMCS_MATERIAL)
+        : 0;
+
+      m_diffuseSource  = rs[D3DRS_DIFFUSEMATERIALSOURCE]  & mask;
+      m_ambientSource  = rs[D3DRS_AMBIENTMATERIALSOURCE]  & mask;
+      m_specularSource = rs[D3DRS_SPECULARMATERIALSOURCE] & mask;
+      m_emissiveSource = rs[D3DRS_EMISSIVEMATERIALSOURCE] & mask;
+
+      for (uint32_t i = 0; i < caps::MaxEnabledLights; i++) {
+        DWORD idx = pState->enabledLightIndices[i];
+
+        if (idx != UINT32_MAX)
+          m_lights.emplace_back(pState->lights[idx].value(), view);
+      }
+
+      DecodeD3DCOLOR(rs[D3DRS_AMBIENT], m_globalAmbient.data);
+      m_material = pState->material;
+    }
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++)
+      m_texMatrices[i] = pState->transforms[GetTransformIndex(D3DTS_TEXTURE0) + i];
+
+    for (const auto& element : pDstDecl->GetElements()) {
+      OutputElement output = { };
+      output.offset = element.Offset;
+      output.type   = D3DDECLTYPE(element.Type);
+
+      if (output.type == D3DDECLTYPE_UDEC3
+       || output.type == D3DDECLTYPE_DEC3N) {
+        m_supported = false;
+        return;
+      }
+
+      switch (element.Usage) {
+        case D3DDECLUSAGE_POSITION:
+        case D3DDECLUSAGE_POSITIONT:
+          if (element.UsageIndex != 0) {
+            m_supported = false;
+            return;
+          }
+
+          output.source = element.Usage == D3DDECLUSAGE_POSITIONT
+            ? OutputSource::PositionT
+            : OutputSource::Position;
+          break;
+
+        case D3DDECLUSAGE_COLOR: {
+          if (element.UsageIndex > 1) {
+            m_supported = false;
+            return;
+          }
+
+          // Elements that are not processed are left untouched
+          if ((Flags & D3DPV_DONOTCOPYDATA) && !m_lighting)
+            continue;
+
+          output.source = OutputSource::Color;
+          output.input  = element.UsageIndex;
+          output.value  = Vector4(element.UsageIndex ? 0.0f : 1.0f);
+        } break;
+
+        case D3DDECLUSAGE_TEXCOORD: {
+          if (element.UsageIndex >= caps::TextureStageCount) {
+            m_supported = false;
+            return;
+          }
+
+          const auto& stage = pState->textureStages[element.UsageIndex];
+
+          uint32_t index = stage[D3DTSS_TEXCOORDINDEX];
+          uint32_t flags = stage[D3DTSS_TEXTURETRANSFORMFLAGS] & ~D3DTTFF_PROJECTED & 0x7;
+
+          TexcoordStage& texcoord = m_texcoords[element.UsageIndex];
+          texcoord.generate  = (index & TCIMask) >> TCIOffset;
+          texcoord.transform = flags != D3DTTFF_DISABLE;
+
+          // Unknown generation modes behave like pass-through
+          if (texcoord.generate > (D3DTSS_TCI_SPHEREMAP >> TCIOffset))
+            texcoord.generate = D3DTSS_TCI_PASSTHRU;
+
+          if ((Flags & D3DPV_DONOTCOPYDATA) && !texcoord.transform
+           && texcoord.generate == D3DTSS_TCI_PASSTHRU)
+            continue;
+
+          texcoord.count    = texcoord.generate != D3DTSS_TCI_PASSTHRU ? 4 : std::min(flags, 4u);
+          texcoord.padCount = (pSrcDecl->GetTexcoordMask() >> (3 * (index & 0x7))) & 0x7;
+
+          if (texcoord.generate == D3DTSS_TCI_PASSTHRU) {
+            int32_t input = FindInput(pSrcDecl, D3DDECLUSAGE_TEXCOORD, index & 0x7);
+
+            texcoord.hasInput = input >= 0;
+            texcoord.input    = uint32_t(std::max(input, 0));
+          }
+
+          output.source = OutputSource::Texcoord;
+          output.input  = element.UsageIndex;
+          output.value  = Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+        } break;
+
+        default:
+          // Fog and point size are left to the GPU path
+          m_supported = false;
+          return;
+      }
+
+      m_outputs.push_back(output);
+    }
+  }
+
+
+  void D3D9CpuVertexProcessor::InitShader(
+    const D3D9CapturableState*  pState,
+    const D3D9ConstantLayout&   ConstantLayout,
+    const DxsoOptions&          ShaderOptions,
+    const D3D9VertexDecl*       pSrcDecl,
+    const D3D9VertexDecl*       pDstDecl,
+          DWORD                 Flags) {
+    const D3D9CommonShader* shader = pState->vertexShader->GetCommonShader();
+
+    D3D9CpuShaderConstants constants;
+    constants.fConsts = pState->vsConsts.fConsts;
+    constants.iConsts = pState->vsConsts.iConsts;
+    constants.bConsts = pState->vsConsts.bConsts;
+
+    m_shader = std::make_unique<D3D9CpuVertexShader>(
+      shader->GetBytecode().data(), ConstantLayout, ShaderOptions, constants);
+
+    if (!m_shader->IsSupported()) {
+      m_supported = false;
+      return;
+    }
+
+    for (const auto& input : m_shader->GetInputs()) {
+      ShaderInput entry;
+      entry.regNumber = input.regNumber;
+      entry.input     = FindInput(pSrcDecl, D3DDECLUSAGE(input.semantic.usage), input.semantic.usageIndex);
+      entry.mask      = 0;
+
+      for (uint32_t i = 0; i < 4; i++)
+        entry.mask |= input.mask[i] ? (1u << i) : 0u;
+
+      m_shaderInputs.push_back(entry);
+    }
+
+    const auto& outputs = m_shader->GetOutputs();
+    const bool  sm3     = shader->GetInfo().majorVersion() >= 3;
+
+    auto findOutput = [&outputs] (DxsoUsage Usage, uint32_t UsageIndex) {
+      for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (outputs[i].semantic == DxsoSemantic { Usage, UsageIndex })
+          return int32_t(i);
+      }
+
+      return -1;
+    };
+
+    int32_t position = findOutput(DxsoUsage::Position, 0);
+
+    if (position >= 0)
+      m_shaderPosition = int32_t(outputs[position].regNumber);
+
+    for (const auto& element : pDstDecl->GetElements()) {
+      OutputElement output = { };
+      output.offset = element.Offset;
+      output.type   = D3DDECLTYPE(element.Type);
+      output.mask   = 0xf;
+
+      if (output.type == D3DDECLTYPE_UDEC3
+       || output.type == D3DDECLTYPE_DEC3N) {
+        m_supported = false;
+        return;
+      }
+
+      if (element.Usage == D3DDECLUSAGE_POSITION
+       || element.Usage == D3DDECLUSAGE_POSITIONT) {
+        if (element.UsageIndex != 0) {
+          m_supported = false;
+          return;
+        }
+
+        output.source = element.Usage == D3DDECLUSAGE_POSITIONT
+          ? OutputSource::PositionT
+          : OutputSource::Position;
+
+        if (m_shaderPosition < 0) {
+          output.source = OutputSource::Default;
+          output.value  = Vector4(0.0f);
+        }
+      } else {
+        // Every other output is computed by the shader,
+        // so D3DPV_DONOTCOPYDATA does not skip anything
+        int32_t index = findOutput(DxsoUsage(element.Usage), element.UsageIndex);
+
+        if (index >= 0) {
+          const auto& shaderOutput = outputs[index];
+
+          output.source   = OutputSource::Shader;
+          output.input    = shaderOutput.regNumber;
+          output.mask     = 0;
+          output.saturate = !sm3 && element.Usage == D3DDECLUSAGE_COLOR;
+
+          for (uint32_t i = 0; i < 4; i++)
+            output.mask |= shaderOutput.mask[i] ? (1u << i) : 0u;
+        } else {
+          bool isColor0 = element.Usage == D3DDECLUSAGE_COLOR && element.UsageIndex == 0;
+
+          output.source = OutputSource::Default;
+          output.value  = Vector4(isColor0 ? 1.0f : 0.0f);
+        }
+      }
+
+      m_outputs.push_back(output);
+    }
+  }
+
+
+  void D3D9CpuVertexProcessor::ProcessRange(
+    const D3D9CpuVertexStream*  pStreams,
+          uint32_t              FirstVertex,
+          uint32_t              VertexCount,
+          uint8_t*              pDst) const {
+    BatchState state;
+    state.worldView      = CpuSplat(m_worldView);
+    state.normalMatrix   = CpuSplat(m_normalMatrix);
+    state.projection     = CpuSplat(m_projection);
+    state.viewportScale  = CpuSplat(m_viewportScale);
+    state.viewportOffset = CpuSplat(m_viewportOffset);
+
+    if (!m_blendIndexed) {
+      for (uint32_t i = 0; i < m_blendMatrices.size(); i++)
+        state.blend[i] = CpuSplat(m_blendMatrices[i]);
+    }
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      if (m_texcoords[i].transform)
+        state.texMatrices[i] = CpuSplat(m_texMatrices[i]);
+    }
+
+    std::array<D3D9CpuVec4, caps::InputRegisterCount> inputs;
+    std::vector<D3D9CpuVec4> values(m_outputs.size());
+
+    std::array<Vector4, D3D9CpuLaneCount> lanes;
+
+    for (uint32_t i = 0; i < VertexCount; i += D3D9CpuLaneCount) {
+      uint32_t laneCount = std::min(VertexCount - i, D3D9CpuLaneCount);
+
+      // Fetch one batch of inputs. Lanes past the end of
+      // the range replicate the last vertex, so that all
+      // arithmetic can ignore partial batches.
+      for (uint32_t j = 0; j < m_inputs.size(); j++) {
+        const auto& input  = m_inputs[j];
+        const auto& stream = pStreams[input.stream];
+
+        for (uint32_t l = 0; l < D3D9CpuLaneCount; l++) {
+          uint32_t vertex = FirstVertex + i + std::min(l, laneCount - 1);
+          lanes[l] = DecodeElement(stream.data + size_t(vertex) * stream.stride + input.offset, input.type);
+        }
+
+        inputs[j] = CpuLoad(lanes.data());
+      }
+
+      if (m_shader)
+        ProcessShader(state, inputs.data(), values.data());
+      else
+        ProcessFixedFunction(state, inputs.data(), values.data());
+
+      for (uint32_t j = 0; j < m_outputs.size(); j++) {
+        const auto& output = m_outputs[j];
+
+        CpuStore(values[j], lanes.data());
+
+        for (uint32_t l = 0; l < laneCount; l++)
+          EncodeElement(pDst + size_t(i + l) * m_dstStride + output.offset, output.type, lanes[l]);
+      }
+    }
+  }
+
+
+  void D3D9CpuVertexProcessor::ProcessFixedFunction(
+    const BatchState&           State,
+    const D3D9CpuVec4*          pInputs,
+          D3D9CpuVec4*          pValues) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+
+    auto loadInput = [pInputs] (int32_t Index) {
+      return Index >= 0 ? pInputs[Index] : CpuSplat(Vector4(0.0f));
+    };
+
+    D3D9CpuVec4 pos = pInputs[m_ff.position];
+    D3D9CpuVec4 nrm = loadInput(m_ff.normal);
+
+    if (m_tween) {
+      const __m128 factor = _mm_set1_ps(m_tweenFactor);
+
+      D3D9CpuVec4 pos1 = loadInput(m_ff.position1);
+      D3D9CpuVec4 nrm1 = loadInput(m_ff.normal1);
+
+      for (uint32_t c = 0; c < 4; c++) {
+        pos[c] = _mm_add_ps(pos[c], _mm_mul_ps(factor, _mm_sub_ps(pos1[c], pos[c])));
+        nrm[c] = _mm_add_ps(nrm[c], _mm_mul_ps(factor, _mm_sub_ps(nrm1[c], nrm[c])));
+      }
+    }
+
+    // View-space position and normal
+    D3D9CpuVec4 vtx;
+    D3D9CpuVec4 normal;
+
+    if (!m_blendMatrices.empty()) {
+      D3D9CpuVec4 weights = loadInput(m_ff.blendWeight);
+      D3D9CpuVec4 indices = loadInput(m_ff.blendIndices);
+
+      vtx    = CpuSplat(Vector4(0.0f));
+      normal = CpuSplat(Vector4(0.0f));
+
+      __m128 remaining = one;
+
+      for (uint32_t i = 0; i <= m_blendCount; i++) {
+        D3D9CpuMat4 matrix;
+
+        if (m_blendIndexed) {
+          alignas(16) int32_t index[4];
+          _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvtps_epi32(indices[i]));
+
+          for (uint32_t l = 0; l < 4; l++)
+            index[l] = std::clamp(index[l], 0, int32_t(m_blendMatrices.size() - 1));
+
+          for (uint32_t r = 0; r < 4; r++) {
+            for (uint32_t c = 0; c < 4; c++) {
+              matrix.m[r][c] = _mm_setr_ps(
+                m_blendMatrices[index[0]][r][c], m_blendMatrices[index[1]][r][c],
+                m_blendMatrices[index[2]][r][c], m_blendMatrices[index[3]][r][c]);
+            }
+          }
+        } else {
+          matrix = State.blend[i];
+        }
+
+        __m128 weight = remaining;
+
+        if (i != m_blendCount) {
+          weight    = weights[i];
+          remaining = _mm_sub_ps(remaining, weight);
+        }
+
+        D3D9CpuVec4 v = CpuTransform(matrix, pos);
+        D3D9CpuVec4 n = CpuTransform(matrix, nrm, 3);
+
+        for (uint32_t c = 0; c < 4; c++) {
+          vtx[c]    = _mm_add_ps(vtx[c],    _mm_mul_ps(v[c], weight));
+          normal[c] = _mm_add_ps(normal[c], _mm_mul_ps(n[c], weight));
+        }
+      }
+    } else {
+      vtx    = CpuTransform(State.worldView,    pos);
+      normal = CpuTransform(State.normalMatrix, nrm, 3);
+    }
+
+    if (m_normalize)
+      normal = CpuNormalize3(normal);
+
+    normal[3] = one;
+
+    D3D9CpuVec4 clip = CpuTransform(State.projection, vtx);
+
+    D3D9CpuVec4 colors[2];
+
+    if (m_lighting)
+      ProcessLighting(pInputs, vtx, normal, colors);
+
+    for (uint32_t j = 0; j < m_outputs.size(); j++) {
+      const auto& output = m_outputs[j];
+
+      switch (output.source) {
+        case OutputSource::Position:
+          pValues[j] = clip;
+          break;
+
+        case OutputSource::PositionT:
+          pValues[j] = TransformPositionT(State, clip);
+          break;
+
+        case OutputSource::Color: {
+          int32_t input = m_ff.color[output.input];
+
+          if (m_lighting)
+            pValues[j] = colors[output.input];
+          else
+            pValues[j] = input >= 0 ? pInputs[input] : CpuSplat(output.value);
+        } break;
+
+        case OutputSource::Texcoord: {
+          const TexcoordStage& stage = m_texcoords[output.input];
+          D3D9CpuVec4 texcoord;
+
+          switch (stage.generate) {
+            case D3DTSS_TCI_CAMERASPACENORMAL >> TCIOffset:
+              texcoord = normal;
+              break;
+
+            case D3DTSS_TCI_CAMERASPACEPOSITION >> TCIOffset:
+              texcoord = vtx;
+              texcoord[3] = one;
+              break;
+
+            case D3DTSS_TCI_CAMERASPACEREFLECTIONVECTOR >> TCIOffset:
+            case D3DTSS_TCI_SPHEREMAP >> TCIOffset: {
+              D3D9CpuVec4 eye = CpuNormalize3(vtx);
+              __m128 dot = CpuDot3(normal, eye);
+              dot = _mm_add_ps(dot, dot);
+
+              for (uint32_t c = 0; c < 3; c++)
+                texcoord[c] = _mm_sub_ps(eye[c], _mm_mul_ps(dot, normal[c]));
+
+              texcoord[3] = one;
+
+              if (stage.generate == (D3DTSS_TCI_SPHEREMAP >> TCIOffset)) {
+                D3D9CpuVec4 m = texcoord;
+                m[2] = _mm_add_ps(m[2], one);
+
+                __m128 scale = _mm_div_ps(_mm_set1_ps(0.5f), _mm_sqrt_ps(CpuDot3(m, m)));
+
+                texcoord[0] = _mm_add_ps(_mm_mul_ps(texcoord[0], scale), _mm_set1_ps(0.5f));
+                texcoord[1] = _mm_add_ps(_mm_mul_ps(texcoord[1], scale), _mm_set1_ps(0.5f));
+                texcoord[2] = zero;
+              }
+            } break;
+
+            default:
+              texcoord = stage.hasInput ? pInputs[stage.input] : CpuSplat(output.value);
+          }
+
+          if (stage.transform) {
+            for (uint32_t c = stage.count; c < 4; c++)
+              texcoord[c] = c > stage.padCount ? zero : one;
+
+            texcoord = CpuTransform(State.texMatrices[output.input], texcoord);
+
+            for (uint32_t c = stage.count; c < 4; c++)
+              texcoord[c] = texcoord[stage.count - 1];
+          }
+
+          pValues[j] = texcoord;
+        } break;
+
+        default:
+          pValues[j] = CpuSplat(output.value);
+      }
+    }
+  }
+
+
+  void D3D9CpuVertexProcessor::ProcessLighting(
+    const D3D9CpuVec4*          pInputs,
+    const D3D9CpuVec4&          Vtx,
+    const D3D9CpuVec4&          Normal,
+          D3D9CpuVec4*          pColors) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+
+    D3D9CpuVec4 ambient  = CpuSplat(Vector4(0.0f));
+    D3D9CpuVec4 diffuse  = CpuSplat(Vector4(0.0f));
+    D3D9CpuVec4 specular = CpuSplat(Vector4(0.0f));
+
+    D3D9CpuVec4 eye = m_localViewer
+      ? CpuNormalize3(Vtx)
+      : CpuSplat(Vector4(0.0f, 0.0f, 1.0f, 0.0f));
+
+    const __m128 power = _mm_set1_ps(m_material.Power);
+
+    for (const auto& light : m_lights) {
+      D3D9CpuVec4 direction = CpuSplat(light.Direction);
+      D3D9CpuVec4 hitDir;
+
+      __m128 atten = one;
+
+      if (light.Type == D3DLIGHT_DIRECTIONAL) {
+        for (uint32_t c = 0; c < 3; c++)
+          hitDir[c] = _mm_set1_ps(-light.Direction[c]);
+
+        hitDir[3] = zero;
+        hitDir = CpuNormalize3(hitDir);
+      } else {
+        D3D9CpuVec4 delta;
+
+        for (uint32_t c = 0; c < 3; c++)
+          delta[c] = _mm_sub_ps(_mm_set1_ps(light.Position[c]), Vtx[c]);
+
+        delta[3] = zero;
+        hitDir = CpuNormalize3(delta);
+
+        __m128 d = _mm_sqrt_ps(CpuDot3(delta, delta));
+
+        atten = _mm_add_ps(_mm_set1_ps(light.Attenuation1), _mm_mul_ps(d, _mm_set1_ps(light.Attenuation2)));
+        atten = _mm_add_ps(_mm_set1_ps(light.Attenuation0), _mm_mul_ps(d, atten));
+        atten = _mm_div_ps(one, atten);
+
+        // Returns FLT_MAX for NaN, like NMin in the shader
+        atten = _mm_min_ps(atten, _mm_set1_ps(FLT_MAX));
+        atten = _mm_andnot_ps(_mm_cmpgt_ps(d, _mm_set1_ps(light.Range)), atten);
+
+        if (light.Type == D3DLIGHT_SPOT) {
+          __m128 theta = _mm_set1_ps(light.Theta);
+          __m128 phi   = _mm_set1_ps(light.Phi);
+          __m128 rho   = _mm_sub_ps(zero, CpuDot3(hitDir, direction));
+
+          __m128 spot = _mm_div_ps(_mm_sub_ps(rho, phi), _mm_sub_ps(theta, phi));
+          spot = CpuPow(spot, _mm_set1_ps(light.Falloff));
+          spot = _mm_and_ps(_mm_cmpgt_ps(rho, phi), spot);
+          spot = CpuSelect(_mm_cmple_ps(rho, theta), spot, one);
+
+          atten = _mm_mul_ps(atten, CpuSaturate(spot));
+        }
+      }
+
+      __m128 diffuseness = _mm_mul_ps(CpuSaturate(CpuDot3(Normal, hitDir)), atten);
+
+      D3D9CpuVec4 mid;
+
+      for (uint32_t c = 0; c < 3; c++)
+        mid[c] = _mm_sub_ps(hitDir[c], eye[c]);
+
+      mid[3] = zero;
+      mid = CpuNormalize3(mid);
+
+      __m128 midDot = CpuSaturate(CpuDot3(Normal, mid));
+      __m128 specularness = _mm_and_ps(_mm_cmpgt_ps(midDot, zero),
+        _mm_mul_ps(CpuPow(midDot, power), atten));
+
+      for (uint32_t c = 0; c < 4; c++) {
+        ambient[c]  = _mm_add_ps(ambient[c],  _mm_mul_ps(_mm_set1_ps(light.Ambient[c]),  atten));
+        diffuse[c]  = _mm_add_ps(diffuse[c],  _mm_mul_ps(_mm_set1_ps(light.Diffuse[c]),  diffuseness));
+        specular[c] = _mm_add_ps(specular[c], _mm_mul_ps(_mm_set1_ps(light.Specular[c]), specularness));
+      }
+    }
+
+    auto pickSource = [&] (uint32_t Source, const D3DCOLORVALUE& Material) {
+      if (Source == D3DMCS_MATERIAL)
+        return CpuSplat(Vector4(Material.r, Material.g, Material.b, Material.a));
+
+      // The source mask guarantees that the input exists
+      return pInputs[m_ff.color[Source == D3DMCS_COLOR1 ? 0 : 1]];
+    };
+
+    D3D9CpuVec4 matDiffuse  = pickSource(m_diffuseSource,  m_material.Diffuse);
+    D3D9CpuVec4 matAmbient  = pickSource(m_ambientSource,  m_material.Ambient);
+    D3D9CpuVec4 matEmissive = pickSource(m_emissiveSource, m_material.Emissive);
+    D3D9CpuVec4 matSpecular = pickSource(m_specularSource, m_material.Specular);
+
+    for (uint32_t c = 0; c < 4; c++) {
+      __m128 color0 = _mm_add_ps(_mm_mul_ps(matAmbient[c], _mm_set1_ps(m_globalAmbient[c])), matEmissive[c]);
+      color0 = _mm_add_ps(color0, _mm_mul_ps(matAmbient[c], ambient[c]));
+      color0 = _mm_add_ps(color0, _mm_mul_ps(matDiffuse[c], diffuse[c]));
+
+      pColors[0][c] = CpuSaturate(c == 3 ? matDiffuse[c] : color0);
+      pColors[1][c] = CpuSaturate(_mm_mul_ps(matSpecular[c], specular[c]));
+    }
+  }
+
+
+  void D3D9CpuVertexProcessor::ProcessShader(
+    const BatchState&           State,
+    const D3D9CpuVec4*          pInputs,
+          D3D9CpuVec4*          pValues) const {
+    std::array<D3D9CpuVec4, caps::InputRegisterCount>  inputs;
+    std::array<D3D9CpuVec4, D3D9CpuOutputRegCount>     outputs;
+
+    // Relative addressing may read undeclared inputs
+    for (auto& input : inputs)
+      input = CpuSplat(Vector4(0.0f));
+
+    for (const auto& input : m_shaderInputs) {
+      if (input.input < 0)
+        continue;
+
+      D3D9CpuVec4& reg = inputs[input.regNumber];
+      reg = pInputs[input.input];
+
+      for (uint32_t c = 0; c < 4; c++) {
+        if (!(input.mask & (1u << c)))
+          reg[c] = _mm_setzero_ps();
+      }
+    }
+
+    m_shader->Execute(inputs.data(), outputs.data());
+
+    for (uint32_t j = 0; j < m_outputs.size(); j++) {
+      const auto& output = m_outputs[j];
+
+      switch (output.source) {
+        case OutputSource::Position:
+          pValues[j] = outputs[m_shaderPosition];
+          break;
+
+        case OutputSource::PositionT:
+          pValues[j] = TransformPositionT(State, outputs[m_shaderPosition]);
+          break;
+
+        case OutputSource::Shader: {
+          // Written components are packed, like the
+          // shader linker does for the pixel shader
+          const D3D9CpuVec4& reg = outputs[output.input];
+          uint32_t count = 0;
+
+          for (uint32_t c = 0; c < 4; c++) {
+            if (output.mask & (1u << c)) {
+              pValues[j][count++] = output.saturate
+                ? CpuSaturate(reg[c]) : reg[c];
+            }
+          }
+
+          while (count < 4)
+            pValues[j][count++] = _mm_setzero_ps();
+        } break;
+
+        default:
+          pValues[j] = CpuSplat(output.value);
+      }
+    }
+  }
+
+
+  D3D9CpuVec4 D3D9CpuVertexProcessor::TransformPositionT(
+    const BatchState&           State,
+    const D3D9CpuVec4&          Clip) const {
+    // Screen-space position with reciprocal W
+    __m128 rhw = _mm_div_ps(_mm_set1_ps(1.0f), Clip[3]);
+
+    D3D9CpuVec4 result;
+
+    for (uint32_t c = 0; c < 3; c++) {
+      result[c] = _mm_add_ps(
+        _mm_mul_ps(_mm_mul_ps(Clip[c], rhw), State.viewportScale[c]),
+        State.viewportOffset[c]);
+    }
+
+    result[3] = rhw;
+    return result;
+  }
+
+
+  int32_t D3D9CpuVertexProcessor::FindInput(
+    const D3D9VertexDecl*       pDecl,
+          D3DDECLUSAGE          Usage,
+          uint32_t              UsageIndex) {
+    for (uint32_t i = 0; i < m_inputs.size(); i++) {
+      if (m_inputs[i].usage == Usage && m_inputs[i].usageIndex == UsageIndex)
+        return int32_t(i);
+    }
+
+    if (m_inputs.size() >= caps::InputRegisterCount)
+      return -1;
+
+    for (const auto& element : pDecl->GetElements()) {
+      if (element.Usage != Usage || element.UsageIndex != UsageIndex)
+        continue;
+
+      InputElement input;
+      input.stream     = element.Stream;
+      input.offset     = element.Offset;
+      input.type       = D3DDECLTYPE(element.Type);
+      input.usage      = Usage;
+      input.usageIndex = UsageIndex;
+
+      m_streamMask |= 1u << input.stream;
+      m_inputs.push_back(input);
+      return int32_t(m_inputs.size() - 1);
+    }
+
+    return -1;
+  }
+
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include "d3d9_include.h"
+#include "d3d9_state.h"
+#include "d3d9_cpu_shader.h"
+
+#include "../util/thread.h"
+#include "../util/util_matrix.h"
+
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace dxvk {
+
+  class D3D9VertexDecl;
+
+  /**
+   * \brief Source stream for CPU vertex processing
+   */
+  struct D3D9CpuVertexStream {
+    const uint8_t* data   = nullptr;
+    uint32_t       stride = 0;
+  };
+
+  /**
+   * \brief Worker threads for CPU vertex processing
+   *
+   * Owned by the device, so that large \c ProcessVertices
+   * calls do not have to create threads every time. The
+   * threads are only started on first use, since most
+   * applications never call \c ProcessVertices at all.
+   */
+  class D3D9CpuVertexWorkers {
+
+  public:
+
+    D3D9CpuVertexWorkers();
+
+    ~D3D9CpuVertexWorkers();
+
+    /**
+     * \brief Runs tasks on the worker threads
+     *
+     * The calling thread processes tasks as well, and
+     * the function returns once all tasks are done.
+     * \param [in] TaskCount Number of tasks
+     * \param [in] Task Function to call for each task index
+     */
+    void Run(
+            uint32_t                        TaskCount,
+      const std::function<void (uint32_t)>& Task);
+
+  private:
+
+    std::mutex                      m_runLock;
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_workCond;
+    std::condition_variable         m_doneCond;
+    std::vector<dxvk::thread>       m_threads;
+    bool                            m_stopThreads = false;
+
+    const std::function<void (uint32_t)>* m_task = nullptr;
+    uint32_t                        m_taskCount   = 0;
+    uint32_t                        m_nextTask    = 0;
+    uint32_t                        m_pendingTasks = 0;
+
+    void WorkerFunc();
+
+  };
+
+  /**
+   * \brief CPU vertex processing
+   *
+   * Implements \c ProcessVertices on the CPU. This avoids a
+   * GPU round trip when the application reads the results
+   * back, and also works on devices that cannot run the
+   * geometry shader based software vertex processing.
+   *
+   * Supports the fixed-function pipeline including lighting,
+   * vertex blending and texture coordinate generation, as
+   * well as \c vs_1_1 to \c vs_3_0 shaders through
+   * \ref D3D9CpuVertexShader. Vertices are processed four
+   * at a time, with one SSE register per vector component.
+   */
+  class D3D9CpuVertexProcessor {
+
+  public:
+
+    D3D9CpuVertexProcessor(
+      const D3D9CapturableState*  pState,
+      const D3D9ConstantLayout&   ConstantLayout,
+      const DxsoOptions&          ShaderOptions,
+      const D3D9VertexDecl*       pSrcDecl,
+      const D3D9VertexDecl*       pDstDecl,
+            DWORD                 Flags);
+
+    ~D3D9CpuVertexProcessor();
+
+    /**
+     * \brief Checks whether the state is supported
+     * \returns \c true if vertices can be processed on the CPU
+     */
+    bool IsSupported() const {
+      return m_supported;
+    }
+
+    /**
+     * \brief Source streams used by the vertex declaration
+     * \returns Bit mask of used source streams
+     */
+    uint32_t GetStreamMask() const {
+      return m_streamMask;
+    }
+
+    /**
+     * \brief Processes vertices
+     *
+     * Large batches are split across the worker threads.
+     * \param [in] Workers Worker threads
+     * \param [in] pStreams Source streams, indexed by stream number
+     * \param [in] FirstVertex Index of the first source vertex
+     * \param [in] VertexCount Number of vertices to process
+     * \param [out] pDst Destination vertex data
+     */
+    void Process(
+            D3D9CpuVertexWorkers& Workers,
+      const D3D9CpuVertexStream*  pStreams,
+            uint32_t              FirstVertex,
+            uint32_t              VertexCount,
+            uint8_t*              pDst) const;
+
+  private:
+
+    enum class OutputSource : uint32_t {
+      Position,
+      PositionT,
+      Default,
+      Color,
+      Texcoord,
+      Shader,
+    };
+
+    struct InputElement {
+      uint32_t      stream;
+      uint32_t      offset;
+      D3DDECLTYPE   type;
+      D3DDECLUSAGE  usage;
+      uint32_t      usageIndex;
+    };
+
+    struct OutputElement {
+      OutputSource  source;
+      uint32_t      input;
+      uint32_t      offset;
+      D3DDECLTYPE   type;
+      Vector4       value;
+      uint32_t      mask;
+      bool          saturate;
+    };
+
+    struct ShaderInput {
+      uint32_t      regNumber;
+      int32_t       input;
+      uint32_t      mask;
+    };
+
+    struct TexcoordStage {
+      uint32_t      input;
+      uint32_t      generate;
+      uint32_t      count;
+      uint32_t      padCount;
+      bool          transform;
+      bool          hasInput;
+    };
+
+    struct FixedFunctionInputs {
+      int32_t       position     = -1;
+      int32_t       position1    = -1;
+      int32_t       normal       = -1;
+      int32_t       normal1      = -1;
+      int32_t       blendWeight  = -1;
+      int32_t       blendIndices = -1;
+      int32_t       color[2]     = { -1, -1 };
+    };
+
+    struct BatchState;
+
+    bool                        m_supported  = true;
+    uint32_t                    m_streamMask = 0;
+    uint32_t                    m_dstStride  = 0;
+
+    Vector4                     m_viewportScale;
+    Vector4                     m_viewportOffset;
+
+    std::vector<InputElement>   m_inputs;
+    std::vector<OutputElement>  m_outputs;
+
+    // Fixed-function state
+    FixedFunctionInputs         m_ff;
+
+    Matrix4                     m_worldView;
+    Matrix4                     m_normalMatrix;
+    Matrix4                     m_projection;
+
+    bool                        m_tween         = false;
+    float                       m_tweenFactor   = 0.0f;
+
+    uint32_t                    m_blendCount    = 0;
+    bool                        m_blendIndexed  = false;
+    std::vector<Matrix4>        m_blendMatrices;
+
+    bool                        m_normalize     = false;
+    bool                        m_lighting      = false;
+    bool                        m_localViewer   = false;
+
+    std::vector<D3D9Light>      m_lights;
+    Vector4                     m_globalAmbient;
+    D3DMATERIAL9                m_material;
+
+    uint32_t                    m_diffuseSource  = D3DMCS_MATERIAL;
+    uint32_t                    m_ambientSource  = D3DMCS_MATERIAL;
+    uint32_t                    m_specularSource = D3DMCS_MATERIAL;
+    uint32_t                    m_emissiveSource = D3DMCS_MATERIAL;
+
+    std::array<TexcoordStage, caps::TextureStageCount> m_texcoords = { };
+    std::array<Matrix4,       caps::TextureStageCount> m_texMatrices;
+
+    // Shader state
+    std::unique_ptr<D3D9CpuVertexShader> m_shader;
+    std::vector<ShaderInput>    m_shaderInputs;
+    int32_t                     m_shaderPosition = -1;
+
+    void InitFixedFunction(
+      const D3D9CapturableState*  pState,
+      const D3D9VertexDecl*       pSrcDecl,
+      const D3D9VertexDecl*       pDstDecl,
+            DWORD                 Flags);
+
+    void InitShader(
+      const D3D9CapturableState*  pState,
+      const D3D9ConstantLayout&   ConstantLayout,
+      const DxsoOptions&          ShaderOptions,
+      const D3D9VertexDecl*       pSrcDecl,
+      const D3D9VertexDecl*       pDstDecl,
+            DWORD                 Flags);
+
+    void ProcessRange(
+      const D3D9CpuVertexStream*  pStreams,
+            uint32_t              FirstVertex,
+            uint32_t              VertexCount,
+            uint8_t*              pDst) const;
+
+    void ProcessFixedFunction(
+      const BatchState&           State,
+      const D3D9CpuVec4*          pInputs,
+            D3D9CpuVec4*          pValues) const;
+
+    void ProcessLighting(
+      const D3D9CpuVec4*          pInputs,
+      const D3D9CpuVec4&          Vtx,
+      const D3D9CpuVec4&          Normal,
+            D3D9CpuVec4*          pColors) const;
+
+    void ProcessShader(
+      const BatchState&           State,
+      const D3D9CpuVec4*          pInputs,
+            D3D9CpuVec4*          pValues) const;
+
+    D3D9CpuVec4 TransformPositionT(
+      const BatchState&           State,
+      const D3D9CpuVec4&          Clip) const;
+
+    int32_t FindInput(
+      const D3D9VertexDecl*       pDecl,
+            D3DDECLUSAGE          Usage,
+            uint32_t              UsageIndex);
+
+  };
+
+}
@@ -14,6 +14,7 @@
 #include "d3d9_spec_constants.h"
 #include "d3d9_names.h"
 #include "d3d9_format_helpers.h"
+#include "d3d9_cpu_vertex.h"
 
 #include "../dxvk/dxvk_adapter.h"
 #include "../dxvk/dxvk_instance.h"
@@ -50,9 +51,11 @@ namespace dxvk {
     , m_behaviorFlags  ( BehaviorFlags )
     , m_multithread    ( BehaviorFlags & D3DCREATE_MULTITHREADED )
     , m_shaderModules  ( new D3D9ShaderModuleSet )
+    , m_readbackFence  ( new sync::Fence(0) )
     , m_d3d9Options    ( dxvkDevice, pParent->GetInstance()->config() )
     , m_dxsoOptions    ( m_dxvkDevice, m_d3d9Options )
-    , m_isSWVP         ( (BehaviorFlags & D3DCREATE_SOFTWARE_VERTEXPROCESSING) ? TRUE : FALSE ) {
+    , m_isSWVP         ( (BehaviorFlags & D3DCREATE_SOFTWARE_VERTEXPROCESSING) ? TRUE : FALSE )
+    , m_samplers       ( m_d3d9Options.samplerCacheSize ) {
     // If we can SWVP, then we use an extended constant set
     // as SWVP has many more slots available than HWVP. 
     bool canSWVP = CanSWVP();
@@ -64,6 +67,9 @@ namespace dxvk {
     m_initializer      = new D3D9Initializer(m_dxvkDevice);
     m_converter        = new D3D9FormatHelper(m_dxvkDevice);
 
+    if (m_d3d9Options.dynamicBufferArenaLimit)
+      m_dynamicBufferArena = CreateDynamicBufferArena();
+
     EmitCs([
       cDevice = m_dxvkDevice
     ] (DxvkContext* ctx) {
@@ -85,10 +91,14 @@ namespace dxvk {
     HRESULT hr = InitialReset(pPresentationParameters, pDisplayMode);
     if (FAILED(hr))
       throw DxvkError("D3D9DeviceEx: Initial device reset failed.");
+
+    m_ffModules.StartPrecompile(this);
   }
 
 
   D3D9DeviceEx::~D3D9DeviceEx() {
+    m_ffModules.StopPrecompile();
+
     Flush();
     SynchronizeCsThread();
 
@@ -815,25 +825,31 @@ namespace dxvk {
 
     VkExtent3D srcExtent = srcTexInfo->GetExtentMip(src->GetMipLevel());
 
+    uint64_t readbackSeq = ++m_readbackSeq;
+
     EmitCs([
       cBuffer       = dstBuffer,
       cImage        = srcImage,
       cSubresources = srcSubresourceLayers,
-      cLevelExtent  = srcExtent
+      cLevelExtent  = srcExtent,
+      cFence        = m_readbackFence,
+      cFenceValue   = readbackSeq
     ] (DxvkContext* ctx) {
       ctx->copyImageToBuffer(
         cBuffer, 0, VkExtent2D { 0u, 0u },
         cImage, cSubresources, VkOffset3D { 0, 0, 0 },
         cLevelExtent);
+      ctx->signal(cFence, cFenceValue);
     });
-    
-    // We need to force a wait here
-    // as some applications depend on
-    // DO_NOT_WAIT not applying after
-    // this has happened.
-    // (this is a blocking call)
-    WaitForResource(dstBuffer, 0);
 
+    // Submit the copy right away, but only wait for it once
+    // the application actually locks the destination surface.
+    // Some applications depend on DO_NOT_WAIT not applying
+    // after this has happened, so that wait is unconditional.
+    dstTexInfo->SetReadbackSeq(dst->GetSubresource(), readbackSeq);
+    m_readbackStats.readbacks.fetch_add(1, std::memory_order_relaxed);
+
+    Flush();
     return D3D_OK;
   }
 
@@ -1969,7 +1985,7 @@ namespace dxvk {
   HRESULT STDMETHODCALLTYPE D3D9DeviceEx::CreateStateBlock(
           D3DSTATEBLOCKTYPE      Type,
           IDirect3DStateBlock9** ppSB) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Create);
 
     InitReturnPtr(ppSB);
 
@@ -2249,7 +2265,7 @@ namespace dxvk {
           D3DPRIMITIVETYPE PrimitiveType,
           UINT             StartVertex,
           UINT             PrimitiveCount) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Draw);
 
     PrepareDraw(PrimitiveType);
 
@@ -2279,7 +2295,7 @@ namespace dxvk {
           UINT             NumVertices,
           UINT             StartIndex,
           UINT             PrimitiveCount) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Draw);
 
     PrepareDraw(PrimitiveType);
 
@@ -2309,7 +2325,7 @@ namespace dxvk {
           UINT             PrimitiveCount,
     const void*            pVertexStreamZeroData,
           UINT             VertexStreamZeroStride) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Draw);
 
     PrepareDraw(PrimitiveType, true);
 
@@ -2352,7 +2368,7 @@ namespace dxvk {
           D3DFORMAT        IndexDataFormat,
     const void*            pVertexStreamZeroData,
           UINT             VertexStreamZeroStride) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Draw);
 
     PrepareDraw(PrimitiveType, true);
 
@@ -2407,25 +2423,14 @@ namespace dxvk {
           IDirect3DVertexBuffer9*      pDestBuffer,
           IDirect3DVertexDeclaration9* pVertexDecl,
           DWORD                        Flags) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Draw);
 
     if (unlikely(pDestBuffer == nullptr || pVertexDecl == nullptr))
       return D3DERR_INVALIDCALL;
 
-    if (!SupportsSWVP()) {
-      static bool s_errorShown = false;
-
-      if (!std::exchange(s_errorShown, true))
-        Logger::err("D3D9DeviceEx::ProcessVertices: SWVP emu unsupported (vertexPipelineStoresAndAtomics)");
-
-      return D3D_OK;
-    }
-
     D3D9CommonBuffer* dst  = static_cast<D3D9VertexBuffer*>(pDestBuffer)->GetCommonBuffer();
     D3D9VertexDecl*   decl = static_cast<D3D9VertexDecl*>  (pVertexDecl);
 
-    PrepareDraw(D3DPT_FORCE_DWORD, false);
-
     if (decl == nullptr) {
       DWORD FVF = dst->Desc()->FVF;
 
@@ -2439,6 +2444,30 @@ namespace dxvk {
         decl = iter->second.ptr();
     }
 
+    // Process vertices on the CPU if the application is going to
+    // read the results back anyway, or if the GPU emulation is not
+    // available on this device. This covers fixed-function as well
+    // as shader-based vertex processing.
+    if (dst->Desc()->Pool == D3DPOOL_SYSTEMMEM || !SupportsSWVP()) {
+      D3D9CpuVertexProcessor processor(&m_state,
+        GetVertexConstantLayout(), m_dxsoOptions,
+        m_state.vertexDecl, decl, Flags);
+
+      if (processor.IsSupported())
+        return ProcessVerticesCpu(processor, SrcStartIndex, DestIndex, VertexCount, dst, decl->GetSize());
+    }
+
+    if (!SupportsSWVP()) {
+      static bool s_errorShown = false;
+
+      if (!std::exchange(s_errorShown, true))
+        Logger::err("D3D9DeviceEx::ProcessVertices: State not supported on the CPU and SWVP emu unsupported (vertexPipelineStoresAndAtomics)");
+
+      return D3D_OK;
+    }
+
+    PrepareDraw(D3DPT_FORCE_DWORD, false);
+
     uint32_t offset = DestIndex * decl->GetSize();
 
     auto slice = dst->GetBufferSlice<D3D9_COMMON_BUFFER_TYPE_REAL>();
@@ -2492,6 +2521,52 @@ namespace dxvk {
   }
 
 
+  HRESULT D3D9DeviceEx::ProcessVerticesCpu(
+    const D3D9CpuVertexProcessor&       Processor,
+          UINT                          SrcStartIndex,
+          UINT                          DestIndex,
+          UINT                          VertexCount,
+          D3D9CommonBuffer*             pDst,
+          UINT                          DstStride) {
+    std::array<D3D9CpuVertexStream, caps::MaxStreams> streams;
+
+    for (uint32_t mask = Processor.GetStreamMask(); mask; mask &= mask - 1) {
+      uint32_t idx = bit::tzcnt(mask);
+
+      const auto& vbo = m_state.vertexBuffers[idx];
+
+      if (unlikely(vbo.vertexBuffer == nullptr))
+        return D3DERR_INVALIDCALL;
+
+      D3D9CommonBuffer* src = vbo.vertexBuffer->GetCommonBuffer();
+
+      if (unlikely(vbo.offset + uint64_t(SrcStartIndex + VertexCount) * vbo.stride > src->Desc()->Size))
+        return D3DERR_INVALIDCALL;
+
+      // Only wait for pending writes to the source, such
+      // as the copy from a previous ProcessVertices call
+      WaitForResource(src->GetBuffer<D3D9_COMMON_BUFFER_TYPE_MAPPING>(), D3DLOCK_READONLY);
+
+      streams[idx].data   = reinterpret_cast<const uint8_t*>(src->GetMappedSlice().mapPtr) + vbo.offset;
+      streams[idx].stride = vbo.stride;
+    }
+
+    if (unlikely(uint64_t(DestIndex + VertexCount) * DstStride > pDst->Desc()->Size))
+      return D3DERR_INVALIDCALL;
+
+    void* dstData = nullptr;
+
+    HRESULT hr = LockBuffer(pDst, DestIndex * DstStride, VertexCount * DstStride, &dstData, 0);
+
+    if (FAILED(hr))
+      return hr;
+
+    Processor.Process(m_cpuVertexWorkers, streams.data(), SrcStartIndex, VertexCount, reinterpret_cast<uint8_t*>(dstData));
+
+    return UnlockBuffer(pDst);
+  }
+
+
   HRESULT STDMETHODCALLTYPE D3D9DeviceEx::CreateVertexDeclaration(
     const D3DVERTEXELEMENT9*            pVertexElements,
           IDirect3DVertexDeclaration9** ppDecl) {
@@ -3420,7 +3495,7 @@ namespace dxvk {
           D3DPRESENT_PARAMETERS* pPresentationParameters,
     const D3DDISPLAYMODEEX*      pFullscreenDisplayMode,
           IDirect3DSwapChain9**  ppSwapChain) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Create);
 
     InitReturnPtr(ppSwapChain);
 
@@ -3594,6 +3669,35 @@ namespace dxvk {
   }
 
 
+  Rc<DxvkBufferArena> D3D9DeviceEx::CreateDynamicBufferArena() {
+    // Must be a superset of what D3D9CommonBuffer
+    // uses for directly mapped vertex and index buffers
+    DxvkBufferCreateInfo info;
+    info.size   = 0;
+    info.usage  = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+                | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    info.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                | VK_PIPELINE_STAGE_HOST_BIT;
+    info.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+                | VK_ACCESS_INDEX_READ_BIT
+                | VK_ACCESS_HOST_WRITE_BIT
+                | VK_ACCESS_HOST_READ_BIT;
+
+    if (SupportsSWVP()) {
+      info.usage  |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+      info.stages |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+      info.access |= VK_ACCESS_SHADER_WRITE_BIT;
+    }
+
+    VkMemoryPropertyFlags memoryFlags
+      = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+      | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+      | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    return new DxvkBufferArena(m_dxvkDevice.ptr(), info, memoryFlags);
+  }
+
+
   void D3D9DeviceEx::DetermineConstantLayouts(bool canSWVP) {
     m_vsLayout.floatCount    = canSWVP ? uint32_t(m_d3d9Options.swvpFloatCount) : caps::MaxFloatConstantsVS;
     m_vsLayout.intCount      = canSWVP ? uint32_t(m_d3d9Options.swvpIntCount)   : caps::MaxOtherConstants;
@@ -3727,6 +3831,31 @@ namespace dxvk {
   }
 
 
+  bool D3D9DeviceEx::WaitForReadback(
+            D3D9CommonTexture*      pResource,
+            UINT                    Subresource) {
+    uint64_t readbackSeq = pResource->SetReadbackSeq(Subresource, 0);
+
+    if (likely(!readbackSeq))
+      return false;
+
+    if (m_readbackFence->value() >= readbackSeq)
+      return true;
+
+    // The copy was submitted in GetRenderTargetData, so we
+    // only need to wait for that particular submission to
+    // complete instead of synchronizing the entire device
+    auto t0 = dxvk::high_resolution_clock::now();
+    m_readbackFence->wait(readbackSeq);
+    auto t1 = dxvk::high_resolution_clock::now();
+
+    auto stallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0);
+    m_readbackStats.stalls.fetch_add(1, std::memory_order_relaxed);
+    m_readbackStats.stallTimeNs.fetch_add(stallTime.count(), std::memory_order_relaxed);
+    return true;
+  }
+
+
   uint32_t D3D9DeviceEx::CalcImageLockOffset(
             uint32_t                SlicePitch,
             uint32_t                RowPitch,
@@ -3760,7 +3889,7 @@ namespace dxvk {
             D3DLOCKED_BOX*          pLockedBox,
       const D3DBOX*                 pBox,
             DWORD                   Flags) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Lock);
 
     UINT Subresource = pResource->CalcSubresource(Face, MipLevel);
 
@@ -3838,6 +3967,12 @@ namespace dxvk {
       });
     }
     else if (managed || scratch || systemmem) {
+      // The readback fence gets signaled slightly before the GPU
+      // releases the mapping buffer, so DO_NOT_WAIT must not apply
+      // to the resource wait either if a readback was pending.
+      if (systemmem && WaitForReadback(pResource, Subresource))
+        Flags &= ~D3DLOCK_DONOTWAIT;
+
       // Managed and scratch resources
       // are meant to be able to provide readback without waiting.
       // We always keep a copy of them in system memory for this reason.
@@ -3978,7 +4113,7 @@ namespace dxvk {
         D3D9CommonTexture*      pResource,
         UINT                    Face,
         UINT                    MipLevel) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Lock);
 
     UINT Subresource = pResource->CalcSubresource(Face, MipLevel);
 
@@ -4067,7 +4202,7 @@ namespace dxvk {
           UINT                    SizeToLock,
           void**                  ppbData,
           DWORD                   Flags) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Lock);
 
     if (unlikely(ppbData == nullptr))
       return D3DERR_INVALIDCALL;
@@ -4214,7 +4349,7 @@ namespace dxvk {
 
   HRESULT D3D9DeviceEx::UnlockBuffer(
         D3D9CommonBuffer*       pResource) {
-    D3D9DeviceLock lock = LockDevice();
+    D3D9DeviceLock lock = LockDevice(D3D9DeviceLockSite::Lock);
 
     if (pResource->DecrementLockCount() != 0)
       return D3D_OK;
@@ -4601,6 +4736,8 @@ namespace dxvk {
       // Reset flush timer used for implicit flushes
       m_lastFlush = dxvk::high_resolution_clock::now();
       m_csIsBusy = false;
+
+      m_submissionCount.fetch_add(1, std::memory_order_release);
     }
   }
 
@@ -5165,10 +5302,12 @@ namespace dxvk {
       cDepthSlot = depthSlot,
       cKey       = key
     ] (DxvkContext* ctx) {
-      auto pair = m_samplers.find(cKey);
-      if (pair != m_samplers.end()) {
-        ctx->bindResourceSampler(cColorSlot, pair->second.color);
-        ctx->bindResourceSampler(cDepthSlot, pair->second.depth);
+      size_t hash = D3D9SamplerKeyHash()(cKey);
+
+      auto pair = m_samplers.Find(cKey, hash);
+      if (pair != nullptr) {
+        ctx->bindResourceSampler(cColorSlot, pair->color);
+        ctx->bindResourceSampler(cDepthSlot, pair->depth);
         return;
       }
 
@@ -5214,9 +5353,7 @@ namespace dxvk {
         pair.color = m_dxvkDevice->createSampler(colorInfo);
         pair.depth = m_dxvkDevice->createSampler(depthInfo);
 
-        m_samplerCount++;
-
-        m_samplers.insert(std::make_pair(cKey, pair));
+        m_samplers.Insert(cKey, hash, pair);
         ctx->bindResourceSampler(cColorSlot, pair.color);
         ctx->bindResourceSampler(cDepthSlot, pair.depth);
       }
@@ -5386,9 +5523,20 @@ namespace dxvk {
           GetVertexShaderPermutation());
       }
       UploadConstants<DxsoProgramTypes::VertexShader>();
+
+      // Software vertex processing uses more than one bool
+      // bitmask, shaders never read the spec constant then
+      UpdateBoolSpecConstant(DxsoProgramTypes::VertexShader, m_vsLayout.bitmaskCount == 1
+        ? GetCommonShader(m_state.vertexShader)->GetBoolSpecConstant(
+            m_state.vsConsts.bConsts[0], m_d3d9Options.boolSpecVariants)
+        : 0u);
+
+      UpdateFFLightingSpecConstant(0u);
     }
-    else
+    else {
+      UpdateBoolSpecConstant(DxsoProgramTypes::VertexShader, 0u);
       UpdateFixedFunctionVS();
+    }
 
     if (m_flags.test(D3D9DeviceFlag::DirtyInputLayout))
       BindInputLayout();
@@ -5404,6 +5552,10 @@ namespace dxvk {
     if (likely(UseProgrammablePS())) {
       UploadConstants<DxsoProgramTypes::PixelShader>();
 
+      UpdateBoolSpecConstant(DxsoProgramTypes::PixelShader,
+        GetCommonShader(m_state.pixelShader)->GetBoolSpecConstant(
+          m_state.psConsts.bConsts[0], m_d3d9Options.boolSpecVariants));
+
       if (GetCommonShader(m_state.pixelShader)->GetInfo().majorVersion() >= 2)
         UpdateSamplerTypes(0u, 0u);
       else
@@ -5411,6 +5563,7 @@ namespace dxvk {
     }
     else {
       UpdateSamplerTypes(0u, 0u);
+      UpdateBoolSpecConstant(DxsoProgramTypes::PixelShader, 0u);
 
       UpdateFixedFunctionPS();
     }
@@ -5473,6 +5626,85 @@ namespace dxvk {
   }
 
 
+  D3D9InputLayout D3D9DeviceEx::CreateInputLayout(
+    const D3D9VertexDecl*                         pVertexDecl,
+    const DxsoIsgn&                               Isgn,
+    const std::array<uint32_t, caps::MaxStreams>& StreamFreq) {
+    D3D9InputLayout layout;
+
+    const auto& elements = pVertexDecl->GetElements();
+
+    auto& attrList = layout.attrs;
+    auto& bindList = layout.binds;
+
+    uint32_t attrMask = 0;
+    uint32_t bindMask = 0;
+
+    for (uint32_t i = 0; i < Isgn.elemCount; i++) {
+      const auto& decl = Isgn.elems[i];
+
+      DxvkVertexAttribute attrib;
+      attrib.location = i;
+      attrib.binding  = NullStreamIdx;
+      attrib.format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attrib.offset   = 0;
+
+      for (const auto& element : elements) {
+        DxsoSemantic elementSemantic = { static_cast<DxsoUsage>(element.Usage), element.UsageIndex };
+        if (elementSemantic.usage == DxsoUsage::PositionT)
+          elementSemantic.usage = DxsoUsage::Position;
+
+        if (elementSemantic == decl.semantic) {
+          attrib.binding = uint32_t(element.Stream);
+          attrib.format  = DecodeDecltype(D3DDECLTYPE(element.Type));
+          attrib.offset  = element.Offset;
+
+          layout.streamsUsed |= 1u << attrib.binding;
+          break;
+        }
+      }
+
+      attrList[i] = attrib;
+
+      DxvkVertexBinding binding;
+      binding.binding = attrib.binding;
+
+      uint32_t instanceData = StreamFreq[binding.binding % caps::MaxStreams];
+      if (instanceData & D3DSTREAMSOURCE_INSTANCEDATA) {
+        binding.fetchRate = instanceData & 0x7FFFFF; // Remove instance packed-in flags in the data.
+        binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+      }
+      else {
+        binding.fetchRate = 0;
+        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+      }
+
+      // Check if the binding was already defined.
+      bool bindingDefined = false;
+
+      for (uint32_t j = 0; j < i; j++) {
+        uint32_t bindingId = attrList.at(j).binding;
+
+        if (binding.binding == bindingId) {
+          bindingDefined = true;
+        }
+      }
+
+      if (!bindingDefined)
+        bindList.at(binding.binding) = binding;
+
+      attrMask |= 1u << i;
+      bindMask |= 1u << binding.binding;
+    }
+
+    // Compact the attribute and binding lists to filter
+    // out attributes and bindings not used by the shader
+    layout.attrCount = CompactSparseList(attrList.data(), attrMask);
+    layout.bindCount = CompactSparseList(bindList.data(), bindMask);
+    return layout;
+  }
+
+
   void D3D9DeviceEx::BindInputLayout() {
     m_flags.clr(D3D9DeviceFlag::DirtyInputLayout);
 
@@ -5501,86 +5733,36 @@ namespace dxvk {
         cStreamsInstanced = m_instancedData,
         cStreamFreq       = streamFreq
       ] (DxvkContext* ctx) {
-        cIaState.streamsInstanced = cStreamsInstanced;
-        cIaState.streamsUsed      = 0;
-
-        const auto& elements = cVertexDecl->GetElements();
-
-        std::array<DxvkVertexAttribute, 2 * caps::InputRegisterCount> attrList;
-        std::array<DxvkVertexBinding,   2 * caps::InputRegisterCount> bindList;
-
-        uint32_t attrMask = 0;
-        uint32_t bindMask = 0;
-
         const auto& isgn = cVertexShader != nullptr
           ? GetCommonShader(cVertexShader.ptr())->GetIsgn()
           : GetFixedFunctionIsgn();
 
-        for (uint32_t i = 0; i < isgn.elemCount; i++) {
-          const auto& decl = isgn.elems[i];
-
-          DxvkVertexAttribute attrib;
-          attrib.location = i;
-          attrib.binding  = NullStreamIdx;
-          attrib.format   = VK_FORMAT_R32G32B32A32_SFLOAT;
-          attrib.offset   = 0;
-
-          for (const auto& element : elements) {
-            DxsoSemantic elementSemantic = { static_cast<DxsoUsage>(element.Usage), element.UsageIndex };
-            if (elementSemantic.usage == DxsoUsage::PositionT)
-              elementSemantic.usage = DxsoUsage::Position;
-
-            if (elementSemantic == decl.semantic) {
-              attrib.binding = uint32_t(element.Stream);
-              attrib.format  = DecodeDecltype(D3DDECLTYPE(element.Type));
-              attrib.offset  = element.Offset;
-
-              cIaState.streamsUsed |= 1u << attrib.binding;
-              break;
-            }
-          }
-
-          attrList[i] = attrib;
-
-          DxvkVertexBinding binding;
-          binding.binding = attrib.binding;
+        D3D9InputLayoutKey key;
+        key.semanticCount = isgn.elemCount;
 
-          uint32_t instanceData = cStreamFreq[binding.binding % caps::MaxStreams];
-          if (instanceData & D3DSTREAMSOURCE_INSTANCEDATA) {
-            binding.fetchRate = instanceData & 0x7FFFFF; // Remove instance packed-in flags in the data.
-            binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
-          }
-          else {
-            binding.fetchRate = 0;
-            binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-          }
-
-          // Check if the binding was already defined.
-          bool bindingDefined = false;
-
-          for (uint32_t j = 0; j < i; j++) {
-            uint32_t bindingId = attrList.at(j).binding;
+        for (uint32_t i = 0; i < isgn.elemCount; i++) {
+          const auto& semantic = isgn.elems[i].semantic;
+          key.semantics[i] = uint16_t(uint32_t(semantic.usage) | (semantic.usageIndex << 8));
+        }
 
-            if (binding.binding == bindingId) {
-              bindingDefined = true;
-            }
-          }
+        for (uint32_t i = 0; i < caps::MaxStreams; i++) {
+          if (cStreamFreq[i] & D3DSTREAMSOURCE_INSTANCEDATA)
+            key.instanceFreq[i] = cStreamFreq[i];
+        }
 
-          if (!bindingDefined)
-            bindList.at(binding.binding) = binding;
+        const D3D9InputLayout* layout = cVertexDecl->FindInputLayout(key);
 
-          attrMask |= 1u << i;
-          bindMask |= 1u << binding.binding;
+        if (unlikely(layout == nullptr)) {
+          layout = &cVertexDecl->AddInputLayout(key,
+            CreateInputLayout(cVertexDecl.ptr(), isgn, cStreamFreq));
         }
 
-        // Compact the attribute and binding lists to filter
-        // out attributes and bindings not used by the shader
-        uint32_t attrCount = CompactSparseList(attrList.data(), attrMask);
-        uint32_t bindCount = CompactSparseList(bindList.data(), bindMask);
-      
+        cIaState.streamsInstanced = cStreamsInstanced;
+        cIaState.streamsUsed      = layout->streamsUsed;
+
         ctx->setInputLayout(
-          attrCount, attrList.data(),
-          bindCount, bindList.data());
+          layout->attrCount, layout->attrs.data(),
+          layout->bindCount, layout->binds.data());
       });
     }
   }
@@ -5831,6 +6013,9 @@ namespace dxvk {
         key.Data.Contents.VertexBlendCount   = m_state.renderStates[D3DRS_VERTEXBLEND] & 0xff;
       }
 
+      if (m_d3d9Options.ffUberShaders)
+        m_ffLightingSpec = ExtractFFLightingState(key);
+
       EmitCs([
         this,
         cKey     = key,
@@ -5841,6 +6026,8 @@ namespace dxvk {
       });
     }
 
+    UpdateFFLightingSpecConstant(m_ffLightingSpec);
+
     if (hasPositionT && (m_flags.test(D3D9DeviceFlag::DirtyFFViewport) || m_ffZTest != IsZTestEnabled())) {
       m_flags.clr(D3D9DeviceFlag::DirtyFFViewport);
       m_flags.set(D3D9DeviceFlag::DirtyFFVertexData);
@@ -6024,6 +6211,16 @@ namespace dxvk {
       if (idx >= 1)
         key.Stages[idx - 1].Contents.ResultIsTemp = false;
 
+      if (m_d3d9Options.ffUberShaders) {
+        std::array<D3D9FixedFunctionStagePS, caps::TextureStageCount> stages;
+        ExtractFFStageState(key, stages.data());
+
+        if (std::memcmp(stages.data(), m_ffStageState.data(), sizeof(stages))) {
+          m_ffStageState = stages;
+          m_flags.set(D3D9DeviceFlag::DirtyFFPixelData);
+        }
+      }
+
       EmitCs([
         this,
         cKey     = key,
@@ -6052,6 +6249,7 @@ namespace dxvk {
 
       D3D9FixedFunctionPS* data = reinterpret_cast<D3D9FixedFunctionPS*>(slice.mapPtr);
       DecodeD3DCOLOR((D3DCOLOR)rs[D3DRS_TEXTUREFACTOR], data->textureFactor.data);
+      std::memcpy(data->stages, m_ffStageState.data(), sizeof(data->stages));
     }
   }
 
@@ -6086,6 +6284,36 @@ namespace dxvk {
   }
 
 
+  void D3D9DeviceEx::UpdateBoolSpecConstant(DxsoProgramType ShaderStage, uint32_t value) {
+    uint32_t& lastValue = m_lastBoolSpecConstants[ShaderStage];
+
+    if (lastValue == value)
+      return;
+
+    D3D9SpecConstantId specId = ShaderStage == DxsoProgramTypes::VertexShader
+      ? D3D9SpecConstantId::VertexShaderBools
+      : D3D9SpecConstantId::PixelShaderBools;
+
+    EmitCs([cSpecId = specId, cValue = value](DxvkContext* ctx) {
+      ctx->setSpecConstant(VK_PIPELINE_BIND_POINT_GRAPHICS, cSpecId, cValue);
+    });
+
+    lastValue = value;
+  }
+
+
+  void D3D9DeviceEx::UpdateFFLightingSpecConstant(uint32_t value) {
+    if (m_lastFFLightingSpec == value)
+      return;
+
+    EmitCs([cValue = value](DxvkContext* ctx) {
+      ctx->setSpecConstant(VK_PIPELINE_BIND_POINT_GRAPHICS, D3D9SpecConstantId::FFVertexLighting, cValue);
+    });
+
+    m_lastFFLightingSpec = value;
+  }
+
+
   void D3D9DeviceEx::ApplyPrimitiveType(
     DxvkContext*      pContext,
     D3DPRIMITIVETYPE  PrimType) {
@@ -6447,6 +6675,9 @@ namespace dxvk {
     m_flags.set(D3D9DeviceFlag::DirtyInputLayout);
 
     UpdateSamplerSpecConsant(0u);
+    UpdateBoolSpecConstant(DxsoProgramTypes::VertexShader, 0u);
+    UpdateBoolSpecConstant(DxsoProgramTypes::PixelShader,  0u);
+    UpdateFFLightingSpecConstant(0u);
 
     return D3D_OK;
   }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../dxvk/dxvk_buffer_arena.h"
 #include "../dxvk/dxvk_device.h"
 #include "../dxvk/dxvk_cs.h"
 
@@ -22,6 +23,7 @@
 #include "d3d9_sampler.h"
 #include "d3d9_fixed_function.h"
 #include "d3d9_swvp_emu.h"
+#include "d3d9_cpu_vertex.h"
 
 #include "d3d9_shader_permutations.h"
 
@@ -41,6 +43,7 @@ namespace dxvk {
   class D3D9Query;
   class D3D9StateBlock;
   class D3D9FormatHelper;
+  struct D3D9InputLayout;
 
   enum class D3D9DeviceFlag : uint32_t {
     DirtyFramebuffer,
@@ -81,16 +84,20 @@ namespace dxvk {
     uint32_t instanceCount;
   };
 
-  struct D3D9SamplerPair {
-    Rc<DxvkSampler> color;
-    Rc<DxvkSampler> depth;
-  };
-
   struct D3D9UPBufferSlice {
     DxvkBufferSlice slice = {};
     void*           mapPtr = nullptr;
   };
 
+  /**
+   * \brief Render target readback statistics
+   */
+  struct D3D9ReadbackStats {
+    uint64_t readbacks    = 0;
+    uint64_t stalls       = 0;
+    uint64_t stallTimeNs  = 0;
+  };
+
   class D3D9DeviceEx final : public ComObjectClamp<IDirect3DDevice9Ex> {
     constexpr static uint32_t DefaultFrameLatency = 3;
     constexpr static uint32_t MaxFrameLatency     = 20;
@@ -819,6 +826,11 @@ namespace dxvk {
       const D3D9CommonShader*                 pShaderModule,
             D3D9ShaderPermutation             Permutation);
 
+    static D3D9InputLayout CreateInputLayout(
+      const D3D9VertexDecl*                         pVertexDecl,
+      const DxsoIsgn&                               Isgn,
+      const std::array<uint32_t, caps::MaxStreams>& StreamFreq);
+
     void BindInputLayout();
 
     void BindVertexBuffer(
@@ -829,8 +841,24 @@ namespace dxvk {
 
     void BindIndices();
 
-    D3D9DeviceLock LockDevice() {
-      return m_multithread.AcquireLock();
+    D3D9DeviceLock LockDevice(D3D9DeviceLockSite Site = D3D9DeviceLockSite::Other) {
+      return m_multithread.AcquireLock(Site);
+    }
+
+    bool IsMultithreaded() const {
+      return m_multithread.IsProtected();
+    }
+
+    void EnableLockStatistics() {
+      m_multithread.EnableStatistics();
+    }
+
+    void DisableLockStatistics() {
+      m_multithread.DisableStatistics();
+    }
+
+    D3D9DeviceLockStats GetLockStatistics() const {
+      return m_multithread.GetStatistics();
     }
 
     const D3D9Options* GetOptions() const {
@@ -841,6 +869,8 @@ namespace dxvk {
       return &m_state;
     }
 
+    bool ShouldRecord();
+
     void Begin(D3D9Query* pQuery);
     void End(D3D9Query* pQuery);
 
@@ -877,9 +907,55 @@ namespace dxvk {
     HRESULT InitialReset(D3DPRESENT_PARAMETERS* pPresentationParameters, D3DDISPLAYMODEEX* pFullscreenDisplayMode);
 
     UINT GetSamplerCount() const {
-      return m_samplerCount.load();
+      return m_samplers.GetCount();
+    }
+
+    D3D9SamplerCacheStats GetSamplerCacheStats() const {
+      return m_samplers.GetStats();
+    }
+
+    D3D9ShaderTranslationStats GetShaderTranslationStats() const {
+      return m_shaderModules->GetStats();
+    }
+
+    /**
+     * \brief Number of command list submissions
+     *
+     * Can be used to determine whether commands
+     * recorded before a given point in time have
+     * been submitted to the GPU yet.
+     * \returns Submission count
+     */
+    uint64_t GetSubmissionCount() const {
+      return m_submissionCount.load(std::memory_order_acquire);
+    }
+
+    const Rc<DxvkBufferArena>& GetDynamicBufferArena() const {
+      return m_dynamicBufferArena;
     }
 
+    D3D9ReadbackStats GetReadbackStats() const {
+      D3D9ReadbackStats stats;
+      stats.readbacks   = m_readbackStats.readbacks.load(std::memory_order_relaxed);
+      stats.stalls      = m_readbackStats.stalls.load(std::memory_order_relaxed);
+      stats.stallTimeNs = m_readbackStats.stallTimeNs.load(std::memory_order_relaxed);
+      return stats;
+    }
+
+    /**
+     * \brief Waits for a pending readback
+     *
+     * Blocks until the copy recorded by \c GetRenderTargetData
+     * into the given subresource has completed on the GPU.
+     * Does nothing if there is no pending readback.
+     * \param [in] pResource The destination texture
+     * \param [in] Subresource Subresource index
+     * \returns \c true if a readback was pending
+     */
+    bool WaitForReadback(
+            D3D9CommonTexture*      pResource,
+            UINT                    Subresource);
+
   private:
 
     D3D9DeviceFlags                 m_flags;
@@ -904,6 +980,7 @@ namespace dxvk {
 
     D3D9FFShaderModuleSet           m_ffModules;
     D3D9SWVPEmulator                m_swvpEmulator;
+    D3D9CpuVertexWorkers            m_cpuVertexWorkers;
 
     DxvkCsChunkRef AllocCsChunk() {
       DxvkCsChunk* chunk = m_csChunkPool.allocChunk(DxvkCsChunkFlag::SingleUse);
@@ -964,6 +1041,19 @@ namespace dxvk {
     Rc<DxvkBuffer>                  m_psFixedFunction;
     Rc<DxvkBuffer>                  m_psShared;
 
+    Rc<DxvkBufferArena>             m_dynamicBufferArena;
+
+    std::atomic<uint64_t>           m_submissionCount = { 0ull };
+
+    Rc<sync::Fence>                 m_readbackFence;
+    uint64_t                        m_readbackSeq = 0ull;
+
+    struct {
+      std::atomic<uint64_t>         readbacks   = { 0ull };
+      std::atomic<uint64_t>         stalls      = { 0ull };
+      std::atomic<uint64_t>         stallTimeNs = { 0ull };
+    }                               m_readbackStats;
+
     D3D9UPBufferSlice               m_upBuffer;
 
     const D3D9Options               m_d3d9Options;
@@ -980,11 +1070,7 @@ namespace dxvk {
     std::vector<
       IDirect3DSwapChain9Ex*>       m_swapchains;
 
-    std::unordered_map<
-      D3D9SamplerKey,
-      D3D9SamplerPair,
-      D3D9SamplerKeyHash,
-      D3D9SamplerKeyEq>             m_samplers;
+    D3D9SamplerCache                m_samplers;
 
     std::unordered_map<
       DWORD,
@@ -998,6 +1084,13 @@ namespace dxvk {
     uint32_t                        m_lastProjectionBitfield = 0;
     uint32_t                        m_projectionBitfield = 0;
 
+    std::array<uint32_t, 2>         m_lastBoolSpecConstants = { };
+
+    uint32_t                        m_ffLightingSpec     = 0;
+    uint32_t                        m_lastFFLightingSpec = 0;
+
+    std::array<D3D9FixedFunctionStagePS, caps::TextureStageCount> m_ffStageState = { };
+
     uint32_t                        m_lastPointMode = 0;
 
     uint32_t                        m_activeRTs        = 0;
@@ -1008,7 +1101,6 @@ namespace dxvk {
     D3D9ViewportInfo                m_viewportInfo;
 
     std::atomic<int64_t>            m_availableMemory = 0;
-    std::atomic<int32_t>            m_samplerCount = 0;
 
     bool                            m_amdATOC         = false;
     bool                            m_nvATOC          = false;
@@ -1019,11 +1111,19 @@ namespace dxvk {
 
     void DetermineConstantLayouts(bool canSWVP);
 
+    Rc<DxvkBufferArena> CreateDynamicBufferArena();
+
     D3D9UPBufferSlice AllocUpBuffer(VkDeviceSize size);
 
     D3D9SwapChainEx* GetInternalSwapchain(UINT index);
 
-    bool ShouldRecord();
+    HRESULT ProcessVerticesCpu(
+      const D3D9CpuVertexProcessor&       Processor,
+            UINT                          SrcStartIndex,
+            UINT                          DestIndex,
+            UINT                          VertexCount,
+            D3D9CommonBuffer*             pDst,
+            UINT                          DstStride);
 
     HRESULT               CreateShaderModule(
             D3D9CommonShader*     pShaderModule,
@@ -1153,6 +1253,10 @@ namespace dxvk {
 
     void UpdateProjectionSpecConstant(uint32_t value);
 
+    void UpdateBoolSpecConstant(DxsoProgramType ShaderStage, uint32_t value);
+
+    void UpdateFFLightingSpecConstant(uint32_t value);
+
   };
 
 }
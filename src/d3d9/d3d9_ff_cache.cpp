@@ -0,0 +1,189 @@
+#include "d3d9_ff_cache.h"
+#include "d3d9_options.h"
+
+#include <cstddef>
+
+namespace dxvk {
+
+  static constexpr size_t D3D9FFShaderCacheHashedSize =
+    offsetof(D3D9FFShaderCacheEntry, hash);
+
+  static_assert(sizeof(D3D9FFShaderKeyVS) <= sizeof(D3D9FFShaderCacheEntry::data));
+  static_assert(sizeof(D3D9FFShaderKeyFS) <= sizeof(D3D9FFShaderCacheEntry::data));
+
+
+  D3D9FFShaderCache::D3D9FFShaderCache(
+    const D3D9Options*          pOptions) {
+    m_options = (pOptions->invariantPosition ? 0x1u : 0u)
+              | (pOptions->ffUberShaders     ? 0x2u : 0u);
+  }
+
+
+  void D3D9FFShaderCache::ReadKeys(
+          std::vector<D3D9FFShaderKeyVS>& VsKeys,
+          std::vector<D3D9FFShaderKeyFS>& FsKeys) {
+    std::ifstream ifile(GetCacheFileName(), std::ios_base::binary);
+
+    if (!ifile)
+      return;
+
+    D3D9FFShaderCacheHeader expected;
+    expected.entrySize = sizeof(D3D9FFShaderCacheEntry);
+    expected.options   = m_options;
+
+    D3D9FFShaderCacheHeader header;
+
+    if (!ifile.read(reinterpret_cast<char*>(&header), sizeof(header))
+     || std::memcmp(&header, &expected, sizeof(header))) {
+      Logger::warn("D3D9: Fixed-function shader cache out of date");
+      return;
+    }
+
+    bool corrupted  = false;
+    bool duplicates = false;
+
+    D3D9FFShaderCacheEntry entry;
+
+    while (ifile.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+      if (entry.hash != Sha1Hash::compute(&entry, D3D9FFShaderCacheHashedSize)) {
+        corrupted = true;
+        continue;
+      }
+
+      if (entry.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+        D3D9FFShaderKeyVS key;
+        std::memcpy(&key, entry.data, sizeof(key));
+
+        if (m_vsKeys.insert(key).second)
+          VsKeys.push_back(key);
+        else
+          duplicates = true;
+      } else if (entry.stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+        D3D9FFShaderKeyFS key;
+        std::memcpy(&key, entry.data, sizeof(key));
+
+        if (m_fsKeys.insert(key).second)
+          FsKeys.push_back(key);
+        else
+          duplicates = true;
+      } else {
+        corrupted = true;
+      }
+    }
+
+    // Trailing partial entries are left behind when
+    // the application got terminated mid-write
+    if (ifile.gcount() != 0)
+      corrupted = true;
+
+    ifile.close();
+
+    Logger::info(str::format("D3D9: Read ",
+      VsKeys.size() + FsKeys.size(), " fixed-function shader keys"));
+
+    if (!corrupted && !duplicates) {
+      m_valid = true;
+      return;
+    }
+
+    // Rewrite the file with all the valid, unique keys
+    if (corrupted)
+      Logger::warn("D3D9: Fixed-function shader cache corrupted");
+
+    for (const auto& key : VsKeys)
+      WriteEntry(VK_SHADER_STAGE_VERTEX_BIT, &key, sizeof(key));
+
+    for (const auto& key : FsKeys)
+      WriteEntry(VK_SHADER_STAGE_FRAGMENT_BIT, &key, sizeof(key));
+  }
+
+
+  void D3D9FFShaderCache::AddKey(const D3D9FFShaderKeyVS& Key) {
+    if (m_vsKeys.insert(Key).second)
+      WriteEntry(VK_SHADER_STAGE_VERTEX_BIT, &Key, sizeof(Key));
+  }
+
+
+  void D3D9FFShaderCache::AddKey(const D3D9FFShaderKeyFS& Key) {
+    if (m_fsKeys.insert(Key).second)
+      WriteEntry(VK_SHADER_STAGE_FRAGMENT_BIT, &Key, sizeof(Key));
+  }
+
+
+  void D3D9FFShaderCache::WriteEntry(
+          VkShaderStageFlagBits       Stage,
+    const void*                       pData,
+          size_t                      Size) {
+    if (!m_file.is_open() && (m_openFailed || !OpenFile()))
+      return;
+
+    D3D9FFShaderCacheEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.stage = Stage;
+    std::memcpy(entry.data, pData, Size);
+    entry.hash = Sha1Hash::compute(&entry, D3D9FFShaderCacheHashedSize);
+
+    m_file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    m_file.flush();
+  }
+
+
+  bool D3D9FFShaderCache::OpenFile() {
+    // Append to the file if its contents are valid,
+    // otherwise start over with a fresh header
+    if (m_valid) {
+      m_file = std::ofstream(GetCacheFileName(),
+        std::ios_base::binary |
+        std::ios_base::app);
+      m_openFailed = !m_file;
+      return !m_openFailed;
+    }
+
+    m_file = std::ofstream(GetCacheFileName(),
+      std::ios_base::binary |
+      std::ios_base::trunc);
+
+    if (!m_file && env::createDirectory(GetCacheDir())) {
+      m_file = std::ofstream(GetCacheFileName(),
+        std::ios_base::binary |
+        std::ios_base::trunc);
+    }
+
+    if (!m_file) {
+      Logger::warn("D3D9: Failed to create fixed-function shader cache");
+      m_openFailed = true;
+      return false;
+    }
+
+    D3D9FFShaderCacheHeader header;
+    header.entrySize = sizeof(D3D9FFShaderCacheEntry);
+    header.options   = m_options;
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_valid = true;
+    return true;
+  }
+
+
+  std::string D3D9FFShaderCache::GetCacheFileName() const {
+    std::string path = GetCacheDir();
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+
+    std::string exeName = env::getExeName();
+    auto extp = exeName.find_last_of('.');
+
+    if (extp != std::string::npos && exeName.substr(extp + 1) == "exe")
+      exeName.erase(extp);
+
+    path += exeName + ".d3d9-ff-cache";
+    return path;
+  }
+
+
+  std::string D3D9FFShaderCache::GetCacheDir() const {
+    return env::getEnvVar("DXVK_STATE_CACHE_PATH");
+  }
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "d3d9_fixed_function.h"
+
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Fixed-function shader cache header
+   *
+   * Stores the cache version as well as a mask of
+   * the options which affect shader generation, so
+   * that keys from incompatible configs are dropped.
+   */
+  struct D3D9FFShaderCacheHeader {
+    char     magic[4]   = { 'D', 'X', 'F', 'F' };
+    uint32_t version    = 2;
+    uint32_t entrySize  = 0;
+    uint32_t options    = 0;
+  };
+
+  static_assert(sizeof(D3D9FFShaderCacheHeader) == 16, "Invalid D3D9FFShaderCacheHeader size");
+
+  /**
+   * \brief Fixed-function shader cache entry
+   *
+   * Stores the raw data of a single vertex or
+   * fragment shader key, along with a hash of
+   * the key data to detect corrupted entries.
+   */
+  struct D3D9FFShaderCacheEntry {
+    VkShaderStageFlagBits stage;
+    uint32_t              data[2 * caps::TextureStageCount];
+    Sha1Hash              hash;
+  };
+
+  /**
+   * \brief Fixed-function shader cache
+   *
+   * Records fixed-function shader keys that an
+   * application has used, so that the shaders can
+   * be created and registered with the pipeline
+   * state cache early on in subsequent runs.
+   */
+  class D3D9FFShaderCache {
+
+  public:
+
+    D3D9FFShaderCache(
+      const D3D9Options*          pOptions);
+
+    /**
+     * \brief Reads keys stored in the cache file
+     *
+     * If the file does not exist or is invalid, no
+     * keys are returned and the file will be rewritten
+     * once the first key gets added. Duplicate keys
+     * are only returned once.
+     * \param [out] VsKeys Vertex shader keys
+     * \param [out] FsKeys Fragment shader keys
+     */
+    void ReadKeys(
+            std::vector<D3D9FFShaderKeyVS>& VsKeys,
+            std::vector<D3D9FFShaderKeyFS>& FsKeys);
+
+    /**
+     * \brief Adds a vertex shader key to the cache
+     *
+     * Does nothing if the key is already stored.
+     * \param [in] Key The shader key
+     */
+    void AddKey(const D3D9FFShaderKeyVS& Key);
+
+    /**
+     * \brief Adds a fragment shader key to the cache
+     *
+     * Does nothing if the key is already stored.
+     * \param [in] Key The shader key
+     */
+    void AddKey(const D3D9FFShaderKeyFS& Key);
+
+  private:
+
+    uint32_t      m_options;
+    bool          m_valid      = false;
+    bool          m_openFailed = false;
+    std::ofstream m_file;
+
+    std::unordered_set<
+      D3D9FFShaderKeyVS,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_vsKeys;
+
+    std::unordered_set<
+      D3D9FFShaderKeyFS,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_fsKeys;
+
+    void WriteEntry(
+            VkShaderStageFlagBits       Stage,
+      const void*                       pData,
+            size_t                      Size);
+
+    bool OpenFile();
+
+    std::string GetCacheFileName() const;
+
+    std::string GetCacheDir() const;
+
+  };
+
+}
@@ -1,6 +1,7 @@
 #include "d3d9_fixed_function.h"
 
 #include "d3d9_device.h"
+#include "d3d9_ff_cache.h"
 #include "d3d9_spec_constants.h"
 
 #include "../dxvk/dxvk_hash.h"
@@ -14,6 +15,7 @@ namespace dxvk {
 
   D3D9FixedFunctionOptions::D3D9FixedFunctionOptions(const D3D9Options* options) {
     invariantPosition = options->invariantPosition;
+    uberShaders       = options->ffUberShaders;
   }
 
   uint32_t DoFixedFunctionFog(SpirvModule& spvModule, const D3D9FogContext& fogCtx) {
@@ -80,15 +82,23 @@ namespace dxvk {
     if (fogCtx.IsPixel)
       depth = spvModule.opFMul(floatType, z, spvModule.opFDiv(floatType, spvModule.constf32(1.0f), w));
     else {
-      if (fogCtx.RangeFog) {
+      uint32_t rangeDepth = 0;
+
+      if (fogCtx.RangeFog || fogCtx.RangeFogSpec) {
         std::array<uint32_t, 3> indices = { 0, 1, 2 };
         uint32_t pos3 = spvModule.opVectorShuffle(vec3Type, fogCtx.vPos, fogCtx.vPos, indices.size(), indices.data());
-        depth = spvModule.opLength(floatType, pos3);
+        rangeDepth = spvModule.opLength(floatType, pos3);
       }
+
+      if (fogCtx.RangeFog && !fogCtx.RangeFogSpec)
+        depth = rangeDepth;
       else
         depth = fogCtx.HasFogInput
           ? fogCtx.vFog
           : spvModule.opFAbs(floatType, z);
+
+      if (fogCtx.RangeFogSpec)
+        depth = spvModule.opSelect(floatType, fogCtx.RangeFogSpec, rangeDepth, depth);
     }
 
     uint32_t applyFogFactor = spvModule.allocateId();
@@ -505,7 +515,10 @@ namespace dxvk {
   enum FFConstantMembersPS {
     PSConstTextureFactor = 0,
 
-    PSConstMemberCount
+    // Only declared by uber shaders
+    PSConstStage0,
+
+    PSConstMemberCount = PSConstStage0 + caps::TextureStageCount
   };
 
   struct D3D9FFPixelData {
@@ -514,6 +527,7 @@ namespace dxvk {
 
     struct {
       uint32_t textureFactor;
+      uint32_t stages[8];
     } constants;
 
     struct {
@@ -563,6 +577,12 @@ namespace dxvk {
 
     void compileVS();
 
+    uint32_t emitLightingBits(uint32_t offset, uint32_t count);
+
+    uint32_t emitLightingFlag(uint32_t bit);
+
+    uint32_t emitSplatBool(uint32_t value, uint32_t count);
+
     void setupRenderStateInfo();
 
     void emitLightTypeDecl();
@@ -614,6 +634,8 @@ namespace dxvk {
     uint32_t              m_rsBlock;
     uint32_t              m_mainFuncLabel;
 
+    uint32_t              m_lightingSpec = 0;
+
     D3D9FixedFunctionOptions m_options;
   };
 
@@ -851,7 +873,7 @@ namespace dxvk {
       }
 
       // Some games rely no normals not being normal.
-      if (m_vsKey.Data.Contents.NormalizeNormals) {
+      if (m_vsKey.Data.Contents.NormalizeNormals || m_options.uberShaders) {
         uint32_t bool_t = m_module.defBoolType();
         uint32_t bool3_t = m_module.defVectorType(bool_t, 3);
 
@@ -860,8 +882,12 @@ namespace dxvk {
         std::array<uint32_t, 3> members = { isZeroNormal, isZeroNormal, isZeroNormal };
         uint32_t isZeroNormal3 = m_module.opCompositeConstruct(bool3_t, members.size(), members.data());
 
-        normal = m_module.opNormalize(m_vec3Type, normal);
-        normal = m_module.opSelect(m_vec3Type, isZeroNormal3, m_module.constvec3f32(0.0f, 0.0f, 0.0f), normal);
+        uint32_t normalized = m_module.opNormalize(m_vec3Type, normal);
+                 normalized = m_module.opSelect(m_vec3Type, isZeroNormal3, m_module.constvec3f32(0.0f, 0.0f, 0.0f), normalized);
+
+        normal = m_options.uberShaders
+          ? m_module.opSelect(m_vec3Type, emitSplatBool(emitLightingFlag(FFNormalizeNormalsBit), 3), normalized, normal)
+          : normalized;
       }
       
       gl_Position = m_module.opVectorTimesMatrix(m_vec4Type, vtx, m_vs.constants.proj);
@@ -991,7 +1017,7 @@ namespace dxvk {
       m_module.opStore(m_vs.out.TEXCOORD[i], transformed);
     }
 
-    if (m_vsKey.Data.Contents.UseLighting) {
+    if (m_vsKey.Data.Contents.UseLighting || m_options.uberShaders) {
       auto PickSource = [&](uint32_t Source, uint32_t Material) {
         if (Source == D3DMCS_MATERIAL)
           return Material;
@@ -1001,11 +1027,30 @@ namespace dxvk {
           return m_vs.in.COLOR[1];
       };
 
+      // The material source comes from the spec constant in uber shaders
+      auto PickSourceSpec = [&](uint32_t Offset, uint32_t Material) {
+        uint32_t bool_t = m_module.defBoolType();
+        uint32_t source = emitLightingBits(Offset, 2);
+
+        uint32_t isMaterial = m_module.opIEqual(bool_t, source, m_module.constu32(D3DMCS_MATERIAL));
+        uint32_t isColor1   = m_module.opIEqual(bool_t, source, m_module.constu32(D3DMCS_COLOR1));
+
+        uint32_t color = m_module.opSelect(m_vec4Type, emitSplatBool(isColor1, 4), m_vs.in.COLOR[0], m_vs.in.COLOR[1]);
+        return m_module.opSelect(m_vec4Type, emitSplatBool(isMaterial, 4), Material, color);
+      };
+
       uint32_t diffuseValue  = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
       uint32_t specularValue = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
       uint32_t ambientValue  = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
 
-      for (uint32_t i = 0; i < m_vsKey.Data.Contents.LightCount; i++) {
+      // Uber shaders handle the maximum number of lights and
+      // mask out unused ones, which drivers can resolve when
+      // specializing the pipeline.
+      uint32_t lightCount = m_options.uberShaders
+        ? caps::MaxEnabledLights
+        : m_vsKey.Data.Contents.LightCount;
+
+      for (uint32_t i = 0; i < lightCount; i++) {
         uint32_t light_ptr_t = m_module.defPointerType(m_vs.lightType, spv::StorageClassUniform);
 
         uint32_t indexVal = m_module.constu32(VSConstLight0 + i);
@@ -1086,7 +1131,14 @@ namespace dxvk {
         uint32_t diffuseness = m_module.opFMul(m_floatType, hitDot, atten);
 
         uint32_t mid;
-        if (m_vsKey.Data.Contents.LocalViewer) {
+        if (m_options.uberShaders) {
+          uint32_t localMid = m_module.opNormalize(m_vec3Type, vtx3);
+
+          mid = m_module.opSelect(m_vec3Type, emitSplatBool(emitLightingFlag(FFLocalViewerBit), 3),
+            localMid, m_module.constvec3f32(0.0f, 0.0f, 1.0f));
+          mid = m_module.opFSub(m_vec3Type, hitDir, mid);
+        }
+        else if (m_vsKey.Data.Contents.LocalViewer) {
           mid = m_module.opNormalize(m_vec3Type, vtx3);
           mid = m_module.opFSub(m_vec3Type, hitDir, mid);
         }
@@ -1106,15 +1158,36 @@ namespace dxvk {
         uint32_t lightDiffuse  = m_module.opVectorTimesScalar(m_vec4Type, diffuse,  diffuseness);
         uint32_t lightSpecular = m_module.opVectorTimesScalar(m_vec4Type, specular, specularness);
 
+        if (m_options.uberShaders) {
+          uint32_t enabled = m_module.opULessThan(bool_t,
+            m_module.constu32(i), emitLightingBits(FFLightCountOffset, 4));
+          uint32_t enabled4 = emitSplatBool(enabled, 4);
+          uint32_t zero     = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
+
+          lightAmbient  = m_module.opSelect(m_vec4Type, enabled4, lightAmbient,  zero);
+          lightDiffuse  = m_module.opSelect(m_vec4Type, enabled4, lightDiffuse,  zero);
+          lightSpecular = m_module.opSelect(m_vec4Type, enabled4, lightSpecular, zero);
+        }
+
         ambientValue  = m_module.opFAdd(m_vec4Type, ambientValue,  lightAmbient);
         diffuseValue  = m_module.opFAdd(m_vec4Type, diffuseValue,  lightDiffuse);
         specularValue = m_module.opFAdd(m_vec4Type, specularValue, lightSpecular);
       }
 
-      uint32_t mat_diffuse  = PickSource(m_vsKey.Data.Contents.DiffuseSource,  m_vs.constants.materialDiffuse);
-      uint32_t mat_ambient  = PickSource(m_vsKey.Data.Contents.AmbientSource,  m_vs.constants.materialAmbient);
-      uint32_t mat_emissive = PickSource(m_vsKey.Data.Contents.EmissiveSource, m_vs.constants.materialEmissive);
-      uint32_t mat_specular = PickSource(m_vsKey.Data.Contents.SpecularSource, m_vs.constants.materialSpecular);
+      uint32_t mat_diffuse, mat_ambient, mat_emissive, mat_specular;
+
+      if (m_options.uberShaders) {
+        mat_diffuse  = PickSourceSpec(FFDiffuseSourceOffset,  m_vs.constants.materialDiffuse);
+        mat_ambient  = PickSourceSpec(FFAmbientSourceOffset,  m_vs.constants.materialAmbient);
+        mat_emissive = PickSourceSpec(FFEmissiveSourceOffset, m_vs.constants.materialEmissive);
+        mat_specular = PickSourceSpec(FFSpecularSourceOffset, m_vs.constants.materialSpecular);
+      }
+      else {
+        mat_diffuse  = PickSource(m_vsKey.Data.Contents.DiffuseSource,  m_vs.constants.materialDiffuse);
+        mat_ambient  = PickSource(m_vsKey.Data.Contents.AmbientSource,  m_vs.constants.materialAmbient);
+        mat_emissive = PickSource(m_vsKey.Data.Contents.EmissiveSource, m_vs.constants.materialEmissive);
+        mat_specular = PickSource(m_vsKey.Data.Contents.SpecularSource, m_vs.constants.materialSpecular);
+      }
       
       std::array<uint32_t, 4> alphaSwizzle = {0, 1, 2, 7};
       uint32_t finalColor0 = m_module.opFFma(m_vec4Type, mat_ambient, m_vs.constants.globalAmbient, mat_emissive);
@@ -1133,6 +1206,13 @@ namespace dxvk {
         m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f),
         m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f));
 
+      if (m_options.uberShaders) {
+        uint32_t useLighting = emitSplatBool(emitLightingFlag(FFUseLightingBit), 4);
+
+        finalColor0 = m_module.opSelect(m_vec4Type, useLighting, finalColor0, m_vs.in.COLOR[0]);
+        finalColor1 = m_module.opSelect(m_vec4Type, useLighting, finalColor1, m_vs.in.COLOR[1]);
+      }
+
       m_module.opStore(m_vs.out.COLOR[0], finalColor0);
       m_module.opStore(m_vs.out.COLOR[1], finalColor1);
     }
@@ -1144,6 +1224,7 @@ namespace dxvk {
     D3D9FogContext fogCtx;
     fogCtx.IsPixel     = false;
     fogCtx.RangeFog    = m_vsKey.Data.Contents.RangeFog;
+    fogCtx.RangeFogSpec = m_options.uberShaders ? emitLightingFlag(FFRangeFogBit) : 0;
     fogCtx.RenderState = m_rsBlock;
     fogCtx.vPos        = vtx;
     fogCtx.HasFogInput = m_vsKey.Data.Contents.HasFog;
@@ -1158,6 +1239,33 @@ namespace dxvk {
   }
 
 
+  uint32_t D3D9FFShaderCompiler::emitLightingBits(uint32_t offset, uint32_t count) {
+    if (!m_lightingSpec) {
+      m_lightingSpec = m_module.specConst32(m_uint32Type, 0);
+      m_module.setDebugName(m_lightingSpec, "ff_vertex_lighting");
+      m_module.decorateSpecId(m_lightingSpec, getSpecId(D3D9SpecConstantId::FFVertexLighting));
+    }
+
+    return m_module.opBitFieldUExtract(m_uint32Type, m_lightingSpec,
+      m_module.consti32(offset), m_module.consti32(count));
+  }
+
+
+  uint32_t D3D9FFShaderCompiler::emitLightingFlag(uint32_t bit) {
+    return m_module.opINotEqual(m_module.defBoolType(),
+      emitLightingBits(bit, 1), m_module.constu32(0));
+  }
+
+
+  uint32_t D3D9FFShaderCompiler::emitSplatBool(uint32_t value, uint32_t count) {
+    std::array<uint32_t, 4> members = { value, value, value, value };
+
+    return m_module.opCompositeConstruct(
+      m_module.defVectorType(m_module.defBoolType(), count),
+      count, members.data());
+  }
+
+
   void D3D9FFShaderCompiler::setupRenderStateInfo() {
     m_rsBlock = SetupRenderStateBlock(m_module);
 
@@ -1527,6 +1635,23 @@ namespace dxvk {
     
     uint32_t texture = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 1.0f);
 
+    // Uber shaders read the ops of each stage from the constant
+    // buffer and evaluate them in uniform control flow. Values
+    // written inside a stage are passed on through variables.
+    uint32_t currentVar = 0;
+    uint32_t tempVar    = 0;
+    uint32_t textureVar = 0;
+    uint32_t resultVar  = 0;
+
+    if (m_options.uberShaders) {
+      uint32_t vec4Ptr = m_module.defPointerType(m_vec4Type, spv::StorageClassPrivate);
+
+      currentVar = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+      tempVar    = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+      textureVar = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+      resultVar  = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+    }
+
     for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
       const auto& stage = m_fsKey.Stages[i].Contents;
 
@@ -1794,6 +1919,159 @@ namespace dxvk {
         return dst;
       };
 
+      if (m_options.uberShaders) {
+        uint32_t boolType = m_module.defBoolType();
+
+        // Color op, color args, alpha op, alpha args
+        std::array<uint32_t, 4> stageState;
+
+        for (uint32_t j = 0; j < stageState.size(); j++)
+          stageState[j] = m_module.opCompositeExtract(m_uint32Type, m_ps.constants.stages[i], 1, &j);
+
+        auto TestMask = [&] (uint32_t value, uint32_t mask) {
+          return m_module.opINotEqual(boolType,
+            m_module.opBitwiseAnd(m_uint32Type, value, m_module.constu32(mask)),
+            m_module.constu32(0));
+        };
+
+        uint32_t stageLabel = m_module.allocateId();
+        uint32_t mergeLabel = m_module.allocateId();
+
+        m_module.opStore(currentVar, current);
+        m_module.opStore(tempVar,    temp);
+
+        // The device disables all stages after the first
+        // disabled one, so we do not need to track that.
+        m_module.opSelectionMerge(mergeLabel, spv::SelectionControlMaskNone);
+        m_module.opBranchConditional(
+          m_module.opINotEqual(boolType, stageState[0], m_module.constu32(D3DTOP_DISABLE)),
+          stageLabel, mergeLabel);
+        m_module.opLabel(stageLabel);
+
+        // Only sample the texture if the stage reads it
+        uint32_t sampleLabel      = m_module.allocateId();
+        uint32_t sampleMergeLabel = m_module.allocateId();
+
+        m_module.opStore(textureVar, m_module.constvec4f32(0.0f, 0.0f, 0.0f, 1.0f));
+        m_module.opSelectionMerge(sampleMergeLabel, spv::SelectionControlMaskNone);
+        m_module.opBranchConditional(
+          TestMask(stageState[1], 1u << FFStageUsesTextureBit),
+          sampleLabel, sampleMergeLabel);
+        m_module.opLabel(sampleLabel);
+        m_module.opStore(textureVar, GetTexture());
+        m_module.opBranch(sampleMergeLabel);
+        m_module.opLabel(sampleMergeLabel);
+
+        texture = m_module.opLoad(m_vec4Type, textureVar);
+        processedTexture = true;
+
+        uint32_t isTemp = emitSplatBool(TestMask(stageState[1], 1u << FFStageResultIsTempBit), 4);
+        uint32_t dst    = m_module.opSelect(m_vec4Type, isTemp, temp, current);
+
+        const std::array<std::pair<uint32_t, uint32_t>, 7> sources = {{
+          { D3DTA_DIFFUSE,  GetArg(D3DTA_DIFFUSE)  },
+          { D3DTA_CURRENT,  GetArg(D3DTA_CURRENT)  },
+          { D3DTA_TEXTURE,  GetArg(D3DTA_TEXTURE)  },
+          { D3DTA_TFACTOR,  GetArg(D3DTA_TFACTOR)  },
+          { D3DTA_SPECULAR, GetArg(D3DTA_SPECULAR) },
+          { D3DTA_TEMP,     GetArg(D3DTA_TEMP)     },
+          { D3DTA_CONSTANT, GetArg(D3DTA_CONSTANT) },
+        }};
+
+        auto GetDynamicArg = [&] (uint32_t args, uint32_t index) {
+          uint32_t arg = m_module.opBitFieldUExtract(m_uint32Type, args,
+            m_module.consti32(index * FFStageArgBits), m_module.consti32(FFStageArgBits));
+          uint32_t select = m_module.opBitwiseAnd(m_uint32Type, arg, m_module.constu32(D3DTA_SELECTMASK));
+
+          uint32_t reg = m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f);
+
+          for (const auto& source : sources) {
+            uint32_t match = m_module.opIEqual(boolType, select, m_module.constu32(source.first));
+            reg = m_module.opSelect(m_vec4Type, emitSplatBool(match, 4), source.second, reg);
+          }
+
+          reg = m_module.opSelect(m_vec4Type, emitSplatBool(TestMask(arg, D3DTA_COMPLEMENT), 4),
+            Complement(reg), reg);
+          reg = m_module.opSelect(m_vec4Type, emitSplatBool(TestMask(arg, D3DTA_ALPHAREPLICATE), 4),
+            AlphaReplicate(reg), reg);
+          return reg;
+        };
+
+        // Ops that are not implemented leave the result
+        // unchanged and are handled by the default case.
+        static constexpr std::array<D3DTEXTUREOP, 21> ops = {{
+          D3DTOP_SELECTARG1,
+          D3DTOP_SELECTARG2,
+          D3DTOP_MODULATE,
+          D3DTOP_MODULATE2X,
+          D3DTOP_MODULATE4X,
+          D3DTOP_ADD,
+          D3DTOP_ADDSIGNED,
+          D3DTOP_ADDSIGNED2X,
+          D3DTOP_SUBTRACT,
+          D3DTOP_ADDSMOOTH,
+          D3DTOP_BLENDDIFFUSEALPHA,
+          D3DTOP_BLENDTEXTUREALPHA,
+          D3DTOP_BLENDFACTORALPHA,
+          D3DTOP_BLENDCURRENTALPHA,
+          D3DTOP_MODULATEALPHA_ADDCOLOR,
+          D3DTOP_MODULATECOLOR_ADDALPHA,
+          D3DTOP_MODULATEINVALPHA_ADDCOLOR,
+          D3DTOP_MODULATEINVCOLOR_ADDALPHA,
+          D3DTOP_DOTPRODUCT3,
+          D3DTOP_MULTIPLYADD,
+          D3DTOP_LERP,
+        }};
+
+        auto DoDynamicOp = [&] (uint32_t op, uint32_t args) {
+          std::array<uint32_t, TextureArgCount> argValues;
+
+          for (uint32_t j = 0; j < TextureArgCount; j++)
+            argValues[j] = GetDynamicArg(args, j);
+
+          std::array<SpirvSwitchCaseLabel, ops.size()> caseLabels;
+
+          for (uint32_t j = 0; j < ops.size(); j++)
+            caseLabels[j] = { uint32_t(ops[j]), m_module.allocateId() };
+
+          uint32_t switchMergeLabel = m_module.allocateId();
+
+          m_module.opStore(resultVar, dst);
+          m_module.opSelectionMerge(switchMergeLabel, spv::SelectionControlMaskNone);
+          m_module.opSwitch(op, switchMergeLabel, caseLabels.size(), caseLabels.data());
+
+          for (const auto& label : caseLabels) {
+            m_module.opLabel(label.labelId);
+            m_module.opStore(resultVar, DoOp(D3DTEXTUREOP(label.literal), dst, argValues));
+            m_module.opBranch(switchMergeLabel);
+          }
+
+          m_module.opLabel(switchMergeLabel);
+          return m_module.opLoad(m_vec4Type, resultVar);
+        };
+
+        uint32_t colorResult = DoDynamicOp(stageState[0], stageState[1]);
+        uint32_t alphaResult = DoDynamicOp(stageState[2], stageState[3]);
+
+        // D3DTOP_DOTPRODUCT3 also writes its result to alpha
+        uint32_t isDot3 = m_module.opIEqual(boolType, stageState[0], m_module.constu32(D3DTOP_DOTPRODUCT3));
+        alphaResult = m_module.opSelect(m_vec4Type, emitSplatBool(isDot3, 4), colorResult, alphaResult);
+
+        // colorResult.x, colorResult.y, colorResult.z, alphaResult.w
+        std::array<uint32_t, 4> indices = { 0, 1, 2, 4 + 3 };
+        uint32_t result = m_module.opVectorShuffle(m_vec4Type,
+          colorResult, alphaResult, indices.size(), indices.data());
+
+        m_module.opStore(currentVar, m_module.opSelect(m_vec4Type, isTemp, current, result));
+        m_module.opStore(tempVar,    m_module.opSelect(m_vec4Type, isTemp, result, temp));
+        m_module.opBranch(mergeLabel);
+        m_module.opLabel(mergeLabel);
+
+        current = m_module.opLoad(m_vec4Type, currentVar);
+        temp    = m_module.opLoad(m_vec4Type, tempVar);
+        continue;
+      }
+
       uint32_t& dst = stage.ResultIsTemp ? temp : current;
 
       D3DTEXTUREOP colorOp = (D3DTEXTUREOP)stage.ColorOp;
@@ -1901,17 +2179,26 @@ namespace dxvk {
     m_ps.out.COLOR   = declareIO(false, DxsoSemantic{ DxsoUsage::Color, 0 });
 
     // Constant Buffer for PS.
-    std::array<uint32_t, PSConstMemberCount> members = {
-      m_vec4Type // Texture Factor
-    };
+    uint32_t uvec4Type = m_module.defVectorType(m_uint32Type, 4);
+
+    std::array<uint32_t, PSConstMemberCount> members;
+    members[PSConstTextureFactor] = m_vec4Type;
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++)
+      members[PSConstStage0 + i] = uvec4Type;
+
+    // Texture stage state is only read by uber shaders
+    const uint32_t memberCount = m_options.uberShaders
+      ? uint32_t(PSConstMemberCount)
+      : uint32_t(PSConstStage0);
 
     const uint32_t structType =
-      m_module.defStructType(members.size(), members.data());
+      m_module.defStructType(memberCount, members.data());
 
     m_module.decorateBlock(structType);
     uint32_t offset = 0;
 
-    for (uint32_t i = 0; i < PSConstMemberCount; i++) {
+    for (uint32_t i = 0; i < memberCount; i++) {
       m_module.memberDecorateOffset(structType, i, offset);
       offset += sizeof(Vector4);
     }
@@ -1919,6 +2206,11 @@ namespace dxvk {
     m_module.setDebugName(structType, "D3D9FixedFunctionPS");
     m_module.setDebugMemberName(structType, 0, "textureFactor");
 
+    for (uint32_t i = PSConstStage0; i < memberCount; i++) {
+      std::string name = str::format("stage", i - PSConstStage0);
+      m_module.setDebugMemberName(structType, i, name.c_str());
+    }
+
     m_ps.constantBuffer = m_module.newVar(
       m_module.defPointerType(structType, spv::StorageClassUniform),
       spv::StorageClassUniform);
@@ -1950,6 +2242,11 @@ namespace dxvk {
 
     m_ps.constants.textureFactor = LoadConstant(m_vec4Type, PSConstTextureFactor);
 
+    if (m_options.uberShaders) {
+      for (uint32_t i = 0; i < caps::TextureStageCount; i++)
+        m_ps.constants.stages[i] = LoadConstant(uvec4Type, PSConstStage0 + i);
+    }
+
     // Samplers
     for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
       auto& sampler = m_ps.samplers[i];
@@ -2196,37 +2493,190 @@ namespace dxvk {
   }
 
 
+  D3D9FFShaderModuleSet::~D3D9FFShaderModuleSet() {
+    StopPrecompile();
+
+    Logger::info(str::format("D3D9: Created ", m_vsModules.size(),
+      " fixed-function vertex and ", m_fsModules.size(), " pixel shaders"));
+  }
+
+
   D3D9FFShader D3D9FFShaderModuleSet::GetShaderModule(
           D3D9DeviceEx*         pDevice,
     const D3D9FFShaderKeyVS&    ShaderKey) {
-    // Use the shader's unique key for the lookup
-    auto entry = m_vsModules.find(ShaderKey);
-    if (entry != m_vsModules.end())
-      return entry->second;
-    
-    D3D9FFShader shader(
-      pDevice, ShaderKey);
-
-    m_vsModules.insert({ShaderKey, shader});
-
-    return shader;
+    return GetOrCreateModule(pDevice, m_vsModules, ShaderKey, true);
   }
 
 
   D3D9FFShader D3D9FFShaderModuleSet::GetShaderModule(
           D3D9DeviceEx*         pDevice,
     const D3D9FFShaderKeyFS&    ShaderKey) {
+    return GetOrCreateModule(pDevice, m_fsModules, ShaderKey, true);
+  }
+
+
+  void D3D9FFShaderModuleSet::StartPrecompile(
+          D3D9DeviceEx*         pDevice) {
+    const Rc<DxvkDevice>& device = pDevice->GetDXVKDevice();
+
+    // Cached keys are only useful if pipelines get cached as well
+    if (env::getEnvVar("DXVK_STATE_CACHE") == "0"
+     || !device->config().enableStateCache)
+      return;
+
+    std::vector<D3D9FFShaderKeyVS> vsKeys;
+    std::vector<D3D9FFShaderKeyFS> fsKeys;
+
+    { std::lock_guard<std::mutex> lock(m_mutex);
+      m_cache = std::make_unique<D3D9FFShaderCache>(pDevice->GetOptions());
+      m_cache->ReadKeys(vsKeys, fsKeys);
+    }
+
+    if (vsKeys.empty() && fsKeys.empty())
+      return;
+
+    m_thread = dxvk::thread([
+      this, pDevice,
+      cVsKeys = std::move(vsKeys),
+      cFsKeys = std::move(fsKeys)
+    ] () mutable {
+      PrecompileFunc(pDevice, std::move(cVsKeys), std::move(cFsKeys));
+    });
+    m_thread.set_priority(ThreadPriority::Lowest);
+  }
+
+
+  void D3D9FFShaderModuleSet::StopPrecompile() {
+    m_stopThread.store(true);
+
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+
+  template<typename Key, typename Map>
+  D3D9FFShader D3D9FFShaderModuleSet::GetOrCreateModule(
+          D3D9DeviceEx*         pDevice,
+          Map&                  Modules,
+    const Key&                  ShaderKey,
+          bool                  AddToCache) {
     // Use the shader's unique key for the lookup
-    auto entry = m_fsModules.find(ShaderKey);
-    if (entry != m_fsModules.end())
-      return entry->second;
-    
+    { std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto entry = Modules.find(ShaderKey);
+      if (entry != Modules.end())
+        return entry->second;
+    }
+
+    // Compile the shader without holding the lock, so that
+    // the precompile thread does not stall draws which need
+    // an unrelated shader
     D3D9FFShader shader(
       pDevice, ShaderKey);
 
-    m_fsModules.insert({ShaderKey, shader});
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Another thread may have created the same shader in the
+    // meantime, in which case we discard ours and use theirs
+    auto entry = Modules.insert({ShaderKey, shader});
+
+    if (AddToCache && m_cache != nullptr)
+      m_cache->AddKey(ShaderKey);
+
+    return entry.first->second;
+  }
+
+
+  void D3D9FFShaderModuleSet::PrecompileFunc(
+          D3D9DeviceEx*         pDevice,
+          std::vector<D3D9FFShaderKeyVS> VsKeys,
+          std::vector<D3D9FFShaderKeyFS> FsKeys) {
+    env::setThreadName("dxvk-ff-cache");
+
+    for (const auto& key : VsKeys) {
+      if (m_stopThread.load())
+        return;
+
+      GetOrCreateModule(pDevice, m_vsModules, key, false);
+    }
+
+    for (const auto& key : FsKeys) {
+      if (m_stopThread.load())
+        return;
+
+      GetOrCreateModule(pDevice, m_fsModules, key, false);
+    }
+
+    Logger::info(str::format("D3D9: Precompiled ",
+      VsKeys.size() + FsKeys.size(), " fixed-function shaders"));
+  }
+
+
+  uint32_t ExtractFFLightingState(D3D9FFShaderKeyVS& Key) {
+    auto& data = Key.Data.Contents;
+
+    uint32_t value = (data.LightCount       << FFLightCountOffset)
+                   | (data.DiffuseSource    << FFDiffuseSourceOffset)
+                   | (data.AmbientSource    << FFAmbientSourceOffset)
+                   | (data.SpecularSource   << FFSpecularSourceOffset)
+                   | (data.EmissiveSource   << FFEmissiveSourceOffset)
+                   | (data.UseLighting      << FFUseLightingBit)
+                   | (data.LocalViewer      << FFLocalViewerBit)
+                   | (data.NormalizeNormals << FFNormalizeNormalsBit)
+                   | (data.RangeFog         << FFRangeFogBit);
+
+    data.LightCount       = 0;
+    data.DiffuseSource    = 0;
+    data.AmbientSource    = 0;
+    data.SpecularSource   = 0;
+    data.EmissiveSource   = 0;
+    data.UseLighting      = 0;
+    data.LocalViewer      = 0;
+    data.NormalizeNormals = 0;
+    data.RangeFog         = 0;
+    return value;
+  }
+
+
+  void ExtractFFStageState(
+          D3D9FFShaderKeyFS&          Key,
+          D3D9FixedFunctionStagePS*   pStages) {
+    auto PackArgs = [] (uint32_t Arg0, uint32_t Arg1, uint32_t Arg2) {
+      return (Arg0 << (0 * FFStageArgBits))
+           | (Arg1 << (1 * FFStageArgBits))
+           | (Arg2 << (2 * FFStageArgBits));
+    };
 
-    return shader;
+    auto IsTexture = [] (uint32_t Arg) {
+      return (Arg & D3DTA_SELECTMASK) == D3DTA_TEXTURE;
+    };
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      auto& data  = Key.Stages[i].Contents;
+      auto& stage = pStages[i];
+
+      bool usesTexture = IsTexture(data.ColorArg0) || IsTexture(data.ColorArg1) || IsTexture(data.ColorArg2)
+                      || IsTexture(data.AlphaArg0) || IsTexture(data.AlphaArg1) || IsTexture(data.AlphaArg2)
+                      || data.ColorOp == D3DTOP_BLENDTEXTUREALPHA
+                      || data.AlphaOp == D3DTOP_BLENDTEXTUREALPHA;
+
+      stage.colorOp   = data.ColorOp;
+      stage.colorArgs = PackArgs(data.ColorArg0, data.ColorArg1, data.ColorArg2)
+                      | (data.ResultIsTemp << FFStageResultIsTempBit)
+                      | (uint32_t(usesTexture) << FFStageUsesTextureBit);
+      stage.alphaOp   = data.AlphaOp;
+      stage.alphaArgs = PackArgs(data.AlphaArg0, data.AlphaArg1, data.AlphaArg2);
+
+      data.ColorOp      = D3DTOP_DISABLE;
+      data.ColorArg0    = 0;
+      data.ColorArg1    = 0;
+      data.ColorArg2    = 0;
+      data.AlphaOp      = D3DTOP_DISABLE;
+      data.AlphaArg0    = 0;
+      data.AlphaArg1    = 0;
+      data.AlphaArg2    = 0;
+      data.ResultIsTemp = 0;
+    }
   }
 
 
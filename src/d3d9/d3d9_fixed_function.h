@@ -3,17 +3,23 @@
 #include "d3d9_include.h"
 
 #include "d3d9_caps.h"
+#include "d3d9_state.h"
 
 #include "../dxvk/dxvk_shader.h"
 
 #include "../dxso/dxso_isgn.h"
 
+#include "../util/thread.h"
+
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <bitset>
 
 namespace dxvk {
 
   class D3D9DeviceEx;
+  class D3D9FFShaderCache;
   class SpirvModule;
 
   struct D3D9Options;
@@ -22,6 +28,7 @@ namespace dxvk {
     // General inputs...
     bool     IsPixel;
     bool     RangeFog;
+    uint32_t RangeFogSpec = 0; // Bool ID, overrides RangeFog if set
     uint32_t RenderState;
     uint32_t vPos;
     uint32_t vFog;
@@ -35,6 +42,7 @@ namespace dxvk {
     D3D9FixedFunctionOptions(const D3D9Options* options);
 
     bool invariantPosition;
+    bool uberShaders;
   };
 
   // Returns new oFog if VS
@@ -122,6 +130,30 @@ namespace dxvk {
     D3D9FFShaderKeyVSData Data;
   };
 
+  // Bit layout of the vertex lighting spec constant
+  // used by fixed-function uber shaders
+  constexpr uint32_t FFLightCountOffset       = 0;
+  constexpr uint32_t FFDiffuseSourceOffset    = 4;
+  constexpr uint32_t FFAmbientSourceOffset    = 6;
+  constexpr uint32_t FFSpecularSourceOffset   = 8;
+  constexpr uint32_t FFEmissiveSourceOffset   = 10;
+  constexpr uint32_t FFUseLightingBit         = 12;
+  constexpr uint32_t FFLocalViewerBit         = 13;
+  constexpr uint32_t FFNormalizeNormalsBit    = 14;
+  constexpr uint32_t FFRangeFogBit            = 15;
+
+  /**
+   * \brief Moves lighting state out of a vertex shader key
+   *
+   * With uber shaders, light count, material sources and
+   * a few lighting and fog flags are passed to the shader
+   * via a spec constant, so that keys which only differ
+   * in those can share one shader module.
+   * \param [in,out] Key Shader key. Lighting fields are cleared.
+   * \returns Value for the vertex lighting spec constant
+   */
+  uint32_t ExtractFFLightingState(D3D9FFShaderKeyVS& Key);
+
   constexpr uint32_t TextureArgCount = 3;
 
   struct D3D9FFShaderStage {
@@ -168,6 +200,26 @@ namespace dxvk {
     D3D9FFShaderStage Stages[caps::TextureStageCount];
   };
 
+  // Bit layout of the packed texture stage arguments
+  // used by fixed-function uber shaders
+  constexpr uint32_t FFStageArgBits           = 8;
+  constexpr uint32_t FFStageResultIsTempBit   = 24;
+  constexpr uint32_t FFStageUsesTextureBit    = 25;
+
+  /**
+   * \brief Moves texture stage ops out of a pixel shader key
+   *
+   * With uber shaders, color and alpha ops, their arguments
+   * and the result register of each stage are read from the
+   * fixed-function constant buffer, so that keys which only
+   * differ in those can share one shader module.
+   * \param [in,out] Key Shader key. Op and argument fields are reset.
+   * \param [out] pStages Stage state, one entry per texture stage
+   */
+  void ExtractFFStageState(
+          D3D9FFShaderKeyFS&          Key,
+          D3D9FixedFunctionStagePS*   pStages);
+
   struct D3D9FFShaderKeyHash {
     size_t operator () (const D3D9FFShaderKeyVS& key) const;
     size_t operator () (const D3D9FFShaderKeyFS& key) const;
@@ -215,6 +267,8 @@ namespace dxvk {
 
   public:
 
+    ~D3D9FFShaderModuleSet();
+
     D3D9FFShader GetShaderModule(
             D3D9DeviceEx*         pDevice,
       const D3D9FFShaderKeyVS&    ShaderKey);
@@ -223,8 +277,36 @@ namespace dxvk {
             D3D9DeviceEx*         pDevice,
       const D3D9FFShaderKeyFS&    ShaderKey);
 
+    /**
+     * \brief Starts precompiling cached shaders
+     *
+     * Reads shader keys used in previous runs from the
+     * on-disk cache and creates the shaders on a worker
+     * thread. Since shaders get registered with the state
+     * cache on creation, this allows pipelines using them
+     * to be compiled before the first draw. Keys of any
+     * shaders created afterwards are added to the cache.
+     * \param [in] pDevice The device
+     */
+    void StartPrecompile(
+            D3D9DeviceEx*         pDevice);
+
+    /**
+     * \brief Stops precompiling shaders
+     *
+     * Must be called before the device is destroyed.
+     */
+    void StopPrecompile();
+
   private:
 
+    std::mutex                          m_mutex;
+
+    std::unique_ptr<D3D9FFShaderCache>  m_cache;
+
+    std::atomic<bool>                   m_stopThread = { false };
+    dxvk::thread                        m_thread;
+
     std::unordered_map<
       D3D9FFShaderKeyVS,
       D3D9FFShader,
@@ -235,6 +317,18 @@ namespace dxvk {
       D3D9FFShader,
       D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_fsModules;
 
+    template<typename Key, typename Map>
+    D3D9FFShader GetOrCreateModule(
+            D3D9DeviceEx*         pDevice,
+            Map&                  Modules,
+      const Key&                  ShaderKey,
+            bool                  AddToCache);
+
+    void PrecompileFunc(
+            D3D9DeviceEx*         pDevice,
+            std::vector<D3D9FFShaderKeyVS> VsKeys,
+            std::vector<D3D9FFShaderKeyFS> FsKeys);
+
   };
 
 
@@ -2,15 +2,32 @@
 
 namespace dxvk::hud {
 
+  static std::string FormatMemorySize(VkDeviceSize size) {
+    VkDeviceSize tenths = (10 * size) >> 20;
+    return str::format(tenths / 10, ".", tenths % 10, " MB");
+  }
+
+
   HudSamplerCount::HudSamplerCount(D3D9DeviceEx* device)
     : m_device       (device)
-    , m_samplerCount ("0"){
+    , m_samplerCount ("0")
+    , m_samplerCache ("-") {
 
   }
 
 
   void HudSamplerCount::update(dxvk::high_resolution_clock::time_point time) {
+    D3D9SamplerCacheStats stats = m_device->GetSamplerCacheStats();
+
     m_samplerCount = str::format(m_device->GetSamplerCount());
+
+    uint64_t lookups = stats.hits + stats.misses;
+
+    if (lookups) {
+      uint64_t hitRate = (1000 * stats.hits) / lookups;
+      m_samplerCache = str::format(hitRate / 10, ".", hitRate % 10, "% hits, ",
+        stats.evictions, " evicted");
+    }
   }
 
 
@@ -29,8 +46,294 @@ namespace dxvk::hud {
       { 1.0f, 1.0f, 1.0f, 1.0f },
       m_samplerCount);
 
+    position.y += 20.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Sampler cache:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_samplerCache);
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
+
+  HudShaderTranslation::HudShaderTranslation(D3D9DeviceEx* device)
+    : m_device      (device)
+    , m_queueDepth  ("0")
+    , m_timeToReady ("-") {
+
+  }
+
+
+  void HudShaderTranslation::update(dxvk::high_resolution_clock::time_point time) {
+    D3D9ShaderTranslationStats stats = m_device->GetShaderTranslationStats();
+
+    m_queueDepth = str::format(stats.queueDepth);
+
+    // Show the average time to ready of shaders translated
+    // since the last update, and keep the old value if no
+    // new shaders have been translated in the meantime.
+    uint64_t count = stats.translatedCount - m_prevStats.translatedCount;
+
+    if (count) {
+      uint64_t timeUs = (stats.timeToReadyUs - m_prevStats.timeToReadyUs) / count;
+      m_timeToReady = str::format(timeUs / 1000, ".", (timeUs / 100) % 10, " ms");
+    }
+
+    m_prevStats = stats;
+  }
+
+
+  HudPos HudShaderTranslation::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    position.y += 16.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Shader queue:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_queueDepth);
+
+    position.y += 20.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Time to ready:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_timeToReady);
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
+
+  HudDeviceLock::HudDeviceLock(D3D9DeviceEx* device)
+    : m_device    (device)
+    , m_prevStats (device->GetLockStatistics()) {
+    // Hold times are only measured on demand since
+    // that requires clock queries on every lock
+    m_device->EnableLockStatistics();
+  }
+
+
+  HudDeviceLock::~HudDeviceLock() {
+    m_device->DisableLockStatistics();
+  }
+
+
+  void HudDeviceLock::update(dxvk::high_resolution_clock::time_point time) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - m_lastUpdate);
+
+    if (elapsed.count() < UpdateInterval)
+      return;
+
+    D3D9DeviceLockStats stats = m_device->GetLockStatistics();
+
+    for (uint32_t i = 0; i < m_siteText.size(); i++) {
+      const auto& cur = stats.sites[i];
+      const auto& old = m_prevStats.sites[i];
+
+      uint64_t acquisitions = cur.acquisitions - old.acquisitions;
+      uint64_t contended    = cur.contended    - old.contended;
+
+      // Wait and hold times are shown in tenths of a
+      // percent of the elapsed time, since this directly
+      // indicates how much the lock serializes the app
+      uint64_t waitPermille = (cur.waitTimeNs - old.waitTimeNs) / std::max<int64_t>(elapsed.count(), 1);
+      uint64_t holdPermille = (cur.holdTimeNs - old.holdTimeNs) / std::max<int64_t>(elapsed.count(), 1);
+
+      m_siteText[i] = str::format(
+        acquisitions * 1'000'000 / elapsed.count(), "/s, ",
+        acquisitions ? contended * 100 / acquisitions : 0, "% cont, ",
+        "wait ", waitPermille / 10, ".", waitPermille % 10, "%, ",
+        "held ", holdPermille / 10, ".", holdPermille % 10, "%");
+    }
+
+    m_prevStats  = stats;
+    m_lastUpdate = time;
+  }
+
+
+  HudPos HudDeviceLock::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    static const std::array<const char*, uint32_t(D3D9DeviceLockSite::Count)> names = {
+      "Lock other:", "Lock draw:", "Lock map:", "Lock create:",
+    };
+
+    if (!m_device->IsMultithreaded()) {
+      position.y += 16.0f;
+
+      renderer.drawText(16.0f,
+        { position.x, position.y },
+        { 0.0f, 1.0f, 0.75f, 1.0f },
+        "Device lock:");
+
+      renderer.drawText(16.0f,
+        { position.x + 180.0f, position.y },
+        { 1.0f, 1.0f, 1.0f, 1.0f },
+        "not used");
+
+      position.y += 8.0f;
+      return position;
+    }
+
+    for (uint32_t i = 0; i < m_siteText.size(); i++) {
+      position.y += i ? 20.0f : 16.0f;
+
+      renderer.drawText(16.0f,
+        { position.x, position.y },
+        { 0.0f, 1.0f, 0.75f, 1.0f },
+        names[i]);
+
+      renderer.drawText(16.0f,
+        { position.x + 180.0f, position.y },
+        { 1.0f, 1.0f, 1.0f, 1.0f },
+        m_siteText[i].empty() ? "-" : m_siteText[i]);
+    }
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
+
+  HudBufferArena::HudBufferArena(D3D9DeviceEx* device)
+    : m_device      (device)
+    , m_memoryUsed  ("-")
+    , m_memorySaved ("-") {
+
+  }
+
+
+  void HudBufferArena::update(dxvk::high_resolution_clock::time_point time) {
+    const auto& arena = m_device->GetDynamicBufferArena();
+
+    if (arena == nullptr)
+      return;
+
+    DxvkBufferArenaStats stats = arena->getStats();
+
+    m_memoryUsed = str::format(
+      FormatMemorySize(stats.usedSize), " / ",
+      FormatMemorySize(stats.allocatedSize));
+
+    // Compare against the slices that buffers would
+    // have kept around if they did not use the arena
+    m_memorySaved = FormatMemorySize(stats.replacedSize > stats.allocatedSize
+      ? stats.replacedSize - stats.allocatedSize : 0);
+  }
+
+
+  HudPos HudBufferArena::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    position.y += 16.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Buffer arena:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_memoryUsed);
+
+    position.y += 20.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Memory saved:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_memorySaved);
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
+  HudReadback::HudReadback(D3D9DeviceEx* device)
+    : m_device        (device)
+    , m_prevStats     (device->GetReadbackStats())
+    , m_readbackText  ("-")
+    , m_stallText     ("-") {
+
+  }
+
+
+  void HudReadback::update(dxvk::high_resolution_clock::time_point time) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - m_lastUpdate);
+
+    if (elapsed.count() < UpdateInterval)
+      return;
+
+    D3D9ReadbackStats stats = m_device->GetReadbackStats();
+
+    uint64_t readbacks = stats.readbacks - m_prevStats.readbacks;
+    uint64_t stalls    = stats.stalls    - m_prevStats.stalls;
+    uint64_t stallUs   = (stats.stallTimeNs - m_prevStats.stallTimeNs) / 1000;
+
+    m_readbackText = str::format(readbacks * 1'000'000 / elapsed.count(), "/s");
+    m_stallText    = str::format(
+      stalls * 1'000'000 / elapsed.count(), "/s, ",
+      stalls ? stallUs / stalls : 0, " us avg");
+
+    m_prevStats  = stats;
+    m_lastUpdate = time;
+  }
+
+
+  HudPos HudReadback::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    position.y += 16.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Readbacks:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_readbackText);
+
+    position.y += 20.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 0.0f, 1.0f, 0.75f, 1.0f },
+      "Readback stalls:");
+
+    renderer.drawText(16.0f,
+      { position.x + 180.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      m_stallText);
+
     position.y += 8.0f;
     return position;
   }
 
-}
\ No newline at end of file
+}
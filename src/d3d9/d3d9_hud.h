@@ -25,7 +25,125 @@ namespace dxvk::hud {
     D3D9DeviceEx* m_device;
 
     std::string m_samplerCount;
+    std::string m_samplerCache;
 
   };
 
-}
\ No newline at end of file
+  /**
+   * \brief HUD item to display shader translation stats
+   */
+  class HudShaderTranslation : public HudItem {
+
+  public:
+
+    HudShaderTranslation(D3D9DeviceEx* device);
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    D3D9DeviceEx* m_device;
+
+    D3D9ShaderTranslationStats m_prevStats;
+
+    std::string m_queueDepth;
+    std::string m_timeToReady;
+
+  };
+
+  /**
+   * \brief HUD item to display device lock stats
+   *
+   * Shows acquisitions, contention and the time
+   * the device lock is held per call site class.
+   * Only meaningful for multithreaded devices.
+   */
+  class HudDeviceLock : public HudItem {
+    constexpr static int64_t UpdateInterval = 500'000;
+  public:
+
+    HudDeviceLock(D3D9DeviceEx* device);
+
+    ~HudDeviceLock();
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    D3D9DeviceEx* m_device;
+
+    D3D9DeviceLockStats m_prevStats;
+
+    dxvk::high_resolution_clock::time_point m_lastUpdate
+      = dxvk::high_resolution_clock::now();
+
+    std::array<std::string,
+      uint32_t(D3D9DeviceLockSite::Count)> m_siteText;
+
+  };
+
+  /**
+   * \brief HUD item to display dynamic buffer arena stats
+   */
+  class HudBufferArena : public HudItem {
+
+  public:
+
+    HudBufferArena(D3D9DeviceEx* device);
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    D3D9DeviceEx* m_device;
+
+    std::string m_memoryUsed;
+    std::string m_memorySaved;
+
+  };
+
+  /**
+   * \brief HUD item to display render target readback stats
+   *
+   * Shows the rate of \c GetRenderTargetData calls and
+   * how much time is spent waiting for their results.
+   */
+  class HudReadback : public HudItem {
+    constexpr static int64_t UpdateInterval = 500'000;
+  public:
+
+    HudReadback(D3D9DeviceEx* device);
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    D3D9DeviceEx* m_device;
+
+    D3D9ReadbackStats m_prevStats;
+
+    dxvk::high_resolution_clock::time_point m_lastUpdate
+      = dxvk::high_resolution_clock::now();
+
+    std::string m_readbackText;
+    std::string m_stallText;
+
+  };
+
+}
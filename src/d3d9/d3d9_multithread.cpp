@@ -1,18 +1,50 @@
 #include "d3d9_device.h"
 
+#include <emmintrin.h>
+
 namespace dxvk {
 
-  void D3D9DeviceMutex::lock() {
-    while (!try_lock())
-      dxvk::this_thread::yield();
+  static const char* GetLockSiteName(D3D9DeviceLockSite Site) {
+    switch (Site) {
+      case D3D9DeviceLockSite::Other:  return "other";
+      case D3D9DeviceLockSite::Draw:   return "draw";
+      case D3D9DeviceLockSite::Lock:   return "lock";
+      case D3D9DeviceLockSite::Create: return "create";
+      default:                         return "unknown";
+    }
+  }
+
+
+  void D3D9DeviceMutex::lock(D3D9DeviceLockSite Site) {
+    if (likely(try_lock())) {
+      if (unlikely(m_counter == 0 && m_statsRefs.load(std::memory_order_relaxed)))
+        onAcquire(Site);
+      return;
+    }
+
+    lockSlow(Site);
   }
 
 
   void D3D9DeviceMutex::unlock() {
-    if (likely(m_counter == 0))
+    if (likely(m_counter == 0)) {
+      if (unlikely(m_lockTime != high_resolution_clock::time_point()))
+        onRelease();
+
       m_owner.store(0, std::memory_order_release);
-    else
+
+      // This load may be ordered before the store above, in
+      // which case a thread that parks concurrently can miss
+      // the wakeup. Parked threads re-check the lock after a
+      // short timeout to cover that, which keeps a full
+      // barrier off the uncontended path.
+      if (unlikely(m_waiters.load(std::memory_order_relaxed))) {
+        std::lock_guard<std::mutex> lock(m_parkMutex);
+        m_parkCond.notify_one();
+      }
+    } else {
       m_counter -= 1;
+    }
   }
 
 
@@ -20,7 +52,7 @@ namespace dxvk {
     uint32_t threadId = GetCurrentThreadId();
     uint32_t expected = 0;
 
-    bool status = m_owner.compare_exchange_weak(
+    bool status = m_owner.compare_exchange_strong(
       expected, threadId, std::memory_order_acquire);
     
     if (status)
@@ -34,8 +66,119 @@ namespace dxvk {
   }
 
 
+  D3D9DeviceLockStats D3D9DeviceMutex::getStatistics() const {
+    D3D9DeviceLockStats result;
+
+    for (uint32_t i = 0; i < m_counters.size(); i++) {
+      const auto& src = m_counters[i];
+      auto&       dst = result.sites[i];
+
+      dst.acquisitions = src.acquisitions.load(std::memory_order_relaxed);
+      dst.contended    = src.contended.load(std::memory_order_relaxed);
+      dst.parked       = src.parked.load(std::memory_order_relaxed);
+      dst.waitTimeNs   = src.waitTimeNs.load(std::memory_order_relaxed);
+      dst.holdTimeNs   = src.holdTimeNs.load(std::memory_order_relaxed);
+    }
+
+    return result;
+  }
+
+
+  void D3D9DeviceMutex::lockSlow(D3D9DeviceLockSite Site) {
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0; i < m_spinCount; i++) {
+      _mm_pause();
+
+      // Only attempt the CAS if the lock looks free
+      // in order to not hammer the cache line
+      if (m_owner.load(std::memory_order_relaxed) == 0 && try_lock()) {
+        onContended(Site, false, t0);
+        return;
+      }
+    }
+
+    { std::unique_lock<std::mutex> lock(m_parkMutex);
+      m_waiters.fetch_add(1, std::memory_order_seq_cst);
+
+      while (!try_lock())
+        m_parkCond.wait_for(lock, std::chrono::milliseconds(1));
+
+      m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    onContended(Site, true, t0);
+  }
+
+
+  void D3D9DeviceMutex::onContended(
+          D3D9DeviceLockSite  Site,
+          bool                Parked,
+          high_resolution_clock::time_point StartTime) {
+    auto t1 = high_resolution_clock::now();
+
+    auto& counters = m_counters[uint32_t(Site)];
+    increment(counters.contended, 1);
+    increment(counters.parked, Parked ? 1 : 0);
+    increment(counters.waitTimeNs, std::chrono::duration_cast<
+      std::chrono::nanoseconds>(t1 - StartTime).count());
+
+    if (m_statsRefs.load(std::memory_order_relaxed))
+      onAcquire(Site);
+  }
+
+
+  void D3D9DeviceMutex::onAcquire(
+          D3D9DeviceLockSite  Site) {
+    increment(m_counters[uint32_t(Site)].acquisitions, 1);
+
+    m_ownerSite = Site;
+    m_lockTime  = high_resolution_clock::now();
+  }
+
+
+  void D3D9DeviceMutex::onRelease() {
+    auto t1 = high_resolution_clock::now();
+    increment(m_counters[uint32_t(m_ownerSite)].holdTimeNs,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - m_lockTime).count());
+
+    m_lockTime = high_resolution_clock::time_point();
+  }
+
+
   D3D9Multithread::D3D9Multithread(
           BOOL                  Protected)
-    : m_protected( Protected ) { }
+    : m_protected( Protected ) {
+    if (dxvk::thread::hardware_concurrency() > 2)
+      m_mutex.setSpinCount(1024);
+  }
+
+
+  D3D9Multithread::~D3D9Multithread() {
+    if (!m_protected)
+      return;
+
+    D3D9DeviceLockStats stats = m_mutex.getStatistics();
+
+    for (uint32_t i = 0; i < stats.sites.size(); i++) {
+      const auto& site = stats.sites[i];
+
+      if (!site.contended)
+        continue;
+
+      std::string message = str::format("D3D9: Device lock (",
+        GetLockSiteName(D3D9DeviceLockSite(i)), "): ",
+        site.contended, " contended, ",
+        site.parked, " parked, ",
+        site.waitTimeNs / 1000, " us waiting");
+
+      if (site.acquisitions) {
+        message += str::format(", ", site.acquisitions, " acquisitions, ",
+          site.holdTimeNs / 1000, " us held");
+      }
+
+      Logger::info(message);
+    }
+  }
 
-}
\ No newline at end of file
+}
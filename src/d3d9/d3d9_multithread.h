@@ -2,29 +2,165 @@
 
 #include "d3d9_include.h"
 
+#include "../util/util_time.h"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+
 namespace dxvk {
 
+  /**
+   * \brief Device lock call site class
+   *
+   * Used to attribute lock statistics to the
+   * kind of API call that acquired the lock.
+   */
+  enum class D3D9DeviceLockSite : uint32_t {
+    Other,
+    Draw,
+    Lock,
+    Create,
+    Count
+  };
+
+
+  /**
+   * \brief Device lock statistics for one call site class
+   *
+   * Contention is always tracked since it only affects the
+   * slow path. Acquisitions and hold times are only counted
+   * while statistics are enabled.
+   */
+  struct D3D9DeviceLockSiteStats {
+    uint64_t acquisitions = 0;
+    uint64_t contended    = 0;
+    uint64_t parked       = 0;
+    uint64_t waitTimeNs   = 0;
+    uint64_t holdTimeNs   = 0;
+  };
+
+
+  /**
+   * \brief Device lock statistics
+   */
+  struct D3D9DeviceLockStats {
+    std::array<D3D9DeviceLockSiteStats,
+      uint32_t(D3D9DeviceLockSite::Count)> sites;
+  };
+
+
   /**
    * \brief Device mutex
    *
-   * Effectively implements a recursive spinlock
-   * which is used to lock the D3D9 device.
+   * Recursive adaptive mutex which is used to lock
+   * the D3D9 device. Uncontended acquisitions only
+   * cost a single atomic operation. Contended ones
+   * spin for a short while, since the lock is usually
+   * held for short periods of time, and then park the
+   * thread rather than burning CPU time that the lock
+   * owner or the CS thread could use instead.
    */
   class D3D9DeviceMutex {
 
   public:
 
-    void lock();
+    void lock() {
+      lock(D3D9DeviceLockSite::Other);
+    }
+
+    void lock(D3D9DeviceLockSite Site);
 
     void unlock();
 
     bool try_lock();
 
+    /**
+     * \brief Sets number of spin iterations
+     *
+     * Spinning is pointless on systems with only
+     * one or two cores, since the lock owner is
+     * unlikely to make progress while we spin.
+     * \param [in] SpinCount Spin iteration count
+     */
+    void setSpinCount(uint32_t SpinCount) {
+      m_spinCount = SpinCount;
+    }
+
+    /**
+     * \brief Enables acquisition and hold time statistics
+     *
+     * Disabled by default in order to keep counters and
+     * clock queries off the fast path. Must be paired
+     * with a call to \ref disableStatistics.
+     */
+    void enableStatistics() {
+      m_statsRefs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Disables acquisition and hold time statistics
+     */
+    void disableStatistics() {
+      m_statsRefs.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Queries lock statistics
+     *
+     * Counters are only ever written by the lock
+     * owner, so the snapshot may be slightly out
+     * of date but is otherwise consistent enough
+     * for display purposes.
+     * \returns Lock statistics
+     */
+    D3D9DeviceLockStats getStatistics() const;
+
   private:
 
-    std::atomic<uint32_t> m_owner = { 0u };
+    struct SiteCounters {
+      std::atomic<uint64_t> acquisitions = { 0ull };
+      std::atomic<uint64_t> contended    = { 0ull };
+      std::atomic<uint64_t> parked       = { 0ull };
+      std::atomic<uint64_t> waitTimeNs   = { 0ull };
+      std::atomic<uint64_t> holdTimeNs   = { 0ull };
+    };
+
+    std::atomic<uint32_t> m_owner   = { 0u };
     uint32_t              m_counter = { 0u };
 
+    uint32_t              m_spinCount = 0u;
+
+    std::atomic<uint32_t>   m_waiters = { 0u };
+    std::mutex              m_parkMutex;
+    std::condition_variable m_parkCond;
+
+    std::atomic<uint32_t> m_statsRefs = { 0u };
+    D3D9DeviceLockSite    m_ownerSite = D3D9DeviceLockSite::Other;
+    high_resolution_clock::time_point m_lockTime;
+
+    std::array<SiteCounters,
+      uint32_t(D3D9DeviceLockSite::Count)> m_counters;
+
+    void lockSlow(D3D9DeviceLockSite Site);
+
+    void onContended(
+            D3D9DeviceLockSite  Site,
+            bool                Parked,
+            high_resolution_clock::time_point StartTime);
+
+    void onAcquire(
+            D3D9DeviceLockSite  Site);
+
+    void onRelease();
+
+    static void increment(std::atomic<uint64_t>& Counter, uint64_t Value) {
+      // Only the lock owner writes counters, so there
+      // is no need for a locked read-modify-write
+      Counter.store(Counter.load(std::memory_order_relaxed) + Value,
+        std::memory_order_relaxed);
+    }
+
   };
 
 
@@ -43,9 +179,9 @@ namespace dxvk {
     D3D9DeviceLock()
       : m_mutex(nullptr) { }
 
-    D3D9DeviceLock(D3D9DeviceMutex& mutex)
+    D3D9DeviceLock(D3D9DeviceMutex& mutex, D3D9DeviceLockSite site)
       : m_mutex(&mutex) {
-      mutex.lock();
+      mutex.lock(site);
     }
 
     D3D9DeviceLock(D3D9DeviceLock&& other)
@@ -84,12 +220,30 @@ namespace dxvk {
     D3D9Multithread(
       BOOL                  Protected);
 
-    D3D9DeviceLock AcquireLock() {
+    ~D3D9Multithread();
+
+    D3D9DeviceLock AcquireLock(D3D9DeviceLockSite Site) {
       return m_protected
-        ? D3D9DeviceLock(m_mutex)
+        ? D3D9DeviceLock(m_mutex, Site)
         : D3D9DeviceLock();
     }
 
+    BOOL IsProtected() const {
+      return m_protected;
+    }
+
+    void EnableStatistics() {
+      m_mutex.enableStatistics();
+    }
+
+    void DisableStatistics() {
+      m_mutex.disableStatistics();
+    }
+
+    D3D9DeviceLockStats GetStatistics() const {
+      return m_mutex.getStatistics();
+    }
+
   private:
 
     BOOL            m_protected;
@@ -98,4 +252,4 @@ namespace dxvk {
 
   };
 
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 
 #include "d3d9_caps.h"
 
+#include "../dxvk/dxvk_buffer_arena.h"
+
 namespace dxvk {
 
   static int32_t parsePciId(const std::string& str) {
@@ -49,6 +51,8 @@ namespace dxvk {
     this->numBackBuffers        = config.getOption<int32_t> ("d3d9.numBackBuffers",        0);
     this->deferSurfaceCreation  = config.getOption<bool>    ("d3d9.deferSurfaceCreation",  false);
     this->samplerAnisotropy     = config.getOption<int32_t> ("d3d9.samplerAnisotropy",     -1);
+    this->samplerCacheSize      = std::max(config.getOption<int32_t>("d3d9.samplerCacheSize", 1024), 0);
+    this->dynamicBufferArenaLimit = config.getOption<int32_t> ("d3d9.dynamicBufferArenaLimit", 65536);
     this->maxAvailableMemory    = config.getOption<int32_t> ("d3d9.maxAvailableMemory",    4096);
     this->supportDFFormats      = config.getOption<bool>    ("d3d9.supportDFFormats",      true);
     this->supportX4R4G4B4       = config.getOption<bool>    ("d3d9.supportX4R4G4B4",       true);
@@ -61,9 +65,17 @@ namespace dxvk {
     this->memoryTrackTest       = config.getOption<bool>    ("d3d9.memoryTrackTest",       false);
     this->supportVCache         = config.getOption<bool>    ("d3d9.supportVCache",         vendorId == 0x10de);
     this->enableDialogMode      = config.getOption<bool>    ("d3d9.enableDialogMode",      false);
+    this->promoteVariables      = config.getOption<bool>    ("d3d9.promoteVariables",      false);
+    this->asyncShaderTranslation = config.getOption<bool>   ("d3d9.asyncShaderTranslation", true);
+    this->boolSpecVariants      = std::max(config.getOption<int32_t>("d3d9.boolSpecVariants", 4), 0);
+    this->ffUberShaders         = config.getOption<bool>    ("d3d9.ffUberShaders",         false);
 
     this->forceAspectRatio      = config.getOption<std::string>("d3d9.forceAspectRatio",   "");
 
+    // The arena does not support slices larger than this
+    this->dynamicBufferArenaLimit = std::min<uint32_t>(
+      this->dynamicBufferArenaLimit, DxvkBufferArena::maxSliceSize());
+
     // If we are not Nvidia, enable general hazards.
     this->generalHazards = adapter == nullptr || !adapter->matchesDriver(DxvkGpuVendor::Nvidia, VK_DRIVER_ID_NVIDIA_PROPRIETARY_KHR, 0, 0);
     applyTristate(this->generalHazards, config.getOption<Tristate>("d3d9.generalHazards", Tristate::Auto));
@@ -68,6 +68,14 @@ namespace dxvk {
     /// given anisotropy value for all samplers.
     int32_t samplerAnisotropy;
 
+    /// Number of sampler pairs to keep before evicting
+    /// samplers that are no longer in use. 0 disables it.
+    uint32_t samplerCacheSize;
+
+    /// Maximum size of dynamic buffers that allocate
+    /// discarded slices from a device-wide arena
+    uint32_t dynamicBufferArenaLimit;
+
     /// Max available memory override
     ///
     /// Changes the max initial value used in
@@ -112,6 +120,22 @@ namespace dxvk {
 
     /// Enable dialog mode (ie. no exclusive fullscreen)
     bool enableDialogMode;
+
+    /// Promote private variables in translated
+    /// shaders to SSA values before emitting them
+    bool promoteVariables;
+
+    /// Translate shaders on worker threads instead of
+    /// blocking the thread that creates the shader
+    bool asyncShaderTranslation;
+
+    /// Maximum number of bool constant combinations
+    /// to specialize each shader for. 0 disables it.
+    uint32_t boolSpecVariants;
+
+    /// Pass fixed-function lighting and texture stage
+    /// state to shaders instead of the shader key
+    bool ffUberShaders;
   };
 
 }
\ No newline at end of file
@@ -119,6 +119,13 @@ namespace dxvk {
         m_parent->End(this);
 
       }
+
+      // Read this after ending the query so that we never
+      // think the end has been submitted when it has not
+      m_endSubmission = m_parent->GetSubmissionCount();
+      m_pendingPolls  = 0;
+      m_endSeq       += 1;
+
       m_state = D3D9_VK_QUERY_ENDED;
     }
       
@@ -134,8 +141,17 @@ namespace dxvk {
     // If we get S_FALSE and it's not from the fact
     // they didn't call end, do some flushy stuff...
     if (flush && hr == S_FALSE && m_state != D3D9_VK_QUERY_BEGUN) {
-      this->NotifyStall();
-      m_parent->FlushImplicit(FALSE);
+      // Don't flush if the end of the query has already been
+      // submitted, the result will become available on its own.
+      // Otherwise, only flush once the app appears to be waiting
+      // for the result, since games that poll every frame would
+      // cause lots of tiny submissions. Present always flushes.
+      bool submitted = m_parent->GetSubmissionCount() > m_endSubmission;
+
+      if (!submitted && (++m_pendingPolls >= MaxPendingPolls || IsStalling())) {
+        this->NotifyStall();
+        m_parent->FlushImplicit(FALSE);
+      }
     }
 
     return hr;
@@ -159,18 +175,42 @@ namespace dxvk {
     if (m_resetCtr != 0u)
       return S_FALSE;
 
+    // Results are cached once available, so polling
+    // a query again does not need to read it back
+    if (m_resultSeq.load(std::memory_order_acquire) != m_endSeq) {
+      D3D9_QUERY_DATA result = { };
+      HRESULT hr = GetGpuQueryData(&result);
+
+      if (hr != D3D_OK) {
+        if (hr == S_FALSE && IsEvent() && pData != nullptr)
+          *static_cast<BOOL*>(pData) = FALSE;
+
+        return hr;
+      }
+
+      m_result = result;
+      m_resultSeq.store(m_endSeq, std::memory_order_release);
+    }
+
+    if (pData != nullptr)
+      std::memcpy(pData, &m_result, GetDataSize());
+
+    return D3D_OK;
+  }
+
+
+  HRESULT D3D9Query::GetGpuQueryData(D3D9_QUERY_DATA* pData) {
     if (m_queryType == D3DQUERYTYPE_EVENT) {
       DxvkGpuEventStatus status = m_event[0]->test();
 
       if (status == DxvkGpuEventStatus::Invalid)
         return D3DERR_INVALIDCALL;
 
-      bool signaled = status == DxvkGpuEventStatus::Signaled;
+      if (status != DxvkGpuEventStatus::Signaled)
+        return S_FALSE;
 
-      if (pData != nullptr)
-        *static_cast<BOOL*>(pData) = signaled;
-
-      return signaled ? D3D_OK : S_FALSE;
+      pData->Event = TRUE;
+      return D3D_OK;
     }
     else {
       std::array<DxvkQueryData, MaxGpuQueries> queryData = { };
@@ -186,40 +226,35 @@ namespace dxvk {
           return S_FALSE;
       }
 
-      if (pData == nullptr)
-        return D3D_OK;
-
-      auto* data = static_cast<D3D9_QUERY_DATA*>(pData);
-
       switch (m_queryType) {
         case D3DQUERYTYPE_VCACHE:
           // Don't know what the hell any of this means.
           // Nor do I care. This just makes games work.
-          data->VCache.Pattern     = MAKEFOURCC('H', 'C', 'A', 'C');
-          data->VCache.OptMethod   = 1;
-          data->VCache.CacheSize   = 24;
-          data->VCache.MagicNumber = 20;
+          pData->VCache.Pattern     = MAKEFOURCC('H', 'C', 'A', 'C');
+          pData->VCache.OptMethod   = 1;
+          pData->VCache.CacheSize   = 24;
+          pData->VCache.MagicNumber = 20;
           return D3D_OK;
 
         case D3DQUERYTYPE_OCCLUSION:
-          data->Occlusion = DWORD(queryData[0].occlusion.samplesPassed);
+          pData->Occlusion = DWORD(queryData[0].occlusion.samplesPassed);
           return D3D_OK;
 
         case D3DQUERYTYPE_TIMESTAMP:
-          data->Timestamp = queryData[0].timestamp.time;
+          pData->Timestamp = queryData[0].timestamp.time;
           return D3D_OK;
 
         case D3DQUERYTYPE_TIMESTAMPDISJOINT:
-          data->TimestampDisjoint = queryData[0].timestamp.time < queryData[1].timestamp.time;
+          pData->TimestampDisjoint = queryData[0].timestamp.time < queryData[1].timestamp.time;
           return D3D_OK;
 
         case D3DQUERYTYPE_TIMESTAMPFREQ:
-          data->TimestampFreq = GetTimestampQueryFrequency();
+          pData->TimestampFreq = GetTimestampQueryFrequency();
           return D3D_OK;
 
         case D3DQUERYTYPE_VERTEXSTATS:
-          data->VertexStats.NumRenderedTriangles      = queryData[0].statistic.iaPrimitives;
-          data->VertexStats.NumExtraClippingTriangles = queryData[0].statistic.clipPrimitives;
+          pData->VertexStats.NumRenderedTriangles      = queryData[0].statistic.iaPrimitives;
+          pData->VertexStats.NumExtraClippingTriangles = queryData[0].statistic.clipPrimitives;
           return D3D_OK;
 
         default:
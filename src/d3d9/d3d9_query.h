@@ -12,6 +12,7 @@ namespace dxvk {
 
   union D3D9_QUERY_DATA {
     D3DDEVINFO_VCACHE         VCache;
+    BOOL                      Event;
     DWORD                     Occlusion;
     UINT64                    Timestamp;
     BOOL                      TimestampDisjoint;
@@ -22,6 +23,9 @@ namespace dxvk {
   class D3D9Query : public D3D9DeviceChild<IDirect3DQuery9> {
     constexpr static uint32_t MaxGpuQueries = 2;
     constexpr static uint32_t MaxGpuEvents  = 1;
+    // Number of polls with D3DGETDATA_FLUSH before we
+    // assume that the app is spinning on the result
+    constexpr static uint32_t MaxPendingPolls = 8;
   public:
 
     D3D9Query(
@@ -79,6 +83,19 @@ namespace dxvk {
 
     std::atomic<uint32_t> m_resetCtr = { 0u };
 
+    // Incremented every time the query gets ended. Once the
+    // result for an end becomes available, it is cached and
+    // published by storing the sequence number, so repeated
+    // polls do not have to read back the query again.
+    uint32_t              m_endSeq    = 0u;
+    std::atomic<uint32_t> m_resultSeq = { 0u };
+    D3D9_QUERY_DATA       m_result    = { };
+
+    uint64_t m_endSubmission = 0;
+    uint32_t m_pendingPolls  = 0;
+
+    HRESULT GetGpuQueryData(D3D9_QUERY_DATA* pData);
+
     UINT64 GetTimestampQueryFrequency() const;
 
   };
@@ -1,5 +1,7 @@
 #include "d3d9_sampler.h"
 
+#include <algorithm>
+
 namespace dxvk {
 
   size_t D3D9SamplerKeyHash::operator () (const D3D9SamplerKey& key) const {
@@ -44,4 +46,169 @@ namespace dxvk {
         && a.BorderColor[3] == b.BorderColor[3];
   }
 
-}
\ No newline at end of file
+
+
+  D3D9SamplerCache::D3D9SamplerCache(uint32_t MaxCount)
+    : m_maxCount(MaxCount) {
+    m_entries.resize(64);
+  }
+
+
+  const D3D9SamplerPair* D3D9SamplerCache::Find(
+    const D3D9SamplerKey&     Key,
+          size_t              Hash) {
+    D3D9SamplerKeyEq eq;
+
+    size_t mask = GetMask();
+
+    for (size_t i = Hash & mask; m_entries[i].isValid(); i = (i + 1) & mask) {
+      Entry& entry = m_entries[i];
+
+      if (entry.hash == Hash && eq(entry.key, Key)) {
+        entry.lastUse = ++m_useCounter;
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return &entry.pair;
+      }
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+
+  void D3D9SamplerCache::Insert(
+    const D3D9SamplerKey&     Key,
+          size_t              Hash,
+    const D3D9SamplerPair&    Pair) {
+    uint32_t count = GetCount();
+
+    if (m_maxCount && count >= m_maxCount)
+      EvictUnused();
+
+    // Keep the load factor at or below 50%
+    if (2 * (GetCount() + 1) > m_entries.size())
+      Grow();
+
+    Entry entry;
+    entry.hash    = Hash;
+    entry.lastUse = ++m_useCounter;
+    entry.key     = Key;
+    entry.pair    = Pair;
+
+    InsertEntry(std::move(entry));
+    m_count.store(GetCount() + 1, std::memory_order_relaxed);
+  }
+
+
+  D3D9SamplerCacheStats D3D9SamplerCache::GetStats() const {
+    D3D9SamplerCacheStats stats;
+    stats.hits      = m_hits.load(std::memory_order_relaxed);
+    stats.misses    = m_misses.load(std::memory_order_relaxed);
+    stats.evictions = m_evictions.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+
+  void D3D9SamplerCache::InsertEntry(Entry&& entry) {
+    size_t mask = GetMask();
+    size_t i = entry.hash & mask;
+
+    while (m_entries[i].isValid())
+      i = (i + 1) & mask;
+
+    m_entries[i] = std::move(entry);
+  }
+
+
+  void D3D9SamplerCache::RemoveEntry(size_t Index) {
+    size_t mask = GetMask();
+
+    // Shift subsequent entries of the probe sequence back
+    // so that lookups never have to skip over tombstones
+    size_t i = Index;
+    size_t j = Index;
+
+    while (true) {
+      j = (j + 1) & mask;
+
+      if (!m_entries[j].isValid())
+        break;
+
+      size_t home = m_entries[j].hash & mask;
+
+      // Entry j can fill the hole at i unless its
+      // home slot lies cyclically within (i, j]
+      bool inRange = i <= j
+        ? (i < home && home <= j)
+        : (i < home || home <= j);
+
+      if (!inRange) {
+        m_entries[i] = std::move(m_entries[j]);
+        i = j;
+      }
+    }
+
+    m_entries[i] = Entry();
+  }
+
+
+  void D3D9SamplerCache::Grow() {
+    std::vector<Entry> entries(m_entries.size() * 2);
+    std::swap(entries, m_entries);
+
+    for (auto& entry : entries) {
+      if (entry.isValid())
+        InsertEntry(std::move(entry));
+    }
+  }
+
+
+  void D3D9SamplerCache::EvictUnused() {
+    // Evict down to three quarters of the limit, including
+    // the new entry, so that this does not run on every insert
+    uint32_t count  = GetCount();
+    uint32_t target = m_maxCount - m_maxCount / 4;
+
+    std::vector<uint64_t> candidates;
+
+    for (const auto& entry : m_entries) {
+      if (entry.isValid()
+       && !entry.pair.color->isInUse()
+       && !entry.pair.depth->isInUse())
+        candidates.push_back(entry.lastUse);
+    }
+
+    if (candidates.empty())
+      return;
+
+    // Find the last use of the most recently used
+    // sampler that we need to evict to hit the target
+    size_t evictCount = std::min<size_t>(count + 1 - target, candidates.size());
+
+    std::nth_element(candidates.begin(),
+      candidates.begin() + evictCount - 1, candidates.end());
+
+    uint64_t lastUse = candidates[evictCount - 1];
+
+    // Removing entries shifts others around, so walk
+    // the table until no more candidates are found
+    uint32_t evicted = 0;
+
+    for (size_t i = 0; i < m_entries.size(); ) {
+      const Entry& entry = m_entries[i];
+
+      if (entry.isValid() && entry.lastUse <= lastUse
+       && !entry.pair.color->isInUse()
+       && !entry.pair.depth->isInUse()) {
+        RemoveEntry(i);
+        evicted += 1;
+      } else {
+        i += 1;
+      }
+    }
+
+    m_count.store(count - evicted, std::memory_order_relaxed);
+    m_evictions.fetch_add(evicted, std::memory_order_relaxed);
+  }
+
+}
@@ -5,9 +5,12 @@
 #include "d3d9_util.h"
 
 #include "../dxvk/dxvk_hash.h"
+#include "../dxvk/dxvk_sampler.h"
 
 #include "../util/util_math.h"
 
+#include <vector>
+
 namespace dxvk {
 
   struct D3D9SamplerKey {
@@ -40,11 +43,27 @@ namespace dxvk {
     key.MinFilter = std::clamp(key.MinFilter, D3DTEXF_NONE, D3DTEXF_ANISOTROPIC);
     key.MipFilter = std::clamp(key.MipFilter, D3DTEXF_NONE, D3DTEXF_ANISOTROPIC);
 
-    key.MaxAnisotropy = std::clamp<DWORD>(key.MaxAnisotropy, 0, 16);
+    // Min and mag filters treat none as point, and
+    // there is no such thing as anisotropic mip filtering
+    if (key.MagFilter == D3DTEXF_NONE)
+      key.MagFilter = D3DTEXF_POINT;
+
+    if (key.MinFilter == D3DTEXF_NONE)
+      key.MinFilter = D3DTEXF_POINT;
+
+    if (key.MipFilter == D3DTEXF_ANISOTROPIC)
+      key.MipFilter = D3DTEXF_LINEAR;
+
+    if (key.MagFilter == D3DTEXF_ANISOTROPIC
+     || key.MinFilter == D3DTEXF_ANISOTROPIC)
+      key.MaxAnisotropy = std::clamp<DWORD>(key.MaxAnisotropy, 0, 16);
+    else
+      key.MaxAnisotropy = 0;
 
     if (key.MipFilter == D3DTEXF_NONE) {
       // May as well try and keep slots down.
       key.MipmapLodBias = 0;
+      key.MaxMipLevel   = 0;
     }
     else {
       // Games also pass NAN/INF here, this accounts for that.
@@ -72,4 +91,123 @@ namespace dxvk {
     }
   }
 
-}
\ No newline at end of file
+
+
+  struct D3D9SamplerPair {
+    Rc<DxvkSampler> color;
+    Rc<DxvkSampler> depth;
+  };
+
+
+  /**
+   * \brief Sampler cache statistics
+   */
+  struct D3D9SamplerCacheStats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+  };
+
+
+  /**
+   * \brief Sampler cache
+   *
+   * Open-addressing hash table with linear probing
+   * which maps normalized sampler keys to sampler
+   * objects. Hashes are stored alongside the keys
+   * so that probing rarely needs to compare keys.
+   *
+   * Once the number of cached samplers exceeds the
+   * given limit, the least recently used samplers
+   * which are not in use by the GPU get evicted.
+   * This keeps applications that animate the LOD
+   * bias or border color from running into driver
+   * limits on the number of sampler objects.
+   *
+   * Not thread-safe, must only be accessed from the
+   * CS thread. Statistics can be queried from any
+   * thread, however.
+   */
+  class D3D9SamplerCache {
+
+  public:
+
+    D3D9SamplerCache(uint32_t MaxCount);
+
+    /**
+     * \brief Looks up a sampler pair
+     *
+     * \param [in] Key Normalized sampler key
+     * \param [in] Hash Hash of the key
+     * \returns Sampler pair, or \c nullptr if not found
+     */
+    const D3D9SamplerPair* Find(
+      const D3D9SamplerKey&     Key,
+            size_t              Hash);
+
+    /**
+     * \brief Adds a sampler pair
+     *
+     * Evicts unused samplers if necessary. This
+     * invalidates pointers returned by \c Find.
+     * \param [in] Key Normalized sampler key
+     * \param [in] Hash Hash of the key
+     * \param [in] Pair Sampler objects
+     */
+    void Insert(
+      const D3D9SamplerKey&     Key,
+            size_t              Hash,
+      const D3D9SamplerPair&    Pair);
+
+    /**
+     * \brief Number of cached sampler pairs
+     * \returns Sampler pair count
+     */
+    uint32_t GetCount() const {
+      return m_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Queries cache statistics
+     * \returns Hit, miss and eviction counts
+     */
+    D3D9SamplerCacheStats GetStats() const;
+
+  private:
+
+    struct Entry {
+      size_t          hash    = 0;
+      uint64_t        lastUse = 0;
+      D3D9SamplerKey  key     = { };
+      D3D9SamplerPair pair;
+
+      bool isValid() const {
+        return pair.color != nullptr;
+      }
+    };
+
+    uint32_t              m_maxCount;
+    uint64_t              m_useCounter = 0;
+
+    std::vector<Entry>    m_entries;
+
+    std::atomic<uint32_t> m_count     = { 0u };
+    std::atomic<uint64_t> m_hits      = { 0ull };
+    std::atomic<uint64_t> m_misses    = { 0ull };
+    std::atomic<uint64_t> m_evictions = { 0ull };
+
+    size_t GetMask() const {
+      return m_entries.size() - 1;
+    }
+
+    void InsertEntry(Entry&& entry);
+
+    void RemoveEntry(size_t Index);
+
+    void Grow();
+
+    void EvictUnused();
+
+  };
+
+}
@@ -1,33 +1,111 @@
 #include "d3d9_shader.h"
 
+#include "d3d9_spec_constants.h"
 #include "d3d9_util.h"
 
+#include <algorithm>
+
 namespace dxvk {
 
+  D3D9ShaderTranslation::D3D9ShaderTranslation()
+  : m_creationTime(dxvk::high_resolution_clock::now()) {
+
+  }
+
+
+  D3D9ShaderTranslation::~D3D9ShaderTranslation() {
+
+  }
+
+
+  void D3D9ShaderTranslation::Translate(
+    const Rc<DxvkDevice>&       Device,
+          VkShaderStageFlagBits ShaderStage,
+    const Sha1Hash&             Hash,
+    const DxsoModuleInfo&       ModuleInfo,
+    const DxsoAnalysisInfo&     AnalysisInfo,
+    const D3D9ConstantLayout&   ConstantLayout,
+          DxsoModule&           Module) {
+    DxvkShaderKey shaderKey = { ShaderStage, Hash };
+
+    const std::string name = shaderKey.toString();
+    Logger::debug(str::format("Compiling shader ", name));
+
+    try {
+      TraceScope trace("shader", "Translate DXSO", name.c_str());
+
+      shaders      = Module.compile(ModuleInfo, name, AnalysisInfo, ConstantLayout);
+      isgn         = Module.isgn();
+      usedSamplers = Module.usedSamplers();
+      usedRTs      = Module.usedRTs();
+
+      meta      = Module.meta();
+      constants = Module.constants();
+
+      shaders[0]->setShaderKey(shaderKey);
+
+      if (shaders[1] != nullptr) {
+        // Lets lie about the shader key type for the state cache.
+        shaders[1]->setShaderKey({ VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, Hash });
+      }
+
+      // If requested by the user, dump the
+      // compiled SPIR-V module to a file.
+      const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
+
+      if (dumpPath.size() != 0) {
+        std::ofstream dumpStream(
+          str::format(dumpPath, "/", name, ".spv"),
+          std::ios_base::binary | std::ios_base::trunc);
+
+        shaders[0]->dump(dumpStream);
+      }
+
+      Device->registerShader(shaders[0]);
+
+      if (shaders[1] != nullptr)
+        Device->registerShader(shaders[1]);
+    } catch (const DxvkError& e) {
+      // Shader creation has already succeeded at this
+      // point, so all we can do is leave the shader
+      // unbound whenever the application uses it.
+      Logger::err(str::format("Failed to translate shader ", name));
+      Logger::err(e.message());
+
+      shaders = DxsoPermutations();
+    }
+
+    { std::lock_guard<std::mutex> lock(m_mutex);
+      m_ready.store(true, std::memory_order_release);
+    }
+
+    m_cond.notify_all();
+  }
+
+
   D3D9CommonShader::D3D9CommonShader() {}
 
   D3D9CommonShader::D3D9CommonShader(
-            D3D9DeviceEx*         pDevice,
             VkShaderStageFlagBits ShaderStage,
       const Sha1Hash*             pHash,
-      const DxsoModuleInfo*       pDxsoModuleInfo,
       const void*                 pShaderBytecode,
       const DxsoAnalysisInfo&     AnalysisInfo,
-            DxsoModule*           pModule) {
+            DxsoModule*           pModule)
+  : m_info        (pModule->info()),
+    m_translation (new D3D9ShaderTranslation()) {
     const uint32_t bytecodeLength = AnalysisInfo.bytecodeByteLength;
     m_bytecode.resize(bytecodeLength);
     std::memcpy(m_bytecode.data(), pShaderBytecode, bytecodeLength);
 
-    DxvkShaderKey shaderKey = { ShaderStage, *pHash };
-
-    const std::string name = shaderKey.toString();
-    Logger::debug(str::format("Compiling shader ", name));
-    
-    // If requested by the user, dump both the raw DXBC
-    // shader and the compiled SPIR-V module to a file.
+    // If requested by the user, dump the raw DXSO shader. This
+    // has to happen here since the application may free the
+    // bytecode before the shader gets translated.
     const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
     
     if (dumpPath.size() != 0) {
+      DxvkShaderKey shaderKey = { ShaderStage, *pHash };
+      const std::string name = shaderKey.toString();
+
       DxsoReader reader(
         reinterpret_cast<const char*>(pShaderBytecode));
 
@@ -49,42 +127,48 @@ namespace dxvk {
           blob->GetBufferSize());
       }
     }
-    
-    // Decide whether we need to create a pass-through
-    // geometry shader for vertex shader stream output
+  }
 
-    const D3D9ConstantLayout& constantLayout = ShaderStage == VK_SHADER_STAGE_VERTEX_BIT
-      ? pDevice->GetVertexConstantLayout()
-      : pDevice->GetPixelConstantLayout();
 
-    m_shaders      = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
-    m_isgn         = pModule->isgn();
-    m_usedSamplers = pModule->usedSamplers();
-    m_usedRTs      = pModule->usedRTs();
+  uint32_t D3D9CommonShader::GetBoolSpecConstant(
+          uint32_t              Bitmask,
+          uint32_t              MaxVariants) const {
+    const uint32_t usedMask = GetMeta().boolConstMask;
+
+    if (!usedMask || !MaxVariants)
+      return 0u;
 
-    m_info      = pModule->info();
-    m_meta      = pModule->meta();
-    m_constants = pModule->constants();
+    Bitmask &= usedMask;
 
-    m_shaders[0]->setShaderKey(shaderKey);
+    auto& variants = m_translation->boolVariants;
 
-    if (m_shaders[1] != nullptr) {
-      // Lets lie about the shader key type for the state cache.
-      m_shaders[1]->setShaderKey({ VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, *pHash });
+    if (std::find(variants.begin(), variants.end(), Bitmask) == variants.end()) {
+      if (variants.size() >= MaxVariants)
+        return 0u;
+
+      variants.push_back(Bitmask);
     }
-    
-    if (dumpPath.size() != 0) {
-      std::ofstream dumpStream(
-        str::format(dumpPath, "/", name, ".spv"),
-        std::ios_base::binary | std::ios_base::trunc);
-      
-      m_shaders[0]->dump(dumpStream);
+
+    return Bitmask | D3D9SpecBoolsValid;
+  }
+
+
+  D3D9ShaderModuleSet::D3D9ShaderModuleSet() {
+
+  }
+
+
+  D3D9ShaderModuleSet::~D3D9ShaderModuleSet() {
+    // Workers drain the queue before exiting, so that
+    // no shader is ever left in an unfinished state
+    { std::lock_guard<std::mutex> lock(m_workerLock);
+      m_stopThreads = true;
     }
 
-    pDevice->GetDXVKDevice()->registerShader(m_shaders[0]);
+    m_workerCond.notify_all();
 
-    if (m_shaders[1] != nullptr)
-      pDevice->GetDXVKDevice()->registerShader(m_shaders[1]);
+    for (auto& worker : m_workerThreads)
+      worker.join();
   }
 
 
@@ -120,14 +204,13 @@ namespace dxvk {
     }
     
     // This shader has not been compiled yet, so we have to create a
-    // new module. This takes a while, so we won't lock the structure.
+    // new module. Translation itself will run on a worker thread.
     D3D9CommonShader commonShader(
-      pDevice, ShaderStage, &hash,
-      pDxbcModuleInfo, pShaderBytecode,
+      ShaderStage, &hash, pShaderBytecode,
       info, &module);
     
     // Insert the new module into the lookup table. If another thread
-    // has compiled the same shader in the meantime, we should return
+    // has created the same shader in the meantime, we should return
     // that object instead and discard the newly created module.
     { std::unique_lock<std::mutex> lock(m_mutex);
       
@@ -135,8 +218,98 @@ namespace dxvk {
       if (!status.second)
         return status.first->second;
     }
+
+    // The module no longer needs the application's bytecode
+    // after analysis, so it can be handed off to the worker
+    TranslationJob job;
+    job.translation = commonShader.m_translation;
+    job.device      = pDevice->GetDXVKDevice();
+    job.stage       = ShaderStage;
+    job.hash        = hash;
+    job.moduleInfo  = *pDxbcModuleInfo;
+    job.analysis    = info;
+    job.layout      = ShaderStage == VK_SHADER_STAGE_VERTEX_BIT
+      ? pDevice->GetVertexConstantLayout()
+      : pDevice->GetPixelConstantLayout();
+    job.module      = std::make_unique<DxsoModule>(std::move(module));
+
+    if (pDevice->GetOptions()->asyncShaderTranslation)
+      this->EnqueueJob(std::move(job));
+    else
+      this->RunJob(job);
     
     return commonShader;
   }
 
-}
\ No newline at end of file
+
+  D3D9ShaderTranslationStats D3D9ShaderModuleSet::GetStats() const {
+    D3D9ShaderTranslationStats stats;
+    stats.queueDepth      = m_queueDepth.load();
+    stats.translatedCount = m_translatedCount.load();
+    stats.timeToReadyUs   = m_timeToReadyUs.load();
+    return stats;
+  }
+
+
+  void D3D9ShaderModuleSet::RunJob(
+          TranslationJob&       Job) {
+    Job.translation->Translate(
+      Job.device, Job.stage, Job.hash,
+      Job.moduleInfo, Job.analysis,
+      Job.layout, *Job.module);
+
+    auto time = dxvk::high_resolution_clock::now()
+              - Job.translation->GetCreationTime();
+
+    m_timeToReadyUs += std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    m_translatedCount += 1;
+  }
+
+
+  void D3D9ShaderModuleSet::EnqueueJob(
+          TranslationJob&&      Job) {
+    std::lock_guard<std::mutex> lock(m_workerLock);
+
+    // Start the worker threads on first use, since many
+    // devices are created without ever creating shaders
+    if (m_workerThreads.empty()) {
+      uint32_t numWorkers = DxvkShader::getTranslationThreadCount();
+
+      Logger::info(str::format("D3D9: Using ", numWorkers, " shader translation threads"));
+
+      for (uint32_t i = 0; i < numWorkers; i++)
+        m_workerThreads.emplace_back([this] () { WorkerFunc(); });
+    }
+
+    m_queueDepth += 1;
+    m_workerQueue.push(std::move(Job));
+    m_workerCond.notify_one();
+  }
+
+
+  void D3D9ShaderModuleSet::WorkerFunc() {
+    env::setThreadName("dxvk-dxso");
+
+    while (true) {
+      TranslationJob job;
+
+      { std::unique_lock<std::mutex> lock(m_workerLock);
+
+        m_workerCond.wait(lock, [this] () {
+          return !m_workerQueue.empty()
+              || m_stopThreads;
+        });
+
+        if (m_workerQueue.empty())
+          break;
+
+        job = std::move(m_workerQueue.front());
+        m_workerQueue.pop();
+      }
+
+      this->RunJob(job);
+      m_queueDepth -= 1;
+    }
+  }
+
+}
@@ -5,40 +5,136 @@
 #include "d3d9_shader_permutations.h"
 #include "d3d9_util.h"
 
+#include "../util/thread.h"
+
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
 
 namespace dxvk {
 
+  class D3D9ShaderModuleSet;
+
+  /**
+   * \brief Shader translation result
+   *
+   * Stores the output of the DXSO compiler. Since
+   * shaders are translated on worker threads, this
+   * may not be available yet when the shader object
+   * is created, so consumers must call \ref Wait
+   * before accessing any of the data.
+   */
+  class D3D9ShaderTranslation : public RcObject {
+
+  public:
+
+    D3D9ShaderTranslation();
+
+    ~D3D9ShaderTranslation();
+
+    /**
+     * \brief Translates the shader
+     *
+     * Compiles the given module and makes the
+     * result available to any waiting threads.
+     * \param [in] Device DXVK device
+     * \param [in] ShaderStage Shader stage
+     * \param [in] Hash SHA-1 hash of the bytecode
+     * \param [in] ModuleInfo DXSO module info
+     * \param [in] AnalysisInfo DXSO analysis info
+     * \param [in] ConstantLayout Constant layout
+     * \param [in] Module The DXSO module
+     */
+    void Translate(
+      const Rc<DxvkDevice>&       Device,
+            VkShaderStageFlagBits ShaderStage,
+      const Sha1Hash&             Hash,
+      const DxsoModuleInfo&       ModuleInfo,
+      const DxsoAnalysisInfo&     AnalysisInfo,
+      const D3D9ConstantLayout&   ConstantLayout,
+            DxsoModule&           Module);
+
+    /**
+     * \brief Waits for the translation to finish
+     *
+     * Returns immediately if the shader
+     * has already been translated.
+     */
+    void Wait() const {
+      if (likely(m_ready.load(std::memory_order_acquire)))
+        return;
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] () {
+        return m_ready.load(std::memory_order_acquire);
+      });
+    }
+
+    /**
+     * \brief Time at which the shader was created
+     * \returns Creation time
+     */
+    dxvk::high_resolution_clock::time_point GetCreationTime() const {
+      return m_creationTime;
+    }
+
+    DxsoIsgn              isgn;
+    uint32_t              usedSamplers = 0;
+    uint32_t              usedRTs      = 0;
+
+    DxsoShaderMetaInfo    meta;
+    DxsoDefinedConstants  constants;
+
+    DxsoPermutations      shaders;
+
+    /// Bool constant combinations that the shader has been
+    /// specialized for. Only accessed with the device locked.
+    std::vector<uint32_t> boolVariants;
+
+  private:
+
+    dxvk::high_resolution_clock::time_point m_creationTime;
+
+    std::atomic<bool>               m_ready = { false };
+    mutable std::mutex              m_mutex;
+    mutable std::condition_variable m_cond;
+
+  };
+
 
   /**
    * \brief Common shader object
    * 
    * Stores the compiled SPIR-V shader and the SHA-1
    * hash of the original DXBC shader, which can be
-   * used to identify the shader.
+   * used to identify the shader. Accessing anything
+   * that depends on the compiled shader will block
+   * until the translation has finished.
    */
   class D3D9CommonShader {
-
+    friend class D3D9ShaderModuleSet;
   public:
 
     D3D9CommonShader();
 
     D3D9CommonShader(
-            D3D9DeviceEx*         pDevice,
             VkShaderStageFlagBits ShaderStage,
       const Sha1Hash*             pHash,
-      const DxsoModuleInfo*       pDxbcModuleInfo,
       const void*                 pShaderBytecode,
       const DxsoAnalysisInfo&     AnalysisInfo,
             DxsoModule*           pModule);
 
 
     Rc<DxvkShader> GetShader(D3D9ShaderPermutation Permutation) const {
-      return m_shaders[Permutation];
+      return GetTranslation().shaders[Permutation];
     }
 
     std::string GetName() const {
-      return m_shaders[D3D9ShaderPermutations::None]->debugName();
+      const auto& shader = GetTranslation().shaders[D3D9ShaderPermutations::None];
+      return shader != nullptr ? shader->debugName() : std::string();
     }
 
     const std::vector<uint8_t>& GetBytecode() const {
@@ -46,29 +142,47 @@ namespace dxvk {
     }
 
     const DxsoIsgn& GetIsgn() const {
-      return m_isgn;
+      return GetTranslation().isgn;
     }
 
-    const DxsoShaderMetaInfo& GetMeta() const { return m_meta; }
-    const DxsoDefinedConstants& GetConstants() const { return m_constants; }
+    const DxsoShaderMetaInfo& GetMeta() const { return GetTranslation().meta; }
+    const DxsoDefinedConstants& GetConstants() const { return GetTranslation().constants; }
 
-    D3D9ShaderMasks GetShaderMask() const { return D3D9ShaderMasks{ m_usedSamplers, m_usedRTs }; }
+    D3D9ShaderMasks GetShaderMask() const {
+      const auto& translation = GetTranslation();
+      return D3D9ShaderMasks{ translation.usedSamplers, translation.usedRTs };
+    }
 
     const DxsoProgramInfo& GetInfo() const { return m_info; }
 
+    /**
+     * \brief Computes bool spec constant
+     *
+     * Masks the given bool constant bitmask with the bools
+     * that the shader reads, and registers the combination
+     * as a new variant if the shader has not been used with
+     * it before. If that would exceed the variant limit, the
+     * shader falls back to reading the bools dynamically.
+     * \param [in] Bitmask Current bool constant bitmask
+     * \param [in] MaxVariants Maximum variant count
+     * \returns Value for the bool spec constant
+     */
+    uint32_t GetBoolSpecConstant(
+            uint32_t              Bitmask,
+            uint32_t              MaxVariants) const;
+
   private:
 
-    DxsoIsgn              m_isgn;
-    uint32_t              m_usedSamplers;
-    uint32_t              m_usedRTs;
+    DxsoProgramInfo           m_info;
 
-    DxsoProgramInfo       m_info;
-    DxsoShaderMetaInfo    m_meta;
-    DxsoDefinedConstants  m_constants;
+    Rc<D3D9ShaderTranslation> m_translation;
 
-    DxsoPermutations      m_shaders;
+    std::vector<uint8_t>      m_bytecode;
 
-    std::vector<uint8_t>  m_bytecode;
+    const D3D9ShaderTranslation& GetTranslation() const {
+      m_translation->Wait();
+      return *m_translation;
+    }
 
   };
 
@@ -158,6 +272,16 @@ namespace dxvk {
 
   };
 
+  /**
+   * \brief Shader translation statistics
+   */
+  struct D3D9ShaderTranslationStats {
+    uint32_t queueDepth       = 0;
+    uint64_t translatedCount  = 0;
+    uint64_t timeToReadyUs    = 0;
+  };
+
+
   /**
    * \brief Shader module set
    * 
@@ -165,18 +289,44 @@ namespace dxvk {
    * times, so we should cache the resulting shader modules
    * and reuse them rather than creating new ones. This
    * class is thread-safe.
+   *
+   * Shader translation runs on a set of worker threads
+   * so that shader creation does not stall the calling
+   * thread. The first use of a shader will block until
+   * its translation has finished.
    */
   class D3D9ShaderModuleSet : public RcObject {
     
   public:
+
+    D3D9ShaderModuleSet();
+
+    ~D3D9ShaderModuleSet();
     
     D3D9CommonShader GetShaderModule(
             D3D9DeviceEx*         pDevice,
             VkShaderStageFlagBits ShaderStage,
       const DxsoModuleInfo*       pDxbcModuleInfo,
       const void*                 pShaderBytecode);
+
+    /**
+     * \brief Retrieves translation statistics
+     * \returns Statistics since device creation
+     */
+    D3D9ShaderTranslationStats GetStats() const;
     
   private:
+
+    struct TranslationJob {
+      Rc<D3D9ShaderTranslation> translation;
+      Rc<DxvkDevice>            device;
+      VkShaderStageFlagBits     stage;
+      Sha1Hash                  hash;
+      DxsoModuleInfo            moduleInfo;
+      DxsoAnalysisInfo          analysis;
+      D3D9ConstantLayout        layout;
+      std::unique_ptr<DxsoModule> module;
+    };
     
     std::mutex m_mutex;
     
@@ -184,7 +334,25 @@ namespace dxvk {
       DxvkShaderKey,
       D3D9CommonShader,
       DxvkHash, DxvkEq> m_modules;
+
+    std::mutex                  m_workerLock;
+    std::condition_variable     m_workerCond;
+    std::queue<TranslationJob>  m_workerQueue;
+    std::vector<dxvk::thread>   m_workerThreads;
+    bool                        m_stopThreads = false;
+
+    std::atomic<uint32_t>       m_queueDepth      = { 0u };
+    std::atomic<uint64_t>       m_translatedCount = { 0ull };
+    std::atomic<uint64_t>       m_timeToReadyUs   = { 0ull };
+
+    void RunJob(
+            TranslationJob&       Job);
+
+    void EnqueueJob(
+            TranslationJob&&      Job);
+
+    void WorkerFunc();
     
-};
+  };
 
-}
\ No newline at end of file
+}
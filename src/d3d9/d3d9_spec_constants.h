@@ -14,6 +14,15 @@ namespace dxvk {
 
     PointMode       = 6,
     ProjectionType  = 7,
+
+    VertexShaderBools = 8,
+    PixelShaderBools  = 9,
+
+    FFVertexLighting  = 10,
   };
 
+  // Set in the bool spec constants if the value is specialized,
+  // since only the lower bits are used for constant registers
+  constexpr uint32_t D3D9SpecBoolsValid = 1u << 31;
+
 }
\ No newline at end of file
@@ -3,10 +3,10 @@
 #include "d3d9_caps.h"
 #include "d3d9_constant_set.h"
 #include "../dxso/dxso_common.h"
+#include "../util/util_bit.h"
 #include "../util/util_matrix.h"
 
 #include <array>
-#include <bitset>
 #include <optional>
 
 namespace dxvk {
@@ -137,8 +137,19 @@ namespace dxvk {
   };
 
 
+  struct D3D9FixedFunctionStagePS {
+    uint32_t colorOp;
+    uint32_t colorArgs;
+    uint32_t alphaOp;
+    uint32_t alphaArgs;
+  };
+
+
   struct D3D9FixedFunctionPS {
     Vector4 textureFactor;
+
+    // Only used by fixed-function uber shaders
+    D3D9FixedFunctionStagePS stages[caps::TextureStageCount];
   };
 
   enum D3D9SharedPSStages {
@@ -315,33 +326,33 @@ namespace dxvk {
   struct D3D9StateCaptures {
     D3D9CapturedStateFlags flags;
 
-    std::bitset<RenderStateCount>                       renderStates;
+    bit::bitset<RenderStateCount>                       renderStates;
 
-    std::bitset<SamplerCount>                           samplers;
+    bit::bitset<SamplerCount>                           samplers;
     std::array<
-      std::bitset<SamplerStateCount>,
+      bit::bitset<SamplerStateCount>,
       SamplerCount>                                     samplerStates;
 
-    std::bitset<caps::MaxStreams>                       vertexBuffers;
-    std::bitset<SamplerCount>                           textures;
-    std::bitset<caps::MaxClipPlanes>                    clipPlanes;
-    std::bitset<caps::MaxStreams>                       streamFreq;
-    std::bitset<caps::MaxTransforms>                    transforms;
-    std::bitset<caps::TextureStageCount>                textureStages;
+    bit::bitset<caps::MaxStreams>                       vertexBuffers;
+    bit::bitset<SamplerCount>                           textures;
+    bit::bitset<caps::MaxClipPlanes>                    clipPlanes;
+    bit::bitset<caps::MaxStreams>                       streamFreq;
+    bit::bitset<caps::MaxTransforms>                    transforms;
+    bit::bitset<caps::TextureStageCount>                textureStages;
     std::array<
-      std::bitset<D3DTSS_CONSTANT>,
+      bit::bitset<D3DTSS_CONSTANT>,
       caps::TextureStageCount>                          textureStageStates;
 
     struct {
-      std::bitset<caps::MaxFloatConstantsSoftware>      fConsts;
-      std::bitset<caps::MaxOtherConstantsSoftware>      iConsts;
-      std::bitset<caps::MaxOtherConstantsSoftware>      bConsts;
+      bit::bitset<caps::MaxFloatConstantsSoftware>      fConsts;
+      bit::bitset<caps::MaxOtherConstantsSoftware>      iConsts;
+      bit::bitset<caps::MaxOtherConstantsSoftware>      bConsts;
     } vsConsts;
 
     struct {
-      std::bitset<caps::MaxFloatConstantsPS>            fConsts;
-      std::bitset<caps::MaxOtherConstants>              iConsts;
-      std::bitset<caps::MaxOtherConstants>              bConsts;
+      bit::bitset<caps::MaxFloatConstantsPS>            fConsts;
+      bit::bitset<caps::MaxOtherConstants>              iConsts;
+      bit::bitset<caps::MaxOtherConstants>              bConsts;
     } psConsts;
   };
 
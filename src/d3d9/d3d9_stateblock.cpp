@@ -72,7 +72,7 @@ namespace dxvk {
     m_state.renderStates[State] = Value;
 
     m_captures.flags.set(D3D9CapturedStateFlag::RenderStates);
-    m_captures.renderStates[State] = true;
+    m_captures.renderStates.set(State, true);
     return D3D_OK;
   }
 
@@ -84,8 +84,8 @@ namespace dxvk {
     m_state.samplerStates[StateSampler][Type] = Value;
 
     m_captures.flags.set(D3D9CapturedStateFlag::SamplerStates);
-    m_captures.samplers[StateSampler] = true;
-    m_captures.samplerStates[StateSampler][Type] = true;
+    m_captures.samplers.set(StateSampler, true);
+    m_captures.samplerStates[StateSampler].set(Type, true);
     return D3D_OK;
   }
 
@@ -100,7 +100,7 @@ namespace dxvk {
     m_state.vertexBuffers[StreamNumber].stride = Stride;
 
     m_captures.flags.set(D3D9CapturedStateFlag::VertexBuffers);
-    m_captures.vertexBuffers[StreamNumber] = true;
+    m_captures.vertexBuffers.set(StreamNumber, true);
     return D3D_OK;
   }
 
@@ -109,7 +109,7 @@ namespace dxvk {
     m_state.streamFreq[StreamNumber] = Setting;
 
     m_captures.flags.set(D3D9CapturedStateFlag::StreamFreq);
-    m_captures.streamFreq[StreamNumber] = true;
+    m_captures.streamFreq.set(StreamNumber, true);
     return D3D_OK;
   }
 
@@ -118,7 +118,7 @@ namespace dxvk {
     TextureChangePrivate(m_state.textures[StateSampler], pTexture);
 
     m_captures.flags.set(D3D9CapturedStateFlag::Textures);
-    m_captures.textures[StateSampler] = true;
+    m_captures.textures.set(StateSampler, true);
     return D3D_OK;
   }
 
@@ -151,7 +151,7 @@ namespace dxvk {
     m_state.transforms[idx] = ConvertMatrix(pMatrix);
 
     m_captures.flags.set(D3D9CapturedStateFlag::Transforms);
-    m_captures.transforms.set(idx);
+    m_captures.transforms.set(idx, true);
     return D3D_OK;
   }
 
@@ -163,8 +163,8 @@ namespace dxvk {
     m_state.textureStages[Stage][Type] = Value;
 
     m_captures.flags.set(D3D9CapturedStateFlag::TextureStages);
-    m_captures.textureStages[Stage] = true;
-    m_captures.textureStageStates[Stage][Type] = true;
+    m_captures.textureStages.set(Stage, true);
+    m_captures.textureStageStates[Stage].set(Type, true);
     return D3D_OK;
   }
 
@@ -173,7 +173,7 @@ namespace dxvk {
     m_state.transforms[idx] = ConvertMatrix(pMatrix) * m_state.transforms[idx];
 
     m_captures.flags.set(D3D9CapturedStateFlag::Transforms);
-    m_captures.transforms.set(idx);
+    m_captures.transforms.set(idx, true);
     return D3D_OK;
   }
 
@@ -199,7 +199,7 @@ namespace dxvk {
       m_state.clipPlanes[Index].coeff[i] = pPlane[i];
 
     m_captures.flags.set(D3D9CapturedStateFlag::ClipPlanes);
-    m_captures.clipPlanes[Index] = true;
+    m_captures.clipPlanes.set(Index, true);
     return D3D_OK;
   }
 
@@ -299,67 +299,67 @@ namespace dxvk {
   void D3D9StateBlock::CapturePixelRenderStates() {
     m_captures.flags.set(D3D9CapturedStateFlag::RenderStates);
 
-    m_captures.renderStates[D3DRS_ZENABLE]                  = true;
-    m_captures.renderStates[D3DRS_FILLMODE]                 = true;
-    m_captures.renderStates[D3DRS_SHADEMODE]                = true;
-    m_captures.renderStates[D3DRS_ZWRITEENABLE]             = true;
-    m_captures.renderStates[D3DRS_ALPHATESTENABLE]          = true;
-    m_captures.renderStates[D3DRS_LASTPIXEL]                = true;
-    m_captures.renderStates[D3DRS_SRCBLEND]                 = true;
-    m_captures.renderStates[D3DRS_DESTBLEND]                = true;
-    m_captures.renderStates[D3DRS_ZFUNC]                    = true;
-    m_captures.renderStates[D3DRS_ALPHAREF]                 = true;
-    m_captures.renderStates[D3DRS_ALPHAFUNC]                = true;
-    m_captures.renderStates[D3DRS_DITHERENABLE]             = true;
-    m_captures.renderStates[D3DRS_FOGSTART]                 = true;
-    m_captures.renderStates[D3DRS_FOGEND]                   = true;
-    m_captures.renderStates[D3DRS_FOGDENSITY]               = true;
-    m_captures.renderStates[D3DRS_ALPHABLENDENABLE]         = true;
-    m_captures.renderStates[D3DRS_DEPTHBIAS]                = true;
-    m_captures.renderStates[D3DRS_STENCILENABLE]            = true;
-    m_captures.renderStates[D3DRS_STENCILFAIL]              = true;
-    m_captures.renderStates[D3DRS_STENCILZFAIL]             = true;
-    m_captures.renderStates[D3DRS_STENCILPASS]              = true;
-    m_captures.renderStates[D3DRS_STENCILFUNC]              = true;
-    m_captures.renderStates[D3DRS_STENCILREF]               = true;
-    m_captures.renderStates[D3DRS_STENCILMASK]              = true;
-    m_captures.renderStates[D3DRS_STENCILWRITEMASK]         = true;
-    m_captures.renderStates[D3DRS_TEXTUREFACTOR]            = true;
-    m_captures.renderStates[D3DRS_WRAP0]                    = true;
-    m_captures.renderStates[D3DRS_WRAP1]                    = true;
-    m_captures.renderStates[D3DRS_WRAP2]                    = true;
-    m_captures.renderStates[D3DRS_WRAP3]                    = true;
-    m_captures.renderStates[D3DRS_WRAP4]                    = true;
-    m_captures.renderStates[D3DRS_WRAP5]                    = true;
-    m_captures.renderStates[D3DRS_WRAP6]                    = true;
-    m_captures.renderStates[D3DRS_WRAP7]                    = true;
-    m_captures.renderStates[D3DRS_WRAP8]                    = true;
-    m_captures.renderStates[D3DRS_WRAP9]                    = true;
-    m_captures.renderStates[D3DRS_WRAP10]                   = true;
-    m_captures.renderStates[D3DRS_WRAP11]                   = true;
-    m_captures.renderStates[D3DRS_WRAP12]                   = true;
-    m_captures.renderStates[D3DRS_WRAP13]                   = true;
-    m_captures.renderStates[D3DRS_WRAP14]                   = true;
-    m_captures.renderStates[D3DRS_WRAP15]                   = true;
-    m_captures.renderStates[D3DRS_COLORWRITEENABLE]         = true;
-    m_captures.renderStates[D3DRS_BLENDOP]                  = true;
-    m_captures.renderStates[D3DRS_SCISSORTESTENABLE]        = true;
-    m_captures.renderStates[D3DRS_SLOPESCALEDEPTHBIAS]      = true;
-    m_captures.renderStates[D3DRS_ANTIALIASEDLINEENABLE]    = true;
-    m_captures.renderStates[D3DRS_TWOSIDEDSTENCILMODE]      = true;
-    m_captures.renderStates[D3DRS_CCW_STENCILFAIL]          = true;
-    m_captures.renderStates[D3DRS_CCW_STENCILZFAIL]         = true;
-    m_captures.renderStates[D3DRS_CCW_STENCILPASS]          = true;
-    m_captures.renderStates[D3DRS_CCW_STENCILFUNC]          = true;
-    m_captures.renderStates[D3DRS_COLORWRITEENABLE1]        = true;
-    m_captures.renderStates[D3DRS_COLORWRITEENABLE2]        = true;
-    m_captures.renderStates[D3DRS_COLORWRITEENABLE3]        = true;
-    m_captures.renderStates[D3DRS_BLENDFACTOR]              = true;
-    m_captures.renderStates[D3DRS_SRGBWRITEENABLE]          = true;
-    m_captures.renderStates[D3DRS_SEPARATEALPHABLENDENABLE] = true;
-    m_captures.renderStates[D3DRS_SRCBLENDALPHA]            = true;
-    m_captures.renderStates[D3DRS_DESTBLENDALPHA]           = true;
-    m_captures.renderStates[D3DRS_BLENDOPALPHA]             = true;
+    m_captures.renderStates.set(D3DRS_ZENABLE,                  true);
+    m_captures.renderStates.set(D3DRS_FILLMODE,                 true);
+    m_captures.renderStates.set(D3DRS_SHADEMODE,                true);
+    m_captures.renderStates.set(D3DRS_ZWRITEENABLE,             true);
+    m_captures.renderStates.set(D3DRS_ALPHATESTENABLE,          true);
+    m_captures.renderStates.set(D3DRS_LASTPIXEL,                true);
+    m_captures.renderStates.set(D3DRS_SRCBLEND,                 true);
+    m_captures.renderStates.set(D3DRS_DESTBLEND,                true);
+    m_captures.renderStates.set(D3DRS_ZFUNC,                    true);
+    m_captures.renderStates.set(D3DRS_ALPHAREF,                 true);
+    m_captures.renderStates.set(D3DRS_ALPHAFUNC,                true);
+    m_captures.renderStates.set(D3DRS_DITHERENABLE,             true);
+    m_captures.renderStates.set(D3DRS_FOGSTART,                 true);
+    m_captures.renderStates.set(D3DRS_FOGEND,                   true);
+    m_captures.renderStates.set(D3DRS_FOGDENSITY,               true);
+    m_captures.renderStates.set(D3DRS_ALPHABLENDENABLE,         true);
+    m_captures.renderStates.set(D3DRS_DEPTHBIAS,                true);
+    m_captures.renderStates.set(D3DRS_STENCILENABLE,            true);
+    m_captures.renderStates.set(D3DRS_STENCILFAIL,              true);
+    m_captures.renderStates.set(D3DRS_STENCILZFAIL,             true);
+    m_captures.renderStates.set(D3DRS_STENCILPASS,              true);
+    m_captures.renderStates.set(D3DRS_STENCILFUNC,              true);
+    m_captures.renderStates.set(D3DRS_STENCILREF,               true);
+    m_captures.renderStates.set(D3DRS_STENCILMASK,              true);
+    m_captures.renderStates.set(D3DRS_STENCILWRITEMASK,         true);
+    m_captures.renderStates.set(D3DRS_TEXTUREFACTOR,            true);
+    m_captures.renderStates.set(D3DRS_WRAP0,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP1,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP2,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP3,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP4,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP5,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP6,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP7,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP8,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP9,                    true);
+    m_captures.renderStates.set(D3DRS_WRAP10,                   true);
+    m_captures.renderStates.set(D3DRS_WRAP11,                   true);
+    m_captures.renderStates.set(D3DRS_WRAP12,                   true);
+    m_captures.renderStates.set(D3DRS_WRAP13,                   true);
+    m_captures.renderStates.set(D3DRS_WRAP14,                   true);
+    m_captures.renderStates.set(D3DRS_WRAP15,                   true);
+    m_captures.renderStates.set(D3DRS_COLORWRITEENABLE,         true);
+    m_captures.renderStates.set(D3DRS_BLENDOP,                  true);
+    m_captures.renderStates.set(D3DRS_SCISSORTESTENABLE,        true);
+    m_captures.renderStates.set(D3DRS_SLOPESCALEDEPTHBIAS,      true);
+    m_captures.renderStates.set(D3DRS_ANTIALIASEDLINEENABLE,    true);
+    m_captures.renderStates.set(D3DRS_TWOSIDEDSTENCILMODE,      true);
+    m_captures.renderStates.set(D3DRS_CCW_STENCILFAIL,          true);
+    m_captures.renderStates.set(D3DRS_CCW_STENCILZFAIL,         true);
+    m_captures.renderStates.set(D3DRS_CCW_STENCILPASS,          true);
+    m_captures.renderStates.set(D3DRS_CCW_STENCILFUNC,          true);
+    m_captures.renderStates.set(D3DRS_COLORWRITEENABLE1,        true);
+    m_captures.renderStates.set(D3DRS_COLORWRITEENABLE2,        true);
+    m_captures.renderStates.set(D3DRS_COLORWRITEENABLE3,        true);
+    m_captures.renderStates.set(D3DRS_BLENDFACTOR,              true);
+    m_captures.renderStates.set(D3DRS_SRGBWRITEENABLE,          true);
+    m_captures.renderStates.set(D3DRS_SEPARATEALPHABLENDENABLE, true);
+    m_captures.renderStates.set(D3DRS_SRCBLENDALPHA,            true);
+    m_captures.renderStates.set(D3DRS_DESTBLENDALPHA,           true);
+    m_captures.renderStates.set(D3DRS_BLENDOPALPHA,             true);
   }
 
 
@@ -367,20 +367,20 @@ namespace dxvk {
     m_captures.flags.set(D3D9CapturedStateFlag::SamplerStates);
 
     for (uint32_t i = 0; i < 17; i++) {
-      m_captures.samplers[i] = true;
-
-      m_captures.samplerStates[i][D3DSAMP_ADDRESSU]      = true;
-      m_captures.samplerStates[i][D3DSAMP_ADDRESSV]      = true;
-      m_captures.samplerStates[i][D3DSAMP_ADDRESSW]      = true;
-      m_captures.samplerStates[i][D3DSAMP_BORDERCOLOR]   = true;
-      m_captures.samplerStates[i][D3DSAMP_MAGFILTER]     = true;
-      m_captures.samplerStates[i][D3DSAMP_MINFILTER]     = true;
-      m_captures.samplerStates[i][D3DSAMP_MIPFILTER]     = true;
-      m_captures.samplerStates[i][D3DSAMP_MIPMAPLODBIAS] = true;
-      m_captures.samplerStates[i][D3DSAMP_MAXMIPLEVEL]   = true;
-      m_captures.samplerStates[i][D3DSAMP_MAXANISOTROPY] = true;
-      m_captures.samplerStates[i][D3DSAMP_SRGBTEXTURE]   = true;
-      m_captures.samplerStates[i][D3DSAMP_ELEMENTINDEX]  = true;
+      m_captures.samplers.set(i, true);
+
+      m_captures.samplerStates[i].set(D3DSAMP_ADDRESSU,      true);
+      m_captures.samplerStates[i].set(D3DSAMP_ADDRESSV,      true);
+      m_captures.samplerStates[i].set(D3DSAMP_ADDRESSW,      true);
+      m_captures.samplerStates[i].set(D3DSAMP_BORDERCOLOR,   true);
+      m_captures.samplerStates[i].set(D3DSAMP_MAGFILTER,     true);
+      m_captures.samplerStates[i].set(D3DSAMP_MINFILTER,     true);
+      m_captures.samplerStates[i].set(D3DSAMP_MIPFILTER,     true);
+      m_captures.samplerStates[i].set(D3DSAMP_MIPMAPLODBIAS, true);
+      m_captures.samplerStates[i].set(D3DSAMP_MAXMIPLEVEL,   true);
+      m_captures.samplerStates[i].set(D3DSAMP_MAXANISOTROPY, true);
+      m_captures.samplerStates[i].set(D3DSAMP_SRGBTEXTURE,   true);
+      m_captures.samplerStates[i].set(D3DSAMP_ELEMENTINDEX,  true);
     }
   }
 
@@ -389,60 +389,60 @@ namespace dxvk {
     m_captures.flags.set(D3D9CapturedStateFlag::PixelShader);
     m_captures.flags.set(D3D9CapturedStateFlag::PsConstants);
 
-    m_captures.psConsts.fConsts.flip();
-    m_captures.psConsts.iConsts.flip();
-    m_captures.psConsts.bConsts.flip();
+    m_captures.psConsts.fConsts.setAll();
+    m_captures.psConsts.iConsts.setAll();
+    m_captures.psConsts.bConsts.setAll();
   }
 
 
   void D3D9StateBlock::CaptureVertexRenderStates() {
     m_captures.flags.set(D3D9CapturedStateFlag::RenderStates);
 
-    m_captures.renderStates[D3DRS_CULLMODE]                   = true;
-    m_captures.renderStates[D3DRS_FOGENABLE]                  = true;
-    m_captures.renderStates[D3DRS_FOGCOLOR]                   = true;
-    m_captures.renderStates[D3DRS_FOGTABLEMODE]               = true;
-    m_captures.renderStates[D3DRS_FOGSTART]                   = true;
-    m_captures.renderStates[D3DRS_FOGEND]                     = true;
-    m_captures.renderStates[D3DRS_FOGDENSITY]                 = true;
-    m_captures.renderStates[D3DRS_RANGEFOGENABLE]             = true;
-    m_captures.renderStates[D3DRS_AMBIENT]                    = true;
-    m_captures.renderStates[D3DRS_COLORVERTEX]                = true;
-    m_captures.renderStates[D3DRS_FOGVERTEXMODE]              = true;
-    m_captures.renderStates[D3DRS_CLIPPING]                   = true;
-    m_captures.renderStates[D3DRS_LIGHTING]                   = true;
-    m_captures.renderStates[D3DRS_LOCALVIEWER]                = true;
-    m_captures.renderStates[D3DRS_EMISSIVEMATERIALSOURCE]     = true;
-    m_captures.renderStates[D3DRS_AMBIENTMATERIALSOURCE]      = true;
-    m_captures.renderStates[D3DRS_DIFFUSEMATERIALSOURCE]      = true;
-    m_captures.renderStates[D3DRS_SPECULARMATERIALSOURCE]     = true;
-    m_captures.renderStates[D3DRS_VERTEXBLEND]                = true;
-    m_captures.renderStates[D3DRS_CLIPPLANEENABLE]            = true;
-    m_captures.renderStates[D3DRS_POINTSIZE]                  = true;
-    m_captures.renderStates[D3DRS_POINTSIZE_MIN]              = true;
-    m_captures.renderStates[D3DRS_POINTSPRITEENABLE]          = true;
-    m_captures.renderStates[D3DRS_POINTSCALEENABLE]           = true;
-    m_captures.renderStates[D3DRS_POINTSCALE_A]               = true;
-    m_captures.renderStates[D3DRS_POINTSCALE_B]               = true;
-    m_captures.renderStates[D3DRS_POINTSCALE_C]               = true;
-    m_captures.renderStates[D3DRS_MULTISAMPLEANTIALIAS]       = true;
-    m_captures.renderStates[D3DRS_MULTISAMPLEMASK]            = true;
-    m_captures.renderStates[D3DRS_PATCHEDGESTYLE]             = true;
-    m_captures.renderStates[D3DRS_POINTSIZE_MAX]              = true;
-    m_captures.renderStates[D3DRS_INDEXEDVERTEXBLENDENABLE]   = true;
-    m_captures.renderStates[D3DRS_TWEENFACTOR]                = true;
-    m_captures.renderStates[D3DRS_POSITIONDEGREE]             = true;
-    m_captures.renderStates[D3DRS_NORMALDEGREE]               = true;
-    m_captures.renderStates[D3DRS_MINTESSELLATIONLEVEL]       = true;
-    m_captures.renderStates[D3DRS_MAXTESSELLATIONLEVEL]       = true;
-    m_captures.renderStates[D3DRS_ADAPTIVETESS_X]             = true;
-    m_captures.renderStates[D3DRS_ADAPTIVETESS_Y]             = true;
-    m_captures.renderStates[D3DRS_ADAPTIVETESS_Z]             = true;
-    m_captures.renderStates[D3DRS_ADAPTIVETESS_W]             = true;
-    m_captures.renderStates[D3DRS_ENABLEADAPTIVETESSELLATION] = true;
-    m_captures.renderStates[D3DRS_NORMALIZENORMALS]           = true;
-    m_captures.renderStates[D3DRS_SPECULARENABLE]             = true;
-    m_captures.renderStates[D3DRS_SHADEMODE]                  = true;
+    m_captures.renderStates.set(D3DRS_CULLMODE,                   true);
+    m_captures.renderStates.set(D3DRS_FOGENABLE,                  true);
+    m_captures.renderStates.set(D3DRS_FOGCOLOR,                   true);
+    m_captures.renderStates.set(D3DRS_FOGTABLEMODE,               true);
+    m_captures.renderStates.set(D3DRS_FOGSTART,                   true);
+    m_captures.renderStates.set(D3DRS_FOGEND,                     true);
+    m_captures.renderStates.set(D3DRS_FOGDENSITY,                 true);
+    m_captures.renderStates.set(D3DRS_RANGEFOGENABLE,             true);
+    m_captures.renderStates.set(D3DRS_AMBIENT,                    true);
+    m_captures.renderStates.set(D3DRS_COLORVERTEX,                true);
+    m_captures.renderStates.set(D3DRS_FOGVERTEXMODE,              true);
+    m_captures.renderStates.set(D3DRS_CLIPPING,                   true);
+    m_captures.renderStates.set(D3DRS_LIGHTING,                   true);
+    m_captures.renderStates.set(D3DRS_LOCALVIEWER,                true);
+    m_captures.renderStates.set(D3DRS_EMISSIVEMATERIALSOURCE,     true);
+    m_captures.renderStates.set(D3DRS_AMBIENTMATERIALSOURCE,      true);
+    m_captures.renderStates.set(D3DRS_DIFFUSEMATERIALSOURCE,      true);
+    m_captures.renderStates.set(D3DRS_SPECULARMATERIALSOURCE,     true);
+    m_captures.renderStates.set(D3DRS_VERTEXBLEND,                true);
+    m_captures.renderStates.set(D3DRS_CLIPPLANEENABLE,            true);
+    m_captures.renderStates.set(D3DRS_POINTSIZE,                  true);
+    m_captures.renderStates.set(D3DRS_POINTSIZE_MIN,              true);
+    m_captures.renderStates.set(D3DRS_POINTSPRITEENABLE,          true);
+    m_captures.renderStates.set(D3DRS_POINTSCALEENABLE,           true);
+    m_captures.renderStates.set(D3DRS_POINTSCALE_A,               true);
+    m_captures.renderStates.set(D3DRS_POINTSCALE_B,               true);
+    m_captures.renderStates.set(D3DRS_POINTSCALE_C,               true);
+    m_captures.renderStates.set(D3DRS_MULTISAMPLEANTIALIAS,       true);
+    m_captures.renderStates.set(D3DRS_MULTISAMPLEMASK,            true);
+    m_captures.renderStates.set(D3DRS_PATCHEDGESTYLE,             true);
+    m_captures.renderStates.set(D3DRS_POINTSIZE_MAX,              true);
+    m_captures.renderStates.set(D3DRS_INDEXEDVERTEXBLENDENABLE,   true);
+    m_captures.renderStates.set(D3DRS_TWEENFACTOR,                true);
+    m_captures.renderStates.set(D3DRS_POSITIONDEGREE,             true);
+    m_captures.renderStates.set(D3DRS_NORMALDEGREE,               true);
+    m_captures.renderStates.set(D3DRS_MINTESSELLATIONLEVEL,       true);
+    m_captures.renderStates.set(D3DRS_MAXTESSELLATIONLEVEL,       true);
+    m_captures.renderStates.set(D3DRS_ADAPTIVETESS_X,             true);
+    m_captures.renderStates.set(D3DRS_ADAPTIVETESS_Y,             true);
+    m_captures.renderStates.set(D3DRS_ADAPTIVETESS_Z,             true);
+    m_captures.renderStates.set(D3DRS_ADAPTIVETESS_W,             true);
+    m_captures.renderStates.set(D3DRS_ENABLEADAPTIVETESSELLATION, true);
+    m_captures.renderStates.set(D3DRS_NORMALIZENORMALS,           true);
+    m_captures.renderStates.set(D3DRS_SPECULARENABLE,             true);
+    m_captures.renderStates.set(D3DRS_SHADEMODE,                  true);
   }
 
 
@@ -450,8 +450,8 @@ namespace dxvk {
     m_captures.flags.set(D3D9CapturedStateFlag::SamplerStates);
 
     for (uint32_t i = 17; i < SamplerCount; i++) {
-      m_captures.samplers[i] = true;
-      m_captures.samplerStates[i][D3DSAMP_DMAPOFFSET] = true;
+      m_captures.samplers.set(i, true);
+      m_captures.samplerStates[i].set(D3DSAMP_DMAPOFFSET, true);
     }
   }
 
@@ -460,9 +460,9 @@ namespace dxvk {
     m_captures.flags.set(D3D9CapturedStateFlag::VertexShader);
     m_captures.flags.set(D3D9CapturedStateFlag::VsConstants);
 
-    m_captures.vsConsts.fConsts.flip();
-    m_captures.vsConsts.iConsts.flip();
-    m_captures.vsConsts.bConsts.flip();
+    m_captures.vsConsts.fConsts.setAll();
+    m_captures.vsConsts.iConsts.setAll();
+    m_captures.vsConsts.bConsts.setAll();
   }
 
 
@@ -473,9 +473,9 @@ namespace dxvk {
       CapturePixelShaderStates();
 
       m_captures.flags.set(D3D9CapturedStateFlag::TextureStages);
-      m_captures.textureStages.flip();
+      m_captures.textureStages.setAll();
       for (auto& stage : m_captures.textureStageStates)
-        stage.flip();
+        stage.setAll();
     }
 
     if (Type == D3D9StateBlockType::VertexState || Type == D3D9StateBlockType::All) {
@@ -487,25 +487,25 @@ namespace dxvk {
       m_captures.flags.set(D3D9CapturedStateFlag::StreamFreq);
 
       for (uint32_t i = 0; i < caps::MaxStreams; i++)
-        m_captures.streamFreq[i] = true;
+        m_captures.streamFreq.set(i, true);
     }
 
     if (Type == D3D9StateBlockType::All) {
       m_captures.flags.set(D3D9CapturedStateFlag::Textures);
-      m_captures.textures.flip();
+      m_captures.textures.setAll();
 
       m_captures.flags.set(D3D9CapturedStateFlag::VertexBuffers);
-      m_captures.vertexBuffers.flip();
+      m_captures.vertexBuffers.setAll();
 
       m_captures.flags.set(D3D9CapturedStateFlag::Indices);
       m_captures.flags.set(D3D9CapturedStateFlag::Viewport);
       m_captures.flags.set(D3D9CapturedStateFlag::ScissorRect);
 
       m_captures.flags.set(D3D9CapturedStateFlag::ClipPlanes);
-      m_captures.clipPlanes.flip();
+      m_captures.clipPlanes.setAll();
 
       m_captures.flags.set(D3D9CapturedStateFlag::Transforms);
-      m_captures.transforms.flip();
+      m_captures.transforms.setAll();
 
       m_captures.flags.set(D3D9CapturedStateFlag::Material);
     }
@@ -114,60 +114,64 @@ namespace dxvk {
       Capture
     };
 
+    /**
+     * \brief Applies or captures state
+     *
+     * \param [in] dst Object to write state to
+     * \param [in] src State to read from
+     * \param [in] cur Current state of \c dst. If not
+     *    \c nullptr, values which are already set in the
+     *    destination state will not be written again.
+     */
     template <typename Dst, typename Src>
-    void ApplyOrCapture(Dst* dst, const Src* src) {
+    void ApplyOrCapture(Dst* dst, const Src* src, const D3D9CapturableState* cur) {
       if (m_captures.flags.test(D3D9CapturedStateFlag::VertexDecl))
         dst->SetVertexDeclaration(src->vertexDecl);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::StreamFreq)) {
-        for (uint32_t i = 0; i < caps::MaxStreams; i++) {
-          if (m_captures.streamFreq[i])
-            dst->SetStreamSourceFreq(i, src->streamFreq[i]);
-        }
+        ForEachBit(m_captures.streamFreq, [&] (uint32_t idx) {
+          dst->SetStreamSourceFreq(idx, src->streamFreq[idx]);
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Indices))
         dst->SetIndices(src->indices);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::RenderStates)) {
-        for (uint32_t i = 0; i < m_captures.renderStates.size(); i++) {
-          if (m_captures.renderStates[i])
-            dst->SetRenderState(D3DRENDERSTATETYPE(i), src->renderStates[i]);
-        }
+        ForEachBit(m_captures.renderStates, [&] (uint32_t idx) {
+          if (!cur || cur->renderStates[idx] != src->renderStates[idx])
+            dst->SetRenderState(D3DRENDERSTATETYPE(idx), src->renderStates[idx]);
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::SamplerStates)) {
-        for (uint32_t i = 0; i < m_captures.samplerStates.size(); i++) {
-          if (m_captures.samplers[i]) {
-            for (uint32_t j = 0; j < m_captures.samplerStates[i].size(); j++) {
-              if (m_captures.samplerStates[i][j])
-                dst->SetStateSamplerState(i, D3DSAMPLERSTATETYPE(j), src->samplerStates[i][j]);
-            }
-          }
-        }
+        ForEachBit(m_captures.samplers, [&] (uint32_t i) {
+          ForEachBit(m_captures.samplerStates[i], [&] (uint32_t j) {
+            if (!cur || cur->samplerStates[i][j] != src->samplerStates[i][j])
+              dst->SetStateSamplerState(i, D3DSAMPLERSTATETYPE(j), src->samplerStates[i][j]);
+          });
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VertexBuffers)) {
-        for (uint32_t i = 0; i < m_captures.vertexBuffers.size(); i++) {
-          if (m_captures.vertexBuffers[i]) {
-            const auto& vbo = src->vertexBuffers[i];
-            dst->SetStreamSource(
-              i,
-              vbo.vertexBuffer,
-              vbo.offset,
-              vbo.stride);
-          }
-        }
+        ForEachBit(m_captures.vertexBuffers, [&] (uint32_t idx) {
+          const auto& vbo = src->vertexBuffers[idx];
+          dst->SetStreamSource(
+            idx,
+            vbo.vertexBuffer,
+            vbo.offset,
+            vbo.stride);
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Material))
         dst->SetMaterial(&src->material);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Textures)) {
-        for (uint32_t i = 0; i < m_captures.textures.size(); i++) {
-          if (m_captures.textures[i])
-            dst->SetStateTexture(i, src->textures[i]);
-        }
+        ForEachBit(m_captures.textures, [&] (uint32_t idx) {
+          if (!cur || cur->textures[idx] != src->textures[idx])
+            dst->SetStateTexture(idx, src->textures[idx]);
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VertexShader))
@@ -177,21 +181,19 @@ namespace dxvk {
         dst->SetPixelShader(src->pixelShader);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Transforms)) {
-        for (uint32_t i = 0; i < m_captures.transforms.size(); i++) {
-          if (m_captures.transforms[i])
-            dst->SetStateTransform(i, reinterpret_cast<const D3DMATRIX*>(&src->transforms[i]));
-        }
+        ForEachBit(m_captures.transforms, [&] (uint32_t idx) {
+          if (!cur || std::memcmp(&cur->transforms[idx], &src->transforms[idx], sizeof(Matrix4)))
+            dst->SetStateTransform(idx, reinterpret_cast<const D3DMATRIX*>(&src->transforms[idx]));
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::TextureStages)) {
-        for (uint32_t i = 0; i < m_captures.textureStages.size(); i++) {
-          if (m_captures.textureStages[i]) {
-            for (uint32_t j = 0; j < m_captures.textureStageStates[i].size(); j++) {
-              if (m_captures.textureStageStates[i][j])
-                dst->SetTextureStageState(i, (D3DTEXTURESTAGESTATETYPE)j, src->textureStages[i][j]);
-            }
-          }
-        }
+        ForEachBit(m_captures.textureStages, [&] (uint32_t i) {
+          ForEachBit(m_captures.textureStageStates[i], [&] (uint32_t j) {
+            if (!cur || cur->textureStages[i][j] != src->textureStages[i][j])
+              dst->SetTextureStageState(i, (D3DTEXTURESTAGESTATETYPE)j, src->textureStages[i][j]);
+          });
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Viewport))
@@ -201,62 +203,57 @@ namespace dxvk {
         dst->SetScissorRect(&src->scissorRect);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::ClipPlanes)) {
-        for (uint32_t i = 0; i < m_captures.clipPlanes.size(); i++) {
-          if (m_captures.clipPlanes[i])
-            dst->SetClipPlane(i, src->clipPlanes[i].coeff);
-        }
+        ForEachBit(m_captures.clipPlanes, [&] (uint32_t idx) {
+          dst->SetClipPlane(idx, src->clipPlanes[idx].coeff);
+        });
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VsConstants)) {
-        for (uint32_t i = 0; i < m_captures.vsConsts.fConsts.size(); i++) {
-          if (m_captures.vsConsts.fConsts[i])
-            dst->SetVertexShaderConstantF(i, (float*)&src->vsConsts.fConsts[i], 1);
-        }
+        ForEachBitRange(m_captures.vsConsts.fConsts, [&] (uint32_t start, uint32_t count) {
+          if (!cur || std::memcmp(&cur->vsConsts.fConsts[start], &src->vsConsts.fConsts[start], count * sizeof(Vector4)))
+            dst->SetVertexShaderConstantF(start, (float*)&src->vsConsts.fConsts[start], count);
+        });
 
-        for (uint32_t i = 0; i < m_captures.vsConsts.iConsts.size(); i++) {
-          if (m_captures.vsConsts.iConsts[i])
-            dst->SetVertexShaderConstantI(i, (int*)&src->vsConsts.iConsts[i], 1);
-        }
+        ForEachBitRange(m_captures.vsConsts.iConsts, [&] (uint32_t start, uint32_t count) {
+          if (!cur || std::memcmp(&cur->vsConsts.iConsts[start], &src->vsConsts.iConsts[start], count * sizeof(Vector4i)))
+            dst->SetVertexShaderConstantI(start, (int*)&src->vsConsts.iConsts[start], count);
+        });
 
         const uint32_t bitfieldCount = m_parent->GetVertexConstantLayout().bitmaskCount;
         for (uint32_t i = 0; i < bitfieldCount; i++) {
-          uint32_t boolMask = 0;
-          for (uint32_t j = 0; j < 32; j++) {
-            if (m_captures.vsConsts.bConsts[i * 32 + j])
-              boolMask |= 1u << j;
-          }
+          uint32_t boolMask = m_captures.vsConsts.bConsts.dword(i);
 
-          dst->SetVertexBoolBitfield(i, boolMask, src->vsConsts.bConsts[i]);
+          if (boolMask && (!cur || ((cur->vsConsts.bConsts[i] ^ src->vsConsts.bConsts[i]) & boolMask)))
+            dst->SetVertexBoolBitfield(i, boolMask, src->vsConsts.bConsts[i]);
         }
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::PsConstants)) {
-        for (uint32_t i = 0; i < m_captures.psConsts.fConsts.size(); i++) {
-          if (m_captures.psConsts.fConsts[i])
-            dst->SetPixelShaderConstantF(i, (float*)&src->psConsts.fConsts[i], 1);
-        }
+        ForEachBitRange(m_captures.psConsts.fConsts, [&] (uint32_t start, uint32_t count) {
+          if (!cur || std::memcmp(&cur->psConsts.fConsts[start], &src->psConsts.fConsts[start], count * sizeof(Vector4)))
+            dst->SetPixelShaderConstantF(start, (float*)&src->psConsts.fConsts[start], count);
+        });
 
-        for (uint32_t i = 0; i < m_captures.psConsts.iConsts.size(); i++) {
-          if (m_captures.psConsts.iConsts[i])
-            dst->SetPixelShaderConstantI(i, (int*)&src->psConsts.iConsts[i], 1);
-        }
+        ForEachBitRange(m_captures.psConsts.iConsts, [&] (uint32_t start, uint32_t count) {
+          if (!cur || std::memcmp(&cur->psConsts.iConsts[start], &src->psConsts.iConsts[start], count * sizeof(Vector4i)))
+            dst->SetPixelShaderConstantI(start, (int*)&src->psConsts.iConsts[start], count);
+        });
 
-        uint32_t boolMask = 0;
-        for (uint32_t i = 0; i < m_captures.psConsts.bConsts.size(); i++) {
-          if (m_captures.psConsts.bConsts[i])
-            boolMask |= 1u << i;
-        }
+        uint32_t boolMask = m_captures.psConsts.bConsts.dword(0);
 
-        dst->SetPixelBoolBitfield(0, boolMask, src->psConsts.bConsts[0]);
+        if (boolMask && (!cur || ((cur->psConsts.bConsts[0] ^ src->psConsts.bConsts[0]) & boolMask)))
+          dst->SetPixelBoolBitfield(0, boolMask, src->psConsts.bConsts[0]);
       }
     }
 
     template <D3D9StateFunction Func>
     void ApplyOrCapture() {
+      // Redundant writes can only be skipped when applying to the
+      // device directly, not when recording into another state block
       if      constexpr (Func == D3D9StateFunction::Apply)
-        ApplyOrCapture(m_parent, &m_state);
+        ApplyOrCapture(m_parent, &m_state, m_parent->ShouldRecord() ? nullptr : m_deviceState);
       else if constexpr (Func == D3D9StateFunction::Capture)
-        ApplyOrCapture(this, m_deviceState);
+        ApplyOrCapture(this, m_deviceState, &m_state);
     }
 
     template <
@@ -276,11 +273,11 @@ namespace dxvk {
         for (uint32_t i = 0; i < Count; i++) {
           uint32_t reg = StartRegister + i;
           if      constexpr (ConstantType == D3D9ConstantType::Float)
-            setCaptures.fConsts[reg] = true;
+            setCaptures.fConsts.set(reg, true);
           else if constexpr (ConstantType == D3D9ConstantType::Int)
-            setCaptures.iConsts[reg] = true;
+            setCaptures.iConsts.set(reg, true);
           else if constexpr (ConstantType == D3D9ConstantType::Bool)
-            setCaptures.bConsts[reg] = true;
+            setCaptures.bConsts.set(reg, true);
         }
 
         UpdateStateConstants<
@@ -310,6 +307,63 @@ namespace dxvk {
 
   private:
 
+    /**
+     * \brief Calls a function for each set bit
+     *
+     * \param [in] bits Bit set
+     * \param [in] fn Function taking the bit index
+     */
+    template <size_t N, typename Fn>
+    static void ForEachBit(const bit::bitset<N>& bits, Fn&& fn) {
+      for (uint32_t i = 0; i < bits.dwordCount(); i++) {
+        uint32_t mask = bits.dword(i);
+
+        while (mask) {
+          fn(i * 32 + bit::tzcnt(mask));
+          mask &= mask - 1;
+        }
+      }
+    }
+
+    /**
+     * \brief Calls a function for each run of set bits
+     *
+     * Used to apply contiguous shader constant
+     * registers with a single call.
+     * \param [in] bits Bit set
+     * \param [in] fn Function taking the first
+     *    index and the length of the run
+     */
+    template <size_t N, typename Fn>
+    static void ForEachBitRange(const bit::bitset<N>& bits, Fn&& fn) {
+      uint32_t start = 0;
+      uint32_t count = 0;
+
+      for (uint32_t i = 0; i < bits.dwordCount(); i++) {
+        uint32_t mask = bits.dword(i);
+
+        while (mask) {
+          uint32_t idx = bit::tzcnt(mask);
+          uint32_t len = bit::tzcnt(~(mask >> idx));
+
+          if (count && start + count == i * 32 + idx) {
+            count += len;
+          } else {
+            if (count)
+              fn(start, count);
+
+            start = i * 32 + idx;
+            count = len;
+          }
+
+          mask = idx + len < 32 ? mask & (~0u << (idx + len)) : 0u;
+        }
+      }
+
+      if (count)
+        fn(start, count);
+    }
+
     void CapturePixelRenderStates();
     void CapturePixelSamplerStates();
     void CapturePixelShaderStates();
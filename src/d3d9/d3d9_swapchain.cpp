@@ -94,6 +94,8 @@ namespace dxvk {
           DWORD    dwFlags) {
     auto lock = m_parent->LockDevice();
 
+    TraceScope trace("app", "Present");
+
     uint32_t presentInterval = m_presentParams.PresentationInterval;
 
     // This is not true directly in d3d9 to to timing differences that don't matter for us.
@@ -850,8 +852,13 @@ namespace dxvk {
   void D3D9SwapChainEx::CreateHud() {
     m_hud = hud::Hud::createHud(m_device);
 
-    if (m_hud != nullptr)
+    if (m_hud != nullptr) {
       m_hud->addItem<hud::HudSamplerCount>("samplers", m_parent);
+      m_hud->addItem<hud::HudShaderTranslation>("shaderqueue", m_parent);
+      m_hud->addItem<hud::HudDeviceLock>("devicelock", m_parent);
+      m_hud->addItem<hud::HudBufferArena>("bufferarena", m_parent);
+      m_hud->addItem<hud::HudReadback>("readback", m_parent);
+    }
   }
 
 
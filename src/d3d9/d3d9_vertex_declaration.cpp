@@ -6,6 +6,38 @@
 
 namespace dxvk {
 
+  bool D3D9InputLayoutKey::eq(const D3D9InputLayoutKey& other) const {
+    if (semanticCount != other.semanticCount)
+      return false;
+
+    for (uint32_t i = 0; i < semanticCount; i++) {
+      if (semantics[i] != other.semantics[i])
+        return false;
+    }
+
+    for (uint32_t i = 0; i < caps::MaxStreams; i++) {
+      if (instanceFreq[i] != other.instanceFreq[i])
+        return false;
+    }
+
+    return true;
+  }
+
+
+  size_t D3D9InputLayoutKey::hash() const {
+    DxvkHashState hash;
+    hash.add(semanticCount);
+
+    for (uint32_t i = 0; i < semanticCount; i++)
+      hash.add(semantics[i]);
+
+    for (uint32_t i = 0; i < caps::MaxStreams; i++)
+      hash.add(instanceFreq[i]);
+
+    return hash;
+  }
+
+
   D3D9VertexDecl::D3D9VertexDecl(
           D3D9DeviceEx*      pDevice,
           DWORD              FVF)
@@ -66,6 +98,23 @@ namespace dxvk {
   }
 
 
+  const D3D9InputLayout* D3D9VertexDecl::FindInputLayout(
+    const D3D9InputLayoutKey& Key) const {
+    auto entry = m_inputLayouts.find(Key);
+
+    return entry != m_inputLayouts.end()
+      ? &entry->second
+      : nullptr;
+  }
+
+
+  const D3D9InputLayout& D3D9VertexDecl::AddInputLayout(
+    const D3D9InputLayoutKey& Key,
+    const D3D9InputLayout&    Layout) {
+    return m_inputLayouts.emplace(Key, Layout).first->second;
+  }
+
+
   void D3D9VertexDecl::SetFVF(DWORD FVF) {
     m_fvf = FVF;
 
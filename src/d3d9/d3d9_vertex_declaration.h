@@ -2,6 +2,7 @@
 
 #include "d3d9_device_child.h"
 
+#include <unordered_map>
 #include <vector>
 
 namespace dxvk {
@@ -17,6 +18,39 @@ namespace dxvk {
   };
   using D3D9VertexDeclFlags = Flags<D3D9VertexDeclFlag>;
 
+  /**
+   * \brief Input layout key
+   *
+   * Stores the semantics of the shader input signature,
+   * packed as one word per input register, as well as
+   * the frequency of every instanced stream. Together
+   * with the vertex declaration, this fully determines
+   * the input layout.
+   */
+  struct D3D9InputLayoutKey {
+    uint32_t                                                  semanticCount = 0;
+    std::array<uint16_t, 2 * DxsoMaxInterfaceRegs>            semantics     = { };
+    std::array<uint32_t, caps::MaxStreams>                    instanceFreq  = { };
+
+    bool eq(const D3D9InputLayoutKey& other) const;
+
+    size_t hash() const;
+  };
+
+  /**
+   * \brief Input layout
+   *
+   * Compacted attribute and binding lists,
+   * ready to be passed to the context.
+   */
+  struct D3D9InputLayout {
+    uint32_t                                                  attrCount   = 0;
+    uint32_t                                                  bindCount   = 0;
+    uint32_t                                                  streamsUsed = 0;
+    std::array<DxvkVertexAttribute, 2 * caps::InputRegisterCount> attrs;
+    std::array<DxvkVertexBinding,   2 * caps::InputRegisterCount> binds;
+  };
+
   using D3D9VertexDeclBase = D3D9DeviceChild<IDirect3DVertexDeclaration9>;
   class D3D9VertexDecl final : public D3D9VertexDeclBase {
 
@@ -65,6 +99,28 @@ namespace dxvk {
       return m_texcoordMask;
     }
 
+    /**
+     * \brief Looks up a cached input layout
+     *
+     * Must only be called from the CS thread.
+     * \param [in] Key Input layout key
+     * \returns The input layout, or \c nullptr
+     */
+    const D3D9InputLayout* FindInputLayout(
+      const D3D9InputLayoutKey& Key) const;
+
+    /**
+     * \brief Adds an input layout to the cache
+     *
+     * Must only be called from the CS thread.
+     * \param [in] Key Input layout key
+     * \param [in] Layout The input layout
+     * \returns Reference to the cached layout
+     */
+    const D3D9InputLayout& AddInputLayout(
+      const D3D9InputLayoutKey& Key,
+      const D3D9InputLayout&    Layout);
+
   private:
 
     void Classify();
@@ -77,6 +133,11 @@ namespace dxvk {
 
     uint32_t                       m_texcoordMask = 0;
 
+    std::unordered_map<
+      D3D9InputLayoutKey,
+      D3D9InputLayout,
+      DxvkHash, DxvkEq>            m_inputLayouts;
+
   };
 
 }
\ No newline at end of file
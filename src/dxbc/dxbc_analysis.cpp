@@ -27,6 +27,12 @@ namespace dxvk {
   
   
   void DxbcAnalyzer::processInstruction(const DxbcShaderInstruction& ins) {
+    for (uint32_t i = 0; i < ins.dstCount; i++)
+      analyzeOperand(ins.dst[i]);
+    
+    for (uint32_t i = 0; i < ins.srcCount; i++)
+      analyzeOperand(ins.src[i]);
+    
     switch (ins.opClass) {
       case DxbcInstClass::Atomic: {
         const uint32_t operandId = ins.dstCount - 1;
@@ -75,4 +81,31 @@ namespace dxvk {
     return result;
   }
   
+  
+  void DxbcAnalyzer::analyzeOperand(const DxbcRegister& reg) {
+    // Relative indices may themselves be indexed
+    for (uint32_t i = 0; i < reg.idxDim; i++) {
+      if (reg.idx[i].relReg != nullptr)
+        analyzeOperand(*reg.idx[i].relReg);
+    }
+    
+    if (reg.type != DxbcOperandType::IndexableTemp)
+      return;
+    
+    // x# regs are indexed as follows:
+    //    (0) register index (immediate)
+    //    (1) element index (relative)
+    const uint32_t regId = reg.idx[0].offset;
+    
+    if (regId >= m_analysis->xRegInfos.size())
+      m_analysis->xRegInfos.resize(regId + 1);
+    
+    auto& info = m_analysis->xRegInfos[regId];
+    
+    if (reg.idx[1].relReg != nullptr || reg.idx[1].offset < 0)
+      info.relativeIndex = true;
+    else
+      info.maxIndex = std::max(info.maxIndex, uint32_t(reg.idx[1].offset));
+  }
+  
 }
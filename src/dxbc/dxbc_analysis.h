@@ -29,11 +29,24 @@ namespace dxvk {
     uint32_t numCullPlanes = 0;
   };
   
+  /**
+   * \brief Info about indexable temporaries
+   * 
+   * Stores how an \c x# array is indexed. Arrays
+   * that are only ever accessed with immediate
+   * indices can be lowered to plain temporaries.
+   */
+  struct DxbcXregInfo {
+    bool     relativeIndex = false;
+    uint32_t maxIndex      = 0;
+  };
+  
   /**
    * \brief Shader analysis info
    */
   struct DxbcAnalysisInfo {
     std::array<DxbcUavInfo, 64> uavInfos;
+    std::vector<DxbcXregInfo>   xRegInfos;
     
     DxbcClipCullInfo clipCullIn;
     DxbcClipCullInfo clipCullOut;
@@ -81,6 +94,9 @@ namespace dxvk {
     DxbcClipCullInfo getClipCullInfo(
       const Rc<DxbcIsgn>& sgn) const;
     
+    void analyzeOperand(
+      const DxbcRegister&       reg);
+    
   };
   
 }
@@ -252,13 +252,26 @@ namespace dxvk {
         shaderOptions.xfbStrides[i] = m_moduleInfo.xfb->strides[i];
     }
 
+    SpirvCodeBuffer code = m_module.compile();
+
+    if (m_moduleInfo.options.optimizeSpirv) {
+      SpirvOptimizer optimizer(SpirvOptimizer::defaultPasses());
+
+      if (optimizer.run(code) && Logger::logLevel() <= LogLevel::Debug) {
+        const SpirvOptStats& stats = optimizer.stats();
+
+        Logger::debug(str::format("DxbcCompiler: Optimized shader, ",
+          stats.dwordsBefore, " -> ", stats.dwordsAfter, " dwords"));
+      }
+    }
+
     // Create the shader module object
     return new DxvkShader(
       m_programInfo.shaderStage(),
       m_resourceSlots.size(),
       m_resourceSlots.data(),
       m_interfaceSlots,
-      m_module.compile(),
+      std::move(code),
       shaderOptions,
       std::move(m_immConstData));
   }
@@ -385,11 +398,30 @@ namespace dxvk {
     if (regId >= m_xRegs.size())
       m_xRegs.resize(regId + 1);
     
-    m_xRegs.at(regId).ccount = info.type.ccount;
-    m_xRegs.at(regId).varId  = emitNewVariable(info);
+    DxbcXreg& xReg = m_xRegs.at(regId);
+    xReg.ccount = info.type.ccount;
+    xReg.varId  = 0;
+    xReg.elementIds.clear();
     
-    m_module.setDebugName(m_xRegs.at(regId).varId,
-      str::format("x", regId).c_str());
+    // Arrays that are only ever accessed with immediate
+    // indices can be lowered to one variable per element,
+    // which avoids going through memory in the driver.
+    if (isIndexableTempScalarizable(regId, info.type.alength)) {
+      info.type.alength = 0;
+      
+      for (uint32_t i = 0; i < ins.imm[1].u32; i++) {
+        uint32_t varId = emitNewVariable(info);
+        xReg.elementIds.push_back(varId);
+        
+        m_module.setDebugName(varId,
+          str::format("x", regId, "_", i).c_str());
+      }
+    } else {
+      xReg.varId = emitNewVariable(info);
+      
+      m_module.setDebugName(xReg.varId,
+        str::format("x", regId).c_str());
+    }
   }
   
   
@@ -4700,12 +4732,22 @@ namespace dxvk {
     //    (1) element index (relative)
     const uint32_t regId = operand.idx[0].offset;
     
+    const DxbcXreg& xReg = m_xRegs.at(regId);
+    
+    if (!xReg.elementIds.empty()) {
+      DxbcRegisterPointer result;
+      result.type.ctype  = DxbcScalarType::Float32;
+      result.type.ccount = xReg.ccount;
+      result.id = xReg.elementIds.at(operand.idx[1].offset);
+      return result;
+    }
+    
     const DxbcRegisterValue vectorId
       = emitIndexLoad(operand.idx[1]);
     
     DxbcRegisterInfo info;
     info.type.ctype   = DxbcScalarType::Float32;
-    info.type.ccount  = m_xRegs[regId].ccount;
+    info.type.ccount  = xReg.ccount;
     info.type.alength = 0;
     info.sclass       = spv::StorageClassPrivate;
     
@@ -4714,8 +4756,7 @@ namespace dxvk {
     result.type.ccount = info.type.ccount;
     result.id = m_module.opAccessChain(
       getPointerTypeId(info),
-      m_xRegs.at(regId).varId,
-      1, &vectorId.id);
+      xReg.varId, 1, &vectorId.id);
     return result;
   }
   
@@ -7649,6 +7690,25 @@ namespace dxvk {
         || type == DxbcScalarType::Uint64
         || type == DxbcScalarType::Float64;
   }
+  
+  
+  bool DxbcCompiler::isIndexableTempScalarizable(
+          uint32_t          regId,
+          uint32_t          length) const {
+    // Very large arrays are usually lookup tables, and
+    // emitting one variable per element would only
+    // bloat the generated code for little benefit.
+    constexpr uint32_t MaxScalarizedLength = 64;
+    
+    if (regId >= m_analysis->xRegInfos.size())
+      return false;
+    
+    const DxbcXregInfo& info = m_analysis->xRegInfos[regId];
+    
+    return !info.relativeIndex
+        && info.maxIndex < length
+        && length <= MaxScalarizedLength;
+  }
 
 
   uint32_t DxbcCompiler::getScalarTypeId(DxbcScalarType type) {
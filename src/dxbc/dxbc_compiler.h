@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "../spirv/spirv_module.h"
+#include "../spirv/spirv_optimizer.h"
 
 #include "dxbc_analysis.h"
 #include "dxbc_chunk_isgn.h"
@@ -85,6 +86,7 @@ namespace dxvk {
   struct DxbcXreg {
     uint32_t ccount = 0;
     uint32_t varId  = 0;
+    std::vector<uint32_t> elementIds;
   };
   
   
@@ -1221,6 +1223,10 @@ namespace dxvk {
     bool isDoubleType(
             DxbcScalarType type) const;
     
+    bool isIndexableTempScalarizable(
+            uint32_t          regId,
+            uint32_t          length) const;
+    
     ///////////////////////////
     // Type definition methods
     uint32_t getScalarTypeId(
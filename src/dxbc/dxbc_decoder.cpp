@@ -357,4 +357,80 @@ namespace dxvk {
     }
   }
   
-}
\ No newline at end of file
+  
+  
+  DxbcInstructionList::DxbcInstructionList(DxbcCodeSlice code) {
+    DxbcDecodeContext decoder;
+    
+    std::vector<OperandOffsets> offsets;
+    std::vector<IndexFixup>     fixups;
+    
+    while (!code.atEnd()) {
+      decoder.decodeInstruction(code);
+      
+      this->addInstruction(
+        decoder.getInstruction(),
+        offsets, fixups);
+    }
+    
+    // The arrays are not going to grow anymore, so
+    // we can safely resolve all operand pointers now
+    for (size_t i = 0; i < m_instructions.size(); i++) {
+      m_instructions[i].dst = m_registers.data()  + offsets[i].dst;
+      m_instructions[i].src = m_registers.data()  + offsets[i].src;
+      m_instructions[i].imm = m_immediates.data() + offsets[i].imm;
+    }
+    
+    for (const auto& fixup : fixups) {
+      m_registers[fixup.reg].idx[fixup.dim].relReg
+        = &m_registers[fixup.target];
+    }
+  }
+  
+  
+  DxbcInstructionList::~DxbcInstructionList() {
+    
+  }
+  
+  
+  void DxbcInstructionList::addInstruction(
+    const DxbcShaderInstruction&  ins,
+          std::vector<OperandOffsets>& offsets,
+          std::vector<IndexFixup>&     fixups) {
+    OperandOffsets offset;
+    offset.dst = uint32_t(m_registers.size());
+    offset.src = offset.dst + ins.dstCount;
+    offset.imm = uint32_t(m_immediates.size());
+    offsets.push_back(offset);
+    
+    uint32_t first = offset.dst;
+    
+    for (uint32_t i = 0; i < ins.dstCount; i++)
+      m_registers.push_back(ins.dst[i]);
+    
+    for (uint32_t i = 0; i < ins.srcCount; i++)
+      m_registers.push_back(ins.src[i]);
+    
+    for (uint32_t i = 0; i < ins.immCount; i++)
+      m_immediates.push_back(ins.imm[i]);
+    
+    // Relative indices are appended after the operands. Since
+    // the loop also visits newly added registers, this handles
+    // nested relative indices as well. Pointers still refer to
+    // the decode context at this point and get resolved later.
+    for (uint32_t r = first; r < m_registers.size(); r++) {
+      for (uint32_t i = 0; i < m_registers[r].idxDim; i++) {
+        const DxbcRegister* relReg = m_registers[r].idx[i].relReg;
+        
+        if (relReg != nullptr) {
+          fixups.push_back({ r, i, uint32_t(m_registers.size()) });
+          m_registers[r].idx[i].relReg = nullptr;
+          m_registers.push_back(*relReg);
+        }
+      }
+    }
+    
+    m_instructions.push_back(ins);
+  }
+  
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <vector>
 
 #include "dxbc_common.h"
 #include "dxbc_decoder.h"
@@ -497,4 +498,72 @@ namespace dxvk {
     
   };
   
+  
+  /**
+   * \brief Decoded instruction list
+   * 
+   * Decodes an entire code slice up front and stores
+   * all instructions in a flat array, with operands,
+   * relative indices and immediates allocated from
+   * shared arrays. This allows multiple passes over
+   * the same shader without decoding it again.
+   * 
+   * Custom data blocks still point into the original
+   * code, which must therefore outlive this object.
+   */
+  class DxbcInstructionList {
+    
+  public:
+    
+    /**
+     * \brief Decodes the given code
+     * \param [in] code Code slice
+     */
+    explicit DxbcInstructionList(DxbcCodeSlice code);
+    
+    ~DxbcInstructionList();
+    
+    DxbcInstructionList             (const DxbcInstructionList&) = delete;
+    DxbcInstructionList& operator = (const DxbcInstructionList&) = delete;
+    
+    /**
+     * \brief Number of decoded instructions
+     * \returns Instruction count
+     */
+    size_t size() const {
+      return m_instructions.size();
+    }
+    
+    auto begin() const { return m_instructions.cbegin(); }
+    auto end()   const { return m_instructions.cend(); }
+    
+    const DxbcShaderInstruction& operator [] (size_t index) const {
+      return m_instructions[index];
+    }
+    
+  private:
+    
+    struct OperandOffsets {
+      uint32_t dst;
+      uint32_t src;
+      uint32_t imm;
+    };
+    
+    struct IndexFixup {
+      uint32_t reg;
+      uint32_t dim;
+      uint32_t target;
+    };
+    
+    std::vector<DxbcShaderInstruction> m_instructions;
+    std::vector<DxbcRegister>          m_registers;
+    std::vector<DxbcImmediate>         m_immediates;
+    
+    void addInstruction(
+      const DxbcShaderInstruction&  ins,
+            std::vector<OperandOffsets>& offsets,
+            std::vector<IndexFixup>&     fixups);
+    
+  };
+  
 }
@@ -2,6 +2,8 @@
 #include "dxbc_compiler.h"
 #include "dxbc_module.h"
 
+#include "../util/util_time.h"
+
 namespace dxvk {
   
   DxbcModule::DxbcModule(DxbcReader& reader)
@@ -41,11 +43,20 @@ namespace dxvk {
   
   
   Rc<DxvkShader> DxbcModule::compile(
-    const DxbcModuleInfo& moduleInfo,
-    const std::string&    fileName) const {
+    const DxbcModuleInfo&     moduleInfo,
+    const std::string&        fileName,
+          DxbcCompileTimings* pTimings) const {
     if (m_shexChunk == nullptr)
       throw DxvkError("DxbcModule::compile: No SHDR/SHEX chunk");
     
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    // Decode the shader once, both the
+    // analyzer and compiler iterate over it
+    DxbcInstructionList code(m_shexChunk->slice());
+    
+    auto t1 = dxvk::high_resolution_clock::now();
+
     DxbcAnalysisInfo analysisInfo;
     
     DxbcAnalyzer analyzer(moduleInfo,
@@ -53,17 +64,29 @@ namespace dxvk {
       m_isgnChunk, m_osgnChunk,
       m_psgnChunk, analysisInfo);
     
-    this->runAnalyzer(analyzer, m_shexChunk->slice());
+    this->runAnalyzer(analyzer, code);
     
+    auto t2 = dxvk::high_resolution_clock::now();
+
     DxbcCompiler compiler(
       fileName, moduleInfo,
       m_shexChunk->programInfo(),
       m_isgnChunk, m_osgnChunk,
       m_psgnChunk, analysisInfo);
     
-    this->runCompiler(compiler, m_shexChunk->slice());
+    this->runCompiler(compiler, code);
     
-    return compiler.finalize();
+    Rc<DxvkShader> shader = compiler.finalize();
+
+    if (pTimings != nullptr) {
+      auto t3 = dxvk::high_resolution_clock::now();
+
+      pTimings->decodeNs  = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+      pTimings->analyzeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+      pTimings->compileNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count();
+    }
+
+    return shader;
   }
   
   
@@ -88,29 +111,17 @@ namespace dxvk {
 
   void DxbcModule::runAnalyzer(
           DxbcAnalyzer&       analyzer,
-          DxbcCodeSlice       slice) const {
-    DxbcDecodeContext decoder;
-    
-    while (!slice.atEnd()) {
-      decoder.decodeInstruction(slice);
-      
-      analyzer.processInstruction(
-        decoder.getInstruction());
-    }
+    const DxbcInstructionList& code) const {
+    for (const auto& ins : code)
+      analyzer.processInstruction(ins);
   }
   
   
   void DxbcModule::runCompiler(
           DxbcCompiler&       compiler,
-          DxbcCodeSlice       slice) const {
-    DxbcDecodeContext decoder;
-    
-    while (!slice.atEnd()) {
-      decoder.decodeInstruction(slice);
-      
-      compiler.processInstruction(
-        decoder.getInstruction());
-    }
+    const DxbcInstructionList& code) const {
+    for (const auto& ins : code)
+      compiler.processInstruction(ins);
   }
   
 }
@@ -17,6 +17,19 @@ namespace dxvk {
   class DxbcAnalyzer;
   class DxbcCompiler;
   
+  /**
+   * \brief Shader compilation timings
+   * 
+   * Time spent in the individual stages of
+   * shader compilation, in nanoseconds. The
+   * compile stage includes SPIR-V finalization.
+   */
+  struct DxbcCompileTimings {
+    uint64_t decodeNs  = 0;
+    uint64_t analyzeNs = 0;
+    uint64_t compileNs = 0;
+  };
+  
   /**
    * \brief DXBC shader module
    * 
@@ -54,11 +67,13 @@ namespace dxvk {
      * \param [in] moduleInfo DXBC module info
      * \param [in] fileName File name, will be added to
      *        the compiled SPIR-V for debugging purposes.
+     * \param [out] pTimings Optional compilation timings
      * \returns The compiled shader object
      */
     Rc<DxvkShader> compile(
-      const DxbcModuleInfo& moduleInfo,
-      const std::string&    fileName) const;
+      const DxbcModuleInfo&     moduleInfo,
+      const std::string&        fileName,
+            DxbcCompileTimings* pTimings = nullptr) const;
     
     /**
      * \brief Compiles a pass-through geometry shader
@@ -85,11 +100,11 @@ namespace dxvk {
     
     void runAnalyzer(
             DxbcAnalyzer&       analyzer,
-            DxbcCodeSlice       slice) const;
+      const DxbcInstructionList& code) const;
     
     void runCompiler(
             DxbcCompiler&       compiler,
-            DxbcCodeSlice       slice) const;
+      const DxbcInstructionList& code) const;
     
   };
   
@@ -55,6 +55,8 @@ namespace dxvk {
     
     // Apply shader-related options
     applyTristate(useSubgroupOpsForEarlyDiscard, device->config().useEarlyDiscard);
+
+    optimizeSpirv = device->config().optimizeShaders;
   }
   
 }
\ No newline at end of file
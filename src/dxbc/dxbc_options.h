@@ -42,6 +42,9 @@ namespace dxvk {
     /// Clear thread-group shared memory to zero
     bool zeroInitWorkgroupMemory = false;
 
+    /// Run SPIR-V optimization passes on the final code
+    bool optimizeSpirv = false;
+
     /// Minimum storage buffer alignment
     VkDeviceSize minSsboAlignment = 0;
   };
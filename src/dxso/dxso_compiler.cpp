@@ -233,12 +233,37 @@ namespace dxvk {
     DxvkShaderOptions shaderOptions = { };
     DxvkShaderConstData constData = { };
 
+    SpirvCodeBuffer code = m_module.compile();
+
+    SpirvOptPasses passes;
+
+    if (m_moduleInfo.options.optimizeSpirv)
+      passes = SpirvOptimizer::defaultPasses();
+
+    if (m_moduleInfo.options.promoteVariables)
+      passes.set(SpirvOptPass::SsaPromotion);
+
+    if (!passes.isClear()) {
+      SpirvOptimizer optimizer(passes);
+
+      if (optimizer.run(code) && Logger::logLevel() <= LogLevel::Debug) {
+        const SpirvOptStats& stats = optimizer.stats();
+
+        Logger::debug(str::format("DxsoCompiler: Optimized shader, ",
+          stats.dwordsBefore, " -> ", stats.dwordsAfter, " dwords, promoted ",
+          stats.ssa.promotedVariables, " variables, removed ",
+          stats.ssa.eliminatedLoads, " loads and ",
+          stats.ssa.eliminatedStores, " stores, added ",
+          stats.ssa.insertedPhis, " phis"));
+      }
+    }
+
     return new DxvkShader(
       m_programInfo.shaderStage(),
       m_resourceSlots.size(),
       m_resourceSlots.data(),
       m_interfaceSlots,
-      m_module.compile(),
+      code,
       shaderOptions,
       std::move(constData));
   }
@@ -823,6 +848,23 @@ namespace dxvk {
   }
 
 
+  uint32_t DxsoCompiler::emitBoolSpecConstant() {
+    if (m_boolSpecConst)
+      return m_boolSpecConst;
+
+    D3D9SpecConstantId specId = m_programInfo.type() == DxsoProgramTypes::VertexShader
+      ? D3D9SpecConstantId::VertexShaderBools
+      : D3D9SpecConstantId::PixelShaderBools;
+
+    // Defaults to zero, which means that the
+    // bool constant buffer is used as usual
+    m_boolSpecConst = m_module.specConst32(m_module.defIntType(32, 0), 0);
+    m_module.decorateSpecId(m_boolSpecConst, getSpecId(specId));
+    m_module.setDebugName(m_boolSpecConst, "s_bool_consts");
+    return m_boolSpecConst;
+  }
+
+
   DxsoRegisterValue DxsoCompiler::emitLoadConstant(
       const DxsoBaseRegister& reg,
       const DxsoBaseRegister* relative) {
@@ -924,6 +966,22 @@ namespace dxvk {
         uint32_t index = (reg.id.num % 128) / 32;
         bitfield = m_module.opCompositeExtract(uintType, bitfield, 1, &index);
       }
+
+      if (reg.id.num < 32)
+        m_meta.boolConstMask |= 1u << reg.id.num;
+
+      if (m_layout->bitmaskCount == 1 && m_moduleInfo.options.specializeBoolConstants) {
+        // If the pipeline is specialized for the current bool constants,
+        // use the spec constant so that drivers can fold the branches
+        uint32_t specConst = this->emitBoolSpecConstant();
+
+        uint32_t isValid = m_module.opINotEqual(m_module.defBoolType(),
+          m_module.opBitwiseAnd(uintType, specConst, m_module.constu32(D3D9SpecBoolsValid)),
+          m_module.constu32(0));
+
+        bitfield = m_module.opSelect(uintType, isValid, specConst, bitfield);
+      }
+
       uint32_t bit = m_module.opBitFieldUExtract(
         uintType, bitfield, bitIdx, m_module.consti32(1));
 
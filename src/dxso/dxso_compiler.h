@@ -8,6 +8,7 @@
 #include "../d3d9/d3d9_constant_layout.h"
 #include "../d3d9/d3d9_shader_permutations.h"
 #include "../spirv/spirv_module.h"
+#include "../spirv/spirv_optimizer.h"
 
 namespace dxvk {
 
@@ -303,6 +304,10 @@ namespace dxvk {
     std::array<uint32_t, caps::MaxOtherConstantsSoftware> m_cInt;
     std::array<uint32_t, caps::MaxOtherConstantsSoftware> m_cBool;
 
+    ////////////////////////////////////////
+    // Spec constant for specialized bools
+    uint32_t m_boolSpecConst = 0;
+
     //////////////////////
     // Loop counter
     DxsoRegisterPointer m_loopCounter;
@@ -447,6 +452,8 @@ namespace dxvk {
             spv::StorageClass storageClass = spv::StorageClassPrivate,
             spv::BuiltIn      builtIn      = spv::BuiltInMax);
 
+    uint32_t emitBoolSpecConstant();
+
     DxsoRegisterValue emitLoadConstant(
       const DxsoBaseRegister& reg,
       const DxsoBaseRegister* relative);
@@ -34,6 +34,7 @@ namespace dxvk {
     uint32_t maxConstIndexF = 0;
     uint32_t maxConstIndexI = 0;
     uint32_t maxConstIndexB = 0;
+    uint32_t boolConstMask  = 0;
   };
 
 }
\ No newline at end of file
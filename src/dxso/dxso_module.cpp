@@ -14,7 +14,8 @@ namespace dxvk {
 
     DxsoAnalyzer analyzer(info);
 
-    this->runAnalyzer(analyzer, m_code.iter());
+    this->decode();
+    this->runAnalyzer(analyzer);
 
     return info;
   }
@@ -29,7 +30,8 @@ namespace dxvk {
       m_header.info(), analysis,
       layout);
 
-    this->runCompiler(compiler, m_code.iter());
+    this->decode();
+    this->runCompiler(compiler);
     m_isgn = compiler.isgn();
 
     m_meta         = compiler.meta();
@@ -42,16 +44,20 @@ namespace dxvk {
     return compiler.compile();
   }
 
-  void DxsoModule::runAnalyzer(
-          DxsoAnalyzer&       analyzer,
-          DxsoCodeIter        iter) const {
+  void DxsoModule::decode() {
+    if (m_decoded)
+      return;
+
+    DxsoCodeIter iter  = m_code.iter();
     DxsoCodeIter start = iter;
 
+    // Decode all instructions up front so that the
+    // analyzer and compiler can both iterate over
+    // them without decoding the token stream twice.
     DxsoDecodeContext decoder(m_header.info());
 
     while (decoder.decodeInstruction(iter))
-      analyzer.processInstruction(
-        decoder.getInstructionContext());
+      m_instructions.push_back(decoder.getInstructionContext());
 
     size_t tokenCount = size_t(iter.ptrAt(0) - start.ptrAt(0));
 
@@ -68,17 +74,22 @@ namespace dxvk {
     // [start token] [frog rendering code] (end of tokenCount) [end token]
     tokenCount += 1;
 
-    analyzer.finalize(tokenCount);
+    m_tokenCount = tokenCount;
+    m_decoded    = true;
   }
 
-  void DxsoModule::runCompiler(
-          DxsoCompiler&       compiler,
-          DxsoCodeIter        iter) const {
-    DxsoDecodeContext decoder(m_header.info());
+  void DxsoModule::runAnalyzer(
+          DxsoAnalyzer&       analyzer) const {
+    for (const auto& ctx : m_instructions)
+      analyzer.processInstruction(ctx);
 
-    while (decoder.decodeInstruction(iter))
-      compiler.processInstruction(
-        decoder.getInstructionContext());
+    analyzer.finalize(m_tokenCount);
+  }
+
+  void DxsoModule::runCompiler(
+          DxsoCompiler&       compiler) const {
+    for (const auto& ctx : m_instructions)
+      compiler.processInstruction(ctx);
   }
 
-}
\ No newline at end of file
+}
@@ -32,8 +32,27 @@ namespace dxvk {
       return m_header.info();
     }
 
+    /**
+     * \brief Decodes the instruction stream
+     *
+     * Called implicitly by \c analyze and \c compile,
+     * and only decodes the shader on the first call.
+     */
+    void decode();
+
     DxsoAnalysisInfo analyze();
 
+    /**
+     * \brief Decoded instructions
+     *
+     * Decodes the shader on the first call.
+     * \returns All instructions, in program order
+     */
+    const std::vector<DxsoInstructionContext>& instructions() {
+      this->decode();
+      return m_instructions;
+    }
+
     /**
      * \brief Compiles DXSO shader to SPIR-V module
      * 
@@ -63,16 +82,18 @@ namespace dxvk {
   private:
 
     void runCompiler(
-            DxsoCompiler&       compiler,
-            DxsoCodeIter        iter) const;
+            DxsoCompiler&       compiler) const;
 
     void runAnalyzer(
-            DxsoAnalyzer&       analyzer,
-            DxsoCodeIter        iter) const;
+            DxsoAnalyzer&       analyzer) const;
 
     DxsoHeader      m_header;
     DxsoCode        m_code;
 
+    std::vector<DxsoInstructionContext> m_instructions;
+    size_t                              m_tokenCount = 0;
+    bool                                m_decoded    = false;
+
     DxsoIsgn        m_isgn;
     uint32_t        m_usedSamplers;
     uint32_t        m_usedRTs;
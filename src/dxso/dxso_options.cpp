@@ -37,6 +37,12 @@ namespace dxvk {
     shaderModel          = options.shaderModel;
 
     invariantPosition    = options.invariantPosition;
+
+    promoteVariables     = options.promoteVariables;
+
+    specializeBoolConstants = options.boolSpecVariants != 0;
+
+    optimizeSpirv        = device->config().optimizeShaders;
   }
 
 }
\ No newline at end of file
@@ -37,6 +37,16 @@ namespace dxvk {
     /// Work around a NV driver quirk
     /// Fixes flickering/z-fighting in some games.
     bool invariantPosition;
+
+    /// Promote temporary registers to SSA values
+    bool promoteVariables = false;
+
+    /// Run SPIR-V optimization passes on the final code
+    bool optimizeSpirv = false;
+
+    /// Read bool constants from specialization
+    /// constants if the device provides them
+    bool specializeBoolConstants = false;
   };
 
 }
\ No newline at end of file
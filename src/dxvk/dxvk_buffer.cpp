@@ -1,4 +1,5 @@
 #include "dxvk_buffer.h"
+#include "dxvk_buffer_arena.h"
 #include "dxvk_device.h"
 
 #include <algorithm>
@@ -43,6 +44,13 @@ namespace dxvk {
 
 
   DxvkBuffer::~DxvkBuffer() {
+    if (m_arena != nullptr) {
+      if (!isOwnSlice(m_physSlice))
+        freeArenaSlice(m_physSlice);
+
+      m_arena->subReplacedSize(m_arenaSlicePeak * m_physSliceStride);
+    }
+
     auto vkd = m_device->vkd();
 
     for (const auto& buffer : m_buffers)
@@ -117,6 +125,44 @@ namespace dxvk {
   }
 
 
+  void DxvkBuffer::setArena(const Rc<DxvkBufferArena>& arena) {
+    m_arena = arena;
+  }
+
+
+  bool DxvkBuffer::isOwnSlice(const DxvkBufferSliceHandle& slice) const {
+    if (slice.handle == m_buffer.buffer)
+      return true;
+
+    for (const auto& buffer : m_buffers) {
+      if (slice.handle == buffer.buffer)
+        return true;
+    }
+
+    return false;
+  }
+
+
+  DxvkBufferSliceHandle DxvkBuffer::allocArenaSlice() {
+    // Keep track of how many slices this buffer would have
+    // needed at most, so we can estimate the memory saved
+    uint32_t count = m_arenaSliceCount.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (count > m_arenaSlicePeak) {
+      m_arena->addReplacedSize((count - m_arenaSlicePeak) * m_physSliceStride);
+      m_arenaSlicePeak = count;
+    }
+
+    return m_arena->allocSlice(m_physSliceLength);
+  }
+
+
+  void DxvkBuffer::freeArenaSlice(const DxvkBufferSliceHandle& slice) {
+    m_arenaSliceCount.fetch_sub(1, std::memory_order_relaxed);
+    m_arena->freeSlice(slice);
+  }
+
+
   VkDeviceSize DxvkBuffer::computeSliceAlignment() const {
     const auto& devInfo = m_device->properties().core.properties;
 
@@ -11,6 +11,8 @@
 
 namespace dxvk {
 
+  class DxvkBufferArena;
+
   /**
    * \brief Buffer create info
    * 
@@ -233,6 +235,9 @@ namespace dxvk {
      * \returns The new buffer slice
      */
     DxvkBufferSliceHandle allocSlice() {
+      if (unlikely(m_arena != nullptr))
+        return allocArenaSlice();
+
       std::unique_lock<sync::Spinlock> freeLock(m_freeMutex);
       
       // If no slices are available, swap the two free lists.
@@ -275,10 +280,26 @@ namespace dxvk {
      * \param [in] slice The buffer slice to free
      */
     void freeSlice(const DxvkBufferSliceHandle& slice) {
+      if (unlikely(m_arena != nullptr) && !isOwnSlice(slice)) {
+        freeArenaSlice(slice);
+        return;
+      }
+
       // Add slice to a separate free list to reduce lock contention.
       std::unique_lock<sync::Spinlock> swapLock(m_swapMutex);
       m_nextSlices.push_back(slice);
     }
+
+    /**
+     * \brief Allocates slices from a shared arena
+     *
+     * Subsequent slices are allocated from the arena
+     * rather than from memory owned by this buffer.
+     * Must be called before the buffer gets renamed
+     * for the first time.
+     * \param [in] arena The buffer arena
+     */
+    void setArena(const Rc<DxvkBufferArena>& arena);
     
   private:
 
@@ -305,6 +326,10 @@ namespace dxvk {
     VkDeviceSize m_physSliceCount    = 1;
     VkDeviceSize m_physSliceMaxCount = 1;
 
+    Rc<DxvkBufferArena>   m_arena;
+    std::atomic<uint32_t> m_arenaSliceCount = { 0u };
+    uint32_t              m_arenaSlicePeak  = 0u;
+
     void pushSlice(const DxvkBufferHandle& handle, uint32_t index) {
       DxvkBufferSliceHandle slice;
       slice.handle = handle.buffer;
@@ -318,6 +343,12 @@ namespace dxvk {
             VkDeviceSize          sliceCount) const;
 
     VkDeviceSize computeSliceAlignment() const;
+
+    bool isOwnSlice(const DxvkBufferSliceHandle& slice) const;
+
+    DxvkBufferSliceHandle allocArenaSlice();
+
+    void freeArenaSlice(const DxvkBufferSliceHandle& slice);
     
   };
   
@@ -0,0 +1,123 @@
+#include "dxvk_buffer_arena.h"
+#include "dxvk_device.h"
+
+#include "../util/util_bit.h"
+
+namespace dxvk {
+
+  DxvkBufferArena::DxvkBufferArena(
+          DxvkDevice*           device,
+    const DxvkBufferCreateInfo& createInfo,
+          VkMemoryPropertyFlags memFlags)
+  : m_device  (device),
+    m_info    (createInfo),
+    m_memFlags(memFlags) {
+
+  }
+
+
+  DxvkBufferArena::~DxvkBufferArena() {
+
+  }
+
+
+  bool DxvkBufferArena::isCompatible(
+    const DxvkBufferCreateInfo& info,
+          VkMemoryPropertyFlags memFlags) const {
+    return (info.usage & ~m_info.usage) == 0
+        && (memFlags == m_memFlags)
+        && (info.size <= maxSliceSize());
+  }
+
+
+  DxvkBufferSliceHandle DxvkBufferArena::allocSlice(
+          VkDeviceSize          length) {
+    uint32_t sizeClass = getSizeClass(length);
+    VkDeviceSize classSize = VkDeviceSize(1) << (sizeClass + MinSliceSizeLog2);
+
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+    auto& freeList = m_freeLists[sizeClass];
+
+    if (unlikely(freeList.empty())) {
+      if (m_blockOffset + classSize > BlockSize)
+        allocBlock();
+
+      pushSlice(sizeClass, m_blockOffset);
+      m_blockOffset += classSize;
+    }
+
+    DxvkBufferSliceHandle result = freeList.back();
+    freeList.pop_back();
+
+    result.length = length;
+
+    m_usedSize.fetch_add(classSize, std::memory_order_relaxed);
+    return result;
+  }
+
+
+  void DxvkBufferArena::freeSlice(
+    const DxvkBufferSliceHandle& slice) {
+    uint32_t sizeClass = getSizeClass(slice.length);
+    VkDeviceSize classSize = VkDeviceSize(1) << (sizeClass + MinSliceSizeLog2);
+
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+    m_freeLists[sizeClass].push_back(slice);
+
+    m_usedSize.fetch_sub(classSize, std::memory_order_relaxed);
+  }
+
+
+  DxvkBufferArenaStats DxvkBufferArena::getStats() const {
+    DxvkBufferArenaStats result;
+    result.allocatedSize = m_allocatedSize.load(std::memory_order_relaxed);
+    result.usedSize      = m_usedSize.load(std::memory_order_relaxed);
+    result.replacedSize  = m_replacedSize.load(std::memory_order_relaxed);
+    return result;
+  }
+
+
+  uint32_t DxvkBufferArena::getSizeClass(VkDeviceSize length) {
+    uint32_t log2 = length > 1
+      ? 32 - bit::lzcnt(uint32_t(length - 1))
+      : 0;
+
+    return std::max<uint32_t>(log2, MinSliceSizeLog2) - MinSliceSizeLog2;
+  }
+
+
+  void DxvkBufferArena::pushSlice(
+          uint32_t              sizeClass,
+          VkDeviceSize          offset) {
+    VkDeviceSize classSize = VkDeviceSize(1) << (sizeClass + MinSliceSizeLog2);
+
+    m_freeLists[sizeClass].push_back(
+      m_blocks.back()->getSliceHandle(offset, classSize));
+  }
+
+
+  void DxvkBufferArena::allocBlock() {
+    // Hand out whatever space is left in the current
+    // block to smaller size classes so it is not lost
+    if (!m_blocks.empty()) {
+      for (uint32_t i = SizeClassCount; i > 0; i--) {
+        VkDeviceSize classSize = VkDeviceSize(1) << (i - 1 + MinSliceSizeLog2);
+
+        while (m_blockOffset + classSize <= BlockSize) {
+          pushSlice(i - 1, m_blockOffset);
+          m_blockOffset += classSize;
+        }
+      }
+    }
+
+    DxvkBufferCreateInfo info = m_info;
+    info.size = BlockSize;
+
+    m_blocks.push_back(m_device->createBuffer(info, m_memFlags));
+    m_blockOffset = 0;
+
+    m_allocatedSize.fetch_add(BlockSize, std::memory_order_relaxed);
+  }
+
+}
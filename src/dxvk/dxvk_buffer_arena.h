@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+
+#include "dxvk_buffer.h"
+
+namespace dxvk {
+
+  class DxvkDevice;
+
+  /**
+   * \brief Buffer arena statistics
+   */
+  struct DxvkBufferArenaStats {
+    /// Memory allocated for arena blocks
+    VkDeviceSize allocatedSize = 0;
+    /// Memory currently handed out as slices
+    VkDeviceSize usedSize      = 0;
+    /// Memory that live buffers would have
+    /// allocated for their own slice pools
+    VkDeviceSize replacedSize  = 0;
+  };
+
+
+  /**
+   * \brief Buffer arena
+   *
+   * Shared pool of memory that small buffers which get
+   * discarded frequently can allocate their backing
+   * slices from, instead of each buffer growing and
+   * keeping its own set of slices. Slices are carved
+   * out of large blocks in power-of-two size classes,
+   * and return to the arena once the command list that
+   * last used them has completed.
+   *
+   * Buffers using the arena must not request usage
+   * flags or memory properties other than those the
+   * arena has been created with.
+   */
+  class DxvkBufferArena : public RcObject {
+    constexpr static VkDeviceSize MinSliceSizeLog2 = 8;
+    constexpr static VkDeviceSize MaxSliceSizeLog2 = 16;
+    constexpr static VkDeviceSize BlockSize        = 4 << 20;
+    constexpr static uint32_t     SizeClassCount   = MaxSliceSizeLog2 - MinSliceSizeLog2 + 1;
+  public:
+
+    DxvkBufferArena(
+            DxvkDevice*           device,
+      const DxvkBufferCreateInfo& createInfo,
+            VkMemoryPropertyFlags memFlags);
+
+    ~DxvkBufferArena();
+
+    /**
+     * \brief Maximum supported slice size
+     * \returns Maximum slice size, in bytes
+     */
+    static constexpr VkDeviceSize maxSliceSize() {
+      return VkDeviceSize(1) << MaxSliceSizeLog2;
+    }
+
+    /**
+     * \brief Checks whether a buffer can use the arena
+     *
+     * \param [in] info Buffer create info
+     * \param [in] memFlags Buffer memory properties
+     * \returns \c true if the buffer is compatible
+     */
+    bool isCompatible(
+      const DxvkBufferCreateInfo& info,
+            VkMemoryPropertyFlags memFlags) const;
+
+    /**
+     * \brief Allocates a slice
+     *
+     * \param [in] length Slice length, in bytes
+     * \returns The new buffer slice
+     */
+    DxvkBufferSliceHandle allocSlice(
+            VkDeviceSize          length);
+
+    /**
+     * \brief Returns a slice to the arena
+     *
+     * Must only be called once the GPU
+     * no longer uses the slice.
+     * \param [in] slice The slice to free
+     */
+    void freeSlice(
+      const DxvkBufferSliceHandle& slice);
+
+    /**
+     * \brief Adjusts replaced memory estimate
+     *
+     * Buffers report the memory that their own slice
+     * pools would have needed, so that the amount of
+     * memory saved by the arena can be reported.
+     * \param [in] size Memory size to add
+     */
+    void addReplacedSize(VkDeviceSize size) {
+      m_replacedSize.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Adjusts replaced memory estimate
+     * \param [in] size Memory size to subtract
+     */
+    void subReplacedSize(VkDeviceSize size) {
+      m_replacedSize.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Queries arena statistics
+     * \returns Arena statistics
+     */
+    DxvkBufferArenaStats getStats() const;
+
+  private:
+
+    DxvkDevice*                   m_device;
+    DxvkBufferCreateInfo          m_info;
+    VkMemoryPropertyFlags         m_memFlags;
+
+    sync::Spinlock                m_mutex;
+
+    std::vector<Rc<DxvkBuffer>>   m_blocks;
+    VkDeviceSize                  m_blockOffset = BlockSize;
+
+    std::array<std::vector<DxvkBufferSliceHandle>, SizeClassCount> m_freeLists;
+
+    std::atomic<VkDeviceSize>     m_allocatedSize = { 0ull };
+    std::atomic<VkDeviceSize>     m_usedSize      = { 0ull };
+    std::atomic<VkDeviceSize>     m_replacedSize  = { 0ull };
+
+    static uint32_t getSizeClass(VkDeviceSize length);
+
+    void pushSlice(
+            uint32_t              sizeClass,
+            VkDeviceSize          offset);
+
+    void allocBlock();
+
+  };
+
+}
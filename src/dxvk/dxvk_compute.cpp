@@ -5,6 +5,7 @@
 #include "dxvk_compute.h"
 #include "dxvk_device.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipestats.h"
 #include "dxvk_spec_const.h"
 #include "dxvk_state_cache.h"
 
@@ -45,7 +46,7 @@ namespace dxvk {
     
       // If no pipeline instance exists with the given state
       // vector, create a new one and add it to the list.
-      instance = this->createInstance(state);
+      instance = this->createInstance(state, false);
     }
     
     if (!instance)
@@ -61,13 +62,26 @@ namespace dxvk {
     std::lock_guard<sync::Spinlock> lock(m_mutex);
 
     if (!this->findInstance(state))
-      this->createInstance(state);
+      this->createInstance(state, true);
   }
   
   
   DxvkComputePipelineInstance* DxvkComputePipeline::createInstance(
-    const DxvkComputePipelineStateInfo& state) {
-    VkPipeline newPipelineHandle = this->createPipeline(state);
+    const DxvkComputePipelineStateInfo& state,
+          bool                          async) {
+    VkPipeline newPipelineHandle = VK_NULL_HANDLE;
+
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    { TraceScope trace("pipeline", "Compile compute pipeline");
+      newPipelineHandle = this->createPipeline(state);
+    }
+
+    auto t1 = dxvk::high_resolution_clock::now();
+
+    // Pipelines not compiled by a worker thread stall the CS thread
+    auto td = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
+    m_pipeMgr->m_stats->addComputePipeline(m_shaders, td.count(), !async);
 
     m_pipeMgr->m_numComputePipelines += 1;
     return &m_pipelines.emplace_back(state, newPipelineHandle);
@@ -112,7 +126,7 @@ namespace dxvk {
     info.sType                = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     info.pNext                = nullptr;
     info.flags                = 0;
-    info.stage                = csm.stageInfo(&specInfo);
+    info.stage                = csm->stageInfo(&specInfo);
     info.layout               = m_layout->pipelineLayout();
     info.basePipelineHandle   = VK_NULL_HANDLE;
     info.basePipelineIndex    = -1;
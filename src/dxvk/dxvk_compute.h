@@ -147,7 +147,8 @@ namespace dxvk {
     std::vector<DxvkComputePipelineInstance> m_pipelines;
     
     DxvkComputePipelineInstance* createInstance(
-      const DxvkComputePipelineStateInfo& state);
+      const DxvkComputePipelineStateInfo& state,
+            bool                          async);
     
     DxvkComputePipelineInstance* findInstance(
       const DxvkComputePipelineStateInfo& state);
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "../util/util_math.h"
+
+#include "dxvk_hash.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Insert-only concurrent hash map
+   *
+   * Hash map that supports lock-free lookups and
+   * concurrent insertion, but no removal. Entries
+   * are never moved after construction, so pointers
+   * to values remain valid for the lifetime of the
+   * map. This is useful for objects such as pipelines
+   * which are created once and then looked up by
+   * many threads.
+   *
+   * The bucket count is fixed, so the map should be
+   * sized for the expected maximum number of entries.
+   * Insertions are serialized per lock stripe, which
+   * also guarantees that a value is only constructed
+   * once for any given key.
+   * \tparam K Key type
+   * \tparam V Value type
+   * \tparam Hash Hash function
+   * \tparam Eq Equality comparator
+   * \tparam BucketCount Number of buckets, must be a power of two
+   * \tparam StripeCount Number of insertion locks, must be a power of two
+   */
+  template<
+    typename K, typename V,
+    typename Hash         = DxvkHash,
+    typename Eq           = DxvkEq,
+    size_t   BucketCount  = 4096,
+    size_t   StripeCount  = 64>
+  class DxvkConcurrentMap {
+    static_assert((BucketCount & (BucketCount - 1)) == 0);
+    static_assert((StripeCount & (StripeCount - 1)) == 0);
+    static_assert(StripeCount <= BucketCount);
+
+    struct Node {
+      template<typename... Args>
+      Node(size_t h, Node* n, const K& k, Args&&... args)
+      : hash(h), next(n), key(k), value(std::forward<Args>(args)...) { }
+
+      size_t  hash;
+      Node*   next;
+      K       key;
+      V       value;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Stripe {
+      std::mutex mutex;
+    };
+
+  public:
+
+    DxvkConcurrentMap() {
+      for (auto& bucket : m_buckets)
+        bucket.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~DxvkConcurrentMap() {
+      for (auto& bucket : m_buckets) {
+        Node* node = bucket.load(std::memory_order_relaxed);
+
+        while (node) {
+          Node* next = node->next;
+          delete node;
+          node = next;
+        }
+      }
+    }
+
+    DxvkConcurrentMap             (const DxvkConcurrentMap&) = delete;
+    DxvkConcurrentMap& operator = (const DxvkConcurrentMap&) = delete;
+
+    /**
+     * \brief Looks up a value
+     *
+     * This does not take any locks and can be
+     * called concurrently with insertions.
+     * \param [in] key The key to look up
+     * \returns Pointer to the value, or \c nullptr
+     */
+    V* find(const K& key) {
+      size_t hash = m_hash(key);
+      return findNode(hash, key,
+        m_buckets[hash & (BucketCount - 1)].load(std::memory_order_acquire));
+    }
+
+    /**
+     * \brief Looks up or inserts a value
+     *
+     * If no value exists for the given key, a new
+     * one will be constructed in place using the
+     * given arguments. Concurrent calls with the
+     * same key will return the same object.
+     * \param [in] key The key to look up
+     * \param [in] args Value constructor arguments
+     * \returns Pointer to the value
+     */
+    template<typename... Args>
+    V* findOrInsert(const K& key, Args&&... args) {
+      size_t hash = m_hash(key);
+
+      auto& bucket = m_buckets[hash & (BucketCount - 1)];
+      Node* head = bucket.load(std::memory_order_acquire);
+
+      if (V* value = findNode(hash, key, head))
+        return value;
+
+      std::lock_guard<std::mutex> lock(
+        m_stripes[hash & (StripeCount - 1)].mutex);
+
+      // Another thread may have inserted the
+      // key while we were waiting for the lock
+      Node* newHead = bucket.load(std::memory_order_acquire);
+
+      if (newHead != head) {
+        if (V* value = findNode(hash, key, newHead))
+          return value;
+      }
+
+      Node* node = new Node(hash, newHead, key, std::forward<Args>(args)...);
+      bucket.store(node, std::memory_order_release);
+      return &node->value;
+    }
+
+  private:
+
+    Hash m_hash;
+    Eq   m_eq;
+
+    std::array<std::atomic<Node*>, BucketCount> m_buckets;
+    std::array<Stripe,             StripeCount> m_stripes;
+
+    V* findNode(size_t hash, const K& key, Node* node) {
+      while (node) {
+        if (node->hash == hash && m_eq(node->key, key))
+          return &node->value;
+
+        node = node->next;
+      }
+
+      return nullptr;
+    }
+
+  };
+
+}
@@ -64,6 +64,11 @@ namespace dxvk {
   
   Rc<DxvkCommandList> DxvkContext::endRecording() {
     this->spillRenderPass();
+
+#ifdef DXVK_COMMIT_PROFILER
+    m_device->addCommitProfile(m_commitProfile);
+    m_commitProfile.reset();
+#endif
     
     m_sdmaBarriers.recordCommands(m_cmd);
     m_initBarriers.recordCommands(m_cmd);
@@ -4331,55 +4336,81 @@ namespace dxvk {
   
   template<bool Indexed, bool Indirect>
   bool DxvkContext::commitGraphicsState() {
+    DXVK_PROFILE_COMMIT(m_commitProfile, Total);
+
     if (m_flags.test(DxvkContextFlag::GpDirtyPipeline)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, Pipeline);
+
       if (unlikely(!this->updateGraphicsPipeline()))
         return false;
     }
     
     if (m_state.gp.flags.any(DxvkGraphicsPipelineFlag::HasStorageDescriptors,
                              DxvkGraphicsPipelineFlag::HasTransformFeedback)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, Barriers);
+
       this->commitGraphicsBarriers<Indexed, Indirect, false>();
       this->commitGraphicsBarriers<Indexed, Indirect, true>();
     }
 
-    if (m_flags.test(DxvkContextFlag::GpDirtyFramebuffer))
+    if (m_flags.test(DxvkContextFlag::GpDirtyFramebuffer)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, Framebuffer);
       this->updateFramebuffer();
+    }
 
-    if (!m_flags.test(DxvkContextFlag::GpRenderPassBound))
+    if (!m_flags.test(DxvkContextFlag::GpRenderPassBound)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, RenderPass);
       this->startRenderPass();
+    }
     
-    if (m_flags.test(DxvkContextFlag::GpDirtyIndexBuffer) && Indexed)
+    if (m_flags.test(DxvkContextFlag::GpDirtyIndexBuffer) && Indexed) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, IndexBuffer);
       this->updateIndexBufferBinding();
+    }
     
-    if (m_flags.test(DxvkContextFlag::GpDirtyVertexBuffers))
+    if (m_flags.test(DxvkContextFlag::GpDirtyVertexBuffers)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, VertexBuffers);
       this->updateVertexBufferBindings();
+    }
     
     if (m_flags.any(
           DxvkContextFlag::GpDirtyResources,
-          DxvkContextFlag::GpDirtyDescriptorBinding))
+          DxvkContextFlag::GpDirtyDescriptorBinding)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, Resources);
       this->updateGraphicsShaderResources();
+    }
     
     if (m_flags.test(DxvkContextFlag::GpDirtyPipelineState)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, PipelineState);
+
       if (unlikely(!this->updateGraphicsPipelineState()))
         return false;
     }
     
-    if (m_state.gp.flags.test(DxvkGraphicsPipelineFlag::HasTransformFeedback))
+    if (m_state.gp.flags.test(DxvkGraphicsPipelineFlag::HasTransformFeedback)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, DynamicState);
       this->updateTransformFeedbackState();
+    }
     
-    if (m_flags.test(DxvkContextFlag::GpDirtyPredicate))
+    if (m_flags.test(DxvkContextFlag::GpDirtyPredicate)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, DynamicState);
       this->updateConditionalRendering();
+    }
 
     if (m_flags.any(
           DxvkContextFlag::GpDirtyViewport,
           DxvkContextFlag::GpDirtyBlendConstants,
           DxvkContextFlag::GpDirtyStencilRef,
           DxvkContextFlag::GpDirtyDepthBias,
-          DxvkContextFlag::GpDirtyDepthBounds))
+          DxvkContextFlag::GpDirtyDepthBounds)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, DynamicState);
       this->updateDynamicState();
+    }
     
-    if (m_flags.test(DxvkContextFlag::DirtyPushConstants))
+    if (m_flags.test(DxvkContextFlag::DirtyPushConstants)) {
+      DXVK_PROFILE_COMMIT(m_commitProfile, PushConstants);
       this->updatePushConstants<VK_PIPELINE_BIND_POINT_GRAPHICS>();
+    }
 
     if (m_flags.test(DxvkContextFlag::DirtyDrawBuffer) && Indirect)
       this->trackDrawBuffer();
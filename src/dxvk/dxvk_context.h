@@ -6,6 +6,7 @@
 #include "dxvk_context_state.h"
 #include "dxvk_data.h"
 #include "dxvk_objects.h"
+#include "dxvk_profiler.h"
 #include "dxvk_util.h"
 
 namespace dxvk {
@@ -1042,6 +1043,10 @@ namespace dxvk {
     std::array<DxvkGraphicsPipeline*, 4096> m_gpLookupCache = { };
     std::array<DxvkComputePipeline*,   256> m_cpLookupCache = { };
 
+#ifdef DXVK_COMMIT_PROFILER
+    DxvkCommitProfile       m_commitProfile;
+#endif
+
     std::unordered_map<
       DxvkBufferSliceHandle,
       DxvkGpuQueryHandle,
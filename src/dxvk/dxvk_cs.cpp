@@ -157,8 +157,10 @@ namespace dxvk {
         }
       }
       
-      if (chunk)
+      if (chunk) {
+        TraceScope trace("cs", "Execute chunk");
         chunk->executeAll(m_context.ptr());
+      }
     }
   }
   
@@ -166,6 +166,7 @@ namespace dxvk {
     result.setCtr(DxvkStatCounter::PipeCountGraphics, pipe.numGraphicsPipelines);
     result.setCtr(DxvkStatCounter::PipeCountCompute,  pipe.numComputePipelines);
     result.setCtr(DxvkStatCounter::PipeCompilerBusy,  m_objects.pipelineManager().isCompilingShaders());
+    result.setCtr(DxvkStatCounter::PipeCompilerStallTime, m_objects.pipelineManager().getCompileStallTime());
     result.setCtr(DxvkStatCounter::GpuIdleTicks,      m_submissionQueue.gpuIdleTicks());
 
     std::lock_guard<sync::Spinlock> lock(m_statLock);
@@ -205,6 +206,10 @@ namespace dxvk {
     presentInfo.waitSync  = semaphore;
     m_submissionQueue.present(presentInfo, status);
     
+#ifdef DXVK_COMMIT_PROFILER
+    m_commitProfiler.endFrame();
+#endif
+
     std::lock_guard<sync::Spinlock> statLock(m_statLock);
     m_statCounters.addCtr(DxvkStatCounter::QueuePresentCount, 1);
   }
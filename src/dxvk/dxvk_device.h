@@ -15,6 +15,7 @@
 #include "dxvk_options.h"
 #include "dxvk_pipecache.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_profiler.h"
 #include "dxvk_queue.h"
 #include "dxvk_recycler.h"
 #include "dxvk_renderpass.h"
@@ -358,6 +359,27 @@ namespace dxvk {
      */
     DxvkMemoryStats getMemoryStats(uint32_t heap);
 
+#ifdef DXVK_COMMIT_PROFILER
+    /**
+     * \brief Adds commit profile data
+     *
+     * Called by contexts when a command
+     * list has finished recording.
+     * \param [in] profile Commit profile
+     */
+    void addCommitProfile(const DxvkCommitProfile& profile) {
+      m_commitProfiler.addProfile(profile);
+    }
+
+    /**
+     * \brief Retrieves commit profiler
+     * \returns Commit profiler
+     */
+    DxvkCommitProfiler& commitProfiler() {
+      return m_commitProfiler;
+    }
+#endif
+
     /**
      * \brief Retreves current frame ID
      * \returns Current frame ID
@@ -478,6 +500,10 @@ namespace dxvk {
 
     sync::Spinlock              m_statLock;
     DxvkStatCounters            m_statCounters;
+
+#ifdef DXVK_COMMIT_PROFILER
+    DxvkCommitProfiler          m_commitProfiler;
+#endif
     
     DxvkDeviceQueueSet          m_queues;
     
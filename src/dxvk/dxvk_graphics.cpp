@@ -3,6 +3,7 @@
 #include "dxvk_device.h"
 #include "dxvk_graphics.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipestats.h"
 #include "dxvk_spec_const.h"
 #include "dxvk_state_cache.h"
 
@@ -64,20 +65,31 @@ namespace dxvk {
     const DxvkGraphicsPipelineStateInfo& state,
     const DxvkRenderPass*                renderPass) {
     DxvkGraphicsPipelineInstance* instance = nullptr;
+    bool wasSpeculative = false;
 
     { std::lock_guard<sync::Spinlock> lock(m_mutex);
     
       instance = this->findInstance(state, renderPass);
       
-      if (instance)
-        return instance->pipeline();
-      
-      instance = this->createInstance(state, renderPass);
+      if (instance) {
+        if (likely(!instance->isSpeculative()))
+          return instance->pipeline();
+
+        // Predicted pipelines are not in the state
+        // cache yet, so we need to write them now
+        instance->markUsed();
+        wasSpeculative = true;
+      } else {
+        instance = this->createInstance(state, renderPass, false, false);
+      }
     }
     
     if (!instance)
       return VK_NULL_HANDLE;
 
+    if (wasSpeculative)
+      m_pipeMgr->m_stateCache->notifyPredictionHit();
+
     this->writePipelineStateToCache(state, renderPass->format());
     return instance->pipeline();
   }
@@ -85,26 +97,41 @@ namespace dxvk {
 
   void DxvkGraphicsPipeline::compilePipeline(
     const DxvkGraphicsPipelineStateInfo& state,
-    const DxvkRenderPass*                renderPass) {
+    const DxvkRenderPass*                renderPass,
+          bool                           speculative) {
     std::lock_guard<sync::Spinlock> lock(m_mutex);
 
     if (!this->findInstance(state, renderPass))
-      this->createInstance(state, renderPass);
+      this->createInstance(state, renderPass, true, speculative);
   }
 
 
   DxvkGraphicsPipelineInstance* DxvkGraphicsPipeline::createInstance(
     const DxvkGraphicsPipelineStateInfo& state,
-    const DxvkRenderPass*                renderPass) {
+    const DxvkRenderPass*                renderPass,
+          bool                           async,
+          bool                           speculative) {
     // If the pipeline state vector is invalid, don't try
     // to create a new pipeline, it won't work anyway.
     if (!this->validatePipelineState(state))
       return nullptr;
 
-    VkPipeline newPipelineHandle = this->createPipeline(state, renderPass);
+    VkPipeline newPipelineHandle = VK_NULL_HANDLE;
+
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    { TraceScope trace("pipeline", "Compile graphics pipeline");
+      newPipelineHandle = this->createPipeline(state, renderPass);
+    }
+
+    auto t1 = dxvk::high_resolution_clock::now();
+
+    // Pipelines not compiled by a worker thread stall the CS thread
+    auto td = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
+    m_pipeMgr->m_stats->addGraphicsPipeline(m_shaders, td.count(), !async);
 
     m_pipeMgr->m_numGraphicsPipelines += 1;
-    return &m_pipelines.emplace_back(state, renderPass, newPipelineHandle);
+    return &m_pipelines.emplace_back(state, renderPass, newPipelineHandle, speculative);
   }
   
   
@@ -187,11 +214,11 @@ namespace dxvk {
     auto fsm  = createShaderModule(m_shaders.fs,  state);
 
     std::vector<VkPipelineShaderStageCreateInfo> stages;
-    if (vsm)  stages.push_back(vsm.stageInfo(&specInfo));
-    if (tcsm) stages.push_back(tcsm.stageInfo(&specInfo));
-    if (tesm) stages.push_back(tesm.stageInfo(&specInfo));
-    if (gsm)  stages.push_back(gsm.stageInfo(&specInfo));
-    if (fsm)  stages.push_back(fsm.stageInfo(&specInfo));
+    if (vsm  != nullptr) stages.push_back(vsm->stageInfo(&specInfo));
+    if (tcsm != nullptr) stages.push_back(tcsm->stageInfo(&specInfo));
+    if (tesm != nullptr) stages.push_back(tesm->stageInfo(&specInfo));
+    if (gsm  != nullptr) stages.push_back(gsm->stageInfo(&specInfo));
+    if (fsm  != nullptr) stages.push_back(fsm->stageInfo(&specInfo));
 
     // Fix up color write masks using the component mappings
     std::array<VkPipelineColorBlendAttachmentState, MaxNumRenderTargets> omBlendAttachments;
@@ -424,11 +451,11 @@ namespace dxvk {
   }
 
 
-  DxvkShaderModule DxvkGraphicsPipeline::createShaderModule(
+  Rc<DxvkShaderModule> DxvkGraphicsPipeline::createShaderModule(
     const Rc<DxvkShader>&                shader,
     const DxvkGraphicsPipelineStateInfo& state) const {
     if (shader == nullptr)
-      return DxvkShaderModule();
+      return nullptr;
 
     DxvkShaderModuleCreateInfo info;
 
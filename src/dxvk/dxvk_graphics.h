@@ -81,15 +81,18 @@ namespace dxvk {
     DxvkGraphicsPipelineInstance()
     : m_stateVector (),
       m_renderPass  (VK_NULL_HANDLE),
-      m_pipeline    (VK_NULL_HANDLE) { }
+      m_pipeline    (VK_NULL_HANDLE),
+      m_speculative (false) { }
 
     DxvkGraphicsPipelineInstance(
       const DxvkGraphicsPipelineStateInfo&  state,
       const DxvkRenderPass*                 rp,
-            VkPipeline                      pipe)
+            VkPipeline                      pipe,
+            bool                            speculative)
     : m_stateVector (state),
       m_renderPass  (rp),
-      m_pipeline    (pipe) { }
+      m_pipeline    (pipe),
+      m_speculative (speculative) { }
 
     /**
      * \brief Checks for matching pipeline state
@@ -113,11 +116,30 @@ namespace dxvk {
       return m_pipeline;
     }
 
+    /**
+     * \brief Checks whether the pipeline is speculative
+     *
+     * Speculative pipelines are compiled based on a
+     * prediction and may never actually be used.
+     * \returns \c true if the pipeline was not used yet
+     */
+    bool isSpeculative() const {
+      return m_speculative;
+    }
+
+    /**
+     * \brief Marks pipeline as used
+     */
+    void markUsed() {
+      m_speculative = false;
+    }
+
   private:
 
     DxvkGraphicsPipelineStateInfo m_stateVector;
     const DxvkRenderPass*         m_renderPass;
     VkPipeline                    m_pipeline;
+    bool                          m_speculative;
 
   };
 
@@ -198,10 +220,13 @@ namespace dxvk {
      * and stores the result for future use.
      * \param [in] state Pipeline state vector
      * \param [in] renderPass The render pass
+     * \param [in] speculative Whether the state
+     *    vector was predicted rather than cached
      */
     void compilePipeline(
       const DxvkGraphicsPipelineStateInfo&    state,
-      const DxvkRenderPass*                   renderPass);
+      const DxvkRenderPass*                   renderPass,
+            bool                              speculative);
     
   private:
     
@@ -225,7 +250,9 @@ namespace dxvk {
     
     DxvkGraphicsPipelineInstance* createInstance(
       const DxvkGraphicsPipelineStateInfo& state,
-      const DxvkRenderPass*                renderPass);
+      const DxvkRenderPass*                renderPass,
+            bool                           async,
+            bool                           speculative);
     
     DxvkGraphicsPipelineInstance* findInstance(
       const DxvkGraphicsPipelineStateInfo& state,
@@ -238,7 +265,7 @@ namespace dxvk {
     void destroyPipeline(
             VkPipeline                     pipeline) const;
     
-    DxvkShaderModule createShaderModule(
+    Rc<DxvkShaderModule> createShaderModule(
       const Rc<DxvkShader>&                shader,
       const DxvkGraphicsPipelineStateInfo& state) const;
     
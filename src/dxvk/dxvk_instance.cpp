@@ -48,7 +48,9 @@ namespace dxvk {
   
   
   DxvkInstance::~DxvkInstance() {
-    
+    // All devices hold a reference to the instance,
+    // so their worker threads are gone at this point
+    TraceRecorder::flush();
   }
   
   
@@ -19,6 +19,7 @@ namespace dxvk {
     MaxUniformBufferSize        = 65536,
     MaxVertexBindingStride      =  2048,
     MaxPushConstantSize         =   128,
+    MaxNumTranslationThreads    =     4,
   };
   
 }
\ No newline at end of file
@@ -6,8 +6,10 @@ namespace dxvk {
     enableStateCache      = config.getOption<bool>    ("dxvk.enableStateCache",       true);
     enableOpenVR          = config.getOption<bool>    ("dxvk.enableOpenVR",           true);
     numCompilerThreads    = config.getOption<int32_t> ("dxvk.numCompilerThreads",     0);
+    numPredictedPipelines = config.getOption<int32_t> ("dxvk.numPredictedPipelines",  4);
     useRawSsbo            = config.getOption<Tristate>("dxvk.useRawSsbo",             Tristate::Auto);
     useEarlyDiscard       = config.getOption<Tristate>("dxvk.useEarlyDiscard",        Tristate::Auto);
+    optimizeShaders       = config.getOption<bool>    ("dxvk.optimizeShaders",        false);
     hud                   = config.getOption<std::string>("dxvk.hud", "");
   }
 
@@ -18,10 +18,18 @@ namespace dxvk {
     /// when using the state cache
     int32_t numCompilerThreads;
 
+    /// Maximum number of pipelines to compile
+    /// speculatively for each new shader
+    int32_t numPredictedPipelines;
+
     /// Shader-related options
     Tristate useRawSsbo;
     Tristate useEarlyDiscard;
 
+    /// Run SPIR-V optimization passes
+    /// on translated shader code
+    bool optimizeShaders;
+
     /// HUD elements
     std::string hud;
   };
@@ -1,5 +1,6 @@
 #include "dxvk_device.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipestats.h"
 #include "dxvk_state_cache.h"
 
 namespace dxvk {
@@ -8,7 +9,8 @@ namespace dxvk {
     const DxvkDevice*         device,
           DxvkRenderPassPool* passManager)
   : m_device    (device),
-    m_cache     (new DxvkPipelineCache(device->vkd())) {
+    m_cache     (new DxvkPipelineCache(device->vkd())),
+    m_stats     (new DxvkPipelineStats()) {
     std::string useStateCache = env::getEnvVar("DXVK_STATE_CACHE");
     
     if (useStateCache != "0" && device->config().enableStateCache)
@@ -17,7 +19,7 @@ namespace dxvk {
   
   
   DxvkPipelineManager::~DxvkPipelineManager() {
-    
+    m_stats->writeReport();
   }
   
   
@@ -26,17 +28,7 @@ namespace dxvk {
     if (shaders.cs == nullptr)
       return nullptr;
     
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    auto pair = m_computePipelines.find(shaders);
-    if (pair != m_computePipelines.end())
-      return &pair->second;
-    
-    auto iter = m_computePipelines.emplace(
-      std::piecewise_construct,
-      std::tuple(shaders),
-      std::tuple(this, shaders));
-    return &iter.first->second;
+    return m_computePipelines.findOrInsert(shaders, this, shaders);
   }
   
   
@@ -45,17 +37,7 @@ namespace dxvk {
     if (shaders.vs == nullptr)
       return nullptr;
     
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    auto pair = m_graphicsPipelines.find(shaders);
-    if (pair != m_graphicsPipelines.end())
-      return &pair->second;
-    
-    auto iter = m_graphicsPipelines.emplace(
-      std::piecewise_construct,
-      std::tuple(shaders),
-      std::tuple(this, shaders));
-    return &iter.first->second;
+    return m_graphicsPipelines.findOrInsert(shaders, this, shaders);
   }
 
   
@@ -74,6 +56,11 @@ namespace dxvk {
   }
 
 
+  uint64_t DxvkPipelineManager::getCompileStallTime() const {
+    return m_stats->getStallTime();
+  }
+
+
   bool DxvkPipelineManager::isCompilingShaders() const {
     return m_stateCache != nullptr
         && m_stateCache->isCompilingShaders();
@@ -1,14 +1,13 @@
 
 #pragma once
 
-#include <mutex>
-#include <unordered_map>
-
 #include "dxvk_compute.h"
+#include "dxvk_concurrent_map.h"
 #include "dxvk_graphics.h"
 
 namespace dxvk {
 
+  class DxvkPipelineStats;
   class DxvkStateCache;
 
   /**
@@ -84,6 +83,15 @@ namespace dxvk {
      */
     DxvkPipelineCount getPipelineCount() const;
 
+    /**
+     * \brief Retrieves pipeline compile stall time
+     *
+     * Total time spent compiling pipelines on the
+     * CS thread, which directly delays rendering.
+     * \returns Stall time, in microseconds
+     */
+    uint64_t getCompileStallTime() const;
+
     /**
      * \brief Checks whether async compiler is busy
      * \returns \c true if shaders are being compiled
@@ -95,18 +103,17 @@ namespace dxvk {
     const DxvkDevice*         m_device;
     Rc<DxvkPipelineCache>     m_cache;
     Rc<DxvkStateCache>        m_stateCache;
+    Rc<DxvkPipelineStats>     m_stats;
 
     std::atomic<uint32_t>     m_numComputePipelines  = { 0 };
     std::atomic<uint32_t>     m_numGraphicsPipelines = { 0 };
     
-    std::mutex m_mutex;
-    
-    std::unordered_map<
+    DxvkConcurrentMap<
       DxvkComputePipelineShaders,
       DxvkComputePipeline,
       DxvkHash, DxvkEq> m_computePipelines;
     
-    std::unordered_map<
+    DxvkConcurrentMap<
       DxvkGraphicsPipelineShaders,
       DxvkGraphicsPipeline,
       DxvkHash, DxvkEq> m_graphicsPipelines;
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <fstream>
+
+#include "dxvk_pipestats.h"
+
+namespace dxvk {
+
+  constexpr static size_t MaxReportedPipelines = 10;
+
+
+  DxvkPipelineStats::DxvkPipelineStats()
+  : m_jsonPath(env::getEnvVar("DXVK_PIPELINE_STATS")) {
+
+  }
+
+
+  DxvkPipelineStats::~DxvkPipelineStats() {
+
+  }
+
+
+  void DxvkPipelineStats::addGraphicsPipeline(
+    const DxvkGraphicsPipelineShaders&  shaders,
+          uint64_t                      time,
+          bool                          stall) {
+    DxvkStateCacheKey key;
+    key.vs  = getShaderKey(shaders.vs);
+    key.tcs = getShaderKey(shaders.tcs);
+    key.tes = getShaderKey(shaders.tes);
+    key.gs  = getShaderKey(shaders.gs);
+    key.fs  = getShaderKey(shaders.fs);
+
+    this->addPipeline(key, time, stall);
+  }
+
+
+  void DxvkPipelineStats::addComputePipeline(
+    const DxvkComputePipelineShaders&   shaders,
+          uint64_t                      time,
+          bool                          stall) {
+    DxvkStateCacheKey key;
+    key.cs  = getShaderKey(shaders.cs);
+
+    this->addPipeline(key, time, stall);
+  }
+
+
+  void DxvkPipelineStats::writeReport() {
+    std::vector<Entry> entries;
+
+    { std::lock_guard<std::mutex> lock(m_mutex);
+      entries.reserve(m_entries.size());
+
+      for (const auto& e : m_entries)
+        entries.push_back(e);
+    }
+
+    if (entries.empty())
+      return;
+
+    // Pipelines that stalled the CS thread go first,
+    // everything else is sorted by total compile time
+    std::sort(entries.begin(), entries.end(),
+      [] (const Entry& a, const Entry& b) {
+        if (a.second.stallTime != b.second.stallTime)
+          return a.second.stallTime > b.second.stallTime;
+        return a.second.totalTime > b.second.totalTime;
+      });
+
+    DxvkPipelineCompileStats total;
+
+    for (const auto& e : entries) {
+      total.instanceCount += e.second.instanceCount;
+      total.stallCount    += e.second.stallCount;
+      total.totalTime     += e.second.totalTime;
+      total.stallTime     += e.second.stallTime;
+    }
+
+    Logger::info(str::format("DxvkPipelineStats: Compiled ",
+      total.instanceCount, " pipelines in ", total.totalTime / 1000, " ms, ",
+      total.stallCount, " on the CS thread (", total.stallTime / 1000, " ms)"));
+
+    for (size_t i = 0; i < entries.size() && i < MaxReportedPipelines; i++) {
+      const auto& stats = entries[i].second;
+
+      if (!stats.stallCount)
+        break;
+
+      Logger::info(str::format("  ", getShaderNames(entries[i].first), ": ",
+        stats.stallCount, "/", stats.instanceCount, " stalls, ",
+        stats.stallTime / 1000, " ms stalled, ",
+        stats.maxTime / 1000, " ms max"));
+    }
+
+    if (!m_jsonPath.empty())
+      this->writeJson(entries);
+  }
+
+
+  void DxvkPipelineStats::addPipeline(
+    const DxvkStateCacheKey&            key,
+          uint64_t                      time,
+          bool                          stall) {
+    if (stall)
+      m_stallTime += time;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& entry = m_entries[key];
+    entry.instanceCount += 1;
+    entry.totalTime     += time;
+    entry.maxTime        = std::max(entry.maxTime, time);
+
+    if (stall) {
+      entry.stallCount  += 1;
+      entry.stallTime   += time;
+    }
+  }
+
+
+  void DxvkPipelineStats::writeJson(
+    const std::vector<Entry>&           entries) const {
+    std::ofstream file(m_jsonPath);
+
+    if (!file) {
+      Logger::warn(str::format("DxvkPipelineStats: Failed to open ", m_jsonPath));
+      return;
+    }
+
+    file << "[" << std::endl;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      const auto& key   = entries[i].first;
+      const auto& stats = entries[i].second;
+
+      file << "  { \"shaders\": \"" << getShaderNames(key) << "\", "
+           << "\"instances\": "  << stats.instanceCount << ", "
+           << "\"stalls\": "     << stats.stallCount    << ", "
+           << "\"totalTimeUs\": "<< stats.totalTime     << ", "
+           << "\"stallTimeUs\": "<< stats.stallTime     << ", "
+           << "\"maxTimeUs\": "  << stats.maxTime       << " }"
+           << (i + 1 < entries.size() ? "," : "") << std::endl;
+    }
+
+    file << "]" << std::endl;
+  }
+
+
+  DxvkShaderKey DxvkPipelineStats::getShaderKey(
+    const Rc<DxvkShader>&               shader) {
+    return shader != nullptr ? shader->getShaderKey() : DxvkShaderKey();
+  }
+
+
+  std::string DxvkPipelineStats::getShaderNames(
+    const DxvkStateCacheKey&            key) {
+    const std::array<const DxvkShaderKey*, 6> shaderKeys = {
+      &key.vs, &key.tcs, &key.tes, &key.gs, &key.fs, &key.cs };
+
+    std::string result;
+
+    for (auto shaderKey : shaderKeys) {
+      if (!shaderKey->type())
+        continue;
+
+      if (!result.empty())
+        result += " ";
+
+      result += shaderKey->toString();
+    }
+
+    return result;
+  }
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dxvk_state_cache_types.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Pipeline compile statistics
+   *
+   * Accumulated compile timings for all pipeline
+   * instances that use a given set of shaders.
+   * All times are given in microseconds.
+   */
+  struct DxvkPipelineCompileStats {
+    uint32_t instanceCount  = 0;
+    uint32_t stallCount     = 0;
+    uint64_t totalTime      = 0;
+    uint64_t stallTime      = 0;
+    uint64_t maxTime        = 0;
+  };
+
+
+  /**
+   * \brief Pipeline compile telemetry
+   *
+   * Records how long each pipeline took to compile,
+   * and whether it was compiled on the CS thread,
+   * in which case the compilation directly stalls
+   * rendering, or on a state cache worker thread.
+   *
+   * The collected data is written to the log when
+   * the pipeline manager gets destroyed, and can
+   * optionally be dumped to a JSON file specified
+   * via the \c DXVK_PIPELINE_STATS variable.
+   */
+  class DxvkPipelineStats : public RcObject {
+
+  public:
+
+    DxvkPipelineStats();
+
+    ~DxvkPipelineStats();
+
+    /**
+     * \brief Records a graphics pipeline compilation
+     *
+     * \param [in] shaders Pipeline shaders
+     * \param [in] time Compile time, in microseconds
+     * \param [in] stall Whether the pipeline was
+     *    compiled synchronously on the CS thread
+     */
+    void addGraphicsPipeline(
+      const DxvkGraphicsPipelineShaders&  shaders,
+            uint64_t                      time,
+            bool                          stall);
+
+    /**
+     * \brief Records a compute pipeline compilation
+     *
+     * \param [in] shaders Pipeline shaders
+     * \param [in] time Compile time, in microseconds
+     * \param [in] stall Whether the pipeline was
+     *    compiled synchronously on the CS thread
+     */
+    void addComputePipeline(
+      const DxvkComputePipelineShaders&   shaders,
+            uint64_t                      time,
+            bool                          stall);
+
+    /**
+     * \brief Total time spent in stalling compiles
+     * \returns Stall time, in microseconds
+     */
+    uint64_t getStallTime() const {
+      return m_stallTime.load();
+    }
+
+    /**
+     * \brief Writes report
+     *
+     * Logs the pipelines that caused the most stall
+     * time, and writes all collected data to the
+     * JSON file, if one was specified.
+     */
+    void writeReport();
+
+  private:
+
+    using Entry = std::pair<DxvkStateCacheKey, DxvkPipelineCompileStats>;
+
+    std::atomic<uint64_t> m_stallTime = { 0ull };
+
+    std::mutex            m_mutex;
+
+    std::unordered_map<
+      DxvkStateCacheKey,
+      DxvkPipelineCompileStats,
+      DxvkHash, DxvkEq> m_entries;
+
+    std::string m_jsonPath;
+
+    void addPipeline(
+      const DxvkStateCacheKey&            key,
+            uint64_t                      time,
+            bool                          stall);
+
+    void writeJson(
+      const std::vector<Entry>&           entries) const;
+
+    static DxvkShaderKey getShaderKey(
+      const Rc<DxvkShader>&               shader);
+
+    static std::string getShaderNames(
+      const DxvkStateCacheKey&            key);
+
+  };
+
+}
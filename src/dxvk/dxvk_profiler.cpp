@@ -0,0 +1,131 @@
+#include "dxvk_profiler.h"
+
+namespace dxvk {
+
+  void DxvkCommitProfile::merge(const DxvkCommitProfile& other) {
+    for (uint32_t i = 0; i < NumStages; i++) {
+      m_stages[i].calls += other.m_stages[i].calls;
+      m_stages[i].ticks += other.m_stages[i].ticks;
+
+      for (uint32_t j = 0; j < NumBuckets; j++)
+        m_stages[i].histogram[j] += other.m_stages[i].histogram[j];
+    }
+  }
+
+
+  void DxvkCommitProfile::reset() {
+    for (uint32_t i = 0; i < NumStages; i++)
+      m_stages[i] = StageData();
+  }
+
+
+  uint64_t DxvkCommitProfile::percentile(DxvkCommitStage stage, uint32_t percentile) const {
+    const auto& data = m_stages[uint32_t(stage)];
+
+    uint64_t threshold = (data.calls * percentile + 99) / 100;
+    uint64_t count = 0;
+
+    for (uint32_t i = 0; i < NumBuckets; i++) {
+      count += data.histogram[i];
+
+      if (count >= threshold && count)
+        return uint64_t(1) << i;
+    }
+
+    return 0;
+  }
+
+
+  DxvkCommitProfiler::DxvkCommitProfiler()
+  : m_startTicks(__rdtsc()),
+    m_startTime (dxvk::high_resolution_clock::now()) {
+    std::string csvPath = env::getEnvVar("DXVK_COMMIT_PROFILE");
+
+    if (!csvPath.empty()) {
+      m_csvFile = std::ofstream(csvPath, std::ios_base::trunc);
+
+      if (m_csvFile)
+        m_csvFile << "frame,stage,calls,total_us,p50_us,p99_us" << std::endl;
+      else
+        Logger::warn(str::format("DxvkCommitProfiler: Failed to open ", csvPath));
+    }
+  }
+
+
+  DxvkCommitProfiler::~DxvkCommitProfiler() {
+
+  }
+
+
+  void DxvkCommitProfiler::addProfile(const DxvkCommitProfile& profile) {
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+    m_current.merge(profile);
+  }
+
+
+  void DxvkCommitProfiler::endFrame() {
+    DxvkCommitProfile profile;
+
+    { std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+      // Re-calibrate the TSC frequency using the
+      // entire time the profiler has been running
+      uint64_t ticks = __rdtsc() - m_startTicks;
+      auto time = dxvk::high_resolution_clock::now() - m_startTime;
+
+      if (ticks) {
+        m_usPerTick = std::chrono::duration<double, std::micro>(time).count()
+                    / double(ticks);
+      }
+
+      m_previous = m_current;
+      m_current.reset();
+      m_frameId += 1;
+
+      profile = m_previous;
+    }
+
+    if (m_csvFile)
+      this->writeCsv(profile);
+  }
+
+
+  DxvkCommitProfile DxvkCommitProfiler::getFrameProfile() {
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+    return m_previous;
+  }
+
+
+  const char* DxvkCommitProfiler::getStageName(DxvkCommitStage stage) {
+    switch (stage) {
+      case DxvkCommitStage::Pipeline:       return "Pipeline";
+      case DxvkCommitStage::Barriers:       return "Barriers";
+      case DxvkCommitStage::Framebuffer:    return "Framebuffer";
+      case DxvkCommitStage::RenderPass:     return "Render pass";
+      case DxvkCommitStage::IndexBuffer:    return "Index buffer";
+      case DxvkCommitStage::VertexBuffers:  return "Vertex buffers";
+      case DxvkCommitStage::Resources:      return "Resources";
+      case DxvkCommitStage::PipelineState:  return "Pipeline state";
+      case DxvkCommitStage::DynamicState:   return "Dynamic state";
+      case DxvkCommitStage::PushConstants:  return "Push constants";
+      case DxvkCommitStage::Total:          return "Total";
+      default:                              return "";
+    }
+  }
+
+
+  void DxvkCommitProfiler::writeCsv(const DxvkCommitProfile& profile) {
+    for (uint32_t i = 0; i < DxvkCommitProfile::NumStages; i++) {
+      auto stage = DxvkCommitStage(i);
+      const auto& data = profile.stage(stage);
+
+      m_csvFile << m_frameId << ","
+                << getStageName(stage) << ","
+                << data.calls << ","
+                << ticksToUs(data.ticks) << ","
+                << ticksToUs(profile.percentile(stage, 50)) << ","
+                << ticksToUs(profile.percentile(stage, 99)) << "\n";
+    }
+  }
+
+}
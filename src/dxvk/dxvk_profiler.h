@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+#include "../util/util_bit.h"
+#include "../util/util_time.h"
+
+#include "dxvk_include.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Draw-time state commit stages
+   *
+   * Stages of \c DxvkContext::commitGraphicsState
+   * that are timed individually by the profiler.
+   */
+  enum class DxvkCommitStage : uint32_t {
+    Pipeline,                 ///< Pipeline object lookup
+    Barriers,                 ///< Resource barriers
+    Framebuffer,              ///< Framebuffer lookup
+    RenderPass,               ///< Render pass begin
+    IndexBuffer,              ///< Index buffer binding
+    VertexBuffers,            ///< Vertex buffer bindings
+    Resources,                ///< Descriptor updates
+    PipelineState,            ///< Pipeline binding and compilation
+    DynamicState,             ///< Dynamic, predicate and XFB state
+    PushConstants,            ///< Push constants
+    Total,                    ///< Entire commit
+    NumStages,
+  };
+
+
+  /**
+   * \brief Commit profile
+   *
+   * Stores CPU time spent in each commit stage, as
+   * well as a histogram of the per-call cost. Times
+   * are measured in TSC ticks, and histogram bucket
+   * \c i counts calls that took less than \c 2^i
+   * ticks.
+   */
+  class DxvkCommitProfile {
+
+  public:
+
+    constexpr static uint32_t NumStages  = uint32_t(DxvkCommitStage::NumStages);
+    constexpr static uint32_t NumBuckets = 32;
+
+    struct StageData {
+      uint64_t calls = 0;
+      uint64_t ticks = 0;
+      std::array<uint32_t, NumBuckets> histogram = { };
+    };
+
+    /**
+     * \brief Records a single call
+     *
+     * \param [in] stage Commit stage
+     * \param [in] ticks TSC ticks spent in the stage
+     */
+    void add(DxvkCommitStage stage, uint64_t ticks) {
+      auto& data = m_stages[uint32_t(stage)];
+      data.calls += 1;
+      data.ticks += ticks;
+
+      uint32_t bucket = ticks >> 32
+        ? NumBuckets - 1
+        : 32 - bit::lzcnt(uint32_t(ticks));
+
+      data.histogram[std::min(bucket, NumBuckets - 1)] += 1;
+    }
+
+    /**
+     * \brief Retrieves data for a given stage
+     *
+     * \param [in] stage Commit stage
+     * \returns Stage data
+     */
+    const StageData& stage(DxvkCommitStage stage) const {
+      return m_stages[uint32_t(stage)];
+    }
+
+    /**
+     * \brief Merges another profile into this one
+     * \param [in] other Profile to add
+     */
+    void merge(const DxvkCommitProfile& other);
+
+    /**
+     * \brief Resets all data
+     */
+    void reset();
+
+    /**
+     * \brief Estimates percentile of per-call cost
+     *
+     * Returns the upper bound of the histogram bucket
+     * that contains the given percentile.
+     * \param [in] stage Commit stage
+     * \param [in] percentile Percentile, between 0 and 100
+     * \returns Upper bound, in TSC ticks
+     */
+    uint64_t percentile(DxvkCommitStage stage, uint32_t percentile) const;
+
+  private:
+
+    std::array<StageData, NumStages> m_stages;
+
+  };
+
+
+  /**
+   * \brief Scoped commit stage timer
+   *
+   * Adds the number of TSC ticks between its
+   * construction and destruction to a profile.
+   */
+  class DxvkCommitTimer {
+
+  public:
+
+    DxvkCommitTimer(
+            DxvkCommitProfile&  profile,
+            DxvkCommitStage     stage)
+    : m_profile(profile), m_stage(stage), m_start(__rdtsc()) { }
+
+    ~DxvkCommitTimer() {
+      m_profile.add(m_stage, __rdtsc() - m_start);
+    }
+
+    DxvkCommitTimer             (const DxvkCommitTimer&) = delete;
+    DxvkCommitTimer& operator = (const DxvkCommitTimer&) = delete;
+
+  private:
+
+    DxvkCommitProfile&  m_profile;
+    DxvkCommitStage     m_stage;
+    uint64_t            m_start;
+
+  };
+
+
+  /**
+   * \brief Commit profiler
+   *
+   * Collects commit profiles from all contexts
+   * and aggregates them per frame. If the
+   * \c DXVK_COMMIT_PROFILE variable is set,
+   * per-frame statistics will be written
+   * to the given file in CSV format.
+   */
+  class DxvkCommitProfiler {
+
+  public:
+
+    DxvkCommitProfiler();
+
+    ~DxvkCommitProfiler();
+
+    /**
+     * \brief Adds profile data of a command list
+     * \param [in] profile Commit profile
+     */
+    void addProfile(const DxvkCommitProfile& profile);
+
+    /**
+     * \brief Finishes the current frame
+     *
+     * Makes the data collected for the current
+     * frame available and writes it to the CSV
+     * log, if enabled.
+     */
+    void endFrame();
+
+    /**
+     * \brief Retrieves profile of the last frame
+     * \returns Commit profile of the last frame
+     */
+    DxvkCommitProfile getFrameProfile();
+
+    /**
+     * \brief Converts TSC ticks to microseconds
+     *
+     * \param [in] ticks Number of ticks
+     * \returns Time in microseconds
+     */
+    double ticksToUs(uint64_t ticks) const {
+      return double(ticks) * m_usPerTick;
+    }
+
+    /**
+     * \brief Retrieves commit stage name
+     *
+     * \param [in] stage Commit stage
+     * \returns Name of the stage
+     */
+    static const char* getStageName(DxvkCommitStage stage);
+
+  private:
+
+    sync::Spinlock    m_mutex;
+
+    DxvkCommitProfile m_current;
+    DxvkCommitProfile m_previous;
+    uint64_t          m_frameId = 0;
+
+    uint64_t                                m_startTicks;
+    dxvk::high_resolution_clock::time_point m_startTime;
+    double                                  m_usPerTick = 0.0;
+
+    std::ofstream     m_csvFile;
+
+    void writeCsv(const DxvkCommitProfile& profile);
+
+  };
+
+}
+
+
+#ifdef DXVK_COMMIT_PROFILER
+#define DXVK_PROFILE_COMMIT(profile, stage) \
+  DxvkCommitTimer _profiler_##stage((profile), DxvkCommitStage::stage)
+#else
+#define DXVK_PROFILE_COMMIT(profile, stage)
+#endif
@@ -104,10 +104,14 @@ namespace dxvk {
         std::lock_guard<std::mutex> lock(m_mutexQueue);
 
         if (entry.submit.cmdList != nullptr) {
+          TraceScope trace("queue", "Submit");
+
           status = entry.submit.cmdList->submit(
             entry.submit.waitSync,
             entry.submit.wakeSync);
         } else if (entry.present.presenter != nullptr) {
+          TraceScope trace("queue", "Present");
+
           status = entry.present.presenter->presentImage(
             entry.present.waitSync);
         }
@@ -163,8 +167,10 @@ namespace dxvk {
       
       VkResult status = m_lastError.load();
       
-      if (status != VK_ERROR_DEVICE_LOST)
+      if (status != VK_ERROR_DEVICE_LOST) {
+        TraceScope trace("queue", "Wait for fence");
         status = entry.submit.cmdList->synchronize();
+      }
       
       if (status != VK_SUCCESS) {
         Logger::err(str::format("DxvkSubmissionQueue: Failed to sync fence: ", status));
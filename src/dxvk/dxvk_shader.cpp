@@ -1,5 +1,7 @@
 #include "dxvk_shader.h"
 
+#include "../util/thread.h"
+
 #include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
@@ -42,28 +44,34 @@ namespace dxvk {
   }
 
 
-  DxvkShaderModule::DxvkShaderModule()
-  : m_vkd(nullptr), m_stage() {
-
+  bool DxvkShaderModuleKey::eq(const DxvkShaderModuleKey& other) const {
+    return bindingIds      == other.bindingIds
+        && fsDualSrcBlend  == other.fsDualSrcBlend
+        && undefinedInputs == other.undefinedInputs;
   }
 
 
-  DxvkShaderModule::DxvkShaderModule(DxvkShaderModule&& other)
-  : m_vkd(std::move(other.m_vkd)) {
-    this->m_stage = other.m_stage;
-    other.m_stage = VkPipelineShaderStageCreateInfo();
+  size_t DxvkShaderModuleKey::hash() const {
+    DxvkHashState state;
+
+    for (uint32_t id : bindingIds)
+      state.add(id);
+
+    state.add(uint32_t(fsDualSrcBlend));
+    state.add(undefinedInputs);
+    return state;
   }
 
 
   DxvkShaderModule::DxvkShaderModule(
     const Rc<vk::DeviceFn>&     vkd,
-    const Rc<DxvkShader>&       shader,
+          VkShaderStageFlagBits stage,
     const SpirvCodeBuffer&      code)
   : m_vkd(vkd), m_stage() {
     m_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     m_stage.pNext = nullptr;
     m_stage.flags = 0;
-    m_stage.stage = shader->stage();
+    m_stage.stage = stage;
     m_stage.module = VK_NULL_HANDLE;
     m_stage.pName = "main";
     m_stage.pSpecializationInfo = nullptr;
@@ -81,18 +89,8 @@ namespace dxvk {
   
   
   DxvkShaderModule::~DxvkShaderModule() {
-    if (m_vkd != nullptr) {
-      m_vkd->vkDestroyShaderModule(
-        m_vkd->device(), m_stage.module, nullptr);
-    }
-  }
-  
-  
-  DxvkShaderModule& DxvkShaderModule::operator = (DxvkShaderModule&& other) {
-    this->m_vkd   = std::move(other.m_vkd);
-    this->m_stage = other.m_stage;
-    other.m_stage = VkPipelineShaderStageCreateInfo();
-    return *this;
+    m_vkd->vkDestroyShaderModule(
+      m_vkd->device(), m_stage.module, nullptr);
   }
 
 
@@ -117,8 +115,12 @@ namespace dxvk {
     for (auto ins : code) {
       if (ins.opCode() == spv::OpDecorate) {
         if (ins.arg(2) == spv::DecorationBinding
-         || ins.arg(2) == spv::DecorationSpecId)
+         || ins.arg(2) == spv::DecorationSpecId) {
           m_idOffsets.push_back(ins.offset() + 3);
+
+          if (ins.arg(3) < MaxNumResourceSlots)
+            m_bindingSlots.push_back(ins.arg(3));
+        }
         
         if (ins.arg(2) == spv::DecorationLocation && ins.arg(3) == 1) {
           m_o1LocOffset = ins.offset() + 3;
@@ -145,6 +147,11 @@ namespace dxvk {
           m_flags.set(DxvkShaderFlag::ExportsViewportIndexLayerFromVertexStage);
       }
     }
+
+    // Only the binding IDs of slots that are actually
+    // referenced by the code affect shader modules
+    std::sort(m_bindingSlots.begin(), m_bindingSlots.end());
+    m_bindingSlots.erase(std::unique(m_bindingSlots.begin(), m_bindingSlots.end()), m_bindingSlots.end());
   }
   
   
@@ -166,7 +173,37 @@ namespace dxvk {
   }
   
   
-  DxvkShaderModule DxvkShader::createShaderModule(
+  Rc<DxvkShaderModule> DxvkShader::createShaderModule(
+    const Rc<vk::DeviceFn>&          vkd,
+    const DxvkDescriptorSlotMapping& mapping,
+    const DxvkShaderModuleCreateInfo& info) {
+    DxvkShaderModuleKey key;
+    key.bindingIds.reserve(m_bindingSlots.size());
+
+    for (uint32_t slot : m_bindingSlots)
+      key.bindingIds.push_back(mapping.getBindingId(slot));
+
+    key.fsDualSrcBlend  = info.fsDualSrcBlend && m_o1IdxOffset && m_o1LocOffset;
+    key.undefinedInputs = info.undefinedInputs;
+
+    { std::lock_guard<std::mutex> lock(m_moduleMutex);
+
+      auto entry = m_modules.find(key);
+      if (entry != m_modules.end())
+        return entry->second;
+    }
+
+    // Compile without holding the lock so that other threads can
+    // still look up existing modules. If two threads race to create
+    // the same module, the one inserted first wins.
+    Rc<DxvkShaderModule> module = compileShaderModule(vkd, mapping, info);
+
+    std::lock_guard<std::mutex> lock(m_moduleMutex);
+    return m_modules.emplace(key, module).first->second;
+  }
+
+
+  Rc<DxvkShaderModule> DxvkShader::compileShaderModule(
     const Rc<vk::DeviceFn>&          vkd,
     const DxvkDescriptorSlotMapping& mapping,
     const DxvkShaderModuleCreateInfo& info) {
@@ -188,7 +225,7 @@ namespace dxvk {
     for (uint32_t u = info.undefinedInputs; u; u &= u - 1)
       eliminateInput(spirvCode, bit::tzcnt(u));
 
-    return DxvkShaderModule(vkd, this, spirvCode);
+    return new DxvkShaderModule(vkd, m_stage, spirvCode);
   }
   
   
@@ -197,6 +234,12 @@ namespace dxvk {
   }
 
 
+  uint32_t DxvkShader::getTranslationThreadCount() {
+    uint32_t numCpuCores = dxvk::thread::hardware_concurrency();
+    return std::clamp(numCpuCores / 2, 1u, uint32_t(MaxNumTranslationThreads));
+  }
+
+
   void DxvkShader::eliminateInput(SpirvCodeBuffer& code, uint32_t location) {
     struct SpirvTypeInfo {
       spv::Op           op            = spv::OpNop;
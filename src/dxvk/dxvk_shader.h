@@ -1,7 +1,10 @@
 #pragma once
 
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include "dxvk_hash.h"
 #include "dxvk_include.h"
 #include "dxvk_limits.h"
 #include "dxvk_pipelayout.h"
@@ -124,6 +127,25 @@ namespace dxvk {
     bool      fsDualSrcBlend  = false;
     uint32_t  undefinedInputs = 0;
   };
+
+
+  /**
+   * \brief Shader module key
+   *
+   * Stores everything that affects the code of a
+   * shader module created from a given shader, i.e.
+   * the binding IDs that the shader's resource slots
+   * are mapped to, as well as the module create info.
+   */
+  struct DxvkShaderModuleKey {
+    std::vector<uint32_t> bindingIds;
+    bool                  fsDualSrcBlend  = false;
+    uint32_t              undefinedInputs = 0;
+
+    bool eq(const DxvkShaderModuleKey& other) const;
+
+    size_t hash() const;
+  };
   
   
   /**
@@ -178,13 +200,16 @@ namespace dxvk {
     /**
      * \brief Creates a shader module
      * 
-     * Maps the binding slot numbers 
+     * Maps the binding slot numbers and applies the
+     * given create info. Modules are cached, so that
+     * pipelines using the same shader with the same
+     * binding layout can share a single module.
      * \param [in] vkd Vulkan device functions
      * \param [in] mapping Resource slot mapping
      * \param [in] info Module create info
      * \returns The shader module
      */
-    DxvkShaderModule createShaderModule(
+    Rc<DxvkShaderModule> createShaderModule(
       const Rc<vk::DeviceFn>&          vkd,
       const DxvkDescriptorSlotMapping& mapping,
       const DxvkShaderModuleCreateInfo& info);
@@ -276,6 +301,17 @@ namespace dxvk {
     static size_t getHash(const Rc<DxvkShader>& shader) {
       return shader != nullptr ? shader->getHash() : 0;
     }
+
+    /**
+     * \brief Number of shader translation threads
+     *
+     * Shared by the front-ends that translate shaders
+     * to SPIR-V on worker threads. Pipeline compilation
+     * has its own set of threads, so this only uses a
+     * fraction of the available CPU cores.
+     * \returns Number of worker threads to start
+     */
+    static uint32_t getTranslationThreadCount();
     
   private:
     
@@ -294,6 +330,19 @@ namespace dxvk {
     size_t m_o1IdxOffset = 0;
     size_t m_o1LocOffset = 0;
 
+    std::vector<uint32_t>         m_bindingSlots;
+
+    std::mutex                    m_moduleMutex;
+    std::unordered_map<
+      DxvkShaderModuleKey,
+      Rc<DxvkShaderModule>,
+      DxvkHash, DxvkEq>           m_modules;
+
+    Rc<DxvkShaderModule> compileShaderModule(
+      const Rc<vk::DeviceFn>&          vkd,
+      const DxvkDescriptorSlotMapping& mapping,
+      const DxvkShaderModuleCreateInfo& info);
+
     static void eliminateInput(SpirvCodeBuffer& code, uint32_t location);
 
   };
@@ -306,23 +355,24 @@ namespace dxvk {
    * perform any shader compilation. Instead, the
    * context will create pipeline objects on the
    * fly when executing draw calls.
+   *
+   * Shader modules are shared between all pipelines
+   * that use the same variant of a shader, and the
+   * Vulkan object is destroyed with the last reference.
    */
-  class DxvkShaderModule {
+  class DxvkShaderModule : public RcObject {
     
   public:
 
-    DxvkShaderModule();
-
-    DxvkShaderModule(DxvkShaderModule&& other);
-    
     DxvkShaderModule(
       const Rc<vk::DeviceFn>&     vkd,
-      const Rc<DxvkShader>&       shader,
+            VkShaderStageFlagBits stage,
       const SpirvCodeBuffer&      code);
     
     ~DxvkShaderModule();
 
-    DxvkShaderModule& operator = (DxvkShaderModule&& other);
+    DxvkShaderModule             (const DxvkShaderModule&) = delete;
+    DxvkShaderModule& operator = (const DxvkShaderModule&) = delete;
     
     /**
      * \brief Shader stage creation info
@@ -337,14 +387,6 @@ namespace dxvk {
       return stage;
     }
     
-    /**
-     * \brief Checks whether module is valid
-     * \returns \c true if module is valid
-     */
-    operator bool () const {
-      return m_stage.module != VK_NULL_HANDLE;
-    }
-    
   private:
     
     Rc<vk::DeviceFn>                m_vkd;
@@ -116,6 +116,22 @@ namespace dxvk {
   }
 
 
+  bool DxvkStateCacheSignature::eq(const DxvkStateCacheSignature& other) const {
+    return this->stage       == other.stage
+        && this->inputSlots  == other.inputSlots
+        && this->outputSlots == other.outputSlots;
+  }
+
+
+  size_t DxvkStateCacheSignature::hash() const {
+    DxvkHashState hash;
+    hash.add(this->stage);
+    hash.add(this->inputSlots);
+    hash.add(this->outputSlots);
+    return hash;
+  }
+
+
   DxvkStateCache::DxvkStateCache(
     const DxvkDevice*           device,
           DxvkPipelineManager*  pipeManager,
@@ -164,6 +180,9 @@ namespace dxvk {
     if (device->config().numCompilerThreads > 0)
       numWorkers = device->config().numCompilerThreads;
     
+    if (device->config().numPredictedPipelines > 0)
+      m_predictionBudget = device->config().numPredictedPipelines;
+    
     Logger::info(str::format("DXVK: Using ", numWorkers, " compiler threads"));
     
     // Start the worker threads and the file writer
@@ -192,6 +211,14 @@ namespace dxvk {
       worker.join();
     
     m_writerThread.join();
+
+    uint32_t predictionCount = m_predictionCount.load();
+    uint32_t predictionHits  = m_predictionHits.load();
+
+    if (predictionCount) {
+      Logger::info(str::format("DXVK: Predicted ", predictionCount, " pipelines, ",
+        predictionHits, " used (", (100 * predictionHits) / predictionCount, "%)"));
+    }
   }
 
 
@@ -278,6 +305,25 @@ namespace dxvk {
       m_workerQueue.push(item);
     }
 
+    if (pipelines.first != pipelines.second) {
+      // Known shaders can serve as a template for new ones
+      DxvkStateCacheSignature signature = getShaderSignature(shader);
+
+      if (signature.stage)
+        m_signatureMap.insert({ signature, key });
+    } else if (m_predictionBudget) {
+      // Shader was not used in previous sessions, try
+      // to guess which pipelines are going to be used
+      std::vector<WorkerItem> items;
+      predictPipelines(shader, items);
+
+      if (!items.empty() && !workerLock)
+        workerLock = std::unique_lock<std::mutex>(m_workerLock);
+
+      for (const auto& item : items)
+        m_workerQueue.push(item);
+    }
+
     if (workerLock)
       m_workerCond.notify_all();
   }
@@ -319,6 +365,15 @@ namespace dxvk {
 
 
   void DxvkStateCache::compilePipelines(const WorkerItem& item) {
+    if (item.predictedEntry != InvalidEntry) {
+      const auto& entry = m_entries[item.predictedEntry];
+
+      auto pipeline = m_pipeManager->createGraphicsPipeline(item.gp);
+      auto rp = m_passManager->getRenderPass(entry.format);
+      pipeline->compilePipeline(entry.gpState, rp, true);
+      return;
+    }
+
     DxvkStateCacheKey key;
     key.vs  = getShaderKey(item.gp.vs);
     key.tcs = getShaderKey(item.gp.tcs);
@@ -335,7 +390,7 @@ namespace dxvk {
         const auto& entry = m_entries[e->second];
 
         auto rp = m_passManager->getRenderPass(entry.format);
-        pipeline->compilePipeline(entry.gpState, rp);
+        pipeline->compilePipeline(entry.gpState, rp, false);
       }
     } else {
       auto pipeline = m_pipeManager->createComputePipeline(item.cp);
@@ -349,6 +404,131 @@ namespace dxvk {
   }
 
 
+  void DxvkStateCache::predictPipelines(
+    const Rc<DxvkShader>&           shader,
+          std::vector<WorkerItem>&  items) {
+    DxvkStateCacheSignature signature = getShaderSignature(shader);
+
+    if (!signature.stage)
+      return;
+
+    // Applications commonly create vertex and fragment shaders
+    // in pairs, so if a new fragment shader immediately follows
+    // a new vertex shader, try to predict pipelines for both.
+    Rc<DxvkShader> vs;
+    Rc<DxvkShader> fs;
+
+    if (signature.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+      vs = shader;
+      m_lastNewVs = shader;
+    } else {
+      fs = shader;
+      vs = std::exchange(m_lastNewVs, nullptr);
+    }
+
+    std::vector<PredictionCandidate> candidates;
+    auto similar = m_signatureMap.equal_range(signature);
+
+    for (auto s = similar.first; s != similar.second; s++)
+      addPredictionCandidates(s->second, vs, fs, candidates);
+
+    std::sort(candidates.begin(), candidates.end(),
+      [] (const PredictionCandidate& a, const PredictionCandidate& b) {
+        return a.score > b.score;
+      });
+
+    for (size_t i = 0; i < candidates.size() && i < m_predictionBudget; i++) {
+      WorkerItem item;
+      item.gp = candidates[i].gp;
+      item.predictedEntry = candidates[i].entryId;
+      items.push_back(item);
+    }
+
+    m_predictionCount += items.size();
+  }
+
+
+  void DxvkStateCache::addPredictionCandidates(
+    const DxvkShaderKey&            similarShader,
+    const Rc<DxvkShader>&           vs,
+    const Rc<DxvkShader>&           fs,
+          std::vector<PredictionCandidate>& candidates) {
+    auto pipelines = m_pipelineMap.equal_range(similarShader);
+
+    for (auto p = pipelines.first; p != pipelines.second; p++) {
+      const DxvkStateCacheKey& key = p->second;
+
+      if (!key.cs.eq(g_nullShaderKey))
+        continue;
+
+      DxvkGraphicsPipelineShaders gp;
+
+      if (!getShaderByKey(key.vs,  gp.vs)
+       || !getShaderByKey(key.tcs, gp.tcs)
+       || !getShaderByKey(key.tes, gp.tes)
+       || !getShaderByKey(key.gs,  gp.gs)
+       || !getShaderByKey(key.fs,  gp.fs))
+        continue;
+
+      // Substitute the new shaders for the known ones. If both
+      // shaders are new, the prediction is a lot more likely to
+      // be useful, so prefer those candidates over others.
+      uint32_t score = 1;
+
+      if (fs != nullptr) {
+        gp.fs = fs;
+
+        if (vs != nullptr && gp.vs != nullptr
+         && getShaderSignature(gp.vs).eq(getShaderSignature(vs))) {
+          gp.vs = vs;
+          score = 2;
+        }
+      } else {
+        gp.vs = vs;
+      }
+
+      auto entries = m_entryMap.equal_range(key);
+
+      for (auto e = entries.first; e != entries.second; e++) {
+        const DxvkStateCacheEntry& entry = m_entries[e->second];
+        bool found = false;
+
+        for (auto& c : candidates) {
+          const DxvkStateCacheEntry& other = m_entries[c.entryId];
+
+          if (c.gp.eq(gp) && other.format.eq(entry.format) && other.gpState == entry.gpState) {
+            c.score += score;
+            found = true;
+            break;
+          }
+        }
+
+        if (!found) {
+          if (candidates.size() >= MaxPredictionCandidates)
+            return;
+
+          candidates.push_back({ gp, e->second, score });
+        }
+      }
+    }
+  }
+
+
+  DxvkStateCacheSignature DxvkStateCache::getShaderSignature(
+    const Rc<DxvkShader>&           shader) {
+    DxvkStateCacheSignature signature;
+
+    if (shader->stage() == VK_SHADER_STAGE_VERTEX_BIT
+     || shader->stage() == VK_SHADER_STAGE_FRAGMENT_BIT) {
+      signature.stage       = shader->stage();
+      signature.inputSlots  = shader->interfaceSlots().inputSlots;
+      signature.outputSlots = shader->interfaceSlots().outputSlots;
+    }
+
+    return signature;
+  }
+
+
   bool DxvkStateCache::readCacheFile() {
     // Open state file and just fail if it doesn't exist
     std::ifstream ifile(getCacheFileName(), std::ios_base::binary);
@@ -79,13 +79,34 @@ namespace dxvk {
       return m_workerBusy.load() > 0;
     }
 
+    /**
+     * \brief Notifies use of a predicted pipeline
+     *
+     * Called when a pipeline that was compiled
+     * speculatively is used for the first time.
+     */
+    void notifyPredictionHit() {
+      m_predictionHits += 1;
+    }
+
   private:
 
+    constexpr static size_t InvalidEntry = ~size_t(0);
+
+    constexpr static size_t MaxPredictionCandidates = 256;
+
     using WriterItem = DxvkStateCacheEntry;
 
     struct WorkerItem {
       DxvkGraphicsPipelineShaders gp;
       DxvkComputePipelineShaders  cp;
+      size_t                      predictedEntry = InvalidEntry;
+    };
+
+    struct PredictionCandidate {
+      DxvkGraphicsPipelineShaders gp;
+      size_t                      entryId;
+      uint32_t                    score;
     };
 
     DxvkPipelineManager*              m_pipeManager;
@@ -108,6 +129,16 @@ namespace dxvk {
       DxvkShaderKey, Rc<DxvkShader>,
       DxvkHash, DxvkEq> m_shaderMap;
 
+    std::unordered_multimap<
+      DxvkStateCacheSignature, DxvkShaderKey,
+      DxvkHash, DxvkEq> m_signatureMap;
+
+    uint32_t                          m_predictionBudget = 0;
+    Rc<DxvkShader>                    m_lastNewVs;
+
+    std::atomic<uint32_t>             m_predictionCount = { 0u };
+    std::atomic<uint32_t>             m_predictionHits  = { 0u };
+
     std::mutex                        m_workerLock;
     std::condition_variable           m_workerCond;
     std::queue<WorkerItem>            m_workerQueue;
@@ -137,6 +168,19 @@ namespace dxvk {
     void compilePipelines(
       const WorkerItem&               item);
 
+    void predictPipelines(
+      const Rc<DxvkShader>&           shader,
+            std::vector<WorkerItem>&  items);
+
+    void addPredictionCandidates(
+      const DxvkShaderKey&            similarShader,
+      const Rc<DxvkShader>&           vs,
+      const Rc<DxvkShader>&           fs,
+            std::vector<PredictionCandidate>& candidates);
+
+    static DxvkStateCacheSignature getShaderSignature(
+      const Rc<DxvkShader>&           shader);
+
     bool readCacheFile();
 
     bool readCacheHeader(
@@ -25,6 +25,26 @@ namespace dxvk {
     size_t hash() const;
   };
 
+
+  /**
+   * \brief Shader interface signature
+   *
+   * Shaders of the same stage that use the same set
+   * of interface slots are likely to be used with
+   * similar pipeline state, so state vectors seen
+   * for one of them can be used to predict the
+   * pipelines needed for another.
+   */
+  struct DxvkStateCacheSignature {
+    VkShaderStageFlags stage       = 0;
+    uint32_t           inputSlots  = 0;
+    uint32_t           outputSlots = 0;
+
+    bool eq(const DxvkStateCacheSignature& other) const;
+
+    size_t hash() const;
+  };
+
   
   /**
    * \brief State entry
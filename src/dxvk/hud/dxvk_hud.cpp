@@ -37,7 +37,12 @@ namespace dxvk::hud {
     addItem<HudSubmissionStatsItem>("submissions", device);
     addItem<HudDrawCallStatsItem>("drawcalls", device);
     addItem<HudPipelineStatsItem>("pipelines", device);
+    addItem<HudPipelineStallItem>("stalls", device);
+#ifdef DXVK_COMMIT_PROFILER
+    addItem<HudCommitProfileItem>("commit", device);
+#endif
     addItem<HudMemoryStatsItem>("memory", device);
+    addItem<HudSpirvStatsItem>("spirv");
     addItem<HudGpuLoadItem>("gpuload", device);
     addItem<HudCompilerActivityItem>("compiler", device);
   }
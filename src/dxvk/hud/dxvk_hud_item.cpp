@@ -443,6 +443,102 @@ namespace dxvk::hud {
   }
 
 
+  HudPipelineStallItem::HudPipelineStallItem(const Rc<DxvkDevice>& device)
+  : m_device(device) {
+    DxvkStatCounters counters = m_device->getStatCounters();
+    m_prevStallTime = counters.getCtr(DxvkStatCounter::PipeCompilerStallTime);
+  }
+
+
+  HudPipelineStallItem::~HudPipelineStallItem() {
+
+  }
+
+
+  void HudPipelineStallItem::update(dxvk::high_resolution_clock::time_point time) {
+    DxvkStatCounters counters = m_device->getStatCounters();
+    uint64_t currStallTime = counters.getCtr(DxvkStatCounter::PipeCompilerStallTime);
+
+    m_maxStallTime  = std::max(m_maxStallTime, currStallTime - m_prevStallTime);
+    m_prevStallTime = currStallTime;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - m_lastUpdate);
+
+    if (elapsed.count() >= UpdateInterval) {
+      m_showStallTime = m_maxStallTime;
+      m_maxStallTime  = 0;
+      m_lastUpdate    = time;
+    }
+  }
+
+
+  HudPos HudPipelineStallItem::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    position.y += 16.0f;
+
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 1.0f, 0.25f, 1.0f, 1.0f },
+      "Pipeline stalls:");
+
+    renderer.drawText(16.0f,
+      { position.x + 204.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format(m_showStallTime / 1000, ".", (m_showStallTime % 1000) / 100, " ms"));
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
+#ifdef DXVK_COMMIT_PROFILER
+  HudCommitProfileItem::HudCommitProfileItem(const Rc<DxvkDevice>& device)
+  : m_device(device) {
+
+  }
+
+
+  HudCommitProfileItem::~HudCommitProfileItem() {
+
+  }
+
+
+  void HudCommitProfileItem::update(dxvk::high_resolution_clock::time_point time) {
+    m_profile = m_device->commitProfiler().getFrameProfile();
+  }
+
+
+  HudPos HudCommitProfileItem::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    const auto& profiler = m_device->commitProfiler();
+
+    for (uint32_t i = 0; i < DxvkCommitProfile::NumStages; i++) {
+      auto stage = DxvkCommitStage(i);
+      const auto& data = m_profile.stage(stage);
+
+      position.y += 16.0f;
+      renderer.drawText(16.0f,
+        { position.x, position.y },
+        { 0.25f, 1.0f, 1.0f, 1.0f },
+        str::format(DxvkCommitProfiler::getStageName(stage), ":"));
+
+      renderer.drawText(16.0f,
+        { position.x + 192.0f, position.y },
+        { 1.0f, 1.0f, 1.0f, 1.0f },
+        str::format(std::fixed, std::setprecision(1),
+          profiler.ticksToUs(data.ticks), " us (", data.calls, "x, p99 ",
+          profiler.ticksToUs(m_profile.percentile(stage, 99)), " us)"));
+      position.y += 4.0f;
+    }
+
+    position.y += 4.0f;
+    return position;
+  }
+#endif
+
+
   HudMemoryStatsItem::HudMemoryStatsItem(const Rc<DxvkDevice>& device)
   : m_device(device), m_memory(device->adapter()->memoryProperties()) {
 
@@ -490,6 +586,57 @@ namespace dxvk::hud {
   }
 
 
+  HudSpirvStatsItem::HudSpirvStatsItem() {
+    SpirvCompressedBuffer::enableStats();
+  }
+
+
+  HudSpirvStatsItem::~HudSpirvStatsItem() {
+    SpirvCompressedBuffer::disableStats();
+  }
+
+
+  void HudSpirvStatsItem::update(dxvk::high_resolution_clock::time_point time) {
+    m_stats = SpirvCompressedBuffer::getStats();
+  }
+
+
+  HudPos HudSpirvStatsItem::render(
+          HudRenderer&      renderer,
+          HudPos            position) {
+    // Bytes per nanosecond happen to be GB/s
+    uint64_t memKib = m_stats.liveBytes >> 10;
+    double   rate   = m_stats.decodeTimeNs
+      ? double(m_stats.decodedBytes) / double(m_stats.decodeTimeNs)
+      : 0.0;
+
+    position.y += 16.0f;
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 1.0f, 1.0f, 0.25f, 1.0f },
+      "SPIR-V memory:");
+
+    renderer.drawText(16.0f,
+      { position.x + 168.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format(std::setfill(' '), std::setw(5), memKib, " kB"));
+
+    position.y += 20.0f;
+    renderer.drawText(16.0f,
+      { position.x, position.y },
+      { 1.0f, 1.0f, 0.25f, 1.0f },
+      "SPIR-V decode:");
+
+    renderer.drawText(16.0f,
+      { position.x + 168.0f, position.y },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format(std::fixed, std::setprecision(1), std::setw(5), rate, " GB/s"));
+
+    position.y += 8.0f;
+    return position;
+  }
+
+
   HudGpuLoadItem::HudGpuLoadItem(const Rc<DxvkDevice>& device)
   : m_device(device) {
 
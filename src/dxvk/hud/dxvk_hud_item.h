@@ -6,6 +6,8 @@
 
 #include "../../util/util_time.h"
 
+#include "../../spirv/spirv_compression.h"
+
 #include "dxvk_hud_renderer.h"
 
 namespace dxvk::hud {
@@ -307,6 +309,71 @@ namespace dxvk::hud {
   };
 
 
+  /**
+   * \brief HUD item to display pipeline compile stalls
+   *
+   * Shows the longest time per frame spent compiling
+   * pipelines on the CS thread within the last update
+   * interval, which is a good indicator for stutter.
+   */
+  class HudPipelineStallItem : public HudItem {
+    constexpr static int64_t UpdateInterval = 500'000;
+  public:
+
+    HudPipelineStallItem(const Rc<DxvkDevice>& device);
+
+    ~HudPipelineStallItem();
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    Rc<DxvkDevice> m_device;
+
+    uint64_t m_prevStallTime = 0;
+    uint64_t m_maxStallTime  = 0;
+    uint64_t m_showStallTime = 0;
+
+    dxvk::high_resolution_clock::time_point m_lastUpdate
+      = dxvk::high_resolution_clock::now();
+
+  };
+
+
+#ifdef DXVK_COMMIT_PROFILER
+  /**
+   * \brief HUD item to display commit profiler data
+   *
+   * Shows the CPU time spent in each stage of
+   * graphics state commits during the last frame.
+   */
+  class HudCommitProfileItem : public HudItem {
+
+  public:
+
+    HudCommitProfileItem(const Rc<DxvkDevice>& device);
+
+    ~HudCommitProfileItem();
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    Rc<DxvkDevice>    m_device;
+    DxvkCommitProfile m_profile;
+
+  };
+#endif
+
+
   /**
    * \brief HUD item to display memory usage
    */
@@ -333,6 +400,34 @@ namespace dxvk::hud {
   };
 
 
+  /**
+   * \brief HUD item to display SPIR-V code stats
+   *
+   * Shows the amount of memory used to store compressed
+   * SPIR-V code for all live shaders, as well as the
+   * average decompression throughput.
+   */
+  class HudSpirvStatsItem : public HudItem {
+
+  public:
+
+    HudSpirvStatsItem();
+
+    ~HudSpirvStatsItem();
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+            HudRenderer&      renderer,
+            HudPos            position);
+
+  private:
+
+    SpirvCompressionStats m_stats;
+
+  };
+
+
   /**
    * \brief HUD item to display GPU load
    */
@@ -1,9 +1,114 @@
+#include <cstring>
+#include <utility>
+
 #include "spirv_compression.h"
 
+#include "../util/util_bit.h"
+#include "../util/util_cpu.h"
+#include "../util/util_time.h"
+
+#ifdef _MSC_VER
+#define DXVK_TARGET_SSSE3
+#else
+#define DXVK_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
 namespace dxvk {
 
-  SpirvCompressedBuffer::SpirvCompressedBuffer()
-  : m_size(0) {
+  // Number of bytes to append to the compressed data, so
+  // that the decoder can always read full 16-byte vectors
+  constexpr size_t SpirvDecodePadding = 16;
+
+  // Masks to extract the packed bytes of a
+  // DWORD, indexed by the two-bit byte count
+  static const uint32_t g_decodeMasks[4] = {
+    0x000000FFu, 0x0000FFFFu, 0x00FFFFFFu, 0xFFFFFFFFu };
+
+  /**
+   * \brief Decode lookup table
+   *
+   * For each control byte, stores the shuffle mask
+   * that expands four packed DWORDs into a vector,
+   * as well as the number of packed bytes consumed.
+   */
+  struct SpirvDecodeTable {
+    uint8_t shuffle[256][16];
+    uint8_t length[256];
+
+    constexpr SpirvDecodeTable()
+    : shuffle(), length() {
+      for (uint32_t c = 0; c < 256; c++) {
+        uint32_t offset = 0;
+
+        for (uint32_t w = 0; w < 4; w++) {
+          uint32_t bytes = ((c >> (2 * w)) & 3) + 1;
+
+          for (uint32_t b = 0; b < 4; b++)
+            shuffle[c][4 * w + b] = b < bytes ? uint8_t(offset + b) : 0x80;
+
+          offset += bytes;
+        }
+
+        length[c] = uint8_t(offset);
+      }
+    }
+  };
+
+  static constexpr SpirvDecodeTable g_decodeTable;
+
+  // Builds only target SSE2, so the shuffle-based decoder
+  // is compiled separately and selected at runtime
+  static const bool g_decodeSsse3 = cpu::hasSsse3();
+
+
+  static void decodeGroupsScalar(
+          uint32_t*         dst,
+          uint32_t          groupCount,
+    const uint8_t*          ctrl,
+    const uint8_t*&         src) {
+    for (uint32_t g = 0; g < groupCount; g++) {
+      uint32_t c = ctrl[g];
+
+      for (uint32_t w = 0; w < 4; w++) {
+        uint32_t lenCode = (c >> (2 * w)) & 3;
+        uint32_t word;
+
+        std::memcpy(&word, src, sizeof(word));
+        dst[4 * g + w] = word & g_decodeMasks[lenCode];
+        src += lenCode + 1;
+      }
+    }
+  }
+
+
+  DXVK_TARGET_SSSE3
+  static void decodeGroupsSsse3(
+          uint32_t*         dst,
+          uint32_t          groupCount,
+    const uint8_t*          ctrl,
+    const uint8_t*&         src) {
+    // The padding guarantees that reading 16 bytes
+    // from the data stream never goes out of bounds
+    for (uint32_t g = 0; g < groupCount; g++) {
+      uint8_t c = ctrl[g];
+
+      __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g_decodeTable.shuffle[c]));
+      __m128i packed  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * g),
+        _mm_shuffle_epi8(packed, shuffle));
+
+      src += g_decodeTable.length[c];
+    }
+  }
+
+  std::atomic<uint64_t> SpirvCompressedBuffer::s_liveBytes    = { 0ull };
+  std::atomic<uint64_t> SpirvCompressedBuffer::s_decodedBytes = { 0ull };
+  std::atomic<uint64_t> SpirvCompressedBuffer::s_decodeTimeNs = { 0ull };
+  std::atomic<uint32_t> SpirvCompressedBuffer::s_statsRefs    = { 0u };
+
+
+  SpirvCompressedBuffer::SpirvCompressedBuffer() {
 
   }
 
@@ -15,56 +120,88 @@ namespace dxvk {
 
     // The compression works by eliminating leading null bytes
     // from DWORDs, exploiting that SPIR-V IDs are consecutive
-    // integers that usually fall into the 16-bit range. For
-    // each DWORD, a two-bit integer is stored which indicates
-    // the number of bytes it takes in the compressed buffer.
-    // This way, it can achieve a compression ratio of ~50%.
-    m_mask.reserve((m_size + NumMaskWords - 1) / NumMaskWords);
-    m_code.reserve((m_size + 1) / 2);
+    // integers that usually fall into the 16-bit range. Like
+    // stream-vbyte, the data is split into a control stream,
+    // which stores a two-bit byte count for each DWORD, and a
+    // data stream with the packed bytes. This way, it can achieve
+    // a compression ratio of ~50% while allowing both encoding
+    // and decoding to be done without data-dependent branches.
+    const size_t ctrlSize = (m_size + 3) / 4;
+
+    m_data.resize(ctrlSize + 4 * size_t(m_size) + SpirvDecodePadding);
+
+    uint8_t* ctrl = m_data.data();
+    uint8_t* dst  = m_data.data() + ctrlSize;
+
+    for (uint32_t i = 0; i < m_size; i++) {
+      uint32_t word = data[i];
+      uint32_t lenCode = uint32_t(word > 0xFFu)
+                       + uint32_t(word > 0xFFFFu)
+                       + uint32_t(word > 0xFFFFFFu);
+
+      ctrl[i / 4] |= uint8_t(lenCode << (2 * (i & 3)));
+
+      // Always write the full DWORD, the next one
+      // will overwrite any unused upper bytes
+      std::memcpy(dst, &word, sizeof(word));
+      dst += lenCode + 1;
+    }
 
-    uint64_t dstWord  = 0;
-    uint32_t dstShift = 0;
+    m_data.resize(size_t(dst - m_data.data()) + SpirvDecodePadding);
+    m_data.shrink_to_fit();
 
-    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
-      uint64_t byteCounts = 0;
+    s_liveBytes += m_data.size();
+  }
 
-      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
-        uint64_t word = data[i + w];
-        uint64_t bytes = 0;
 
-        if      (word < (1 <<  8)) bytes = 0;
-        else if (word < (1 << 16)) bytes = 1;
-        else if (word < (1 << 24)) bytes = 2;
-        else                       bytes = 3;
+  SpirvCompressedBuffer::SpirvCompressedBuffer(
+    const SpirvCompressedBuffer& other)
+  : m_size(other.m_size),
+    m_data(other.m_data) {
+    s_liveBytes += m_data.size();
+  }
 
-        byteCounts |= bytes << (2 * w);
 
-        uint32_t bits = 8 * bytes + 8;
-        uint32_t rem  = bit::pack(dstWord, dstShift, word, bits);
+  SpirvCompressedBuffer::SpirvCompressedBuffer(
+          SpirvCompressedBuffer&& other)
+  : m_size(std::exchange(other.m_size, 0u)),
+    m_data(std::move(other.m_data)) {
+    other.m_data.clear();
+  }
 
-        if (unlikely(rem != 0)) {
-          m_code.push_back(dstWord);
 
-          dstWord  = 0;
-          dstShift = 0;
+  SpirvCompressedBuffer& SpirvCompressedBuffer::operator = (
+    const SpirvCompressedBuffer& other) {
+    if (this != &other) {
+      s_liveBytes -= m_data.size();
 
-          bit::pack(dstWord, dstShift, word >> (bits - rem), rem);
-        }
-      }
+      m_size = other.m_size;
+      m_data = other.m_data;
 
-      m_mask.push_back(byteCounts);
+      s_liveBytes += m_data.size();
     }
 
-    if (dstShift)
-      m_code.push_back(dstWord);
+    return *this;
+  }
+
+
+  SpirvCompressedBuffer& SpirvCompressedBuffer::operator = (
+          SpirvCompressedBuffer&& other) {
+    if (this != &other) {
+      s_liveBytes -= m_data.size();
+
+      m_size = std::exchange(other.m_size, 0u);
+      m_data = std::move(other.m_data);
 
-    m_mask.shrink_to_fit();
-    m_code.shrink_to_fit();
+      other.m_data.clear();
+    }
+
+    return *this;
   }
 
-    
-  SpirvCompressedBuffer::~SpirvCompressedBuffer() {
 
+  SpirvCompressedBuffer::~SpirvCompressedBuffer() {
+    s_liveBytes -= m_data.size();
   }
 
 
@@ -75,36 +212,74 @@ namespace dxvk {
     if (m_size == 0)
       return code;
 
-    uint32_t maskIdx = 0;
-    uint32_t codeIdx = 0;
+    // Only query timestamps while the stats are displayed,
+    // since this is called for every pipeline compile
+    bool collectStats = s_statsRefs.load(std::memory_order_relaxed) != 0;
 
-    uint64_t srcWord  = m_code[codeIdx++];
-    uint32_t srcShift = 0;
+    dxvk::high_resolution_clock::time_point t0;
 
-    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
-      uint64_t srcMask = m_mask[maskIdx++];
+    if (collectStats)
+      t0 = dxvk::high_resolution_clock::now();
 
-      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
-        uint32_t bits = 8 * ((srcMask & 3) + 1);
+    const size_t ctrlSize = (m_size + 3) / 4;
 
-        uint64_t word = 0;
-        uint32_t rem = bit::unpack(word, srcWord, srcShift, bits);
+    const uint8_t* ctrl = m_data.data();
+    const uint8_t* src  = m_data.data() + ctrlSize;
 
-        if (unlikely(rem != 0)) {
-          srcWord  = m_code[codeIdx++];
-          srcShift = 0;
+    // Decode all complete groups of four DWORDs first
+    uint32_t groupCount = m_size / 4;
+    decodeGroups(data, groupCount, src);
 
-          uint64_t tmp = 0;
-          bit::unpack(tmp, srcWord, srcShift, rem);
-          word |= tmp << (bits - rem);
-        }
+    // Decode remaining DWORDs one by one
+    for (uint32_t i = 4 * groupCount; i < m_size; i++) {
+      uint32_t lenCode = (ctrl[i / 4] >> (2 * (i & 3))) & 3;
+      uint32_t word;
 
-        data[i + w] = word;
-        srcMask >>= 2;
-      }
+      std::memcpy(&word, src, sizeof(word));
+      data[i] = word & g_decodeMasks[lenCode];
+      src += lenCode + 1;
+    }
+
+    if (collectStats) {
+      auto t1 = dxvk::high_resolution_clock::now();
+
+      s_decodedBytes += code.size();
+      s_decodeTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
     }
 
     return code;
   }
 
-}
\ No newline at end of file
+
+  SpirvCompressionStats SpirvCompressedBuffer::getStats() {
+    SpirvCompressionStats stats;
+    stats.liveBytes    = s_liveBytes.load();
+    stats.decodedBytes = s_decodedBytes.load();
+    stats.decodeTimeNs = s_decodeTimeNs.load();
+    return stats;
+  }
+
+
+  void SpirvCompressedBuffer::enableStats() {
+    s_statsRefs += 1;
+  }
+
+
+  void SpirvCompressedBuffer::disableStats() {
+    s_statsRefs -= 1;
+  }
+
+
+  void SpirvCompressedBuffer::decodeGroups(
+          uint32_t*         dst,
+          uint32_t          groupCount,
+    const uint8_t*&         src) const {
+    const uint8_t* ctrl = m_data.data();
+
+    if (likely(g_decodeSsse3))
+      decodeGroupsSsse3(dst, groupCount, ctrl, src);
+    else
+      decodeGroupsScalar(dst, groupCount, ctrl, src);
+  }
+
+}
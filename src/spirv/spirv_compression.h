@@ -1,11 +1,25 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 
 #include "spirv_code_buffer.h"
 
 namespace dxvk {
 
+  /**
+   * \brief SPIR-V compression statistics
+   *
+   * Global statistics for all compressed
+   * buffers that exist within the module.
+   */
+  struct SpirvCompressionStats {
+    uint64_t liveBytes    = 0;  ///< Compressed bytes currently held
+    uint64_t decodedBytes = 0;  ///< Uncompressed bytes produced while stats are enabled
+    uint64_t decodeTimeNs = 0;  ///< Time spent decompressing while stats are enabled
+  };
+
+
   /**
    * \brief Compressed SPIR-V code buffer
    *
@@ -13,24 +27,66 @@ namespace dxvk {
    * to keep memory footprint low.
    */
   class SpirvCompressedBuffer {
-    constexpr static uint32_t NumMaskWords = 32;
+
   public:
 
     SpirvCompressedBuffer();
 
     SpirvCompressedBuffer(
       const SpirvCodeBuffer&  code);
-    
+
+    SpirvCompressedBuffer(
+      const SpirvCompressedBuffer& other);
+
+    SpirvCompressedBuffer(
+            SpirvCompressedBuffer&& other);
+
+    SpirvCompressedBuffer& operator = (
+      const SpirvCompressedBuffer& other);
+
+    SpirvCompressedBuffer& operator = (
+            SpirvCompressedBuffer&& other);
+
     ~SpirvCompressedBuffer();
-    
+
     SpirvCodeBuffer decompress() const;
 
+    /**
+     * \brief Queries global compression statistics
+     * \returns Statistics for all live buffers
+     */
+    static SpirvCompressionStats getStats();
+
+    /**
+     * \brief Enables decode statistics
+     *
+     * Decode time and size are only tracked while at
+     * least one caller has enabled statistics, so that
+     * decompression does not have to query timestamps.
+     * Must be paired with a call to \ref disableStats.
+     */
+    static void enableStats();
+
+    /**
+     * \brief Disables decode statistics
+     */
+    static void disableStats();
+
   private:
 
-    uint32_t              m_size;
-    std::vector<uint64_t> m_mask;
-    std::vector<uint64_t> m_code;
+    uint32_t              m_size = 0;
+    std::vector<uint8_t>  m_data;
+
+    static std::atomic<uint64_t> s_liveBytes;
+    static std::atomic<uint64_t> s_decodedBytes;
+    static std::atomic<uint64_t> s_decodeTimeNs;
+    static std::atomic<uint32_t> s_statsRefs;
+
+    void decodeGroups(
+            uint32_t*         dst,
+            uint32_t          groupCount,
+      const uint8_t*&         src) const;
 
   };
 
-}
\ No newline at end of file
+}
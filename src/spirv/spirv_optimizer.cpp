@@ -0,0 +1,1452 @@
+// Needed for spv::HasResultAndType
+#define SPV_ENABLE_UTILITY_CODE
+
+#include <algorithm>
+#include <functional>
+
+#include "spirv_optimizer.h"
+
+#include "../util/util_time.h"
+
+namespace dxvk {
+
+  SpirvOptimizer::SpirvOptimizer(SpirvOptPasses passes)
+  : m_passes(passes) {
+
+  }
+
+
+  SpirvOptimizer::~SpirvOptimizer() {
+
+  }
+
+
+  bool SpirvOptimizer::run(SpirvCodeBuffer& code) {
+    this->reset();
+
+    if (code.dwords() < 5 || code.data()[0] != spv::MagicNumber)
+      return false;
+
+    m_stats.dwordsBefore = code.dwords();
+    m_stats.dwordsAfter  = code.dwords();
+
+    // SSA promotion inserts new instructions, so unlike the other
+    // passes it rewrites the module before we parse it. Promoted
+    // loads become OpCopyObject, which copy propagation forwards,
+    // and variables it cannot promote are left to load/store
+    // elimination, so both passes never touch the same variable.
+    if (m_passes.test(SpirvOptPass::SsaPromotion)) {
+      auto t0 = dxvk::high_resolution_clock::now();
+
+      SpirvSsaPass ssaPass;
+
+      if (ssaPass.run(code)) {
+        m_stats.ssa = ssaPass.stats();
+        m_stats[SpirvOptPass::SsaPromotion].changes = m_stats.ssa.eliminatedLoads + m_stats.ssa.eliminatedStores;
+      }
+
+      auto t1 = dxvk::high_resolution_clock::now();
+
+      m_stats[SpirvOptPass::SsaPromotion].timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+
+    m_code.assign(code.data(), code.data() + code.dwords());
+    m_bound = m_code[3];
+
+    this->parseInstructions();
+    this->parseTypes();
+
+    auto runPass = [this] (SpirvOptPass pass, void (SpirvOptimizer::*fn)()) {
+      if (!m_passes.test(pass))
+        return;
+
+      auto t0 = dxvk::high_resolution_clock::now();
+      (this->*fn)();
+      auto t1 = dxvk::high_resolution_clock::now();
+
+      m_stats[pass].timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    };
+
+    // Passes that replace values only register the replacement
+    // and resolve their own operands through it, so all uses
+    // can be rewritten in one go before dead code removal.
+    runPass(SpirvOptPass::StripInterface,  &SpirvOptimizer::runStripInterface);
+    runPass(SpirvOptPass::CopyPropagation, &SpirvOptimizer::runCopyPropagation);
+    runPass(SpirvOptPass::LoadStoreElim,   &SpirvOptimizer::runLoadStoreElim);
+    runPass(SpirvOptPass::ConstantFolding, &SpirvOptimizer::runConstantFolding);
+
+    this->applyReplacements();
+
+    runPass(SpirvOptPass::DeadCodeElim,    &SpirvOptimizer::runDeadCodeElim);
+
+    uint32_t changes = 0;
+
+    for (const auto& pass : m_stats.passes)
+      changes += pass.changes;
+
+    if (!changes)
+      return false;
+
+    code = this->emitCode();
+
+    m_stats.dwordsAfter = code.dwords();
+    return true;
+  }
+
+
+  SpirvOptPasses SpirvOptimizer::allPasses() {
+    SpirvOptPasses passes = defaultPasses();
+    passes.set(SpirvOptPass::SsaPromotion);
+    return passes;
+  }
+
+
+  SpirvOptPasses SpirvOptimizer::defaultPasses() {
+    return SpirvOptPasses(
+      SpirvOptPass::StripInterface,
+      SpirvOptPass::CopyPropagation,
+      SpirvOptPass::LoadStoreElim,
+      SpirvOptPass::ConstantFolding,
+      SpirvOptPass::DeadCodeElim);
+  }
+
+
+  const char* SpirvOptimizer::passName(SpirvOptPass pass) {
+    switch (pass) {
+      case SpirvOptPass::SsaPromotion:    return "SSA promotion";
+      case SpirvOptPass::StripInterface:  return "Strip interface";
+      case SpirvOptPass::CopyPropagation: return "Copy propagation";
+      case SpirvOptPass::LoadStoreElim:   return "Load/store elimination";
+      case SpirvOptPass::ConstantFolding: return "Constant folding";
+      case SpirvOptPass::DeadCodeElim:    return "Dead code elimination";
+      default:                            return "Unknown";
+    }
+  }
+
+
+  void SpirvOptimizer::reset() {
+    m_stats = SpirvOptStats();
+
+    m_code.clear();
+    m_bound = 0;
+
+    m_instructions.clear();
+    m_defs.clear();
+    m_replacements.clear();
+    m_types.clear();
+    m_constants.clear();
+    m_scalarConstants.clear();
+    m_newConstants.clear();
+    m_newConstantIds.clear();
+  }
+
+
+  void SpirvOptimizer::parseInstructions() {
+    m_defs.resize(m_bound, InvalidIndex);
+
+    uint32_t offset   = 5;
+    uint32_t function = InvalidIndex;
+
+    while (offset < m_code.size()) {
+      Instruction ins;
+      ins.offset  = offset;
+      ins.length  = m_code[offset] >> spv::WordCountShift;
+      ins.op      = spv::Op(m_code[offset] & spv::OpCodeMask);
+      ins.removed = false;
+
+      if (!ins.length || offset + ins.length > m_code.size())
+        break;
+
+      uint32_t index = m_instructions.size();
+
+      if (ins.op == spv::OpFunction)
+        function = index;
+
+      ins.function = function;
+      ins.knownLayout = this->forEachIdOperand(ins, [] (uint32_t&) { });
+
+      if (ins.op == spv::OpFunctionEnd)
+        function = InvalidIndex;
+
+      uint32_t resultId = this->getResultId(ins);
+
+      if (resultId && resultId < m_defs.size())
+        m_defs[resultId] = index;
+
+      m_instructions.push_back(ins);
+      offset += ins.length;
+    }
+  }
+
+
+  void SpirvOptimizer::parseTypes() {
+    for (const auto& ins : m_instructions) {
+      if (ins.function != InvalidIndex)
+        break;
+
+      switch (ins.op) {
+        case spv::OpTypeBool: {
+          TypeInfo type;
+          type.op = ins.op;
+          m_types.insert({ arg(ins, 1), type });
+        } break;
+
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat: {
+          TypeInfo type;
+          type.op    = ins.op;
+          type.width = arg(ins, 2);
+          m_types.insert({ arg(ins, 1), type });
+        } break;
+
+        case spv::OpTypeVector: {
+          TypeInfo type;
+          type.op         = ins.op;
+          type.compTypeId = arg(ins, 2);
+          type.compCount  = arg(ins, 3);
+          m_types.insert({ arg(ins, 1), type });
+        } break;
+
+        case spv::OpConstant: {
+          // Only 32-bit constants have exactly one literal word
+          if (ins.length != 4)
+            break;
+
+          ConstValue value;
+          value.typeId = arg(ins, 1);
+          value.comps  = { arg(ins, 3) };
+
+          m_constants.insert({ arg(ins, 2), value });
+          m_scalarConstants.insert({ (uint64_t(value.typeId) << 32) | value.comps[0], arg(ins, 2) });
+        } break;
+
+        case spv::OpConstantTrue:
+        case spv::OpConstantFalse: {
+          ConstValue value;
+          value.typeId = arg(ins, 1);
+          value.comps  = { ins.op == spv::OpConstantTrue ? 1u : 0u };
+
+          m_constants.insert({ arg(ins, 2), value });
+          m_scalarConstants.insert({ (uint64_t(value.typeId) << 32) | value.comps[0], arg(ins, 2) });
+        } break;
+
+        case spv::OpConstantComposite: {
+          // Only vectors of scalars are of interest here
+          auto type = m_types.find(arg(ins, 1));
+
+          if (type == m_types.end() || type->second.op != spv::OpTypeVector)
+            break;
+
+          ConstValue value;
+          value.typeId = arg(ins, 1);
+
+          for (uint32_t i = 3; i < ins.length; i++) {
+            auto comp = m_constants.find(arg(ins, i));
+
+            if (comp == m_constants.end() || comp->second.comps.size() != 1)
+              break;
+
+            value.comps.push_back(comp->second.comps[0]);
+          }
+
+          if (value.comps.size() == ins.length - 3)
+            m_constants.insert({ arg(ins, 2), value });
+        } break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+
+  void SpirvOptimizer::runStripInterface() {
+    std::unordered_set<uint32_t> inputs;
+
+    for (const auto& ins : m_instructions) {
+      if (ins.op == spv::OpVariable
+       && ins.function == InvalidIndex
+       && arg(ins, 3) == spv::StorageClassInput)
+        inputs.insert(arg(ins, 2));
+    }
+
+    // Built-ins may affect pipeline behaviour even if they
+    // are never read, e.g. SampleId enables sample shading,
+    // and the same goes for sample interpolation.
+    for (const auto& ins : m_instructions) {
+      if (ins.removed || inputs.empty())
+        continue;
+
+      switch (ins.op) {
+        case spv::OpEntryPoint:
+        case spv::OpName:
+        case spv::OpMemberName:
+        case spv::OpMemberDecorate:
+          break;
+
+        case spv::OpDecorate:
+          if (arg(ins, 2) == spv::DecorationBuiltIn
+           || arg(ins, 2) == spv::DecorationSample)
+            inputs.erase(arg(ins, 1));
+          break;
+
+        default:
+          this->forEachIdOperand(ins, [&] (uint32_t& id) {
+            inputs.erase(id);
+          });
+      }
+    }
+
+    if (inputs.empty())
+      return;
+
+    for (auto& ins : m_instructions) {
+      if (ins.op != spv::OpEntryPoint)
+        continue;
+
+      // Skip the execution model, function ID and name
+      uint32_t src = 3;
+
+      while (src < ins.length && (m_code[ins.offset + src++] >> 24))
+        continue;
+
+      uint32_t dst = src;
+
+      for ( ; src < ins.length; src++) {
+        uint32_t id = m_code[ins.offset + src];
+
+        if (inputs.find(id) == inputs.end())
+          m_code[ins.offset + dst++] = id;
+      }
+
+      ins.length = dst;
+    }
+
+    for (uint32_t id : inputs)
+      this->removeInstruction(getDefIndex(id));
+
+    this->removeNamesAndDecorations(inputs);
+
+    m_stats[SpirvOptPass::StripInterface].changes += inputs.size();
+  }
+
+
+  void SpirvOptimizer::runCopyPropagation() {
+    for (const auto& ins : m_instructions) {
+      if (ins.removed || ins.function == InvalidIndex)
+        continue;
+
+      uint32_t resultId = getResultId(ins);
+
+      switch (ins.op) {
+        case spv::OpCopyObject:
+          m_replacements[resultId] = resolve(arg(ins, 3));
+          break;
+
+        case spv::OpBitcast: {
+          uint32_t operandIndex = getDefIndex(arg(ins, 3));
+
+          if (operandIndex == InvalidIndex
+           || getResultTypeId(m_instructions[operandIndex]) != arg(ins, 1))
+            continue;
+
+          m_replacements[resultId] = resolve(arg(ins, 3));
+        } break;
+
+        default:
+          continue;
+      }
+
+      m_stats[SpirvOptPass::CopyPropagation].changes += 1;
+    }
+  }
+
+
+  void SpirvOptimizer::runLoadStoreElim() {
+    auto& stats = m_stats[SpirvOptPass::LoadStoreElim];
+
+    // Find Private and Function variables that are only ever
+    // accessed directly through OpLoad and OpStore. Those
+    // cannot be aliased, so we can track them in each block.
+    std::unordered_map<uint32_t, spv::StorageClass> vars;
+    std::unordered_map<uint32_t, uint32_t>          loadCounts;
+
+    for (const auto& ins : m_instructions) {
+      if (ins.op == spv::OpVariable && !ins.removed
+       && (arg(ins, 3) == spv::StorageClassPrivate
+        || arg(ins, 3) == spv::StorageClassFunction))
+        vars.insert({ arg(ins, 2), spv::StorageClass(arg(ins, 3)) });
+    }
+
+    for (const auto& ins : m_instructions) {
+      if (ins.removed || vars.empty())
+        continue;
+
+      if (ins.op == spv::OpName || ins.op == spv::OpDecorate)
+        continue;
+
+      const uint32_t* base = &m_code[ins.offset];
+
+      this->forEachIdOperand(ins, [&] (uint32_t& id) {
+        uint32_t position = uint32_t(&id - base);
+
+        if (ins.knownLayout && ins.op == spv::OpLoad && position == 3) {
+          loadCounts[id] += 1;
+          return;
+        }
+
+        if (ins.knownLayout && ins.op == spv::OpStore && position == 1)
+          return;
+
+        vars.erase(id);
+      });
+    }
+
+    std::unordered_map<uint32_t, uint32_t> values;
+    std::unordered_map<uint32_t, uint32_t> stores;
+
+    for (uint32_t i = 0; i < m_instructions.size(); i++) {
+      const Instruction& ins = m_instructions[i];
+
+      if (ins.removed)
+        continue;
+
+      switch (ins.op) {
+        case spv::OpLabel: {
+          values.clear();
+          stores.clear();
+        } break;
+
+        case spv::OpFunctionCall: {
+          // The callee may access any private variable
+          for (const auto& var : vars) {
+            if (var.second == spv::StorageClassPrivate) {
+              values.erase(var.first);
+              stores.erase(var.first);
+            }
+          }
+        } break;
+
+        case spv::OpLoad: {
+          uint32_t varId = arg(ins, 3);
+
+          if (vars.find(varId) == vars.end())
+            break;
+
+          auto value = values.find(varId);
+
+          if (value != values.end()) {
+            m_replacements[arg(ins, 2)] = value->second;
+            stats.changes += 1;
+          } else {
+            values.insert({ varId, arg(ins, 2) });
+          }
+
+          stores.erase(varId);
+        } break;
+
+        case spv::OpStore: {
+          uint32_t varId = arg(ins, 1);
+
+          if (vars.find(varId) == vars.end())
+            break;
+
+          // Stores to variables that are never read are dead
+          if (loadCounts.find(varId) == loadCounts.end()) {
+            this->removeInstruction(i);
+            stats.changes += 1;
+            break;
+          }
+
+          uint32_t valueId = resolve(arg(ins, 2));
+
+          // Writing back the value that the variable already
+          // holds, as is common for masked register writes
+          auto value = values.find(varId);
+
+          if (value != values.end() && value->second == valueId) {
+            this->removeInstruction(i);
+            stats.changes += 1;
+            break;
+          }
+
+          // Previous store has been overwritten without being read
+          auto store = stores.find(varId);
+
+          if (store != stores.end()) {
+            this->removeInstruction(store->second);
+            stats.changes += 1;
+          }
+
+          values[varId] = valueId;
+          stores[varId] = i;
+        } break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+
+  void SpirvOptimizer::runConstantFolding() {
+    std::unordered_set<uint32_t> folded;
+
+    for (uint32_t i = 0; i < m_instructions.size(); i++) {
+      const Instruction& ins = m_instructions[i];
+
+      if (ins.removed || !ins.knownLayout || ins.function == InvalidIndex)
+        continue;
+
+      if (this->foldInstruction(ins)) {
+        uint32_t resultId = getResultId(ins);
+
+        // The result ID is now defined as a global constant,
+        // and decorations like NoContraction no longer apply
+        if (m_replacements.find(resultId) == m_replacements.end()) {
+          this->removeInstruction(i);
+          folded.insert(resultId);
+        }
+
+        m_stats[SpirvOptPass::ConstantFolding].changes += 1;
+      }
+    }
+
+    if (!folded.empty())
+      this->removeNamesAndDecorations(folded);
+  }
+
+
+  void SpirvOptimizer::runDeadCodeElim() {
+    std::vector<bool>     live(m_instructions.size(), false);
+    std::vector<uint32_t> worklist;
+
+    auto markInstruction = [&] (uint32_t index) {
+      if (!live[index] && !m_instructions[index].removed) {
+        live[index] = true;
+        worklist.push_back(index);
+      }
+    };
+
+    std::function<void (uint32_t)> markId = [&] (uint32_t id) {
+      uint32_t index = getDefIndex(id);
+
+      if (index != InvalidIndex) {
+        markInstruction(index);
+        return;
+      }
+
+      // Folded results are no longer defined by an instruction
+
+      auto entry = m_newConstantIds.find(id);
+
+      if (entry != m_newConstantIds.end()) {
+        NewConstant& constant = m_newConstants[entry->second];
+
+        if (!constant.live) {
+          constant.live = true;
+          markId(constant.typeId);
+
+          for (uint32_t operand : constant.operands)
+            markId(operand);
+        }
+      }
+    };
+
+    auto isRoot = [this] (const Instruction& ins) {
+      if (ins.function != InvalidIndex)
+        return !ins.knownLayout || hasSideEffects(ins.op) || !getResultId(ins);
+
+      switch (ins.op) {
+        case spv::OpName:
+        case spv::OpMemberName:
+        case spv::OpDecorate:
+        case spv::OpMemberDecorate:
+        case spv::OpTypeVoid:
+        case spv::OpTypeBool:
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+        case spv::OpTypeVector:
+        case spv::OpTypeMatrix:
+        case spv::OpTypeImage:
+        case spv::OpTypeSampler:
+        case spv::OpTypeSampledImage:
+        case spv::OpTypeArray:
+        case spv::OpTypeRuntimeArray:
+        case spv::OpTypeStruct:
+        case spv::OpTypePointer:
+        case spv::OpTypeFunction:
+        case spv::OpConstantTrue:
+        case spv::OpConstantFalse:
+        case spv::OpConstant:
+        case spv::OpConstantComposite:
+        case spv::OpConstantNull:
+        case spv::OpSpecConstantTrue:
+        case spv::OpSpecConstantFalse:
+        case spv::OpSpecConstant:
+        case spv::OpSpecConstantComposite:
+        case spv::OpVariable:
+        case spv::OpUndef:
+          return false;
+
+        default:
+          return true;
+      }
+    };
+
+    for (auto& constant : m_newConstants)
+      constant.live = false;
+
+    for (uint32_t i = 0; i < m_instructions.size(); i++) {
+      if (m_instructions[i].function == InvalidIndex && isRoot(m_instructions[i]))
+        markInstruction(i);
+    }
+
+    while (!worklist.empty()) {
+      uint32_t index = worklist.back();
+      worklist.pop_back();
+
+      const Instruction& ins = m_instructions[index];
+
+      this->forEachIdOperand(ins, [&] (uint32_t& id) {
+        markId(id);
+      });
+
+      // Function bodies only matter if the function is used
+      if (ins.op == spv::OpFunction) {
+        for (uint32_t i = index; i < m_instructions.size() && m_instructions[i].function == index; i++) {
+          if (isRoot(m_instructions[i]))
+            markInstruction(i);
+        }
+      }
+    }
+
+    // Names and decorations are kept for live objects only
+    for (uint32_t i = 0; i < m_instructions.size(); i++) {
+      const Instruction& ins = m_instructions[i];
+
+      if (ins.removed || live[i])
+        continue;
+
+      bool isDebugOrAnnotation = ins.op == spv::OpName
+                              || ins.op == spv::OpMemberName
+                              || ins.op == spv::OpDecorate
+                              || ins.op == spv::OpMemberDecorate;
+
+      if (isDebugOrAnnotation) {
+        uint32_t target = getDefIndex(arg(ins, 1));
+
+        if (target == InvalidIndex || live[target])
+          continue;
+      }
+
+      this->removeInstruction(i);
+      m_stats[SpirvOptPass::DeadCodeElim].changes += 1;
+    }
+  }
+
+
+  void SpirvOptimizer::applyReplacements() {
+    if (m_replacements.empty())
+      return;
+
+    for (const auto& ins : m_instructions) {
+      if (ins.removed || !ins.knownLayout)
+        continue;
+
+      // Names and decorations belong to the original object
+      if (ins.op == spv::OpName || ins.op == spv::OpMemberName
+       || ins.op == spv::OpDecorate || ins.op == spv::OpMemberDecorate)
+        continue;
+
+      this->forEachIdOperand(ins, [this] (uint32_t& id) {
+        id = resolve(id);
+      });
+    }
+  }
+
+
+  SpirvCodeBuffer SpirvOptimizer::emitCode() const {
+    SpirvCodeBuffer code;
+    code.putHeader(m_bound);
+    code.data()[1] = m_code[1];
+    code.data()[2] = m_code[2];
+
+    bool emittedConstants = false;
+
+    auto emitConstants = [&] () {
+      for (const auto& constant : m_newConstants) {
+        if (!constant.live)
+          continue;
+
+        code.putIns (constant.op, 3 + constant.operands.size());
+        code.putWord(constant.typeId);
+        code.putWord(constant.resultId);
+
+        for (uint32_t operand : constant.operands)
+          code.putWord(operand);
+      }
+
+      emittedConstants = true;
+    };
+
+    for (const auto& ins : m_instructions) {
+      // New constants must be declared in the global
+      // declaration section, after all existing types
+      if (ins.op == spv::OpFunction && !emittedConstants)
+        emitConstants();
+
+      if (ins.removed)
+        continue;
+
+      code.putIns(ins.op, ins.length);
+
+      for (uint32_t i = 1; i < ins.length; i++)
+        code.putWord(m_code[ins.offset + i]);
+    }
+
+    if (!emittedConstants)
+      emitConstants();
+
+    return code;
+  }
+
+
+  bool SpirvOptimizer::foldInstruction(
+    const Instruction&          ins) {
+    uint32_t typeId   = getResultTypeId(ins);
+    uint32_t resultId = getResultId(ins);
+
+    if (!typeId || !resultId)
+      return false;
+
+    // Only handle 32-bit scalars, booleans and vectors thereof
+    auto type = m_types.find(typeId);
+
+    if (type == m_types.end())
+      return false;
+
+    TypeInfo scalarType = type->second;
+    uint32_t compCount  = 1;
+
+    if (scalarType.op == spv::OpTypeVector) {
+      compCount = scalarType.compCount;
+
+      auto compType = m_types.find(scalarType.compTypeId);
+
+      if (compType == m_types.end())
+        return false;
+
+      scalarType = compType->second;
+    }
+
+    if (scalarType.op != spv::OpTypeBool && scalarType.width != 32)
+      return false;
+
+    ConstValue result;
+    result.typeId = typeId;
+    result.comps.resize(compCount);
+
+    ConstValue a, b;
+
+    switch (ins.op) {
+      case spv::OpIAdd:
+      case spv::OpISub:
+      case spv::OpIMul:
+      case spv::OpUDiv:
+      case spv::OpUMod:
+      case spv::OpBitwiseAnd:
+      case spv::OpBitwiseOr:
+      case spv::OpBitwiseXor:
+      case spv::OpShiftLeftLogical:
+      case spv::OpShiftRightLogical:
+      case spv::OpShiftRightArithmetic:
+      case spv::OpIEqual:
+      case spv::OpINotEqual:
+      case spv::OpUGreaterThan:
+      case spv::OpUGreaterThanEqual:
+      case spv::OpULessThan:
+      case spv::OpULessThanEqual:
+      case spv::OpSGreaterThan:
+      case spv::OpSGreaterThanEqual:
+      case spv::OpSLessThan:
+      case spv::OpSLessThanEqual:
+      case spv::OpLogicalAnd:
+      case spv::OpLogicalOr:
+      case spv::OpLogicalEqual:
+      case spv::OpLogicalNotEqual: {
+        if (!getConstant(arg(ins, 3), a) || a.comps.size() != compCount
+         || !getConstant(arg(ins, 4), b) || b.comps.size() != compCount)
+          return false;
+
+        for (uint32_t i = 0; i < compCount; i++) {
+          uint32_t x = a.comps[i];
+          uint32_t y = b.comps[i];
+          uint32_t r = 0;
+
+          switch (ins.op) {
+            case spv::OpIAdd:                 r = x + y; break;
+            case spv::OpISub:                 r = x - y; break;
+            case spv::OpIMul:                 r = x * y; break;
+            case spv::OpBitwiseAnd:           r = x & y; break;
+            case spv::OpBitwiseOr:            r = x | y; break;
+            case spv::OpBitwiseXor:           r = x ^ y; break;
+            case spv::OpIEqual:               r = x == y; break;
+            case spv::OpINotEqual:            r = x != y; break;
+            case spv::OpUGreaterThan:         r = x >  y; break;
+            case spv::OpUGreaterThanEqual:    r = x >= y; break;
+            case spv::OpULessThan:            r = x <  y; break;
+            case spv::OpULessThanEqual:       r = x <= y; break;
+            case spv::OpSGreaterThan:         r = int32_t(x) >  int32_t(y); break;
+            case spv::OpSGreaterThanEqual:    r = int32_t(x) >= int32_t(y); break;
+            case spv::OpSLessThan:            r = int32_t(x) <  int32_t(y); break;
+            case spv::OpSLessThanEqual:       r = int32_t(x) <= int32_t(y); break;
+            case spv::OpLogicalAnd:           r = x && y; break;
+            case spv::OpLogicalOr:            r = x || y; break;
+            case spv::OpLogicalEqual:         r = x == y; break;
+            case spv::OpLogicalNotEqual:      r = x != y; break;
+
+            // Results are undefined in these cases, leave
+            // it to the driver to deal with them.
+            case spv::OpUDiv:
+              if (!y) return false;
+              r = x / y;
+              break;
+
+            case spv::OpUMod:
+              if (!y) return false;
+              r = x % y;
+              break;
+
+            case spv::OpShiftLeftLogical:
+              if (y >= 32) return false;
+              r = x << y;
+              break;
+
+            case spv::OpShiftRightLogical:
+              if (y >= 32) return false;
+              r = x >> y;
+              break;
+
+            case spv::OpShiftRightArithmetic:
+              if (y >= 32) return false;
+              r = uint32_t(int32_t(x) >> y);
+              break;
+
+            default:
+              return false;
+          }
+
+          result.comps[i] = r;
+        }
+      } break;
+
+      case spv::OpNot:
+      case spv::OpSNegate:
+      case spv::OpLogicalNot:
+      case spv::OpBitcast: {
+        if (!getConstant(arg(ins, 3), a) || a.comps.size() != compCount)
+          return false;
+
+        for (uint32_t i = 0; i < compCount; i++) {
+          switch (ins.op) {
+            case spv::OpNot:        result.comps[i] = ~a.comps[i]; break;
+            case spv::OpSNegate:    result.comps[i] = 0u - a.comps[i]; break;
+            case spv::OpLogicalNot: result.comps[i] = !a.comps[i]; break;
+            case spv::OpBitcast:    result.comps[i] = a.comps[i]; break;
+            default: return false;
+          }
+        }
+      } break;
+
+      case spv::OpSelect: {
+        if (!getConstant(arg(ins, 3), a))
+          return false;
+
+        // With a scalar condition, this simply forwards one
+        // of the operands, which need not be constant
+        if (a.comps.size() == 1) {
+          m_replacements[resultId] = resolve(arg(ins, a.comps[0] ? 4 : 5));
+          return true;
+        }
+
+        ConstValue c;
+
+        if (a.comps.size() != compCount
+         || !getConstant(arg(ins, 4), b) || b.comps.size() != compCount
+         || !getConstant(arg(ins, 5), c) || c.comps.size() != compCount)
+          return false;
+
+        for (uint32_t i = 0; i < compCount; i++)
+          result.comps[i] = a.comps[i] ? b.comps[i] : c.comps[i];
+      } break;
+
+      case spv::OpCompositeExtract: {
+        if (ins.length != 5 || compCount != 1
+         || !getConstant(arg(ins, 3), a)
+         || arg(ins, 4) >= a.comps.size())
+          return false;
+
+        result.comps[0] = a.comps[arg(ins, 4)];
+      } break;
+
+      case spv::OpCompositeConstruct: {
+        result.comps.clear();
+
+        for (uint32_t i = 3; i < ins.length; i++) {
+          if (!getConstant(arg(ins, i), a))
+            return false;
+
+          result.comps.insert(result.comps.end(), a.comps.begin(), a.comps.end());
+        }
+
+        if (result.comps.size() != compCount)
+          return false;
+      } break;
+
+      case spv::OpVectorShuffle: {
+        if (!getConstant(arg(ins, 3), a)
+         || !getConstant(arg(ins, 4), b)
+         || ins.length != 5 + compCount)
+          return false;
+
+        for (uint32_t i = 0; i < compCount; i++) {
+          uint32_t index = arg(ins, 5 + i);
+
+          if (index < a.comps.size())
+            result.comps[i] = a.comps[index];
+          else if (index - a.comps.size() < b.comps.size())
+            result.comps[i] = b.comps[index - a.comps.size()];
+          else
+            return false;
+        }
+      } break;
+
+      default:
+        return false;
+    }
+
+    this->defineConstant(resultId, result);
+    return true;
+  }
+
+
+  bool SpirvOptimizer::getConstant(
+          uint32_t              id,
+          ConstValue&           value) const {
+    auto entry = m_constants.find(resolve(id));
+
+    if (entry == m_constants.end())
+      return false;
+
+    value = entry->second;
+    return true;
+  }
+
+
+  uint32_t SpirvOptimizer::getScalarConstant(
+          uint32_t              typeId,
+          uint32_t              value) {
+    uint64_t key = (uint64_t(typeId) << 32) | value;
+
+    auto entry = m_scalarConstants.find(key);
+
+    if (entry != m_scalarConstants.end())
+      return entry->second;
+
+    uint32_t resultId = m_bound++;
+
+    ConstValue constant;
+    constant.typeId = typeId;
+    constant.comps  = { value };
+
+    this->defineConstant(resultId, constant);
+    return resultId;
+  }
+
+
+  void SpirvOptimizer::defineConstant(
+          uint32_t              resultId,
+    const ConstValue&           value) {
+    const TypeInfo& type = m_types[value.typeId];
+
+    NewConstant constant;
+    constant.typeId   = value.typeId;
+    constant.resultId = resultId;
+    constant.live     = true;
+
+    if (type.op == spv::OpTypeVector) {
+      constant.op = spv::OpConstantComposite;
+
+      for (uint32_t comp : value.comps)
+        constant.operands.push_back(getScalarConstant(type.compTypeId, comp));
+    } else if (type.op == spv::OpTypeBool) {
+      constant.op = value.comps[0] ? spv::OpConstantTrue : spv::OpConstantFalse;
+    } else {
+      constant.op = spv::OpConstant;
+      constant.operands = { value.comps[0] };
+    }
+
+    if (type.op != spv::OpTypeVector)
+      m_scalarConstants.insert({ (uint64_t(value.typeId) << 32) | value.comps[0], resultId });
+
+    if (resultId < m_defs.size())
+      m_defs[resultId] = InvalidIndex;
+
+    m_constants[resultId] = value;
+    m_newConstantIds[resultId] = m_newConstants.size();
+    m_newConstants.push_back(std::move(constant));
+  }
+
+
+  void SpirvOptimizer::removeInstruction(
+          uint32_t              index) {
+    if (index == InvalidIndex)
+      return;
+
+    m_instructions[index].removed = true;
+  }
+
+
+  void SpirvOptimizer::removeNamesAndDecorations(
+    const std::unordered_set<uint32_t>& ids) {
+    for (auto& ins : m_instructions) {
+      if (ins.op == spv::OpName || ins.op == spv::OpDecorate) {
+        if (ids.find(arg(ins, 1)) != ids.end())
+          ins.removed = true;
+      }
+    }
+  }
+
+
+  uint32_t SpirvOptimizer::resolve(
+          uint32_t              id) const {
+    auto entry = m_replacements.find(id);
+
+    while (entry != m_replacements.end()) {
+      id = entry->second;
+      entry = m_replacements.find(id);
+    }
+
+    return id;
+  }
+
+
+  uint32_t SpirvOptimizer::getResultId(
+    const Instruction&          ins) const {
+    bool hasResult = false;
+    bool hasType   = false;
+
+    spv::HasResultAndType(ins.op, &hasResult, &hasType);
+    return hasResult ? arg(ins, hasType ? 2 : 1) : 0;
+  }
+
+
+  uint32_t SpirvOptimizer::getResultTypeId(
+    const Instruction&          ins) const {
+    bool hasResult = false;
+    bool hasType   = false;
+
+    spv::HasResultAndType(ins.op, &hasResult, &hasType);
+    return hasType ? arg(ins, 1) : 0;
+  }
+
+
+  template<typename Fn>
+  bool SpirvOptimizer::forEachIdOperand(
+    const Instruction&          ins,
+          Fn&&                  fn) {
+    bool hasResult = false;
+    bool hasType   = false;
+
+    spv::HasResultAndType(ins.op, &hasResult, &hasType);
+
+    uint32_t* words = &m_code[ins.offset];
+    uint32_t  first = 1 + (hasResult ? 1 : 0) + (hasType ? 1 : 0);
+
+    auto ids = [&] (uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < std::min(end, ins.length); i++)
+        fn(words[i]);
+    };
+
+    if (hasType)
+      fn(words[1]);
+
+    switch (ins.op) {
+      // Instructions that do not take any IDs as operands
+      case spv::OpNop:
+      case spv::OpCapability:
+      case spv::OpExtension:
+      case spv::OpExtInstImport:
+      case spv::OpMemoryModel:
+      case spv::OpSource:
+      case spv::OpSourceExtension:
+      case spv::OpString:
+      case spv::OpTypeVoid:
+      case spv::OpTypeBool:
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+      case spv::OpTypeSampler:
+      case spv::OpConstantTrue:
+      case spv::OpConstantFalse:
+      case spv::OpConstant:
+      case spv::OpConstantNull:
+      case spv::OpSpecConstantTrue:
+      case spv::OpSpecConstantFalse:
+      case spv::OpSpecConstant:
+      case spv::OpUndef:
+      case spv::OpFunctionParameter:
+      case spv::OpFunctionEnd:
+      case spv::OpLabel:
+      case spv::OpReturn:
+      case spv::OpKill:
+      case spv::OpUnreachable:
+      case spv::OpEmitVertex:
+      case spv::OpEndPrimitive:
+      case spv::OpDemoteToHelperInvocationEXT:
+      case spv::OpIsHelperInvocationEXT:
+        return true;
+
+      // One ID followed by literals
+      case spv::OpName:
+      case spv::OpMemberName:
+      case spv::OpDecorate:
+      case spv::OpMemberDecorate:
+      case spv::OpExecutionMode:
+      case spv::OpLine:
+      case spv::OpSelectionMerge:
+        ids(1, 2);
+        return true;
+
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+      case spv::OpTypeImage:
+        ids(2, 3);
+        return true;
+
+      case spv::OpTypePointer:
+        ids(3, 4);
+        return true;
+
+      case spv::OpEntryPoint: {
+        ids(2, 3);
+
+        // The name is a null-terminated string, the last
+        // word of which always has its high byte cleared
+        uint32_t i = 3;
+
+        while (i < ins.length && (words[i++] >> 24))
+          continue;
+
+        ids(i, ins.length);
+      } return true;
+
+      case spv::OpVariable:
+      case spv::OpFunction:
+        ids(first + 1, ins.length);
+        return true;
+
+      case spv::OpExtInst:
+        ids(first, first + 1);
+        ids(first + 2, ins.length);
+        return true;
+
+      case spv::OpArrayLength:
+      case spv::OpCompositeExtract:
+        ids(first, first + 1);
+        return true;
+
+      case spv::OpCompositeInsert:
+      case spv::OpVectorShuffle:
+        ids(first, first + 2);
+        return true;
+
+      case spv::OpLoad:
+      case spv::OpStore: {
+        uint32_t count = ins.op == spv::OpStore ? 2 : 1;
+        ids(first, first + count);
+
+        // Memory access operands may contain scope IDs
+        if (first + count < ins.length) {
+          uint32_t mask = words[first + count];
+
+          if (mask & (spv::MemoryAccessMakePointerAvailableKHRMask
+                    | spv::MemoryAccessMakePointerVisibleKHRMask)) {
+            ids(first + count + 1, ins.length);
+            return false;
+          }
+        }
+      } return true;
+
+      case spv::OpImageSampleImplicitLod:
+      case spv::OpImageSampleExplicitLod:
+      case spv::OpImageSampleProjImplicitLod:
+      case spv::OpImageSampleProjExplicitLod:
+      case spv::OpImageFetch:
+      case spv::OpImageRead:
+      case spv::OpImageSparseSampleImplicitLod:
+      case spv::OpImageSparseSampleExplicitLod:
+      case spv::OpImageSparseFetch:
+      case spv::OpImageSparseRead:
+        // Image operand mask follows the fixed operands
+        ids(first, first + 2);
+        ids(first + 3, ins.length);
+        return true;
+
+      case spv::OpImageSampleDrefImplicitLod:
+      case spv::OpImageSampleDrefExplicitLod:
+      case spv::OpImageSampleProjDrefImplicitLod:
+      case spv::OpImageSampleProjDrefExplicitLod:
+      case spv::OpImageGather:
+      case spv::OpImageDrefGather:
+      case spv::OpImageSparseSampleDrefImplicitLod:
+      case spv::OpImageSparseSampleDrefExplicitLod:
+      case spv::OpImageSparseGather:
+      case spv::OpImageSparseDrefGather:
+      case spv::OpImageWrite:
+        ids(first, first + 3);
+        ids(first + 4, ins.length);
+        return true;
+
+      case spv::OpLoopMerge:
+        ids(1, 3);
+        return true;
+
+      case spv::OpBranchConditional:
+        ids(1, 4);
+        return true;
+
+      case spv::OpSwitch: {
+        // We only ever emit 32-bit selectors, so
+        // each case consists of a literal and a label
+        ids(1, 3);
+
+        for (uint32_t i = 4; i < ins.length; i += 2)
+          fn(words[i]);
+      } return true;
+
+      case spv::OpGroupNonUniformBallotBitCount:
+      case spv::OpGroupNonUniformIAdd:
+      case spv::OpGroupNonUniformFAdd:
+      case spv::OpGroupNonUniformIMul:
+      case spv::OpGroupNonUniformFMul:
+      case spv::OpGroupNonUniformSMin:
+      case spv::OpGroupNonUniformUMin:
+      case spv::OpGroupNonUniformFMin:
+      case spv::OpGroupNonUniformSMax:
+      case spv::OpGroupNonUniformUMax:
+      case spv::OpGroupNonUniformFMax:
+      case spv::OpGroupNonUniformBitwiseAnd:
+      case spv::OpGroupNonUniformBitwiseOr:
+      case spv::OpGroupNonUniformBitwiseXor:
+      case spv::OpGroupNonUniformLogicalAnd:
+      case spv::OpGroupNonUniformLogicalOr:
+      case spv::OpGroupNonUniformLogicalXor:
+        // Scope, group operation, value
+        ids(first, first + 1);
+        ids(first + 2, ins.length);
+        return true;
+
+      default:
+        // Treat all operands as IDs. This is only exact for
+        // known instructions, for anything else this will
+        // conservatively treat literals as IDs as well.
+        ids(first, ins.length);
+        return isKnownOpcode(ins.op);
+    }
+  }
+
+
+  bool SpirvOptimizer::isKnownOpcode(
+          spv::Op               op) {
+    switch (op) {
+      case spv::OpTypeSampledImage:
+      case spv::OpTypeArray:
+      case spv::OpTypeRuntimeArray:
+      case spv::OpTypeStruct:
+      case spv::OpTypeFunction:
+      case spv::OpConstantComposite:
+      case spv::OpSpecConstantComposite:
+      case spv::OpFunctionCall:
+      case spv::OpAccessChain:
+      case spv::OpInBoundsAccessChain:
+      case spv::OpSampledImage:
+      case spv::OpImage:
+      case spv::OpImageQuerySizeLod:
+      case spv::OpImageQuerySize:
+      case spv::OpImageQueryLod:
+      case spv::OpImageQueryLevels:
+      case spv::OpImageQuerySamples:
+      case spv::OpImageTexelPointer:
+      case spv::OpConvertFToU:
+      case spv::OpConvertFToS:
+      case spv::OpConvertSToF:
+      case spv::OpConvertUToF:
+      case spv::OpUConvert:
+      case spv::OpSConvert:
+      case spv::OpFConvert:
+      case spv::OpBitcast:
+      case spv::OpVectorExtractDynamic:
+      case spv::OpVectorInsertDynamic:
+      case spv::OpCompositeConstruct:
+      case spv::OpCopyObject:
+      case spv::OpTranspose:
+      case spv::OpSNegate:
+      case spv::OpFNegate:
+      case spv::OpIAdd:
+      case spv::OpFAdd:
+      case spv::OpISub:
+      case spv::OpFSub:
+      case spv::OpIMul:
+      case spv::OpFMul:
+      case spv::OpUDiv:
+      case spv::OpSDiv:
+      case spv::OpFDiv:
+      case spv::OpUMod:
+      case spv::OpSRem:
+      case spv::OpSMod:
+      case spv::OpFRem:
+      case spv::OpFMod:
+      case spv::OpVectorTimesScalar:
+      case spv::OpMatrixTimesScalar:
+      case spv::OpVectorTimesMatrix:
+      case spv::OpMatrixTimesVector:
+      case spv::OpMatrixTimesMatrix:
+      case spv::OpDot:
+      case spv::OpAny:
+      case spv::OpAll:
+      case spv::OpIsNan:
+      case spv::OpIsInf:
+      case spv::OpLogicalEqual:
+      case spv::OpLogicalNotEqual:
+      case spv::OpLogicalOr:
+      case spv::OpLogicalAnd:
+      case spv::OpLogicalNot:
+      case spv::OpSelect:
+      case spv::OpIEqual:
+      case spv::OpINotEqual:
+      case spv::OpUGreaterThan:
+      case spv::OpSGreaterThan:
+      case spv::OpUGreaterThanEqual:
+      case spv::OpSGreaterThanEqual:
+      case spv::OpULessThan:
+      case spv::OpSLessThan:
+      case spv::OpULessThanEqual:
+      case spv::OpSLessThanEqual:
+      case spv::OpFOrdEqual:
+      case spv::OpFUnordEqual:
+      case spv::OpFOrdNotEqual:
+      case spv::OpFUnordNotEqual:
+      case spv::OpFOrdLessThan:
+      case spv::OpFUnordLessThan:
+      case spv::OpFOrdGreaterThan:
+      case spv::OpFUnordGreaterThan:
+      case spv::OpFOrdLessThanEqual:
+      case spv::OpFUnordLessThanEqual:
+      case spv::OpFOrdGreaterThanEqual:
+      case spv::OpFUnordGreaterThanEqual:
+      case spv::OpShiftRightLogical:
+      case spv::OpShiftRightArithmetic:
+      case spv::OpShiftLeftLogical:
+      case spv::OpBitwiseOr:
+      case spv::OpBitwiseXor:
+      case spv::OpBitwiseAnd:
+      case spv::OpNot:
+      case spv::OpBitFieldInsert:
+      case spv::OpBitFieldSExtract:
+      case spv::OpBitFieldUExtract:
+      case spv::OpBitReverse:
+      case spv::OpBitCount:
+      case spv::OpDPdx:
+      case spv::OpDPdy:
+      case spv::OpFwidth:
+      case spv::OpDPdxFine:
+      case spv::OpDPdyFine:
+      case spv::OpFwidthFine:
+      case spv::OpDPdxCoarse:
+      case spv::OpDPdyCoarse:
+      case spv::OpFwidthCoarse:
+      case spv::OpEmitStreamVertex:
+      case spv::OpEndStreamPrimitive:
+      case spv::OpControlBarrier:
+      case spv::OpMemoryBarrier:
+      case spv::OpAtomicLoad:
+      case spv::OpAtomicStore:
+      case spv::OpAtomicExchange:
+      case spv::OpAtomicCompareExchange:
+      case spv::OpAtomicIIncrement:
+      case spv::OpAtomicIDecrement:
+      case spv::OpAtomicIAdd:
+      case spv::OpAtomicISub:
+      case spv::OpAtomicSMin:
+      case spv::OpAtomicUMin:
+      case spv::OpAtomicSMax:
+      case spv::OpAtomicUMax:
+      case spv::OpAtomicAnd:
+      case spv::OpAtomicOr:
+      case spv::OpAtomicXor:
+      case spv::OpPhi:
+      case spv::OpBranch:
+      case spv::OpReturnValue:
+      case spv::OpGroupNonUniformElect:
+      case spv::OpGroupNonUniformAll:
+      case spv::OpGroupNonUniformAny:
+      case spv::OpGroupNonUniformBroadcastFirst:
+      case spv::OpGroupNonUniformBallot:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
+  bool SpirvOptimizer::hasSideEffects(
+          spv::Op               op) {
+    switch (op) {
+      case spv::OpFunction:
+      case spv::OpFunctionParameter:
+      case spv::OpFunctionEnd:
+      case spv::OpFunctionCall:
+      case spv::OpLabel:
+      case spv::OpBranch:
+      case spv::OpBranchConditional:
+      case spv::OpSwitch:
+      case spv::OpSelectionMerge:
+      case spv::OpLoopMerge:
+      case spv::OpReturn:
+      case spv::OpReturnValue:
+      case spv::OpKill:
+      case spv::OpUnreachable:
+      case spv::OpDemoteToHelperInvocationEXT:
+      case spv::OpStore:
+      case spv::OpImageWrite:
+      case spv::OpEmitVertex:
+      case spv::OpEndPrimitive:
+      case spv::OpEmitStreamVertex:
+      case spv::OpEndStreamPrimitive:
+      case spv::OpControlBarrier:
+      case spv::OpMemoryBarrier:
+      case spv::OpAtomicLoad:
+      case spv::OpAtomicStore:
+      case spv::OpAtomicExchange:
+      case spv::OpAtomicCompareExchange:
+      case spv::OpAtomicIIncrement:
+      case spv::OpAtomicIDecrement:
+      case spv::OpAtomicIAdd:
+      case spv::OpAtomicISub:
+      case spv::OpAtomicSMin:
+      case spv::OpAtomicUMin:
+      case spv::OpAtomicSMax:
+      case spv::OpAtomicUMax:
+      case spv::OpAtomicAnd:
+      case spv::OpAtomicOr:
+      case spv::OpAtomicXor:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+}
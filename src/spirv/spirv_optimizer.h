@@ -0,0 +1,249 @@
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "spirv_code_buffer.h"
+#include "spirv_include.h"
+#include "spirv_ssa.h"
+
+namespace dxvk {
+
+  /**
+   * \brief SPIR-V optimization passes
+   */
+  enum class SpirvOptPass : uint32_t {
+    SsaPromotion        = 0,  ///< Promotes variables to SSA values
+    StripInterface      = 1,  ///< Removes unused input variables
+    CopyPropagation     = 2,  ///< Forwards copies and no-op bitcasts
+    LoadStoreElim       = 3,  ///< Removes redundant loads and stores
+    ConstantFolding     = 4,  ///< Folds integer and bitwise arithmetic
+    DeadCodeElim        = 5,  ///< Removes unused code and declarations
+
+    Count
+  };
+
+  using SpirvOptPasses = Flags<SpirvOptPass>;
+
+
+  /**
+   * \brief Statistics for a single pass
+   */
+  struct SpirvOptPassStats {
+    uint32_t changes  = 0;  ///< Number of values or instructions changed
+    uint64_t timeNs   = 0;  ///< Time spent running the pass
+  };
+
+
+  /**
+   * \brief Optimizer statistics
+   */
+  struct SpirvOptStats {
+    uint32_t dwordsBefore = 0;
+    uint32_t dwordsAfter  = 0;
+
+    std::array<SpirvOptPassStats, uint32_t(SpirvOptPass::Count)> passes = { };
+
+    SpirvSsaStats ssa = { };
+
+    const SpirvOptPassStats& operator [] (SpirvOptPass pass) const {
+      return passes[uint32_t(pass)];
+    }
+
+    SpirvOptPassStats& operator [] (SpirvOptPass pass) {
+      return passes[uint32_t(pass)];
+    }
+  };
+
+
+  /**
+   * \brief SPIR-V optimizer
+   *
+   * Runs a set of simple, conservative passes over a
+   * generated module in order to reduce its size and
+   * thus both memory usage and driver compile times.
+   *
+   * Passes do not rewrite the module individually.
+   * Instead, they remove instructions and register
+   * value replacements, and the final module is
+   * emitted once all enabled passes have run.
+   *
+   * Operand layouts are only known for instructions
+   * that our shader compilers actually emit. Uses of
+   * values by any other instruction are taken into
+   * account, but never rewritten.
+   */
+  class SpirvOptimizer {
+
+  public:
+
+    SpirvOptimizer(SpirvOptPasses passes);
+
+    ~SpirvOptimizer();
+
+    /**
+     * \brief Optimizes a module
+     *
+     * \param [in,out] code SPIR-V module
+     * \returns \c true if the module was changed
+     */
+    bool run(SpirvCodeBuffer& code);
+
+    /**
+     * \brief Retrieves statistics
+     * \returns Statistics of the last run
+     */
+    const SpirvOptStats& stats() const {
+      return m_stats;
+    }
+
+    /**
+     * \brief Queries all available passes
+     * \returns All passes in the order they run in
+     */
+    static SpirvOptPasses allPasses();
+
+    /**
+     * \brief Queries passes enabled by default
+     *
+     * SSA promotion is only enabled on request
+     * since it has only been validated with the
+     * code generated by the D3D9 shader compiler.
+     * \returns All passes except SSA promotion
+     */
+    static SpirvOptPasses defaultPasses();
+
+    /**
+     * \brief Queries pass name
+     *
+     * \param [in] pass The pass
+     * \returns Human-readable pass name
+     */
+    static const char* passName(SpirvOptPass pass);
+
+  private:
+
+    constexpr static uint32_t InvalidIndex = ~0u;
+
+    struct Instruction {
+      uint32_t  offset;
+      uint32_t  length;
+      spv::Op   op;
+      uint32_t  function;
+      bool      knownLayout;
+      bool      removed;
+    };
+
+    struct TypeInfo {
+      spv::Op   op          = spv::OpNop;
+      uint32_t  width       = 0;
+      uint32_t  compTypeId  = 0;
+      uint32_t  compCount   = 1;
+    };
+
+    struct ConstValue {
+      uint32_t              typeId = 0;
+      std::vector<uint32_t> comps;
+    };
+
+    struct NewConstant {
+      spv::Op               op;
+      uint32_t              typeId;
+      uint32_t              resultId;
+      std::vector<uint32_t> operands;
+      bool                  live;
+    };
+
+    SpirvOptPasses            m_passes;
+    SpirvOptStats             m_stats;
+
+    std::vector<uint32_t>     m_code;
+    uint32_t                  m_bound = 0;
+
+    std::vector<Instruction>  m_instructions;
+    std::vector<uint32_t>     m_defs;
+
+    std::unordered_map<uint32_t, uint32_t>    m_replacements;
+    std::unordered_map<uint32_t, TypeInfo>    m_types;
+    std::unordered_map<uint32_t, ConstValue>  m_constants;
+    std::unordered_map<uint64_t, uint32_t>    m_scalarConstants;
+    std::vector<NewConstant>                  m_newConstants;
+    std::unordered_map<uint32_t, uint32_t>    m_newConstantIds;
+
+    void reset();
+
+    void parseInstructions();
+
+    void parseTypes();
+
+    void runStripInterface();
+
+    void runCopyPropagation();
+
+    void runLoadStoreElim();
+
+    void runConstantFolding();
+
+    void runDeadCodeElim();
+
+    void applyReplacements();
+
+    SpirvCodeBuffer emitCode() const;
+
+    bool foldInstruction(
+      const Instruction&          ins);
+
+    bool getConstant(
+            uint32_t              id,
+            ConstValue&           value) const;
+
+    uint32_t getScalarConstant(
+            uint32_t              typeId,
+            uint32_t              value);
+
+    void defineConstant(
+            uint32_t              resultId,
+      const ConstValue&           value);
+
+    void removeInstruction(
+            uint32_t              index);
+
+    void removeNamesAndDecorations(
+      const std::unordered_set<uint32_t>& ids);
+
+    uint32_t resolve(
+            uint32_t              id) const;
+
+    uint32_t getResultId(
+      const Instruction&          ins) const;
+
+    uint32_t getResultTypeId(
+      const Instruction&          ins) const;
+
+    uint32_t getDefIndex(
+            uint32_t              id) const {
+      return id < m_defs.size() ? m_defs[id] : InvalidIndex;
+    }
+
+    uint32_t arg(
+      const Instruction&          ins,
+            uint32_t              idx) const {
+      return idx < ins.length ? m_code[ins.offset + idx] : 0;
+    }
+
+    template<typename Fn>
+    bool forEachIdOperand(
+      const Instruction&          ins,
+            Fn&&                  fn);
+
+    static bool isKnownOpcode(
+            spv::Op               op);
+
+    static bool hasSideEffects(
+            spv::Op               op);
+
+  };
+
+}
@@ -0,0 +1,738 @@
+#include <algorithm>
+
+#include "spirv_ssa.h"
+
+namespace dxvk {
+
+  SpirvSsaPass::SpirvSsaPass() {
+
+  }
+
+
+  SpirvSsaPass::~SpirvSsaPass() {
+
+  }
+
+
+  bool SpirvSsaPass::run(SpirvCodeBuffer& code) {
+    this->reset();
+
+    if (code.dwords() < 5 || code.data()[0] != spv::MagicNumber)
+      return false;
+
+    m_code  = code.data();
+    m_bound = code.data()[3];
+
+    this->parseInstructions(code);
+
+    if (!this->findCandidates())
+      return false;
+
+    // Process all functions that access promoted variables
+    uint32_t functionStart = InvalidIndex;
+
+    for (uint32_t i = 0; i < m_instructions.size(); i++) {
+      const Instruction& ins = m_instructions[i];
+
+      if (ins.op == spv::OpFunction)
+        functionStart = i;
+
+      if (ins.op == spv::OpFunctionEnd && functionStart != InvalidIndex) {
+        this->processFunction(functionStart, i);
+        functionStart = InvalidIndex;
+      }
+    }
+
+    uint32_t promotedCount = 0;
+
+    for (const auto& var : m_vars)
+      promotedCount += var.second.promote ? 1 : 0;
+
+    if (!promotedCount)
+      return false;
+
+    this->removeTrivialPhis();
+
+    m_stats.promotedVariables = promotedCount;
+    m_stats.eliminatedLoads   = m_loadValues.size();
+
+    for (const auto& phi : m_phis) {
+      if (m_replacements.find(phi.id) == m_replacements.end())
+        m_stats.insertedPhis += 1;
+    }
+
+    code = this->emitCode();
+    return true;
+  }
+
+
+  void SpirvSsaPass::reset() {
+    m_stats = SpirvSsaStats();
+    m_code  = nullptr;
+    m_bound = 0;
+
+    m_instructions.clear();
+    m_vars.clear();
+    m_undefs.clear();
+    m_phis.clear();
+    m_blockPhis.clear();
+    m_loadValues.clear();
+    m_replacements.clear();
+  }
+
+
+  void SpirvSsaPass::parseInstructions(
+    const SpirvCodeBuffer&      code) {
+    uint32_t offset = 5;
+
+    while (offset < code.dwords()) {
+      Instruction ins;
+      ins.offset = offset;
+      ins.length = m_code[offset] >> spv::WordCountShift;
+      ins.op     = spv::Op(m_code[offset] & spv::OpCodeMask);
+
+      if (!ins.length || offset + ins.length > code.dwords())
+        break;
+
+      m_instructions.push_back(ins);
+      offset += ins.length;
+    }
+  }
+
+
+  bool SpirvSsaPass::findCandidates() {
+    std::unordered_map<uint32_t, uint32_t> pointerTypes;
+    std::unordered_map<uint32_t, uint32_t> callCounts;
+    std::unordered_map<uint32_t, uint32_t> callers;
+    std::unordered_map<uint32_t, bool>     hasLoops;
+
+    uint32_t entryPointCount = 0;
+    uint32_t entryPointId    = 0;
+    uint32_t functionId      = 0;
+
+    for (const auto& ins : m_instructions) {
+      switch (ins.op) {
+        case spv::OpEntryPoint:
+          entryPointCount += 1;
+          entryPointId = arg(ins, 2);
+          break;
+
+        case spv::OpTypePointer:
+          pointerTypes.insert({ arg(ins, 1), arg(ins, 3) });
+          break;
+
+        case spv::OpFunction:
+          functionId = arg(ins, 2);
+          break;
+
+        case spv::OpFunctionEnd:
+          functionId = 0;
+          break;
+
+        case spv::OpFunctionCall:
+          callCounts[arg(ins, 3)] += 1;
+          callers[arg(ins, 3)] = functionId;
+          break;
+
+        case spv::OpLoopMerge:
+          hasLoops[functionId] = true;
+          break;
+
+        case spv::OpVariable: {
+          auto storage = spv::StorageClass(arg(ins, 3));
+          auto type    = pointerTypes.find(arg(ins, 1));
+
+          bool isGlobal = !functionId && storage == spv::StorageClassPrivate;
+          bool isLocal  =  functionId && storage == spv::StorageClassFunction;
+
+          if ((isGlobal || isLocal) && type != pointerTypes.end()) {
+            Variable var;
+            var.typeId     = type->second;
+            var.initId     = ins.length > 4 ? arg(ins, 4) : 0;
+            var.functionId = functionId;
+            var.isGlobal   = isGlobal;
+            m_vars.insert({ arg(ins, 2), var });
+          }
+        } break;
+
+        default:
+          break;
+      }
+    }
+
+    if (entryPointCount != 1 || m_vars.empty())
+      return false;
+
+    // Find all uses of candidate variables. Anything other
+    // than a direct load or store disqualifies the variable.
+    functionId = 0;
+
+    for (const auto& ins : m_instructions) {
+      uint32_t firstArg = 1;
+      uint32_t lastArg  = ins.length;
+
+      // Types and constants cannot reference variables,
+      // but may contain literals that look like IDs.
+      if ((ins.op >= spv::OpTypeVoid && ins.op <= spv::OpTypeForwardPointer)
+       || (ins.op >= spv::OpConstantTrue && ins.op <= spv::OpSpecConstantOp))
+        continue;
+
+      switch (ins.op) {
+        case spv::OpFunction:
+          functionId = arg(ins, 2);
+          break;
+
+        case spv::OpFunctionEnd:
+          functionId = 0;
+          break;
+
+        case spv::OpName:
+        case spv::OpDecorate:
+          // The target may be a variable, which is fine
+          // since these will be removed. The remaining
+          // arguments are strings or literals.
+          lastArg = 1;
+          break;
+
+        case spv::OpMemberName:
+        case spv::OpMemberDecorate:
+        case spv::OpString:
+        case spv::OpSource:
+        case spv::OpSourceExtension:
+        case spv::OpExtension:
+        case spv::OpExtInstImport:
+        case spv::OpExecutionMode:
+        case spv::OpCapability:
+        case spv::OpMemoryModel:
+        case spv::OpLine:
+        case spv::OpSelectionMerge:
+        case spv::OpLoopMerge:
+        case spv::OpBranch:
+        case spv::OpSwitch:
+          lastArg = 1;
+          break;
+
+        case spv::OpBranchConditional:
+          lastArg = 2;
+          break;
+
+        case spv::OpExtInst:
+          firstArg = 5;
+          break;
+
+        case spv::OpCompositeExtract:
+          lastArg = 4;
+          break;
+
+        case spv::OpCompositeInsert:
+        case spv::OpVectorShuffle:
+          lastArg = 5;
+          break;
+
+        case spv::OpEntryPoint: {
+          // Skip over the entry point name
+          const char* name = reinterpret_cast<const char*>(&m_code[ins.offset + 3]);
+          uint32_t maxLen = (ins.length - 3) * sizeof(uint32_t);
+          uint32_t strLen = 0;
+
+          while (strLen < maxLen && name[strLen])
+            strLen += 1;
+
+          firstArg = 3 + (strLen + 4) / 4;
+        } break;
+
+        case spv::OpVariable:
+          firstArg = 3;
+          break;
+
+        case spv::OpLoad: {
+          auto var = m_vars.find(arg(ins, 3));
+
+          if (var != m_vars.end()) {
+            if (!var->second.functionId)
+              var->second.functionId = functionId;
+            else if (var->second.functionId != functionId)
+              var->second.promote = false;
+          }
+
+          lastArg = 1;
+        } break;
+
+        case spv::OpStore: {
+          auto var = m_vars.find(arg(ins, 1));
+
+          if (var != m_vars.end()) {
+            if (!var->second.functionId)
+              var->second.functionId = functionId;
+            else if (var->second.functionId != functionId)
+              var->second.promote = false;
+          }
+
+          firstArg = 2;
+          lastArg  = 3;
+        } break;
+
+        default:
+          break;
+      }
+
+      for (uint32_t i = firstArg; i < lastArg; i++) {
+        auto var = m_vars.find(arg(ins, i));
+
+        if (var != m_vars.end())
+          var->second.promote = false;
+      }
+    }
+
+    // The value of a private variable persists across function
+    // calls, so we can only promote it if the function that
+    // uses it runs at most once. For the entry point, this is
+    // trivially the case. For other functions, require that
+    // they are only called once from the entry point, outside
+    // of any loop.
+    bool hasPromotedVars = false;
+
+    for (auto& pair : m_vars) {
+      Variable& var = pair.second;
+
+      if (var.isGlobal && var.functionId && var.functionId != entryPointId) {
+        auto callCount = callCounts.find(var.functionId);
+        auto caller    = callers.find(var.functionId);
+
+        if (callCount == callCounts.end() || callCount->second != 1
+         || caller->second != entryPointId || hasLoops[entryPointId])
+          var.promote = false;
+      }
+
+      hasPromotedVars |= var.promote;
+    }
+
+    return hasPromotedVars;
+  }
+
+
+  bool SpirvSsaPass::processFunction(
+          uint32_t              first,
+          uint32_t              last) {
+    uint32_t functionId = arg(m_instructions[first], 2);
+    bool hasPromotedVars = false;
+
+    for (const auto& var : m_vars)
+      hasPromotedVars |= var.second.promote && var.second.functionId == functionId;
+
+    if (!hasPromotedVars)
+      return false;
+
+    if (!this->buildCfg(first, last)) {
+      for (auto& var : m_vars) {
+        if (var.second.functionId == functionId)
+          var.second.promote = false;
+      }
+
+      return false;
+    }
+
+    // Blocks without predecessors, i.e. the entry block and
+    // unreachable blocks, can be sealed right away
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+      if (m_blocks[i].preds.empty())
+        m_blocks[i].sealed = true;
+    }
+
+    for (uint32_t b = 0; b < m_blocks.size(); b++) {
+      for (uint32_t i = m_blocks[b].first; i <= m_blocks[b].last; i++) {
+        const Instruction& ins = m_instructions[i];
+
+        if (ins.op == spv::OpLoad && isPromoted(arg(ins, 3)))
+          m_loadValues.insert({ arg(ins, 2), readVariable(arg(ins, 3), b) });
+
+        if (ins.op == spv::OpStore && isPromoted(arg(ins, 1))) {
+          writeVariable(arg(ins, 1), b, arg(ins, 2));
+          m_stats.eliminatedStores += 1;
+        }
+      }
+
+      m_blocks[b].filled = true;
+
+      // Seal successors once all their predecessors are filled,
+      // which for loop headers happens after the back edge.
+      for (uint32_t s : m_blocks[b].succs) {
+        if (m_blocks[s].sealed)
+          continue;
+
+        bool allFilled = true;
+
+        for (uint32_t p : m_blocks[s].preds)
+          allFilled &= m_blocks[p].filled;
+
+        if (allFilled)
+          this->sealBlock(s);
+      }
+    }
+
+    return true;
+  }
+
+
+  bool SpirvSsaPass::buildCfg(
+          uint32_t              first,
+          uint32_t              last) {
+    m_blocks.clear();
+    m_blockIds.clear();
+    m_incompletePhis.clear();
+    m_defs.clear();
+
+    uint32_t current = InvalidIndex;
+
+    // The last instruction is OpFunctionEnd
+    for (uint32_t i = first; i < last; i++) {
+      const Instruction& ins = m_instructions[i];
+
+      if (ins.op == spv::OpLabel) {
+        Block block;
+        block.labelId = arg(ins, 1);
+        block.first   = i;
+        block.last    = i;
+
+        current = m_blocks.size();
+        m_blockIds.insert({ block.labelId, current });
+        m_blocks.push_back(std::move(block));
+      } else if (current != InvalidIndex) {
+        m_blocks[current].last = i;
+      }
+    }
+
+    // Gather successors from the block terminators
+    for (auto& block : m_blocks) {
+      const Instruction& ins = m_instructions[block.last];
+      std::vector<uint32_t> targets;
+
+      switch (ins.op) {
+        case spv::OpBranch:
+          targets.push_back(arg(ins, 1));
+          break;
+
+        case spv::OpBranchConditional:
+          targets.push_back(arg(ins, 2));
+          targets.push_back(arg(ins, 3));
+          break;
+
+        case spv::OpSwitch:
+          // Only 32-bit selectors are supported
+          if ((ins.length - 3) & 1)
+            return false;
+
+          targets.push_back(arg(ins, 2));
+
+          for (uint32_t i = 4; i < ins.length; i += 2)
+            targets.push_back(arg(ins, i));
+          break;
+
+        case spv::OpReturn:
+        case spv::OpReturnValue:
+        case spv::OpKill:
+        case spv::OpUnreachable:
+          break;
+
+        default:
+          // Malformed block
+          return false;
+      }
+
+      for (uint32_t target : targets) {
+        auto entry = m_blockIds.find(target);
+
+        if (entry == m_blockIds.end())
+          return false;
+
+        if (std::find(block.succs.begin(), block.succs.end(), entry->second) == block.succs.end())
+          block.succs.push_back(entry->second);
+      }
+    }
+
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+      for (uint32_t s : m_blocks[i].succs)
+        m_blocks[s].preds.push_back(i);
+    }
+
+    // The entry block must not have predecessors
+    if (m_blocks.empty() || !m_blocks[0].preds.empty())
+      return false;
+
+    m_incompletePhis.resize(m_blocks.size());
+    return true;
+  }
+
+
+  void SpirvSsaPass::sealBlock(
+          uint32_t              block) {
+    for (const auto& phi : m_incompletePhis[block])
+      this->addPhiOperands(phi.phi);
+
+    m_incompletePhis[block].clear();
+    m_blocks[block].sealed = true;
+  }
+
+
+  void SpirvSsaPass::writeVariable(
+          uint32_t              varId,
+          uint32_t              block,
+          uint32_t              value) {
+    m_defs[getDefKey(varId, block)] = value;
+  }
+
+
+  uint32_t SpirvSsaPass::readVariable(
+          uint32_t              varId,
+          uint32_t              block) {
+    auto entry = m_defs.find(getDefKey(varId, block));
+
+    if (entry != m_defs.end())
+      return entry->second;
+
+    return readVariableRecursive(varId, block);
+  }
+
+
+  uint32_t SpirvSsaPass::readVariableRecursive(
+          uint32_t              varId,
+          uint32_t              block) {
+    // Walk up chains of single-predecessor blocks
+    // iteratively to keep the recursion depth low
+    std::vector<uint32_t> chain;
+    uint32_t value = 0;
+
+    while (!value) {
+      const Block& b = m_blocks[block];
+
+      if (!b.sealed) {
+        uint32_t phi = newPhi(varId, block);
+        m_incompletePhis[block].push_back({ varId, phi });
+        value = m_phis[phi].id;
+        writeVariable(varId, block, value);
+      } else if (b.preds.empty()) {
+        value = getInitialValue(varId);
+        writeVariable(varId, block, value);
+      } else if (b.preds.size() == 1) {
+        chain.push_back(block);
+        block = b.preds[0];
+
+        auto entry = m_defs.find(getDefKey(varId, block));
+
+        if (entry != m_defs.end())
+          value = entry->second;
+      } else {
+        // Write the phi before adding operands
+        // in order to break cycles in loops
+        uint32_t phi = newPhi(varId, block);
+        value = m_phis[phi].id;
+        writeVariable(varId, block, value);
+        addPhiOperands(phi);
+      }
+    }
+
+    for (uint32_t b : chain)
+      writeVariable(varId, b, value);
+
+    return value;
+  }
+
+
+  uint32_t SpirvSsaPass::newPhi(
+          uint32_t              varId,
+          uint32_t              block) {
+    Phi phi;
+    phi.id    = m_bound++;
+    phi.varId = varId;
+    phi.block = block;
+
+    uint32_t index = m_phis.size();
+    m_phis.push_back(std::move(phi));
+    m_blockPhis[m_blocks[block].labelId].push_back(index);
+    return index;
+  }
+
+
+  void SpirvSsaPass::addPhiOperands(
+          uint32_t              phi) {
+    uint32_t varId = m_phis[phi].varId;
+    uint32_t block = m_phis[phi].block;
+
+    // Reading operands may create new phis, so
+    // don't hold on to any references here
+    for (uint32_t i = 0; i < m_blocks[block].preds.size(); i++) {
+      uint32_t pred  = m_blocks[block].preds[i];
+      uint32_t value = readVariable(varId, pred);
+
+      m_phis[phi].operands.push_back(value);
+      m_phis[phi].predLabels.push_back(m_blocks[pred].labelId);
+    }
+  }
+
+
+  uint32_t SpirvSsaPass::getInitialValue(
+          uint32_t              varId) {
+    const Variable& var = m_vars[varId];
+
+    if (var.initId)
+      return var.initId;
+
+    auto entry = m_undefs.find(var.typeId);
+
+    if (entry != m_undefs.end())
+      return entry->second;
+
+    uint32_t undefId = m_bound++;
+    m_undefs.insert({ var.typeId, undefId });
+    return undefId;
+  }
+
+
+  void SpirvSsaPass::removeTrivialPhis() {
+    bool progress = true;
+
+    while (progress) {
+      progress = false;
+
+      for (const auto& phi : m_phis) {
+        if (m_replacements.find(phi.id) != m_replacements.end())
+          continue;
+
+        uint32_t same = 0;
+        bool trivial = true;
+
+        for (uint32_t op : phi.operands) {
+          op = resolve(op);
+
+          if (op == same || op == phi.id)
+            continue;
+
+          if (same) {
+            trivial = false;
+            break;
+          }
+
+          same = op;
+        }
+
+        if (trivial) {
+          // A phi that only references itself is
+          // in unreachable code, any value will do
+          if (!same)
+            same = getInitialValue(phi.varId);
+
+          m_replacements.insert({ phi.id, same });
+          progress = true;
+        }
+      }
+    }
+  }
+
+
+  uint32_t SpirvSsaPass::resolve(
+          uint32_t              value) const {
+    auto entry = m_replacements.find(value);
+
+    while (entry != m_replacements.end()) {
+      value = entry->second;
+      entry = m_replacements.find(value);
+    }
+
+    return value;
+  }
+
+
+  SpirvCodeBuffer SpirvSsaPass::emitCode() {
+    SpirvCodeBuffer code;
+    code.putHeader(m_bound);
+    code.data()[1] = m_code[1];
+    code.data()[2] = m_code[2];
+
+    bool emittedUndefs = false;
+
+    for (const auto& ins : m_instructions) {
+      switch (ins.op) {
+        case spv::OpName:
+        case spv::OpDecorate:
+          if (isPromoted(arg(ins, 1)))
+            continue;
+          break;
+
+        case spv::OpVariable:
+          if (isPromoted(arg(ins, 2)))
+            continue;
+          break;
+
+        case spv::OpStore:
+          if (isPromoted(arg(ins, 1)))
+            continue;
+          break;
+
+        case spv::OpLoad:
+          if (isPromoted(arg(ins, 3))) {
+            code.putIns (spv::OpCopyObject, 4);
+            code.putWord(arg(ins, 1));
+            code.putWord(arg(ins, 2));
+            code.putWord(resolve(m_loadValues[arg(ins, 2)]));
+            continue;
+          }
+          break;
+
+        case spv::OpFunction:
+          // Undefined values must be declared
+          // in the global declaration section
+          if (!emittedUndefs) {
+            for (const auto& undef : m_undefs) {
+              code.putIns (spv::OpUndef, 3);
+              code.putWord(undef.first);
+              code.putWord(undef.second);
+            }
+
+            emittedUndefs = true;
+          }
+          break;
+
+        default:
+          break;
+      }
+
+      for (uint32_t i = 0; i < ins.length; i++)
+        code.putWord(m_code[ins.offset + i]);
+
+      if (ins.op == spv::OpLabel) {
+        auto phis = m_blockPhis.find(arg(ins, 1));
+
+        if (phis == m_blockPhis.end())
+          continue;
+
+        for (uint32_t index : phis->second) {
+          const Phi& phi = m_phis[index];
+
+          if (m_replacements.find(phi.id) != m_replacements.end())
+            continue;
+
+          code.putIns (spv::OpPhi, 3 + 2 * phi.operands.size());
+          code.putWord(m_vars[phi.varId].typeId);
+          code.putWord(phi.id);
+
+          for (uint32_t i = 0; i < phi.operands.size(); i++) {
+            code.putWord(resolve(phi.operands[i]));
+            code.putWord(phi.predLabels[i]);
+          }
+        }
+      }
+    }
+
+    return code;
+  }
+
+
+  bool SpirvSsaPass::isPromoted(
+          uint32_t              id) const {
+    auto entry = m_vars.find(id);
+
+    return entry != m_vars.end()
+        && entry->second.promote;
+  }
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "spirv_code_buffer.h"
+
+namespace dxvk {
+
+  /**
+   * \brief SSA promotion statistics
+   */
+  struct SpirvSsaStats {
+    uint32_t promotedVariables  = 0;
+    uint32_t eliminatedLoads    = 0;
+    uint32_t eliminatedStores   = 0;
+    uint32_t insertedPhis       = 0;
+  };
+
+
+  /**
+   * \brief SSA promotion pass
+   *
+   * Promotes \c Private and \c Function variables that
+   * are only ever accessed as a whole via \c OpLoad and
+   * \c OpStore to SSA values, inserting \c OpPhi where
+   * control flow merges. This removes a large amount of
+   * redundant memory traffic from generated shaders.
+   *
+   * Private variables are only promoted if they are
+   * used within a single function that is known to
+   * run at most once per shader invocation.
+   *
+   * Promoted loads are replaced by \c OpCopyObject,
+   * which avoids having to know the operand layout of
+   * every instruction that may consume the loaded value.
+   *
+   * SSA construction follows Braun et al., "Simple and
+   * Efficient Construction of Static Single Assignment
+   * Form", which works directly on the CFG without
+   * having to compute dominance frontiers first.
+   */
+  class SpirvSsaPass {
+
+  public:
+
+    SpirvSsaPass();
+
+    ~SpirvSsaPass();
+
+    /**
+     * \brief Runs the pass on a module
+     *
+     * \param [in,out] code SPIR-V module
+     * \returns \c true if the module was changed
+     */
+    bool run(SpirvCodeBuffer& code);
+
+    /**
+     * \brief Retrieves statistics
+     * \returns Statistics of the last run
+     */
+    const SpirvSsaStats& stats() const {
+      return m_stats;
+    }
+
+  private:
+
+    constexpr static uint32_t InvalidIndex = ~0u;
+
+    struct Instruction {
+      uint32_t  offset;
+      uint32_t  length;
+      spv::Op   op;
+    };
+
+    struct Variable {
+      uint32_t  typeId      = 0;
+      uint32_t  initId      = 0;
+      uint32_t  functionId  = 0;
+      bool      isGlobal    = false;
+      bool      promote     = true;
+    };
+
+    struct Block {
+      uint32_t              labelId = 0;
+      uint32_t              first   = 0;
+      uint32_t              last    = 0;
+      std::vector<uint32_t> preds;
+      std::vector<uint32_t> succs;
+      bool                  filled  = false;
+      bool                  sealed  = false;
+    };
+
+    struct Phi {
+      uint32_t              id;
+      uint32_t              varId;
+      uint32_t              block;
+      std::vector<uint32_t> operands;
+      std::vector<uint32_t> predLabels;
+    };
+
+    struct IncompletePhi {
+      uint32_t varId;
+      uint32_t phi;
+    };
+
+    SpirvSsaStats             m_stats;
+
+    const uint32_t*           m_code  = nullptr;
+    uint32_t                  m_bound = 0;
+
+    std::vector<Instruction>  m_instructions;
+
+    std::unordered_map<uint32_t, Variable> m_vars;
+    std::unordered_map<uint32_t, uint32_t> m_undefs;
+
+    // State of the function currently being processed
+    std::vector<Block>                          m_blocks;
+    std::unordered_map<uint32_t, uint32_t>      m_blockIds;
+    std::vector<std::vector<IncompletePhi>>     m_incompletePhis;
+    std::unordered_map<uint64_t, uint32_t>      m_defs;
+
+    // Results for the whole module
+    std::vector<Phi>                            m_phis;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_blockPhis;
+    std::unordered_map<uint32_t, uint32_t>      m_loadValues;
+    std::unordered_map<uint32_t, uint32_t>      m_replacements;
+
+    void reset();
+
+    void parseInstructions(
+      const SpirvCodeBuffer&      code);
+
+    bool findCandidates();
+
+    bool processFunction(
+            uint32_t              first,
+            uint32_t              last);
+
+    bool buildCfg(
+            uint32_t              first,
+            uint32_t              last);
+
+    void sealBlock(
+            uint32_t              block);
+
+    void writeVariable(
+            uint32_t              varId,
+            uint32_t              block,
+            uint32_t              value);
+
+    uint32_t readVariable(
+            uint32_t              varId,
+            uint32_t              block);
+
+    uint32_t readVariableRecursive(
+            uint32_t              varId,
+            uint32_t              block);
+
+    uint32_t newPhi(
+            uint32_t              varId,
+            uint32_t              block);
+
+    void addPhiOperands(
+            uint32_t              phi);
+
+    uint32_t getInitialValue(
+            uint32_t              varId);
+
+    void removeTrivialPhis();
+
+    uint32_t resolve(
+            uint32_t              value) const;
+
+    SpirvCodeBuffer emitCode();
+
+    bool isPromoted(
+            uint32_t              id) const;
+
+    uint32_t arg(
+      const Instruction&          ins,
+            uint32_t              idx) const {
+      return idx < ins.length ? m_code[ins.offset + idx] : 0;
+    }
+
+    static uint64_t getDefKey(
+            uint32_t              varId,
+            uint32_t              block) {
+      return (uint64_t(block) << 32) | varId;
+    }
+
+  };
+
+}
@@ -0,0 +1,308 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+#include "trace.h"
+
+#include "../log/log.h"
+
+#include "../util_env.h"
+
+namespace dxvk {
+
+  std::atomic<bool> TraceRecorder::s_enabled = { !env::getEnvVar("DXVK_TRACE").empty() };
+  TraceRecorder     TraceRecorder::s_instance;
+
+
+  TraceRecorder::TraceRecorder()
+  : m_startTime(dxvk::high_resolution_clock::now()) {
+    for (size_t i = 0; i < MaxThreadCount; i++) {
+      m_threadIds[i].store(0u);
+      m_buffers[i].store(nullptr);
+    }
+  }
+
+
+  TraceRecorder::~TraceRecorder() {
+    // Other threads may still be running while the module
+    // unloads, so stop recording before reading any buffers.
+    // Threads that are already inside record() are handled
+    // by writeJson, which skips the slot they may overwrite.
+    if (!s_enabled.exchange(false))
+      return;
+
+    // The logger may already be gone during static
+    // destruction, so only write out events that were
+    // recorded after the last flush, and do so silently.
+    if (this->countEvents() != m_flushedEvents)
+      this->writeJson(getFileName(env::getEnvVar("DXVK_TRACE")));
+
+    // Buffers are not freed here since other threads
+    // may still be running while the module unloads.
+  }
+
+
+  void TraceRecorder::flush() {
+    if (!s_enabled.load())
+      return;
+
+    std::lock_guard<std::mutex> lock(s_instance.m_flushMutex);
+
+    std::string path = getFileName(env::getEnvVar("DXVK_TRACE"));
+    Logger::info(str::format("Trace: Writing ", path));
+
+    if (s_instance.m_overflow.load())
+      Logger::warn("Trace: Too many threads, some events were dropped");
+
+    if (!s_instance.writeJson(path))
+      Logger::warn(str::format("Trace: Failed to open ", path));
+
+    s_instance.m_flushedEvents = s_instance.countEvents();
+  }
+
+
+  void TraceRecorder::record(
+    const char*                 category,
+    const char*                 name,
+    const char*                 detail,
+          char                  phase) {
+    TraceBuffer* buffer = this->getBuffer();
+
+    if (!buffer)
+      return;
+
+    // Mark the buffer as busy before checking whether recording
+    // was stopped. Either the destructor sees the busy flag, or
+    // this thread sees that recording is no longer enabled.
+    buffer->busy.store(true);
+
+    if (!s_enabled.load()) {
+      buffer->busy.store(false, std::memory_order_release);
+      return;
+    }
+
+    uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+
+    TraceEvent& event = buffer->events[index % TraceBuffer::EventCount];
+    event.category  = category;
+    event.name      = name;
+    event.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      dxvk::high_resolution_clock::now() - m_startTime).count();
+    event.phase     = phase;
+    event.detail[0] = '\0';
+
+    if (detail) {
+      std::strncpy(event.detail, detail, sizeof(event.detail) - 1);
+      event.detail[sizeof(event.detail) - 1] = '\0';
+    }
+
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+    buffer->busy.store(false, std::memory_order_release);
+  }
+
+
+  void TraceRecorder::nameThread(
+    const std::string&          name) {
+    TraceBuffer* buffer = this->getBuffer();
+
+    if (!buffer)
+      return;
+
+    std::lock_guard<std::mutex> lock(buffer->nameMutex);
+    buffer->threadName = name;
+  }
+
+
+  TraceBuffer* TraceRecorder::getBuffer() {
+    uint32_t threadId = ::GetCurrentThreadId();
+
+    // Open addressing with linear probing. Slots are
+    // never freed, and since only the owning thread
+    // inserts its own ID, a matching slot is always
+    // fully initialized by the time it is found.
+    size_t start = (threadId * 2654435761u) % MaxThreadCount;
+
+    for (size_t i = 0; i < MaxThreadCount; i++) {
+      size_t slot = (start + i) % MaxThreadCount;
+
+      uint32_t slotId = m_threadIds[slot].load(std::memory_order_acquire);
+
+      if (slotId == threadId)
+        return m_buffers[slot].load(std::memory_order_acquire);
+
+      if (slotId == 0u && m_threadIds[slot].compare_exchange_strong(slotId, threadId)) {
+        auto buffer = new TraceBuffer();
+        buffer->threadId = threadId;
+
+        m_buffers[slot].store(buffer, std::memory_order_release);
+        return buffer;
+      }
+
+      if (slotId == threadId)
+        return m_buffers[slot].load(std::memory_order_acquire);
+    }
+
+    m_overflow.store(true);
+    return nullptr;
+  }
+
+
+  uint64_t TraceRecorder::countEvents() const {
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < MaxThreadCount; i++) {
+      TraceBuffer* buffer = m_buffers[i].load(std::memory_order_acquire);
+
+      if (buffer)
+        count += buffer->writeIndex.load(std::memory_order_acquire);
+    }
+
+    return count;
+  }
+
+
+  bool TraceRecorder::writeJson(
+    const std::string&          path) {
+    std::ofstream file(path, std::ios_base::trunc);
+
+    if (!file)
+      return false;
+
+    uint32_t processId = ::GetCurrentProcessId();
+    bool first = true;
+
+    auto writeSeparator = [&file, &first] () {
+      file << (first ? "\n" : ",\n");
+      first = false;
+    };
+
+    auto writeString = [&file] (const char* str) {
+      file << '"';
+
+      for (const char* c = str; *c; c++) {
+        if (*c == '"' || *c == '\\')
+          file << '\\';
+
+        if (uint8_t(*c) >= 0x20)
+          file << *c;
+      }
+
+      file << '"';
+    };
+
+    file << "{\"traceEvents\":[";
+
+    for (size_t i = 0; i < MaxThreadCount; i++) {
+      TraceBuffer* buffer = m_buffers[i].load(std::memory_order_acquire);
+
+      if (!buffer)
+        continue;
+
+      // Threads terminated during process exit may still
+      // own the lock, so skip the name rather than block
+      { std::unique_lock<std::mutex> lock(buffer->nameMutex, std::try_to_lock);
+
+        if (lock && !buffer->threadName.empty()) {
+          writeSeparator();
+          file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << processId
+               << ",\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+          writeString(buffer->threadName.c_str());
+          file << "}}";
+        }
+      }
+
+      bool     busy  = buffer->busy.load(std::memory_order_acquire);
+      uint64_t end   = buffer->writeIndex.load(std::memory_order_acquire);
+      uint64_t begin = end > TraceBuffer::EventCount
+        ? end - TraceBuffer::EventCount : 0;
+
+      // A thread that is still inside record() writes the slot
+      // at the current write index, which holds the oldest event
+      if (busy && begin + TraceBuffer::EventCount == end)
+        begin += 1;
+
+      // If the ring buffer has wrapped around, skip end
+      // events whose begin event has been overwritten
+      uint32_t depth = 0;
+
+      for (uint64_t j = begin; j < end; j++) {
+        const TraceEvent& event = buffer->events[j % TraceBuffer::EventCount];
+
+        if (event.phase == 'E') {
+          if (!depth)
+            continue;
+          depth -= 1;
+        } else if (event.phase == 'B') {
+          depth += 1;
+        }
+
+        writeSeparator();
+        file << "{\"ph\":\"" << event.phase << "\",\"cat\":";
+        writeString(event.category);
+        file << ",\"name\":";
+        writeString(event.name);
+        file << ",\"pid\":" << processId
+             << ",\"tid\":" << buffer->threadId
+             << ",\"ts\":" << (event.timestamp / 1000)
+             << "." << std::setw(3) << std::setfill('0') << (event.timestamp % 1000);
+
+        if (event.phase == 'i')
+          file << ",\"s\":\"t\"";
+
+        if (event.detail[0]) {
+          file << ",\"args\":{\"detail\":";
+          writeString(event.detail);
+          file << "}";
+        }
+
+        file << "}";
+      }
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    return true;
+  }
+
+
+  std::string TraceRecorder::getFileName(
+    const std::string&          directory) {
+    std::string path = directory;
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+
+    std::string exeName = env::getExeName();
+    auto extp = exeName.find_last_of('.');
+
+    if (extp != std::string::npos && exeName.substr(extp + 1) == "exe")
+      exeName.erase(extp);
+
+    // Each DLL has its own recorder, so include
+    // the module name to keep the files apart
+    std::string moduleName = "dxvk";
+    HMODULE module = nullptr;
+
+    if (::GetModuleHandleExW(
+          GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+          GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+          reinterpret_cast<LPCWSTR>(&s_instance), &module)) {
+      WCHAR modulePath[MAX_PATH + 1] = { };
+      ::GetModuleFileNameW(module, modulePath, MAX_PATH);
+
+      moduleName = str::fromws(modulePath);
+
+      auto n = moduleName.find_last_of("\\/");
+
+      if (n != std::string::npos)
+        moduleName.erase(0, n + 1);
+
+      extp = moduleName.find_last_of('.');
+
+      if (extp != std::string::npos)
+        moduleName.erase(extp);
+    }
+
+    return str::format(path, exeName, "_", moduleName, ".trace.json");
+  }
+
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../util_time.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Trace event
+   *
+   * Single begin, end or instant event. Name and
+   * category must be string literals since only
+   * the pointers are stored. The optional detail
+   * string is copied and truncated if necessary.
+   */
+  struct TraceEvent {
+    const char* category;
+    const char* name;
+    int64_t     timestamp;
+    char        phase;
+    char        detail[39];
+  };
+
+
+  /**
+   * \brief Per-thread trace buffer
+   *
+   * Ring buffer that is only ever written by the
+   * thread that owns it, so no locking is needed
+   * when recording events. The busy flag is set
+   * while an event is being written. If the buffer
+   * overflows, the oldest events are overwritten.
+   */
+  struct TraceBuffer {
+    constexpr static size_t EventCount = 16384;
+
+    uint32_t                            threadId = 0;
+    std::atomic<uint64_t>               writeIndex = { 0ull };
+    std::atomic<bool>                   busy = { false };
+    std::array<TraceEvent, EventCount>  events;
+
+    std::mutex                          nameMutex;
+    std::string                         threadName;
+  };
+
+
+  /**
+   * \brief Trace recorder
+   *
+   * Records begin and end events of interesting
+   * operations on all threads, and writes them to
+   * a JSON file in the Chrome trace event format
+   * when the DXVK instance is destroyed. The output can
+   * be viewed with \c chrome://tracing or Perfetto.
+   *
+   * Tracing is enabled by setting \c DXVK_TRACE to
+   * a directory. Otherwise, recording an event
+   * only costs a single branch.
+   */
+  class TraceRecorder {
+
+  public:
+
+    TraceRecorder();
+
+    ~TraceRecorder();
+
+    TraceRecorder             (const TraceRecorder&) = delete;
+    TraceRecorder& operator = (const TraceRecorder&) = delete;
+
+    /**
+     * \brief Checks whether tracing is enabled
+     * \returns \c true if events are recorded
+     */
+    static bool isEnabled() {
+      return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Records the start of an operation
+     *
+     * \param [in] category Event category
+     * \param [in] name Event name
+     * \param [in] detail Optional detail string
+     */
+    static void begin(
+      const char*                 category,
+      const char*                 name,
+      const char*                 detail = nullptr) {
+      if (s_enabled.load(std::memory_order_relaxed))
+        s_instance.record(category, name, detail, 'B');
+    }
+
+    /**
+     * \brief Records the end of an operation
+     *
+     * \param [in] category Event category
+     * \param [in] name Event name
+     */
+    static void end(
+      const char*                 category,
+      const char*                 name) {
+      if (s_enabled.load(std::memory_order_relaxed))
+        s_instance.record(category, name, nullptr, 'E');
+    }
+
+    /**
+     * \brief Records an instant event
+     *
+     * \param [in] category Event category
+     * \param [in] name Event name
+     * \param [in] detail Optional detail string
+     */
+    static void instant(
+      const char*                 category,
+      const char*                 name,
+      const char*                 detail = nullptr) {
+      if (s_enabled.load(std::memory_order_relaxed))
+        s_instance.record(category, name, detail, 'i');
+    }
+
+    /**
+     * \brief Sets name of the calling thread
+     *
+     * The name will be shown in the trace viewer.
+     * \param [in] name Thread name
+     */
+    static void setThreadName(
+      const std::string&          name) {
+      if (s_enabled.load(std::memory_order_relaxed))
+        s_instance.nameThread(name);
+    }
+
+    /**
+     * \brief Writes the trace file
+     *
+     * Must be called at a point where no other threads
+     * record events, e.g. when the DXVK instance gets
+     * destroyed. Events recorded after the last flush
+     * are still written when the module is unloaded.
+     */
+    static void flush();
+
+  private:
+
+    constexpr static size_t MaxThreadCount = 256;
+
+    static std::atomic<bool> s_enabled;
+    static TraceRecorder     s_instance;
+
+    dxvk::high_resolution_clock::time_point m_startTime;
+
+    std::array<std::atomic<uint32_t>,     MaxThreadCount> m_threadIds;
+    std::array<std::atomic<TraceBuffer*>, MaxThreadCount> m_buffers;
+
+    std::atomic<bool> m_overflow = { false };
+
+    std::mutex        m_flushMutex;
+    uint64_t          m_flushedEvents = 0;
+
+    void record(
+      const char*                 category,
+      const char*                 name,
+      const char*                 detail,
+            char                  phase);
+
+    void nameThread(
+      const std::string&          name);
+
+    TraceBuffer* getBuffer();
+
+    uint64_t countEvents() const;
+
+    bool writeJson(
+      const std::string&          path);
+
+    static std::string getFileName(
+      const std::string&          directory);
+
+  };
+
+
+  /**
+   * \brief Scoped trace event
+   *
+   * Records a begin event on construction
+   * and the matching end event when the
+   * object goes out of scope.
+   */
+  class TraceScope {
+
+  public:
+
+    TraceScope(
+      const char*                 category,
+      const char*                 name,
+      const char*                 detail = nullptr)
+    : m_category(category), m_name(name) {
+      TraceRecorder::begin(category, name, detail);
+    }
+
+    ~TraceScope() {
+      TraceRecorder::end(m_category, m_name);
+    }
+
+    TraceScope             (const TraceScope&) = delete;
+    TraceScope& operator = (const TraceScope&) = delete;
+
+  private:
+
+    const char* m_category;
+    const char* m_name;
+
+  };
+
+}
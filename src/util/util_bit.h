@@ -15,6 +15,8 @@
 
 #include "util_likely.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <type_traits>
 
@@ -165,4 +167,81 @@ namespace dxvk::bit {
     #endif
   }
   
+  /**
+   * \brief Fixed-size bit set
+   *
+   * Unlike \c std::bitset, this exposes the
+   * underlying dwords so that set bits can be
+   * iterated efficiently using \c tzcnt.
+   */
+  template<size_t Bits>
+  class bitset {
+    static constexpr size_t Dwords = (Bits + 31) / 32;
+  public:
+
+    constexpr bitset()
+    : m_dwords() { }
+
+    constexpr bool get(uint32_t idx) const {
+      return m_dwords[idx / 32] & (1u << (idx % 32));
+    }
+
+    constexpr void set(uint32_t idx, bool value) {
+      uint32_t bit = 1u << (idx % 32);
+
+      if (value)
+        m_dwords[idx / 32] |= bit;
+      else
+        m_dwords[idx / 32] &= ~bit;
+    }
+
+    constexpr void setAll() {
+      for (size_t i = 0; i < Dwords - 1; i++)
+        m_dwords[i] = ~0u;
+
+      m_dwords[Dwords - 1] = (Bits % 32)
+        ? (1u << (Bits % 32)) - 1
+        : ~0u;
+    }
+
+    constexpr void clearAll() {
+      for (size_t i = 0; i < Dwords; i++)
+        m_dwords[i] = 0u;
+    }
+
+    constexpr bool any() const {
+      for (size_t i = 0; i < Dwords; i++) {
+        if (m_dwords[i])
+          return true;
+      }
+
+      return false;
+    }
+
+    constexpr uint32_t dword(uint32_t idx) const {
+      return m_dwords[idx];
+    }
+
+    constexpr uint32_t& dword(uint32_t idx) {
+      return m_dwords[idx];
+    }
+
+    constexpr size_t bitCount() const {
+      return Bits;
+    }
+
+    constexpr size_t dwordCount() const {
+      return Dwords;
+    }
+
+    constexpr bool operator [] (uint32_t idx) const {
+      return get(idx);
+    }
+
+  private:
+
+    uint32_t m_dwords[Dwords];
+
+  };
+
 }
@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef _MSC_VER
+#include <cpuid.h>
+#else
+#include <intrin.h>
+#endif
+
+#include <cstdint>
+
+namespace dxvk::cpu {
+
+  /**
+   * \brief Checks whether the CPU supports SSSE3
+   *
+   * Builds only require SSE2, so code paths that use
+   * newer instructions must be selected at runtime.
+   * \returns \c true if SSSE3 is supported
+   */
+  inline bool hasSsse3() {
+    uint32_t regs[4] = { };
+
+#ifndef _MSC_VER
+    if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+      return false;
+#else
+    __cpuid(reinterpret_cast<int*>(regs), 1);
+#endif
+
+    return regs[2] & (1u << 9);
+  }
+
+}
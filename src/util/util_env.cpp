@@ -1,5 +1,7 @@
 #include "util_env.h"
 
+#include "./trace/trace.h"
+
 #include "./com/com_include.h"
 
 namespace dxvk::env {
@@ -44,6 +46,8 @@ namespace dxvk::env {
       str::tows(name.c_str(), wideName.data(), wideName.size());
       (*proc)(::GetCurrentThread(), wideName.data());
     }
+
+    TraceRecorder::setThreadName(name);
   }
 
 
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <d3dcompiler.h>
+#include <d3d11.h>
+
+#include <windows.h>
+#include <windowsx.h>
+
+#include "../test_utils.h"
+
+using namespace dxvk;
+
+// Each variant uses a different loop count and constant,
+// which is enough to get a unique DXBC blob per shader
+const std::string g_pixelShaderCode =
+  "cbuffer c_data : register(b0) {\n"
+  "  float4 scale[16];\n"
+  "};\n"
+  "Texture2D<float4> t_tex : register(t0);\n"
+  "SamplerState s_samp : register(s0);\n"
+  "float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET {\n"
+  "  float4 result = 0.0f;\n"
+  "  [unroll] for (uint i = 0; i < LOOP_COUNT; i++) {\n"
+  "    float2 coord = uv + float2(i, i) * OFFSET;\n"
+  "    result += t_tex.Sample(s_samp, coord) * scale[i % 16];\n"
+  "  }\n"
+  "  return result;\n"
+  "}\n";
+
+constexpr uint32_t NumShaders = 256;
+constexpr uint32_t NumThreads = 4;
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  Com<ID3D11Device>         device;
+  Com<ID3D11DeviceContext>  context;
+
+  if (FAILED(D3D11CreateDevice(
+        nullptr, D3D_DRIVER_TYPE_HARDWARE,
+        nullptr, 0, nullptr, 0, D3D11_SDK_VERSION,
+        &device, nullptr, &context))) {
+    std::cerr << "Failed to create D3D11 device" << std::endl;
+    return 1;
+  }
+
+  // Build the shader corpus up front so that
+  // only shader creation itself gets measured
+  std::vector<Com<ID3DBlob>> blobs(NumShaders);
+
+  for (uint32_t i = 0; i < NumShaders; i++) {
+    std::string loopCount = std::to_string(4 + i % 28);
+    std::string offset    = std::to_string(0.001f * float(i + 1));
+
+    D3D_SHADER_MACRO macros[] = {
+      { "LOOP_COUNT", loopCount.c_str() },
+      { "OFFSET",     offset.c_str()    },
+      { nullptr,      nullptr           },
+    };
+
+    if (FAILED(D3DCompile(
+          g_pixelShaderCode.data(),
+          g_pixelShaderCode.size(),
+          "Pixel shader",
+          macros, nullptr,
+          "main", "ps_5_0", 0, 0,
+          &blobs[i],
+          nullptr))) {
+      std::cerr << "Failed to compile pixel shader" << std::endl;
+      return 1;
+    }
+  }
+
+  // Create all shaders from multiple threads
+  std::vector<Com<ID3D11PixelShader>> shaders(NumShaders);
+  std::vector<std::thread> threads;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+
+  for (uint32_t t = 0; t < NumThreads; t++) {
+    threads.emplace_back([&, t] () {
+      for (uint32_t i = t; i < NumShaders; i += NumThreads) {
+        if (FAILED(device->CreatePixelShader(
+              blobs[i]->GetBufferPointer(),
+              blobs[i]->GetBufferSize(),
+              nullptr, &shaders[i])))
+          std::cerr << "Failed to create pixel shader " << i << std::endl;
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  // Bind every shader once, which waits for any
+  // pending translation to finish on the device
+  for (uint32_t i = 0; i < NumShaders; i++)
+    context->PSSetShader(shaders[i].ptr(), nullptr, 0);
+
+  D3D11_QUERY_DESC queryDesc;
+  queryDesc.Query     = D3D11_QUERY_EVENT;
+  queryDesc.MiscFlags = 0;
+
+  Com<ID3D11Query> query;
+
+  if (FAILED(device->CreateQuery(&queryDesc, &query))) {
+    std::cerr << "Failed to create event query" << std::endl;
+    return 1;
+  }
+
+  context->End(query.ptr());
+
+  while (context->GetData(query.ptr(), nullptr, 0, 0) == S_FALSE)
+    continue;
+
+  auto t2 = std::chrono::high_resolution_clock::now();
+
+  auto createUs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+  auto readyUs  = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t0).count();
+
+  std::cout << "Created " << NumShaders << " shaders on " << NumThreads << " threads" << std::endl;
+  std::cout << "  Creation: " << (createUs / 1000) << " ms" << std::endl;
+  std::cout << "  Ready:    " << (readyUs  / 1000) << " ms" << std::endl;
+
+  context->ClearState();
+  return 0;
+}
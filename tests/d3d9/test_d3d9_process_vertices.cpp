@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <d3d9.h>
+
+#include "../test_utils.h"
+
+using namespace dxvk;
+
+struct InputVertex {
+  float x, y, z;
+};
+
+struct OutputVertex {
+  float x, y, z, rhw;
+};
+
+constexpr uint32_t VertexCount = 64;
+
+class ProcessVerticesApp {
+
+public:
+
+  ProcessVerticesApp(HINSTANCE instance, HWND window)
+  : m_window(window) {
+    HRESULT status = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_d3d);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to create D3D9 interface");
+
+    D3DPRESENT_PARAMETERS params;
+    getPresentParams(params);
+
+    status = m_d3d->CreateDeviceEx(
+      D3DADAPTER_DEFAULT,
+      D3DDEVTYPE_HAL,
+      m_window,
+      D3DCREATE_SOFTWARE_VERTEXPROCESSING,
+      &params,
+      nullptr,
+      &m_device);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to create D3D9 device");
+  }
+
+  bool run() {
+    D3DMATRIX world = makeMatrix({
+      1.0f, 0.0f, 0.0f, 0.0f,
+      0.0f, 1.0f, 0.0f, 0.0f,
+      0.0f, 0.0f, 1.0f, 0.0f,
+      2.0f, 3.0f, 4.0f, 1.0f,
+    });
+
+    D3DMATRIX view = makeMatrix({
+      0.0f, 0.0f,-1.0f, 0.0f,
+      0.0f, 1.0f, 0.0f, 0.0f,
+      1.0f, 0.0f, 0.0f, 0.0f,
+     -1.0f,-2.0f, 5.0f, 1.0f,
+    });
+
+    D3DMATRIX proj = makeMatrix({
+      1.5f, 0.0f, 0.0f,   0.0f,
+      0.0f, 2.0f, 0.0f,   0.0f,
+      0.0f, 0.0f, 1.001f, 1.0f,
+      0.0f, 0.0f,-0.1f,   0.0f,
+    });
+
+    D3DVIEWPORT9 viewport = { 16, 8, 640, 480, 0.25f, 0.75f };
+
+    m_device->SetTransform(D3DTS_WORLD,      &world);
+    m_device->SetTransform(D3DTS_VIEW,       &view);
+    m_device->SetTransform(D3DTS_PROJECTION, &proj);
+    m_device->SetViewport(&viewport);
+    m_device->SetRenderState(D3DRS_LIGHTING, FALSE);
+    m_device->SetRenderState(D3DRS_CLIPPING, FALSE);
+
+    std::array<InputVertex, VertexCount> input;
+
+    for (uint32_t i = 0; i < VertexCount; i++) {
+      input[i].x = float(i % 4) - 1.5f;
+      input[i].y = float((i / 4) % 4) - 1.5f;
+      input[i].z = float(i / 16) * 0.5f;
+    }
+
+    Com<IDirect3DVertexBuffer9> srcBuffer;
+
+    if (FAILED(m_device->CreateVertexBuffer(sizeof(input), 0, D3DFVF_XYZ, D3DPOOL_SYSTEMMEM, &srcBuffer, nullptr)))
+      throw DxvkError("Failed to create source buffer");
+
+    void* srcData = nullptr;
+    srcBuffer->Lock(0, 0, &srcData, 0);
+    std::memcpy(srcData, input.data(), sizeof(input));
+    srcBuffer->Unlock();
+
+    m_device->SetStreamSource(0, srcBuffer.ptr(), 0, sizeof(InputVertex));
+    m_device->SetFVF(D3DFVF_XYZ);
+
+    // Compare the CPU path used for system memory destinations
+    // and the GPU path used for default pool destinations
+    // against a scalar reference implementation
+    bool success = true;
+    success &= check("SYSTEMMEM", D3DPOOL_SYSTEMMEM, input.data(), world, view, proj, viewport);
+    success &= check("DEFAULT",   D3DPOOL_DEFAULT,   input.data(), world, view, proj, viewport);
+    return success;
+  }
+
+private:
+
+  HWND                          m_window;
+
+  Com<IDirect3D9Ex>             m_d3d;
+  Com<IDirect3DDevice9Ex>       m_device;
+
+  bool check(
+    const char*                 name,
+          D3DPOOL               pool,
+    const InputVertex*          pInput,
+    const D3DMATRIX&            world,
+    const D3DMATRIX&            view,
+    const D3DMATRIX&            proj,
+    const D3DVIEWPORT9&         viewport) {
+    Com<IDirect3DVertexBuffer9> dstBuffer;
+
+    if (FAILED(m_device->CreateVertexBuffer(VertexCount * sizeof(OutputVertex), 0, D3DFVF_XYZRHW, pool, &dstBuffer, nullptr)))
+      throw DxvkError("Failed to create destination buffer");
+
+    if (FAILED(m_device->ProcessVertices(0, 0, VertexCount, dstBuffer.ptr(), nullptr, 0))) {
+      std::cerr << name << ": ProcessVertices failed" << std::endl;
+      return false;
+    }
+
+    void* dstData = nullptr;
+
+    if (FAILED(dstBuffer->Lock(0, 0, &dstData, D3DLOCK_READONLY)))
+      throw DxvkError("Failed to lock destination buffer");
+
+    const OutputVertex* output = reinterpret_cast<const OutputVertex*>(dstData);
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < VertexCount; i++) {
+      OutputVertex expected = transformVertex(pInput[i], world, view, proj, viewport);
+
+      if (!compare(output[i], expected)) {
+        if (!mismatches++) {
+          std::cerr << str::format(name, ": Vertex ", i,
+            ": got (", output[i].x, ", ", output[i].y, ", ", output[i].z, ", ", output[i].rhw, ")",
+            ", expected (", expected.x, ", ", expected.y, ", ", expected.z, ", ", expected.rhw, ")") << std::endl;
+        }
+      }
+    }
+
+    dstBuffer->Unlock();
+
+    std::cout << str::format(name, ": ", mismatches ? "FAILED" : "OK",
+      " (", VertexCount - mismatches, "/", VertexCount, " vertices match)") << std::endl;
+    return !mismatches;
+  }
+
+  static D3DMATRIX makeMatrix(const std::array<float, 16>& values) {
+    D3DMATRIX result;
+    std::memcpy(result.m, values.data(), sizeof(result.m));
+    return result;
+  }
+
+  static OutputVertex transformVertex(
+    const InputVertex&          input,
+    const D3DMATRIX&            world,
+    const D3DMATRIX&            view,
+    const D3DMATRIX&            proj,
+    const D3DVIEWPORT9&         viewport) {
+    float pos[4] = { input.x, input.y, input.z, 1.0f };
+
+    multiply(pos, world);
+    multiply(pos, view);
+    multiply(pos, proj);
+
+    float rhw = 1.0f / pos[3];
+
+    OutputVertex result;
+    result.x   = float(viewport.X) + (1.0f + pos[0] * rhw) * 0.5f * float(viewport.Width);
+    result.y   = float(viewport.Y) + (1.0f - pos[1] * rhw) * 0.5f * float(viewport.Height);
+    result.z   = viewport.MinZ + pos[2] * rhw * (viewport.MaxZ - viewport.MinZ);
+    result.rhw = rhw;
+    return result;
+  }
+
+  static void multiply(float (&v)[4], const D3DMATRIX& m) {
+    float r[4];
+
+    for (uint32_t j = 0; j < 4; j++)
+      r[j] = v[0] * m.m[0][j] + v[1] * m.m[1][j] + v[2] * m.m[2][j] + v[3] * m.m[3][j];
+
+    std::memcpy(v, r, sizeof(r));
+  }
+
+  static bool compare(const OutputVertex& a, const OutputVertex& b) {
+    auto equal = [] (float x, float y) {
+      return std::abs(x - y) <= 1.0e-3f * std::max(1.0f, std::abs(y));
+    };
+
+    return equal(a.x, b.x) && equal(a.y, b.y)
+        && equal(a.z, b.z) && equal(a.rhw, b.rhw);
+  }
+
+  void getPresentParams(D3DPRESENT_PARAMETERS& params) {
+    params.AutoDepthStencilFormat = D3DFMT_UNKNOWN;
+    params.BackBufferCount = 1;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.BackBufferWidth = 1024;
+    params.BackBufferHeight = 600;
+    params.EnableAutoDepthStencil = FALSE;
+    params.Flags = 0;
+    params.FullScreen_RefreshRateInHz = 0;
+    params.hDeviceWindow = m_window;
+    params.MultiSampleQuality = 0;
+    params.MultiSampleType = D3DMULTISAMPLE_NONE;
+    params.PresentationInterval = D3DPRESENT_INTERVAL_DEFAULT;
+    params.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    params.Windowed = TRUE;
+  }
+
+};
+
+LRESULT CALLBACK WindowProc(HWND hWnd,
+                            UINT message,
+                            WPARAM wParam,
+                            LPARAM lParam);
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  HWND hWnd;
+  WNDCLASSEXW wc;
+  ZeroMemory(&wc, sizeof(WNDCLASSEX));
+  wc.cbSize = sizeof(WNDCLASSEX);
+  wc.style = CS_HREDRAW | CS_VREDRAW;
+  wc.lpfnWndProc = WindowProc;
+  wc.hInstance = hInstance;
+  wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+  wc.hbrBackground = (HBRUSH)COLOR_WINDOW;
+  wc.lpszClassName = L"WindowClass1";
+  RegisterClassExW(&wc);
+
+  hWnd = CreateWindowExW(0,
+    L"WindowClass1",
+    L"ProcessVertices test",
+    WS_OVERLAPPEDWINDOW,
+    300, 300,
+    640, 480,
+    nullptr,
+    nullptr,
+    hInstance,
+    nullptr);
+
+  try {
+    ProcessVerticesApp app(hInstance, hWnd);
+    return app.run() ? 0 : 1;
+  } catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+}
+
+LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+  switch (message) {
+    case WM_CLOSE:
+      PostQuitMessage(0);
+      return 0;
+  }
+
+  return DefWindowProc(hWnd, message, wParam, lParam);
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <d3d9.h>
+
+#include "../test_utils.h"
+
+using namespace dxvk;
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+constexpr uint32_t BenchIterations = 10000;
+
+class StateBlockApp {
+
+public:
+
+  StateBlockApp(HINSTANCE instance, HWND window)
+  : m_window(window) {
+    HRESULT status = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_d3d);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to create D3D9 interface");
+
+    D3DPRESENT_PARAMETERS params;
+    getPresentParams(params);
+
+    status = m_d3d->CreateDeviceEx(
+      D3DADAPTER_DEFAULT,
+      D3DDEVTYPE_HAL,
+      m_window,
+      D3DCREATE_HARDWARE_VERTEXPROCESSING,
+      &params,
+      nullptr,
+      &m_device);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to create D3D9 device");
+  }
+
+  void run() {
+    Com<IDirect3DStateBlock9> allA = createFullBlock(0.0f);
+    Com<IDirect3DStateBlock9> allB = createFullBlock(1.0f);
+
+    Com<IDirect3DStateBlock9> sparseA = createSparseBlock(D3DCULL_CW,  0.0f);
+    Com<IDirect3DStateBlock9> sparseB = createSparseBlock(D3DCULL_CCW, 1.0f);
+
+    // Alternate between two blocks with different values so
+    // that every iteration actually changes device state
+    benchmark("D3DSBT_ALL apply",     [&] (uint32_t i) { (i & 1 ? allB : allA)->Apply(); });
+    benchmark("D3DSBT_ALL reapply",   [&] (uint32_t) { allA->Apply(); });
+    benchmark("D3DSBT_ALL capture",   [&] (uint32_t) { allA->Capture(); });
+    benchmark("Sparse apply",         [&] (uint32_t i) { (i & 1 ? sparseB : sparseA)->Apply(); });
+    benchmark("Sparse reapply",       [&] (uint32_t) { sparseA->Apply(); });
+    benchmark("Sparse capture",       [&] (uint32_t) { sparseA->Capture(); });
+  }
+
+private:
+
+  HWND                          m_window;
+
+  Com<IDirect3D9Ex>             m_d3d;
+  Com<IDirect3DDevice9Ex>       m_device;
+
+  template<typename Fn>
+  void benchmark(const char* name, const Fn& fn) {
+    auto t0 = BenchClock::now();
+
+    for (uint32_t i = 0; i < BenchIterations; i++)
+      fn(i);
+
+    auto t1 = BenchClock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+
+    std::cout << str::format(name, ": ", ns / BenchIterations, " ns per call") << std::endl;
+  }
+
+  Com<IDirect3DStateBlock9> createFullBlock(float value) {
+    DWORD fogStart;
+    std::memcpy(&fogStart, &value, sizeof(fogStart));
+
+    setConstants(value, 256);
+    m_device->SetRenderState(D3DRS_FOGSTART, fogStart);
+
+    Com<IDirect3DStateBlock9> block;
+
+    if (FAILED(m_device->CreateStateBlock(D3DSBT_ALL, &block)))
+      throw DxvkError("Failed to create state block");
+
+    return block;
+  }
+
+  Com<IDirect3DStateBlock9> createSparseBlock(DWORD cullMode, float value) {
+    Com<IDirect3DStateBlock9> block;
+
+    if (FAILED(m_device->BeginStateBlock()))
+      throw DxvkError("Failed to begin state block");
+
+    m_device->SetRenderState(D3DRS_CULLMODE, cullMode);
+    m_device->SetRenderState(D3DRS_ZWRITEENABLE, cullMode == D3DCULL_CW);
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP, cullMode == D3DCULL_CW ? D3DTOP_MODULATE : D3DTOP_SELECTARG1);
+    setConstants(value, 4);
+
+    if (FAILED(m_device->EndStateBlock(&block)))
+      throw DxvkError("Failed to end state block");
+
+    return block;
+  }
+
+  void setConstants(float value, uint32_t count) {
+    std::vector<float> data(4 * count, value);
+    m_device->SetVertexShaderConstantF(0, data.data(), count);
+    m_device->SetPixelShaderConstantF(0, data.data(), std::min(count, 224u));
+  }
+
+  void getPresentParams(D3DPRESENT_PARAMETERS& params) {
+    params.AutoDepthStencilFormat = D3DFMT_UNKNOWN;
+    params.BackBufferCount = 1;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.BackBufferWidth = 1024;
+    params.BackBufferHeight = 600;
+    params.EnableAutoDepthStencil = FALSE;
+    params.Flags = 0;
+    params.FullScreen_RefreshRateInHz = 0;
+    params.hDeviceWindow = m_window;
+    params.MultiSampleQuality = 0;
+    params.MultiSampleType = D3DMULTISAMPLE_NONE;
+    params.PresentationInterval = D3DPRESENT_INTERVAL_DEFAULT;
+    params.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    params.Windowed = TRUE;
+  }
+
+};
+
+LRESULT CALLBACK WindowProc(HWND hWnd,
+                            UINT message,
+                            WPARAM wParam,
+                            LPARAM lParam);
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  HWND hWnd;
+  WNDCLASSEXW wc;
+  ZeroMemory(&wc, sizeof(WNDCLASSEX));
+  wc.cbSize = sizeof(WNDCLASSEX);
+  wc.style = CS_HREDRAW | CS_VREDRAW;
+  wc.lpfnWndProc = WindowProc;
+  wc.hInstance = hInstance;
+  wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+  wc.hbrBackground = (HBRUSH)COLOR_WINDOW;
+  wc.lpszClassName = L"WindowClass1";
+  RegisterClassExW(&wc);
+
+  hWnd = CreateWindowExW(0,
+    L"WindowClass1",
+    L"State block benchmark",
+    WS_OVERLAPPEDWINDOW,
+    300, 300,
+    640, 480,
+    nullptr,
+    nullptr,
+    hInstance,
+    nullptr);
+
+  try {
+    StateBlockApp app(hInstance, hWnd);
+    app.run();
+  } catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+  switch (message) {
+    case WM_CLOSE:
+      PostQuitMessage(0);
+      return 0;
+  }
+
+  return DefWindowProc(hWnd, message, wParam, lParam);
+}
@@ -0,0 +1,749 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <vector>
+
+#include "../../src/dxbc/dxbc_module.h"
+#include "../../src/dxso/dxso_module.h"
+#include "../../src/dxso/dxso_modinfo.h"
+#include "../../src/dxvk/dxvk_device.h"
+#include "../../src/dxvk/dxvk_instance.h"
+#include "../../src/dxvk/dxvk_shader.h"
+#include "../../src/spirv/spirv_compression.h"
+#include "../../src/spirv/spirv_optimizer.h"
+
+#include "test_spirv_passes.h"
+
+#include <shellapi.h>
+#include <windows.h>
+#include <windowsx.h>
+
+namespace dxvk {
+  Logger Logger::s_instance("shader-bench.log");
+}
+
+using namespace dxvk;
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+/**
+ * \brief Shader binary format
+ */
+enum class BenchShaderType {
+  Dxbc,
+  Dxso,
+};
+
+/**
+ * \brief Benchmark result for one shader
+ *
+ * Times are medians across all iterations, in
+ * microseconds. SPIR-V statistics are summed
+ * up across all shaders produced from the
+ * input, e.g. all DXSO permutations. Driver
+ * time is not part of the total since it is
+ * only measured for some shaders.
+ */
+struct BenchResult {
+  std::string name;
+  bool        success           = false;
+  double      decodeUs          = 0.0;
+  double      analyzeUs         = 0.0;
+  double      compileUs         = 0.0;
+  double      compressUs        = 0.0;
+  double      driverUs          = 0.0;
+  uint64_t    spirvBytes        = 0;
+  uint64_t    spirvInstructions = 0;
+
+  double totalUs() const {
+    return decodeUs + analyzeUs + compileUs + compressUs;
+  }
+
+  void add(const BenchResult& other) {
+    decodeUs          += other.decodeUs;
+    analyzeUs         += other.analyzeUs;
+    compileUs         += other.compileUs;
+    compressUs        += other.compressUs;
+    driverUs          += other.driverUs;
+    spirvBytes        += other.spirvBytes;
+    spirvInstructions += other.spirvInstructions;
+  }
+};
+
+
+/**
+ * \brief Raw timings for a single iteration
+ */
+struct BenchSample {
+  uint64_t decodeNs   = 0;
+  uint64_t analyzeNs  = 0;
+  uint64_t compileNs  = 0;
+  uint64_t compressNs = 0;
+  uint64_t driverNs   = 0;
+};
+
+
+static bool g_optimizeSpirv = false;
+static bool g_passReport    = false;
+
+static SpirvPassTotals g_passTotals;
+
+static Rc<DxvkDevice> g_device;
+
+
+static uint64_t elapsedNs(BenchClock::time_point t0, BenchClock::time_point t1) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+}
+
+
+static double medianUs(std::vector<uint64_t> values) {
+  if (values.empty())
+    return 0.0;
+
+  std::sort(values.begin(), values.end());
+  return double(values[values.size() / 2]) / 1000.0;
+}
+
+
+static std::vector<char> readFile(const std::string& fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  file.ignore(std::numeric_limits<std::streamsize>::max());
+  std::streamsize length = file.gcount();
+  file.clear();
+
+  file.seekg(0, std::ios_base::beg);
+  std::vector<char> data(length);
+  file.read(data.data(), length);
+  return data;
+}
+
+
+/**
+ * \brief Runs all optimizer pass configurations
+ *
+ * Only done on the SPIR-V produced by the first
+ * iteration of each shader. When combined with
+ * \c -O, this only shows what the optimizer
+ * can still find in already optimized code.
+ */
+static void measurePasses(
+  const SpirvCodeBuffer&    code) {
+  for (uint32_t i = 0; i < g_passTotals.size(); i++) {
+    SpirvCodeBuffer copy = code;
+    SpirvOptimizer optimizer(getPassConfig(i));
+    optimizer.run(copy);
+
+    g_passTotals[i].add(optimizer.stats());
+  }
+}
+
+
+/**
+ * \brief Creates a device for driver measurements
+ *
+ * Uses the first adapter with all of its features
+ * enabled, so that any shader can be compiled.
+ * \returns \c true on success
+ */
+static bool createDevice() {
+  try {
+    Rc<DxvkInstance> instance = new DxvkInstance();
+    Rc<DxvkAdapter>  adapter  = instance->enumAdapters(0);
+
+    if (adapter == nullptr) {
+      Logger::err("No Vulkan adapter found");
+      return false;
+    }
+
+    g_device = adapter->createDevice(instance, "shader-bench", adapter->features());
+    return true;
+  } catch (const DxvkError& e) {
+    Logger::err(e.message());
+    return false;
+  }
+}
+
+
+/**
+ * \brief Measures driver compile time for a shader
+ *
+ * Creates a shader module and pipeline the same way
+ * compute pipelines do, without a pipeline cache.
+ * Graphics shaders are skipped since their pipelines
+ * depend on state that the shader binary does not
+ * provide. Drivers may still cache compiled shaders
+ * on their own, e.g. Mesa unless its shader cache
+ * is disabled with MESA_SHADER_CACHE_DISABLE=1.
+ * \returns Time spent in the driver, in nanoseconds
+ */
+static uint64_t measureDriverCompile(
+  const Rc<DxvkShader>&     shader) {
+  if (g_device == nullptr || shader->stage() != VK_SHADER_STAGE_COMPUTE_BIT)
+    return 0;
+
+  Rc<vk::DeviceFn> vkd = g_device->vkd();
+
+  DxvkDescriptorSlotMapping slotMapping;
+  shader->defineResourceSlots(slotMapping);
+
+  slotMapping.makeDescriptorsDynamic(
+    g_device->options().maxNumDynamicUniformBuffers,
+    g_device->options().maxNumDynamicStorageBuffers);
+
+  Rc<DxvkPipelineLayout> layout = new DxvkPipelineLayout(
+    vkd, slotMapping, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+  DxvkShaderModuleCreateInfo moduleInfo;
+  moduleInfo.fsDualSrcBlend = false;
+
+  auto t0 = BenchClock::now();
+  Rc<DxvkShaderModule> module = shader->createShaderModule(vkd, slotMapping, moduleInfo);
+
+  VkComputePipelineCreateInfo info;
+  info.sType                = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  info.pNext                = nullptr;
+  info.flags                = 0;
+  info.stage                = module->stageInfo(nullptr);
+  info.layout               = layout->pipelineLayout();
+  info.basePipelineHandle   = VK_NULL_HANDLE;
+  info.basePipelineIndex    = -1;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  if (vkd->vkCreateComputePipelines(vkd->device(),
+        VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS)
+    throw DxvkError("Failed to create compute pipeline");
+
+  auto t1 = BenchClock::now();
+
+  vkd->vkDestroyPipeline(vkd->device(), pipeline, nullptr);
+  return elapsedNs(t0, t1);
+}
+
+
+/**
+ * \brief Gathers SPIR-V stats for a compiled shader
+ *
+ * Re-compresses the final SPIR-V code in order to
+ * measure compression time, since the compressor
+ * runs as part of shader object creation.
+ */
+static void processSpirv(
+  const Rc<DxvkShader>&     shader,
+        bool                firstIteration,
+        BenchSample&        sample,
+        BenchResult&        result) {
+  if (shader == nullptr)
+    return;
+
+  std::stringstream stream;
+  shader->dump(stream);
+
+  SpirvCodeBuffer code(stream);
+
+  if (g_passReport && firstIteration)
+    measurePasses(code);
+
+  auto t0 = BenchClock::now();
+  SpirvCompressedBuffer compressed(code);
+  auto t1 = BenchClock::now();
+
+  sample.compressNs += elapsedNs(t0, t1);
+  sample.driverNs   += measureDriverCompile(shader);
+
+  result.spirvBytes = code.size();
+  result.spirvInstructions = 0;
+
+  for (auto ins : code) {
+    (void)ins;
+    result.spirvInstructions += 1;
+  }
+}
+
+
+/**
+ * \brief Removes compression time from compile time
+ *
+ * Shader objects compress their code on creation, so the
+ * compile time includes compression. Since compression is
+ * reported separately, subtract it to not count it twice.
+ */
+static void excludeCompression(
+        BenchSample&        sample) {
+  sample.compileNs -= std::min(sample.compileNs, sample.compressNs);
+}
+
+
+static BenchSample runDxbc(
+  const std::string&        name,
+  const std::vector<char>&  data,
+        bool                firstIteration,
+        BenchResult&        result) {
+  BenchSample sample;
+
+  DxbcReader reader(data.data(), data.size());
+  DxbcModule module(reader);
+
+  DxbcModuleInfo moduleInfo;
+  moduleInfo.options.useSubgroupOpsForAtomicCounters = true;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.minSsboAlignment = 4;
+  moduleInfo.options.optimizeSpirv = g_optimizeSpirv;
+  moduleInfo.tess = nullptr;
+  moduleInfo.xfb = nullptr;
+
+  DxbcCompileTimings timings;
+  Rc<DxvkShader> shader = module.compile(moduleInfo, name, &timings);
+
+  sample.decodeNs  = timings.decodeNs;
+  sample.analyzeNs = timings.analyzeNs;
+  sample.compileNs = timings.compileNs;
+
+  processSpirv(shader, firstIteration, sample, result);
+  excludeCompression(sample);
+  return sample;
+}
+
+
+static BenchSample runDxso(
+  const std::string&        name,
+  const std::vector<char>&  data,
+        bool                firstIteration,
+        BenchResult&        result) {
+  BenchSample sample;
+
+  DxsoReader reader(data.data());
+  DxsoModule module(reader);
+
+  DxsoModuleInfo moduleInfo;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.strictConstantCopies = false;
+  moduleInfo.options.d3d9FloatEmulation = true;
+  moduleInfo.options.strictPow = true;
+  moduleInfo.options.shaderModel = 3;
+  moduleInfo.options.invariantPosition = false;
+  moduleInfo.options.optimizeSpirv = g_optimizeSpirv;
+
+  // Use the same constant layout as a device
+  // without software vertex processing would
+  D3D9ConstantLayout layout;
+
+  if (module.info().type() == DxsoProgramType::VertexShader) {
+    layout.floatCount = caps::MaxFloatConstantsVS;
+  } else {
+    layout.floatCount = caps::MaxFloatConstantsPS;
+  }
+
+  layout.intCount     = caps::MaxOtherConstants;
+  layout.boolCount    = caps::MaxOtherConstants;
+  layout.bitmaskCount = align(layout.boolCount, 32) / 32;
+
+  auto t0 = BenchClock::now();
+  module.decode();
+  auto t1 = BenchClock::now();
+  DxsoAnalysisInfo analysis = module.analyze();
+  auto t2 = BenchClock::now();
+  DxsoPermutations shaders = module.compile(moduleInfo, name, analysis, layout);
+  auto t3 = BenchClock::now();
+
+  sample.decodeNs  = elapsedNs(t0, t1);
+  sample.analyzeNs = elapsedNs(t1, t2);
+  sample.compileNs = elapsedNs(t2, t3);
+
+  uint64_t spirvBytes = 0;
+  uint64_t spirvInstructions = 0;
+
+  for (const auto& shader : shaders) {
+    processSpirv(shader, firstIteration, sample, result);
+    spirvBytes        += result.spirvBytes;
+    spirvInstructions += result.spirvInstructions;
+  }
+
+  result.spirvBytes        = spirvBytes;
+  result.spirvInstructions = spirvInstructions;
+
+  excludeCompression(sample);
+  return sample;
+}
+
+
+static BenchResult runShader(
+  const std::string&        path,
+  const std::string&        name,
+        BenchShaderType     type,
+        uint32_t            iterations) {
+  BenchResult result;
+  result.name = name;
+
+  std::vector<char> data = readFile(path);
+
+  std::vector<uint64_t> decodeNs;
+  std::vector<uint64_t> analyzeNs;
+  std::vector<uint64_t> compileNs;
+  std::vector<uint64_t> compressNs;
+  std::vector<uint64_t> driverNs;
+
+  try {
+    for (uint32_t i = 0; i < iterations; i++) {
+      BenchSample sample = type == BenchShaderType::Dxbc
+        ? runDxbc(name, data, i == 0, result)
+        : runDxso(name, data, i == 0, result);
+
+      decodeNs  .push_back(sample.decodeNs);
+      analyzeNs .push_back(sample.analyzeNs);
+      compileNs .push_back(sample.compileNs);
+      compressNs.push_back(sample.compressNs);
+      driverNs  .push_back(sample.driverNs);
+    }
+  } catch (const DxvkError& e) {
+    Logger::err(str::format(name, ": ", e.message()));
+    return result;
+  }
+
+  result.success    = true;
+  result.decodeUs   = medianUs(std::move(decodeNs));
+  result.analyzeUs  = medianUs(std::move(analyzeNs));
+  result.compileUs  = medianUs(std::move(compileNs));
+  result.compressUs = medianUs(std::move(compressNs));
+  result.driverUs   = medianUs(std::move(driverNs));
+  return result;
+}
+
+
+/**
+ * \brief Finds shader binaries in a directory
+ *
+ * Picks up files with a \c .dxbc or \c .dxso
+ * extension, as written by DXVK_SHADER_DUMP_PATH.
+ */
+static void findShaders(
+  const std::string&        directory,
+        std::vector<std::pair<std::string, BenchShaderType>>& files) {
+  WIN32_FIND_DATAW findData;
+  WCHAR pattern[MAX_PATH];
+
+  str::tows(str::format(directory, "/*").c_str(), pattern);
+
+  HANDLE handle = FindFirstFileW(pattern, &findData);
+
+  if (handle == INVALID_HANDLE_VALUE) {
+    Logger::err(str::format("Failed to open directory ", directory));
+    return;
+  }
+
+  do {
+    if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+
+    std::string fileName = str::fromws(findData.cFileName);
+    std::string path = str::format(directory, "/", fileName);
+
+    if (fileName.size() > 5 && fileName.substr(fileName.size() - 5) == ".dxbc")
+      files.push_back({ path, BenchShaderType::Dxbc });
+    else if (fileName.size() > 5 && fileName.substr(fileName.size() - 5) == ".dxso")
+      files.push_back({ path, BenchShaderType::Dxso });
+  } while (FindNextFileW(handle, &findData));
+
+  FindClose(handle);
+}
+
+
+static std::string baseName(const std::string& path) {
+  size_t pos = path.find_last_of("/\\");
+  return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+
+static void writeEntry(std::ostream& stream, const BenchResult& result) {
+  stream << "\"success\": " << (result.success ? "true" : "false")
+         << ", \"decodeUs\": " << result.decodeUs
+         << ", \"analyzeUs\": " << result.analyzeUs
+         << ", \"compileUs\": " << result.compileUs
+         << ", \"compressUs\": " << result.compressUs
+         << ", \"driverUs\": " << result.driverUs
+         << ", \"spirvBytes\": " << result.spirvBytes
+         << ", \"spirvInstructions\": " << result.spirvInstructions;
+}
+
+
+static void writeJson(
+  const std::string&                fileName,
+        uint32_t                    iterations,
+  const std::vector<BenchResult>&   results,
+  const BenchResult&                total) {
+  std::ofstream file(fileName, std::ios::trunc);
+  file << std::fixed << std::setprecision(2);
+
+  file << "{" << std::endl;
+  file << "  \"iterations\": " << iterations << "," << std::endl;
+  file << "  \"shaders\": [" << std::endl;
+
+  for (size_t i = 0; i < results.size(); i++) {
+    file << "    { \"name\": \"" << results[i].name << "\", ";
+    writeEntry(file, results[i]);
+    file << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+
+  file << "  ]," << std::endl;
+  file << "  \"total\": { ";
+  writeEntry(file, total);
+  file << " }" << std::endl;
+  file << "}" << std::endl;
+}
+
+
+/**
+ * \brief Reads a baseline written by a previous run
+ *
+ * This only understands the subset of JSON that \c writeJson
+ * produces, i.e. flat objects with string, number or boolean
+ * members. The aggregate entry is the object without a name.
+ */
+static bool readJson(
+  const std::string&                      fileName,
+        std::map<std::string, BenchResult>& results,
+        BenchResult&                      total) {
+  std::ifstream file(fileName);
+
+  if (!file)
+    return false;
+
+  std::stringstream stream;
+  stream << file.rdbuf();
+  std::string json = stream.str();
+
+  static const std::regex objectRegex(R"(\{([^{}]*)\})");
+  static const std::regex memberRegex(R"re("(\w+)"\s*:\s*("([^"]*)"|[^,\s}]+))re");
+
+  for (auto o = std::sregex_iterator(json.begin(), json.end(), objectRegex); o != std::sregex_iterator(); o++) {
+    std::string object = (*o)[1].str();
+
+    BenchResult result;
+    bool named = false;
+
+    for (auto m = std::sregex_iterator(object.begin(), object.end(), memberRegex); m != std::sregex_iterator(); m++) {
+      std::string key   = (*m)[1].str();
+      std::string value = (*m)[2].str();
+
+      if (key == "name") {
+        result.name = (*m)[3].str();
+        named = true;
+      } else if (key == "success") {
+        result.success = value == "true";
+      } else if (key == "decodeUs") {
+        result.decodeUs = std::stod(value);
+      } else if (key == "analyzeUs") {
+        result.analyzeUs = std::stod(value);
+      } else if (key == "compileUs") {
+        result.compileUs = std::stod(value);
+      } else if (key == "compressUs") {
+        result.compressUs = std::stod(value);
+      } else if (key == "driverUs") {
+        result.driverUs = std::stod(value);
+      } else if (key == "spirvBytes") {
+        result.spirvBytes = std::stoull(value);
+      } else if (key == "spirvInstructions") {
+        result.spirvInstructions = std::stoull(value);
+      }
+    }
+
+    if (named)
+      results.insert({ result.name, result });
+    else
+      total = result;
+  }
+
+  return true;
+}
+
+
+static double percentChange(double base, double value) {
+  return base > 0.0 ? 100.0 * (value - base) / base : 0.0;
+}
+
+
+/**
+ * \brief Compares results against a baseline
+ *
+ * Individual shaders are only reported, since timings of
+ * small shaders are noisy. The run fails if the aggregate
+ * time regresses by more than the given threshold, or if
+ * a shader that used to compile no longer does.
+ */
+static bool compareBaseline(
+  const std::string&                fileName,
+  const std::vector<BenchResult>&   results,
+  const BenchResult&                total,
+        double                      threshold) {
+  std::map<std::string, BenchResult> baseline;
+  BenchResult baselineTotal;
+
+  if (!readJson(fileName, baseline, baselineTotal)) {
+    std::cerr << "Failed to read baseline " << fileName << std::endl;
+    return false;
+  }
+
+  bool passed = true;
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Comparing against " << fileName << ":" << std::endl;
+
+  for (const auto& result : results) {
+    auto entry = baseline.find(result.name);
+
+    if (entry == baseline.end())
+      continue;
+
+    const BenchResult& base = entry->second;
+
+    if (base.success && !result.success) {
+      std::cout << "  " << result.name << ": no longer compiles" << std::endl;
+      passed = false;
+      continue;
+    }
+
+    double timeChange = percentChange(base.totalUs(), result.totalUs());
+
+    if (timeChange > threshold) {
+      std::cout << "  " << result.name << ": time " << base.totalUs()
+                << " us -> " << result.totalUs() << " us (+" << timeChange << "%)" << std::endl;
+    }
+
+    if (result.spirvBytes > base.spirvBytes) {
+      std::cout << "  " << result.name << ": SPIR-V size " << base.spirvBytes
+                << " -> " << result.spirvBytes << " bytes" << std::endl;
+    }
+  }
+
+  double totalChange = percentChange(baselineTotal.totalUs(), total.totalUs());
+
+  std::cout << "  Total time: " << baselineTotal.totalUs() << " us -> "
+            << total.totalUs() << " us (" << (totalChange >= 0.0 ? "+" : "") << totalChange << "%)" << std::endl;
+  std::cout << "  Total SPIR-V size: " << baselineTotal.spirvBytes << " -> "
+            << total.spirvBytes << " bytes" << std::endl;
+
+  if (totalChange > threshold) {
+    std::cout << "  Total time exceeds threshold of " << threshold << "%" << std::endl;
+    passed = false;
+  }
+
+  return passed;
+}
+
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  int     argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(
+    GetCommandLineW(), &argc);
+
+  uint32_t    iterations = 10;
+  double      threshold  = 10.0;
+  std::string outputFile;
+  std::string baselineFile;
+  bool        measureDriver = false;
+
+  std::vector<std::string> directories;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = str::fromws(argv[i]);
+
+    if (arg == "-n" && i + 1 < argc)
+      iterations = std::max(1, std::stoi(str::fromws(argv[++i])));
+    else if (arg == "-t" && i + 1 < argc)
+      threshold = std::stod(str::fromws(argv[++i]));
+    else if (arg == "-o" && i + 1 < argc)
+      outputFile = str::fromws(argv[++i]);
+    else if (arg == "-b" && i + 1 < argc)
+      baselineFile = str::fromws(argv[++i]);
+    else if (arg == "-O")
+      g_optimizeSpirv = true;
+    else if (arg == "-p")
+      g_passReport = true;
+    else if (arg == "-d")
+      measureDriver = true;
+    else
+      directories.push_back(arg);
+  }
+
+  if (directories.empty()) {
+    std::cerr << "Usage: shader-bench [-n iterations] [-o output.json] [-b baseline.json] [-t threshold] [-O] [-p] [-d] dir..." << std::endl;
+    return 1;
+  }
+
+  if (measureDriver && !createDevice())
+    return 1;
+
+  std::vector<std::pair<std::string, BenchShaderType>> files;
+
+  for (const auto& directory : directories)
+    findShaders(directory, files);
+
+  std::sort(files.begin(), files.end());
+
+  std::vector<BenchResult> results;
+  BenchResult total;
+  total.success = true;
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << std::left << std::setw(48) << "Shader"
+            << std::right << std::setw(10) << "Decode"
+            << std::setw(10) << "Analyze"
+            << std::setw(10) << "Compile"
+            << std::setw(10) << "Compress"
+            << std::setw(10) << "Driver"
+            << std::setw(10) << "Bytes"
+            << std::setw(8)  << "Ins" << std::endl;
+
+  for (const auto& file : files) {
+    BenchResult result = runShader(file.first,
+      baseName(file.first), file.second, iterations);
+
+    if (result.success) {
+      std::cout << std::left << std::setw(48) << result.name
+                << std::right << std::setw(10) << result.decodeUs
+                << std::setw(10) << result.analyzeUs
+                << std::setw(10) << result.compileUs
+                << std::setw(10) << result.compressUs
+                << std::setw(10) << result.driverUs
+                << std::setw(10) << result.spirvBytes
+                << std::setw(8)  << result.spirvInstructions << std::endl;
+
+      total.add(result);
+    } else {
+      std::cout << std::left << std::setw(48) << result.name << " failed" << std::endl;
+      total.success = false;
+    }
+
+    results.push_back(std::move(result));
+  }
+
+  g_device = nullptr;
+
+  std::cout << std::left << std::setw(48) << "Total (us)"
+            << std::right << std::setw(10) << total.decodeUs
+            << std::setw(10) << total.analyzeUs
+            << std::setw(10) << total.compileUs
+            << std::setw(10) << total.compressUs
+            << std::setw(10) << total.driverUs
+            << std::setw(10) << total.spirvBytes
+            << std::setw(8)  << total.spirvInstructions << std::endl;
+
+  if (g_passReport)
+    printPassReport(g_passTotals, false);
+
+  if (!outputFile.empty())
+    writeJson(outputFile, iterations, results, total);
+
+  if (!baselineFile.empty() && !compareBaseline(baselineFile, results, total, threshold))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,1041 @@
+// Needed for spv::HasResultAndType
+#define SPV_ENABLE_UTILITY_CODE
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+#include <d3dcompiler.h>
+
+#include "../../src/dxbc/dxbc_module.h"
+#include "../../src/dxso/dxso_module.h"
+#include "../../src/dxso/dxso_modinfo.h"
+#include "../../src/dxvk/dxvk_shader.h"
+#include "../../src/spirv/spirv_optimizer.h"
+
+#include "test_spirv_passes.h"
+
+#include <shellapi.h>
+#include <windows.h>
+#include <windowsx.h>
+
+#include "../test_utils.h"
+
+namespace dxvk {
+  Logger Logger::s_instance("spirv-optimizer.log");
+}
+
+using namespace dxvk;
+
+/**
+ * \brief Test shader
+ *
+ * HLSL source which gets compiled to DXBC or,
+ * for shader model 3 targets, to DXSO byte code.
+ */
+struct TestShader {
+  const char* name;
+  const char* target;
+  const char* source;
+};
+
+
+const std::array<TestShader, 9> g_testShaders = {{
+  { "vs_transform", "vs_5_0", R"(
+    cbuffer c_transform : register(b0) {
+      float4x4 world_view;
+      float4x4 projection;
+      float4   tint;
+    };
+
+    struct vs_in {
+      float4 pos    : POSITION;
+      float3 normal : NORMAL;
+      float2 uv     : TEXCOORD0;
+      float4 unused : TEXCOORD1;
+    };
+
+    struct vs_out {
+      float4 pos    : SV_POSITION;
+      float3 normal : NORMAL;
+      float2 uv     : TEXCOORD0;
+      float4 color  : COLOR0;
+    };
+
+    vs_out main(vs_in i) {
+      vs_out o;
+      float4 view_pos = mul(world_view, i.pos);
+      o.pos    = mul(projection, view_pos);
+      o.normal = normalize(mul((float3x3)world_view, i.normal));
+      o.uv     = i.uv * 2.0f - 1.0f;
+      o.color  = tint * saturate(view_pos.z);
+      return o;
+    })" },
+
+  { "ps_lighting", "ps_5_0", R"(
+    Texture2D<float4> t_albedo : register(t0);
+    SamplerState      s_linear : register(s0);
+
+    cbuffer c_lights : register(b0) {
+      uint   light_count;
+      float3 ambient;
+      float4 light_dirs[8];
+      float4 light_colors[8];
+    };
+
+    float4 main(float4 pos : SV_POSITION, float3 normal : NORMAL, float2 uv : TEXCOORD0) : SV_TARGET {
+      float4 albedo = t_albedo.Sample(s_linear, uv);
+
+      if (albedo.a < 0.5f)
+        discard;
+
+      float3 n = normalize(normal);
+      float3 color = ambient;
+
+      [loop]
+      for (uint i = 0; i < light_count; i++)
+        color += light_colors[i].rgb * saturate(dot(n, light_dirs[i].xyz));
+
+      return float4(albedo.rgb * color, albedo.a);
+    })" },
+
+  { "cs_blur", "cs_5_0", R"(
+    Texture2D<float4>   t_src : register(t0);
+    RWTexture2D<float4> u_dst : register(u0);
+
+    cbuffer c_blur : register(b0) {
+      uint2  size;
+      float  weights[4];
+    };
+
+    groupshared float4 g_cache[64 + 6];
+
+    [numthreads(64, 1, 1)]
+    void main(uint3 tid : SV_DispatchThreadID, uint gi : SV_GroupIndex) {
+      uint2 coord = min(tid.xy, size - 1);
+      g_cache[gi + 3] = t_src.Load(int3(coord, 0));
+
+      if (gi < 3) {
+        g_cache[gi]      = t_src.Load(int3(max(int(coord.x) - 3, 0), coord.y, 0));
+        g_cache[gi + 67] = t_src.Load(int3(min(coord.x + 64, size.x - 1), coord.y, 0));
+      }
+
+      GroupMemoryBarrierWithGroupSync();
+
+      float4 sum = g_cache[gi + 3] * weights[0];
+
+      [unroll]
+      for (uint i = 1; i < 4; i++)
+        sum += (g_cache[gi + 3 - i] + g_cache[gi + 3 + i]) * weights[i];
+
+      if (all(tid.xy < size))
+        u_dst[tid.xy] = sum;
+    })" },
+
+  { "cs_histogram", "cs_5_0", R"(
+    Texture2D<float4>          t_src  : register(t0);
+    RWByteAddressBuffer        u_hist : register(u0);
+    RWStructuredBuffer<uint2>  u_minmax : register(u1);
+
+    [numthreads(8, 8, 1)]
+    void main(uint3 tid : SV_DispatchThreadID) {
+      float4 c = t_src.Load(int3(tid.xy, 0));
+      float luma = dot(c.rgb, float3(0.299f, 0.587f, 0.114f));
+      uint bin = uint(saturate(luma) * 255.0f);
+
+      u_hist.InterlockedAdd(bin * 4, 1);
+
+      uint dummy;
+      InterlockedMin(u_minmax[0].x, bin, dummy);
+      InterlockedMax(u_minmax[0].y, bin, dummy);
+    })" },
+
+  { "gs_sprites", "gs_5_0", R"(
+    struct gs_in {
+      float4 pos  : SV_POSITION;
+      float  size : PSIZE;
+    };
+
+    struct gs_out {
+      float4 pos : SV_POSITION;
+      float2 uv  : TEXCOORD0;
+    };
+
+    [maxvertexcount(4)]
+    void main(point gs_in i[1], inout TriangleStream<gs_out> stream) {
+      const float2 offsets[4] = {
+        float2(-1.0f, -1.0f), float2(-1.0f, 1.0f),
+        float2( 1.0f, -1.0f), float2( 1.0f, 1.0f),
+      };
+
+      [unroll]
+      for (uint v = 0; v < 4; v++) {
+        gs_out o;
+        o.pos = i[0].pos + float4(offsets[v] * i[0].size, 0.0f, 0.0f);
+        o.uv  = offsets[v] * 0.5f + 0.5f;
+        stream.Append(o);
+      }
+    })" },
+
+  { "hs_patch", "hs_5_0", R"(
+    struct hs_data {
+      float4 pos : POSITION;
+    };
+
+    struct hs_patch_data {
+      float edges[3] : SV_TessFactor;
+      float inside   : SV_InsideTessFactor;
+    };
+
+    cbuffer c_tess : register(b0) {
+      float tess_factor;
+    };
+
+    hs_patch_data main_patch(InputPatch<hs_data, 3> ip) {
+      hs_patch_data o;
+      o.edges[0] = tess_factor;
+      o.edges[1] = tess_factor;
+      o.edges[2] = tess_factor;
+      o.inside   = tess_factor;
+      return o;
+    }
+
+    [domain("tri")]
+    [partitioning("integer")]
+    [outputtopology("triangle_cw")]
+    [outputcontrolpoints(3)]
+    [patchconstantfunc("main_patch")]
+    hs_data main(InputPatch<hs_data, 3> ip, uint cp : SV_OutputControlPointID) {
+      return ip[cp];
+    })" },
+
+  { "vs_sm3_skinning", "vs_3_0", R"(
+    float4x4 view_proj   : register(c0);
+    float4x3 bones[16]   : register(c4);
+
+    struct vs_in {
+      float4 pos     : POSITION;
+      float4 weights : BLENDWEIGHT;
+      float4 indices : BLENDINDICES;
+      float2 uv      : TEXCOORD0;
+    };
+
+    struct vs_out {
+      float4 pos : POSITION;
+      float2 uv  : TEXCOORD0;
+    };
+
+    vs_out main(vs_in i) {
+      float3 pos = 0.0f;
+
+      for (int b = 0; b < 4; b++)
+        pos += mul(i.pos, bones[int(i.indices[b])]) * i.weights[b];
+
+      vs_out o;
+      o.pos = mul(float4(pos, 1.0f), view_proj);
+      o.uv  = i.uv;
+      return o;
+    })" },
+
+  { "ps_sm3_fog", "ps_3_0", R"(
+    sampler2D s_diffuse : register(s0);
+    float4    fog_color : register(c0);
+    float4    fog_range : register(c1);
+
+    float4 main(float2 uv : TEXCOORD0, float depth : TEXCOORD1) : COLOR0 {
+      float4 color = tex2D(s_diffuse, uv);
+      float fog = saturate((depth - fog_range.x) * fog_range.y);
+      return float4(lerp(color.rgb, fog_color.rgb, fog), color.a);
+    })" },
+
+  { "ps_sm3_lights", "ps_3_0", R"(
+    float4 light_pos[8]   : register(c0);
+    float4 light_color[8] : register(c8);
+    int    light_count    : register(i0);
+
+    float4 main(float3 pos : TEXCOORD0, float3 normal : TEXCOORD1) : COLOR0 {
+      float3 n = normalize(normal);
+      float3 color = 0.0f;
+
+      [loop]
+      for (int i = 0; i < light_count; i++) {
+        float3 l = light_pos[i].xyz - pos;
+        float d = dot(n, normalize(l));
+
+        [branch]
+        if (d > 0.0f)
+          color += light_color[i].rgb * d / (1.0f + dot(l, l));
+      }
+
+      return float4(color, 1.0f);
+    })" },
+}};
+
+
+/**
+ * \brief Structural SPIR-V validator
+ *
+ * Checks the properties that the optimizer could
+ * plausibly break: module layout, unique result IDs,
+ * that all referenced IDs are defined, that types are
+ * declared before use, and that every block is
+ * properly terminated and only branches to labels
+ * within its own function.
+ *
+ * This is not a replacement for \c spirv-val, which
+ * can be run on top of it via the \c -v option.
+ */
+class SpirvValidator {
+
+public:
+
+  bool validate(const SpirvCodeBuffer& code) {
+    m_errors.clear();
+
+    const uint32_t* words = code.data();
+    size_t count = code.dwords();
+
+    if (count < 5 || words[0] != spv::MagicNumber) {
+      error("Invalid header");
+      return false;
+    }
+
+    m_bound = words[3];
+
+    std::vector<Ins> instructions;
+
+    for (size_t offset = 5; offset < count; ) {
+      uint32_t length = words[offset] >> spv::WordCountShift;
+
+      if (!length || offset + length > count) {
+        error(str::format("Invalid instruction length at offset ", offset));
+        return false;
+      }
+
+      instructions.push_back({ spv::Op(words[offset] & spv::OpCodeMask), &words[offset], length });
+      offset += length;
+    }
+
+    std::vector<bool> defined(m_bound, false);
+    std::vector<bool> isLabel(m_bound, false);
+
+    // Gather definitions first since
+    // forward references are legal
+    for (const auto& ins : instructions) {
+      uint32_t resultId = getResultId(ins);
+
+      if (!resultId)
+        continue;
+
+      if (resultId >= m_bound) {
+        error(str::format("ID ", resultId, " exceeds bound ", m_bound));
+        continue;
+      }
+
+      if (defined[resultId])
+        error(str::format("ID ", resultId, " defined more than once"));
+
+      defined[resultId] = true;
+      isLabel[resultId] = ins.op == spv::OpLabel;
+    }
+
+    std::vector<bool> declared(m_bound, false);
+
+    uint32_t section     = 0;
+    bool     inFunction  = false;
+    bool     inBlock     = false;
+    bool     afterMerge  = false;
+    uint32_t blockCount  = 0;
+
+    std::unordered_set<uint32_t> functionLabels;
+    std::vector<uint32_t>        branchTargets;
+
+    for (const auto& ins : instructions) {
+      if (!inFunction) {
+        uint32_t insSection = getSection(ins.op);
+
+        if (insSection < section)
+          error(str::format("Instruction ", uint32_t(ins.op), " out of order"));
+
+        section = std::max(section, insSection);
+      }
+
+      bool hasResult = false;
+      bool hasType   = false;
+      spv::HasResultAndType(ins.op, &hasResult, &hasType);
+
+      if (hasType && (ins.length < 2 || !declared.at(std::min(ins.words[1], m_bound - 1))))
+        error(str::format("Instruction ", uint32_t(ins.op), " uses undeclared type ", ins.words[1]));
+
+      forEachIdOperand(ins, [&] (uint32_t id) {
+        if (id >= m_bound || !defined[id])
+          error(str::format("Instruction ", uint32_t(ins.op), " uses undefined ID ", id));
+      });
+
+      // Control flow structure
+      if (ins.op == spv::OpFunction) {
+        if (inFunction)
+          error("Nested function");
+
+        inFunction = true;
+        blockCount = 0;
+        functionLabels.clear();
+        branchTargets.clear();
+      } else if (ins.op == spv::OpFunctionEnd) {
+        if (!inFunction || inBlock)
+          error("Function ended inside a block");
+
+        for (uint32_t target : branchTargets) {
+          if (!functionLabels.count(target))
+            error(str::format("Branch to label ", target, " outside of function"));
+        }
+
+        inFunction = false;
+      } else if (ins.op == spv::OpLabel) {
+        if (!inFunction || inBlock)
+          error(str::format("Label ", ins.words[1], " inside of a block"));
+
+        functionLabels.insert(ins.words[1]);
+        inBlock = true;
+        blockCount += 1;
+      } else if (inFunction && ins.op != spv::OpFunctionParameter && ins.op != spv::OpLine && ins.op != spv::OpNoLine) {
+        if (!inBlock)
+          error(str::format("Instruction ", uint32_t(ins.op), " outside of a block"));
+
+        if (ins.op == spv::OpVariable && blockCount != 1)
+          error("Function variable declared outside of the first block");
+      }
+
+      if (afterMerge && ins.op != spv::OpBranch
+       && ins.op != spv::OpBranchConditional
+       && ins.op != spv::OpSwitch)
+        error("Merge instruction not followed by a branch");
+
+      afterMerge = ins.op == spv::OpSelectionMerge
+                || ins.op == spv::OpLoopMerge;
+
+      forEachLabelOperand(ins, [&] (uint32_t id) {
+        if (id >= m_bound || !isLabel[id])
+          error(str::format("Instruction ", uint32_t(ins.op), " targets non-label ", id));
+
+        branchTargets.push_back(id);
+      });
+
+      if (isTerminator(ins.op))
+        inBlock = false;
+
+      if (hasResult && !inFunction)
+        declared.at(std::min(getResultId(ins), m_bound - 1)) = true;
+    }
+
+    if (inFunction)
+      error("Unterminated function");
+
+    return m_errors.empty();
+  }
+
+  const std::vector<std::string>& errors() const {
+    return m_errors;
+  }
+
+private:
+
+  enum Section : uint32_t {
+    SectionCapabilities,
+    SectionExtensions,
+    SectionImports,
+    SectionMemoryModel,
+    SectionEntryPoints,
+    SectionExecutionModes,
+    SectionDebug,
+    SectionAnnotations,
+    SectionGlobals,
+    SectionFunctions,
+  };
+
+  struct Ins {
+    spv::Op         op;
+    const uint32_t* words;
+    uint32_t        length;
+  };
+
+  uint32_t                  m_bound = 0;
+  std::vector<std::string>  m_errors;
+
+  void error(const std::string& message) {
+    // Keep the output readable for badly broken modules
+    if (m_errors.size() < 16)
+      m_errors.push_back(message);
+  }
+
+  static uint32_t getResultId(const Ins& ins) {
+    bool hasResult = false;
+    bool hasType   = false;
+    spv::HasResultAndType(ins.op, &hasResult, &hasType);
+
+    if (!hasResult)
+      return 0;
+
+    uint32_t index = hasType ? 2 : 1;
+    return index < ins.length ? ins.words[index] : 0;
+  }
+
+  static uint32_t getSection(spv::Op op) {
+    switch (op) {
+      case spv::OpCapability:       return SectionCapabilities;
+      case spv::OpExtension:        return SectionExtensions;
+      case spv::OpExtInstImport:    return SectionImports;
+      case spv::OpMemoryModel:      return SectionMemoryModel;
+      case spv::OpEntryPoint:       return SectionEntryPoints;
+      case spv::OpExecutionMode:
+      case spv::OpExecutionModeId:  return SectionExecutionModes;
+      case spv::OpString:
+      case spv::OpSource:
+      case spv::OpSourceExtension:
+      case spv::OpSourceContinued:
+      case spv::OpName:
+      case spv::OpMemberName:       return SectionDebug;
+      case spv::OpDecorate:
+      case spv::OpMemberDecorate:
+      case spv::OpDecorationGroup:
+      case spv::OpGroupDecorate:
+      case spv::OpDecorateId:
+      case spv::OpDecorateString:
+      case spv::OpMemberDecorateString: return SectionAnnotations;
+      case spv::OpFunction:         return SectionFunctions;
+      default:                      return SectionGlobals;
+    }
+  }
+
+  static bool isTerminator(spv::Op op) {
+    switch (op) {
+      case spv::OpBranch:
+      case spv::OpBranchConditional:
+      case spv::OpSwitch:
+      case spv::OpReturn:
+      case spv::OpReturnValue:
+      case spv::OpKill:
+      case spv::OpUnreachable:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+  template<typename Fn>
+  static void forEachLabelOperand(const Ins& ins, const Fn& fn) {
+    switch (ins.op) {
+      case spv::OpBranch:
+        fn(ins.words[1]);
+        break;
+
+      case spv::OpBranchConditional:
+        fn(ins.words[2]);
+        fn(ins.words[3]);
+        break;
+
+      case spv::OpSwitch:
+        fn(ins.words[2]);
+
+        for (uint32_t i = 4; i < ins.length; i += 2)
+          fn(ins.words[i]);
+        break;
+
+      case spv::OpSelectionMerge:
+        fn(ins.words[1]);
+        break;
+
+      case spv::OpLoopMerge:
+        fn(ins.words[1]);
+        fn(ins.words[2]);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  /**
+   * \brief Iterates over ID operands
+   *
+   * Only covers instructions with a simple operand
+   * layout, other instructions are not checked.
+   * Result type and result IDs are not included.
+   */
+  template<typename Fn>
+  static void forEachIdOperand(const Ins& ins, const Fn& fn) {
+    bool hasResult = false;
+    bool hasType   = false;
+    spv::HasResultAndType(ins.op, &hasResult, &hasType);
+
+    uint32_t first = uint32_t(hasResult) + uint32_t(hasType) + 1;
+    uint32_t count = 0;
+
+    switch (ins.op) {
+      // Debug info and annotations
+      case spv::OpName:
+      case spv::OpMemberName:
+      case spv::OpDecorate:
+      case spv::OpMemberDecorate:
+      case spv::OpExecutionMode:
+        first = 1;
+        count = 1;
+        break;
+
+      case spv::OpEntryPoint: {
+        fn(ins.words[2]);
+
+        // Skip the name string to get to the interface
+        uint32_t index = 3;
+
+        while (index < ins.length && (ins.words[index] >> 24))
+          index += 1;
+
+        first = index + 1;
+        count = ins.length - std::min(first, ins.length);
+      } break;
+
+      // Types
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+      case spv::OpTypeRuntimeArray:
+      case spv::OpTypeSampledImage:
+        count = 1;
+        break;
+
+      case spv::OpTypeImage:
+        count = 1;
+        break;
+
+      case spv::OpTypeArray:
+        count = 2;
+        break;
+
+      case spv::OpTypePointer:
+        first = 3;
+        count = 1;
+        break;
+
+      case spv::OpTypeStruct:
+      case spv::OpTypeFunction:
+      case spv::OpConstantComposite:
+      case spv::OpSpecConstantComposite:
+        count = ins.length - first;
+        break;
+
+      case spv::OpVariable:
+        first = 4;
+        count = ins.length - std::min(first, ins.length);
+        break;
+
+      // Memory access
+      case spv::OpLoad:
+        count = 1;
+        break;
+
+      case spv::OpStore:
+        first = 1;
+        count = 2;
+        break;
+
+      case spv::OpAccessChain:
+      case spv::OpInBoundsAccessChain:
+      case spv::OpFunctionCall:
+      case spv::OpCompositeConstruct:
+        count = ins.length - first;
+        break;
+
+      case spv::OpCompositeExtract:
+        count = 1;
+        break;
+
+      case spv::OpCompositeInsert:
+      case spv::OpVectorShuffle:
+        count = 2;
+        break;
+
+      case spv::OpExtInst:
+        fn(ins.words[3]);
+        first = 5;
+        count = ins.length - std::min(first, ins.length);
+        break;
+
+      case spv::OpPhi:
+        for (uint32_t i = first; i + 1 < ins.length; i += 2)
+          fn(ins.words[i]);
+        break;
+
+      case spv::OpBranchConditional:
+      case spv::OpSwitch:
+      case spv::OpReturnValue:
+        first = 1;
+        count = 1;
+        break;
+
+      case spv::OpControlBarrier:
+        first = 1;
+        count = 3;
+        break;
+
+      case spv::OpMemoryBarrier:
+        first = 1;
+        count = 2;
+        break;
+
+      case spv::OpAtomicStore:
+        first = 1;
+        count = 4;
+        break;
+
+      case spv::OpAtomicLoad:
+      case spv::OpAtomicExchange:
+      case spv::OpAtomicIIncrement:
+      case spv::OpAtomicIDecrement:
+      case spv::OpAtomicIAdd:
+      case spv::OpAtomicISub:
+      case spv::OpAtomicSMin:
+      case spv::OpAtomicUMin:
+      case spv::OpAtomicSMax:
+      case spv::OpAtomicUMax:
+      case spv::OpAtomicAnd:
+      case spv::OpAtomicOr:
+      case spv::OpAtomicXor:
+      case spv::OpAtomicCompareExchange:
+        count = ins.length - first;
+        break;
+
+      // Arithmetic, logical and conversion ops,
+      // which only take IDs as their operands
+      case spv::OpSNegate:
+      case spv::OpFNegate:
+      case spv::OpIAdd:
+      case spv::OpFAdd:
+      case spv::OpISub:
+      case spv::OpFSub:
+      case spv::OpIMul:
+      case spv::OpFMul:
+      case spv::OpUDiv:
+      case spv::OpSDiv:
+      case spv::OpFDiv:
+      case spv::OpUMod:
+      case spv::OpSRem:
+      case spv::OpSMod:
+      case spv::OpFRem:
+      case spv::OpFMod:
+      case spv::OpVectorTimesScalar:
+      case spv::OpMatrixTimesScalar:
+      case spv::OpVectorTimesMatrix:
+      case spv::OpMatrixTimesVector:
+      case spv::OpMatrixTimesMatrix:
+      case spv::OpDot:
+      case spv::OpIAddCarry:
+      case spv::OpISubBorrow:
+      case spv::OpUMulExtended:
+      case spv::OpSMulExtended:
+      case spv::OpShiftRightLogical:
+      case spv::OpShiftRightArithmetic:
+      case spv::OpShiftLeftLogical:
+      case spv::OpBitwiseOr:
+      case spv::OpBitwiseXor:
+      case spv::OpBitwiseAnd:
+      case spv::OpNot:
+      case spv::OpBitFieldInsert:
+      case spv::OpBitFieldSExtract:
+      case spv::OpBitFieldUExtract:
+      case spv::OpBitReverse:
+      case spv::OpBitCount:
+      case spv::OpAny:
+      case spv::OpAll:
+      case spv::OpIsNan:
+      case spv::OpIsInf:
+      case spv::OpLogicalEqual:
+      case spv::OpLogicalNotEqual:
+      case spv::OpLogicalOr:
+      case spv::OpLogicalAnd:
+      case spv::OpLogicalNot:
+      case spv::OpSelect:
+      case spv::OpIEqual:
+      case spv::OpINotEqual:
+      case spv::OpUGreaterThan:
+      case spv::OpSGreaterThan:
+      case spv::OpUGreaterThanEqual:
+      case spv::OpSGreaterThanEqual:
+      case spv::OpULessThan:
+      case spv::OpSLessThan:
+      case spv::OpULessThanEqual:
+      case spv::OpSLessThanEqual:
+      case spv::OpFOrdEqual:
+      case spv::OpFUnordEqual:
+      case spv::OpFOrdNotEqual:
+      case spv::OpFUnordNotEqual:
+      case spv::OpFOrdLessThan:
+      case spv::OpFUnordLessThan:
+      case spv::OpFOrdGreaterThan:
+      case spv::OpFUnordGreaterThan:
+      case spv::OpFOrdLessThanEqual:
+      case spv::OpFUnordLessThanEqual:
+      case spv::OpFOrdGreaterThanEqual:
+      case spv::OpFUnordGreaterThanEqual:
+      case spv::OpConvertFToU:
+      case spv::OpConvertFToS:
+      case spv::OpConvertSToF:
+      case spv::OpConvertUToF:
+      case spv::OpUConvert:
+      case spv::OpSConvert:
+      case spv::OpFConvert:
+      case spv::OpBitcast:
+      case spv::OpCopyObject:
+      case spv::OpDPdx:
+      case spv::OpDPdy:
+      case spv::OpFwidth:
+      case spv::OpDPdxFine:
+      case spv::OpDPdyFine:
+      case spv::OpFwidthFine:
+      case spv::OpDPdxCoarse:
+      case spv::OpDPdyCoarse:
+      case spv::OpFwidthCoarse:
+      case spv::OpSampledImage:
+      case spv::OpImage:
+        count = ins.length - first;
+        break;
+
+      default:
+        break;
+    }
+
+    for (uint32_t i = 0; i < count && first + i < ins.length; i++)
+      fn(ins.words[first + i]);
+  }
+
+};
+
+
+static SpirvPassTotals g_passTotals;
+
+static std::string g_spirvVal;
+
+
+static void writeSpirv(const std::string& fileName, const SpirvCodeBuffer& code) {
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(code.data()), code.size());
+}
+
+
+static bool runSpirvVal(const std::string& name, const SpirvCodeBuffer& code) {
+  if (g_spirvVal.empty())
+    return true;
+
+  std::string fileName = str::format(name, ".spv");
+  writeSpirv(fileName, code);
+
+  std::string command = str::format("\"", g_spirvVal, "\" --target-env vulkan1.1 ", fileName);
+  bool success = std::system(command.c_str()) == 0;
+
+  if (success)
+    std::remove(fileName.c_str());
+
+  return success;
+}
+
+
+/**
+ * \brief Runs all pass configurations on a shader
+ *
+ * Invalid output is written to disk alongside the
+ * input module so that failures can be reproduced.
+ * \returns \c true if all outputs are valid
+ */
+static bool testSpirv(const std::string& name, const SpirvCodeBuffer& code) {
+  SpirvValidator validator;
+
+  if (!validator.validate(code) || !runSpirvVal(name, code)) {
+    std::cerr << name << ": Input module is invalid" << std::endl;
+
+    for (const auto& error : validator.errors())
+      std::cerr << "  " << error << std::endl;
+
+    return false;
+  }
+
+  bool success = true;
+
+  for (uint32_t i = 0; i < g_passTotals.size(); i++) {
+    SpirvCodeBuffer optimized = code;
+    SpirvOptimizer optimizer(getPassConfig(i));
+    optimizer.run(optimized);
+
+    SpirvPassTotal& total = g_passTotals[i];
+    total.add(optimizer.stats());
+
+    std::string outputName = str::format(name, ".", i);
+
+    if (!validator.validate(optimized) || !runSpirvVal(outputName, optimized)) {
+      std::cerr << name << ": " << getPassConfigName(i) << " produced invalid code" << std::endl;
+
+      for (const auto& error : validator.errors())
+        std::cerr << "  " << error << std::endl;
+
+      writeSpirv(str::format(name, ".in.spv"), code);
+      writeSpirv(str::format(outputName, ".spv"), optimized);
+
+      total.failures += 1;
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+
+static void compileDxbc(
+  const std::string&        name,
+  const void*               data,
+        size_t              size,
+        std::vector<std::pair<std::string, SpirvCodeBuffer>>& modules) {
+  DxbcReader reader(reinterpret_cast<const char*>(data), size);
+  DxbcModule module(reader);
+
+  DxbcModuleInfo moduleInfo;
+  moduleInfo.options.useSubgroupOpsForAtomicCounters = true;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.minSsboAlignment = 4;
+  moduleInfo.options.optimizeSpirv = false;
+  moduleInfo.tess = nullptr;
+  moduleInfo.xfb = nullptr;
+
+  Rc<DxvkShader> shader = module.compile(moduleInfo, name);
+
+  std::stringstream stream;
+  shader->dump(stream);
+
+  modules.push_back({ name, SpirvCodeBuffer(stream) });
+}
+
+
+static void compileDxso(
+  const std::string&        name,
+  const void*               data,
+        std::vector<std::pair<std::string, SpirvCodeBuffer>>& modules) {
+  DxsoReader reader(reinterpret_cast<const char*>(data));
+  DxsoModule module(reader);
+
+  DxsoModuleInfo moduleInfo;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.strictConstantCopies = false;
+  moduleInfo.options.d3d9FloatEmulation = true;
+  moduleInfo.options.strictPow = true;
+  moduleInfo.options.shaderModel = 3;
+  moduleInfo.options.invariantPosition = false;
+  moduleInfo.options.optimizeSpirv = false;
+
+  D3D9ConstantLayout layout;
+
+  if (module.info().type() == DxsoProgramType::VertexShader) {
+    layout.floatCount = caps::MaxFloatConstantsVS;
+  } else {
+    layout.floatCount = caps::MaxFloatConstantsPS;
+  }
+
+  layout.intCount     = caps::MaxOtherConstants;
+  layout.boolCount    = caps::MaxOtherConstants;
+  layout.bitmaskCount = align(layout.boolCount, 32) / 32;
+
+  module.decode();
+  DxsoAnalysisInfo analysis = module.analyze();
+  DxsoPermutations shaders = module.compile(moduleInfo, name, analysis, layout);
+
+  for (uint32_t i = 0; i < shaders.size(); i++) {
+    if (shaders[i] == nullptr)
+      continue;
+
+    std::stringstream stream;
+    shaders[i]->dump(stream);
+
+    modules.push_back({ str::format(name, "_", i), SpirvCodeBuffer(stream) });
+  }
+}
+
+
+static bool compileTestShader(
+  const TestShader&         shader,
+        std::vector<std::pair<std::string, SpirvCodeBuffer>>& modules) {
+  Com<ID3DBlob> binary;
+  Com<ID3DBlob> errors;
+
+  HRESULT hr = D3DCompile(
+    shader.source,
+    std::strlen(shader.source),
+    shader.name, nullptr, nullptr,
+    "main", shader.target,
+    D3DCOMPILE_OPTIMIZATION_LEVEL3,
+    0, &binary, &errors);
+
+  if (FAILED(hr)) {
+    std::cerr << shader.name << ": Failed to compile HLSL" << std::endl;
+
+    if (errors != nullptr)
+      std::cerr << reinterpret_cast<const char*>(errors->GetBufferPointer()) << std::endl;
+
+    return false;
+  }
+
+  try {
+    if (shader.target[3] == '3')
+      compileDxso(shader.name, binary->GetBufferPointer(), modules);
+    else
+      compileDxbc(shader.name, binary->GetBufferPointer(), binary->GetBufferSize(), modules);
+  } catch (const DxvkError& e) {
+    std::cerr << shader.name << ": " << e.message() << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  int     argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(
+    GetCommandLineW(), &argc);
+
+  std::vector<std::pair<std::string, SpirvCodeBuffer>> modules;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = str::fromws(argv[i]);
+
+    if (arg == "-v" && i + 1 < argc) {
+      g_spirvVal = str::fromws(argv[++i]);
+    } else {
+      std::cerr << "Usage: spirv-optimizer [-v path/to/spirv-val]" << std::endl;
+      return 1;
+    }
+  }
+
+  bool success = true;
+
+  for (const auto& shader : g_testShaders)
+    success &= compileTestShader(shader, modules);
+
+  for (const auto& module : modules) {
+    bool result = testSpirv(module.first, module.second);
+
+    std::cout << std::left << std::setw(32) << module.first
+              << (result ? "OK" : "FAILED") << std::endl;
+
+    success &= result;
+  }
+
+  printPassReport(g_passTotals, true);
+  return success ? 0 : 1;
+}
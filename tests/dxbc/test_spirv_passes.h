@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "../../src/spirv/spirv_optimizer.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Optimizer results for one pass configuration
+   *
+   * Accumulated across all shaders. Each pass is run in
+   * isolation, followed by dead code elimination so that
+   * removed instructions actually affect the code size.
+   */
+  struct SpirvPassTotal {
+    uint64_t dwordsBefore = 0;
+    uint64_t dwordsAfter  = 0;
+    uint64_t changes      = 0;
+    uint64_t timeNs       = 0;
+    uint32_t failures     = 0;
+
+    void add(const SpirvOptStats& stats) {
+      dwordsBefore += stats.dwordsBefore;
+      dwordsAfter  += stats.dwordsAfter;
+
+      for (const auto& pass : stats.passes) {
+        changes += pass.changes;
+        timeNs  += pass.timeNs;
+      }
+    }
+  };
+
+
+  // One entry per pass, plus one for the full pipeline
+  using SpirvPassTotals = std::array<SpirvPassTotal, uint32_t(SpirvOptPass::Count) + 1>;
+
+
+  /**
+   * \brief Queries passes for a configuration
+   *
+   * \param [in] config Index into \c SpirvPassTotals
+   * \returns The pass and dead code elimination, or
+   *    all passes for the last configuration
+   */
+  inline SpirvOptPasses getPassConfig(uint32_t config) {
+    return config < uint32_t(SpirvOptPass::Count)
+      ? SpirvOptPasses(SpirvOptPass(config), SpirvOptPass::DeadCodeElim)
+      : SpirvOptimizer::allPasses();
+  }
+
+
+  /**
+   * \brief Queries name of a pass configuration
+   *
+   * \param [in] config Index into \c SpirvPassTotals
+   * \returns Human-readable name
+   */
+  inline std::string getPassConfigName(uint32_t config) {
+    if (config >= uint32_t(SpirvOptPass::Count))
+      return "All passes";
+
+    std::string name = SpirvOptimizer::passName(SpirvOptPass(config));
+
+    if (SpirvOptPass(config) != SpirvOptPass::DeadCodeElim)
+      name += " + DCE";
+
+    return name;
+  }
+
+
+  /**
+   * \brief Prints per-pass optimizer results
+   *
+   * \param [in] totals Results for all configurations
+   * \param [in] showFailures Whether to print the
+   *    number of modules that failed validation
+   */
+  inline void printPassReport(
+    const SpirvPassTotals&    totals,
+          bool                showFailures) {
+    std::cout << std::fixed << std::setprecision(1) << std::endl
+              << std::left << std::setw(32) << "Optimizer pass"
+              << std::right << std::setw(10) << "Dwords"
+              << std::setw(10) << "Saved"
+              << std::setw(10) << "Changes"
+              << std::setw(10) << "Time";
+
+    if (showFailures)
+      std::cout << std::setw(10) << "Failed";
+
+    std::cout << std::endl;
+
+    for (uint32_t i = 0; i < totals.size(); i++) {
+      const SpirvPassTotal& total = totals[i];
+
+      double saved = total.dwordsBefore
+        ? 100.0 * double(total.dwordsBefore - total.dwordsAfter) / double(total.dwordsBefore)
+        : 0.0;
+
+      std::cout << std::left << std::setw(32) << getPassConfigName(i)
+                << std::right << std::setw(10) << total.dwordsAfter
+                << std::setw(9) << saved << "%"
+                << std::setw(10) << total.changes
+                << std::setw(10) << double(total.timeNs) / 1000.0;
+
+      if (showFailures)
+        std::cout << std::setw(10) << total.failures;
+
+      std::cout << std::endl;
+    }
+  }
+
+}
@@ -0,0 +1,167 @@
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../../src/dxvk/dxvk_concurrent_map.h"
+
+#include "../../src/util/log/log.h"
+#include "../../src/util/util_string.h"
+#include "../../src/util/util_time.h"
+
+#include "../../src/util/thread.h"
+
+#include <shellapi.h>
+#include <windows.h>
+
+namespace dxvk {
+  Logger Logger::s_instance("dxvk-pipeline-map.log");
+}
+
+using namespace dxvk;
+
+/**
+ * \brief Stub pipeline key
+ *
+ * Mimics a shader set, but only
+ * stores a single integer ID.
+ */
+struct TestPipelineKey {
+  uint32_t id;
+
+  bool eq(const TestPipelineKey& other) const {
+    return id == other.id;
+  }
+
+  size_t hash() const {
+    DxvkHashState state;
+    state.add(id);
+    return state;
+  }
+};
+
+/**
+ * \brief Stub pipeline object
+ *
+ * Burns a bit of CPU time on construction in order
+ * to simulate pipeline layout creation, but does not
+ * require a Vulkan device.
+ */
+struct TestPipeline {
+  TestPipeline(uint32_t id)
+  : id(id) {
+    for (uint32_t i = 0; i < 1000; i++)
+      data = data * 31 + i;
+  }
+
+  uint32_t          id;
+  volatile uint32_t data = 0;
+};
+
+/**
+ * \brief Reference implementation
+ *
+ * Same behaviour as the pipeline manager
+ * used to have, with a single mutex.
+ */
+class TestLockedMap {
+
+public:
+
+  TestPipeline* findOrInsert(const TestPipelineKey& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pair = m_map.find(key);
+    if (pair != m_map.end())
+      return &pair->second;
+
+    auto iter = m_map.emplace(
+      std::piecewise_construct,
+      std::tuple(key),
+      std::tuple(key.id));
+    return &iter.first->second;
+  }
+
+private:
+
+  std::mutex m_mutex;
+
+  std::unordered_map<
+    TestPipelineKey, TestPipeline,
+    DxvkHash, DxvkEq> m_map;
+
+};
+
+class TestConcurrentMap {
+
+public:
+
+  TestPipeline* findOrInsert(const TestPipelineKey& key) {
+    return m_map.findOrInsert(key, key.id);
+  }
+
+private:
+
+  DxvkConcurrentMap<
+    TestPipelineKey, TestPipeline,
+    DxvkHash, DxvkEq> m_map;
+
+};
+
+template<typename Map>
+double runTest(uint32_t threadCount, uint32_t keyCount, uint32_t lookupCount) {
+  Map map;
+
+  std::atomic<uint32_t> errors = { 0u };
+  std::vector<dxvk::thread> threads;
+
+  auto t0 = dxvk::high_resolution_clock::now();
+
+  for (uint32_t i = 0; i < threadCount; i++) {
+    threads.emplace_back([&map, &errors, i, keyCount, lookupCount] {
+      // Simple LCG so that every thread hits the
+      // keys in a different, but repeatable order
+      uint32_t seed = 0x1234567u * (i + 1);
+
+      for (uint32_t j = 0; j < lookupCount; j++) {
+        seed = seed * 1103515245u + 12345u;
+
+        TestPipelineKey key = { (seed >> 8) % keyCount };
+        TestPipeline* pipeline = map.findOrInsert(key);
+
+        if (pipeline->id != key.id)
+          errors += 1;
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  auto t1 = dxvk::high_resolution_clock::now();
+
+  if (errors.load())
+    Logger::err(str::format("Lookup returned wrong pipeline ", errors.load(), " times"));
+
+  return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  const uint32_t keyCount    = 2048;
+  const uint32_t lookupCount = 1000000;
+
+  uint32_t maxThreads = dxvk::thread::hardware_concurrency();
+
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    double locked     = runTest<TestLockedMap>    (threads, keyCount, lookupCount);
+    double concurrent = runTest<TestConcurrentMap>(threads, keyCount, lookupCount);
+
+    Logger::info(str::format(threads, " threads: ",
+      "std::mutex: ",        locked,     " ms, ",
+      "DxvkConcurrentMap: ", concurrent, " ms"));
+  }
+
+  return 0;
+}